@@ -0,0 +1,44 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <Arduino.h>
+
+// Pin definitions, as wired on the ClockV1 board (PCB/ClockV1)
+namespace Pins {
+    // TFA module signals, on PORTC (level shifted)
+    constexpr uint8_t RF_BIT = 0; // PC0, demodulated DCF77, not captured yet
+    constexpr uint8_t BA_BIT = 2; // PC2, high during an hour frame
+    constexpr uint8_t MU_BIT = 3; // PC3, hour code
+    
+    // LED1 on PA1, lit while the CPU decodes a frame (active time probe)
+    constexpr uint8_t LED_BIT = 1;
+    
+    // DFR_EN on PB0, high to power the DFPlayer through its high-side switch
+    constexpr uint8_t DFPLAYER_POWER_BIT = 0;
+}
+
+// Clock and capture timers
+namespace CaptureConfig {
+    // The CPU and the TCBs run from the 32kHz ULP oscillator: the timers keep
+    // counting in standby for about a microamp
+    constexpr uint32_t TICKS_PER_SECOND = 32768;
+    
+    // Accuracy of the ULP oscillator, the frame timings are measured against
+    // the BA pulse, only its length is checked against this tolerance
+    constexpr uint32_t CLOCK_TOLERANCE_PERCENT = 25;
+    
+    // MU edges kept per frame, a valid frame has at most 8
+    constexpr uint8_t MAX_FRAME_EDGES = 16;
+}
+
+// Power state trace (see PowerTrace)
+namespace TraceConfig {
+    // The RTC runs from the 32kHz ULP oscillator divided by 32: about a
+    // millisecond per tick, overflowing every 64 seconds
+    constexpr uint16_t TICKS_PER_SECOND = 1024;
+    
+    // Records kept, the oldest overwritten (4 bytes each)
+    constexpr uint8_t NUM_RECORDS = 64;
+}
+
+#endif // CONFIG_H
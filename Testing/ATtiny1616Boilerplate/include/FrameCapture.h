@@ -0,0 +1,69 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include "Config.h"
+
+/**
+ * Hardware capture of the MU/BA hour frames, with the CPU in standby.
+ *
+ * The pins are routed to the timers by the event system, so the edges are
+ * timed by the TCBs whatever the wake-up latency:
+ *   MU (PC3) -> ASYNCCH2 -> TCB0, input capture on event, free running. The
+ *               edge sensitivity is set after each capture from the new
+ *               level, to get both.
+ *   BA (PC2) -> SYNCCH0 -> TCB1, pulse-width measurement: cleared when BA
+ *               rises, BA high time captured when it falls.
+ * A TCB holds a single capture, so each MU edge takes a short interrupt
+ * storing it (only while BA is high); an edge coming before the interrupt
+ * ran is missed, and the frame marked incomplete. The BA capture completes
+ * the frame: its interrupt locates the BA rising edge in the TCB0 time base,
+ * both counters running on the same clock, and the main loop, woken once per
+ * frame, takes the frame with readFrame().
+ */
+class FrameCapture {
+public:
+    // Frame timings, in timer ticks (CaptureConfig::TICKS_PER_SECOND)
+    struct Frame {
+        uint16_t length;     // BA high time
+        uint8_t numEdges;    // MU edges while BA was high
+        bool incomplete;     // Edges missed: too many (MAX_FRAME_EDGES), or too close
+        uint16_t risingMask; // Bit n set if edge n is rising
+        uint16_t edgeTimes[CaptureConfig::MAX_FRAME_EDGES]; // From BA rising
+    };
+    
+    /**
+     * Route the pins to the timers and start them
+     */
+    void begin();
+    
+    /**
+     * Check if a frame is complete, interrupts disabled
+     */
+    bool isFrameReady() const { return frameReady; }
+    
+    /**
+     * Take the complete frame, if any, and start the next one
+     * @param frame Filled with the frame
+     * @return true if a frame was complete
+     */
+    bool readFrame(Frame& frame);
+    
+    // Interrupt handlers (TCB0 and TCB1 vectors)
+    static void handleMuCapture();
+    static void handleBaCapture();
+
+private:
+    // Written by the interrupts
+    volatile bool frameReady = false;
+    volatile uint8_t numEdges = 0;
+    volatile bool incomplete = false;
+    volatile uint16_t risingMask = 0;
+    volatile uint16_t edgeTimes[CaptureConfig::MAX_FRAME_EDGES]; // TCB0 time base
+    volatile uint16_t frameStart = 0;  // BA rising, TCB0 time base
+    volatile uint16_t frameLength = 0; // BA high time
+    
+    // Pointer to the current instance (for the interrupts)
+    static FrameCapture* instance;
+};
+
+#endif // FRAME_CAPTURE_H
@@ -0,0 +1,70 @@
+#ifndef HOUR_FRAME_DECODER_H
+#define HOUR_FRAME_DECODER_H
+
+#include "Config.h"
+#include "FrameCapture.h"
+
+/**
+ * Decoder of the hour frames captured by FrameCapture, as the Sniffer's
+ * HourFrameDecoder.
+ *
+ * BA goes high, 4ms later MU pulses the 0b1TTUUUU code, one bit every 8ms
+ * starting with the leading 1, then a final 4ms high pulse; both fall at the
+ * same time, 64ms after BA rose. The ULP oscillator is not accurate enough to
+ * time the slots on its own, so the edges are scaled to the measured BA high
+ * time, then MU is sampled in the middle of each slot. Every MU edge must be
+ * on the 4ms/8ms grid, within GRID_TOLERANCE: a glitch invalidates the frame
+ * rather than the hour.
+ */
+class HourFrameDecoder {
+public:
+    struct Result {
+        bool valid;        // The frame decoded to an hour
+        int8_t hour;       // 0-23, -1 if invalid
+        int8_t code;       // 7 bits as sent, -1 if the frame is malformed
+        uint16_t maxError; // Largest timing error of an edge against the grid, in us
+    };
+    
+    /**
+     * Decode a frame
+     * @param frame Frame captured
+     * @return true if the frame decoded to an hour
+     */
+    bool decode(const FrameCapture::Frame& frame);
+    
+    /**
+     * Get the result of the last frame decoded
+     */
+    const Result& getLastResult() const { return lastResult; }
+    
+    // Counters from boot
+    uint16_t getFramesDecoded() const { return framesDecoded; }
+    uint16_t getFramesValid() const { return framesValid; }
+
+private:
+    // Protocol timings, in microseconds
+    static constexpr uint32_t START_PULSE = 4000;
+    static constexpr uint32_t BIT_DURATION = 8000;
+    static constexpr uint32_t END_PULSE = 4000;
+    static constexpr uint32_t FRAME_DURATION = 64000;
+    static constexpr uint32_t GRID_TOLERANCE = 2000;
+    static constexpr uint8_t NUM_BITS = 7;
+    
+    // BA high time accepted, in timer ticks
+    static constexpr uint32_t FRAME_TICKS = FRAME_DURATION * CaptureConfig::TICKS_PER_SECOND / 1000000;
+    static constexpr uint32_t FRAME_TICKS_MIN = FRAME_TICKS * (100 - CaptureConfig::CLOCK_TOLERANCE_PERCENT) / 100;
+    static constexpr uint32_t FRAME_TICKS_MAX = FRAME_TICKS * (100 + CaptureConfig::CLOCK_TOLERANCE_PERCENT) / 100;
+    
+    Result lastResult = {false, -1, -1, 0};
+    uint16_t framesDecoded = 0;
+    uint16_t framesValid = 0;
+    
+    /**
+     * Get the level of MU at a time of the frame
+     * @param frame Frame captured
+     * @param time Time from BA rising, in timer ticks
+     */
+    static uint8_t levelAt(const FrameCapture::Frame& frame, uint32_t time);
+};
+
+#endif // HOUR_FRAME_DECODER_H
@@ -0,0 +1,90 @@
+#ifndef POWER_TRACE_H
+#define POWER_TRACE_H
+
+#include "Config.h"
+
+/**
+ * Timestamped power states of the board, replayed on the host by the energy
+ * model of PyGrannyTool (pygrannytool energy).
+ *
+ * Each change of the states (CPU awake, DFPlayer powered, LEDs lit) is stored
+ * as a 4-byte record: the RTC time in the low 24 bits (TraceConfig ticks,
+ * wrapping every 4.5 hours) and the states in the high byte. The RTC keeps
+ * counting in standby on the ULP oscillator, its overflow interrupt extends
+ * the time; the CPU waking for each overflow, consecutive records are never
+ * a wrap apart.
+ *
+ * The records are kept in a ring, the oldest overwritten: on the device the
+ * ring is read over UPDI (see Buffer), in the native build the simulation
+ * takes them as they come with read(). The states are changed by the main
+ * loop only, not from the interrupts.
+ */
+class PowerTrace {
+public:
+    enum State : uint8_t {
+        CPU_ACTIVE = 0x01,
+        DFPLAYER_ON = 0x02,
+        LED1_ON = 0x04,
+        LED2_ON = 0x08
+    };
+    
+    using Record = uint32_t;
+    static constexpr uint8_t TIME_BITS = 24;
+    static constexpr Record TIME_MASK = (1UL << TIME_BITS) - 1;
+    
+    // Memory layout read by the host: little-endian, no padding
+    struct Buffer {
+        uint8_t head;  // Next record written
+        uint8_t count; // Records stored
+        uint16_t lost; // Records overwritten, saturating
+        Record records[TraceConfig::NUM_RECORDS];
+    };
+    
+    /**
+     * Start the RTC and record the initial states
+     */
+    void begin(uint8_t initialStates);
+    
+    /**
+     * Set or clear states, recording the change if any
+     * @param changed States (State bits)
+     * @param on true to set them
+     */
+    void set(uint8_t changed, bool on);
+    
+    /**
+     * Get the current states (State bits)
+     */
+    uint8_t getStates() const { return states; }
+    
+    /**
+     * Get the time, in RTC ticks from begin()
+     */
+    uint32_t now() const;
+    
+    /**
+     * Take the oldest record
+     * @return false if there is none
+     */
+    bool read(Record& record);
+    
+    // Fields of a record
+    static uint32_t timeOf(Record record) { return record & TIME_MASK; }
+    static uint8_t statesOf(Record record) { return record >> TIME_BITS; }
+    
+    // Interrupt handler (RTC overflow vector)
+    static void handleOverflow();
+
+private:
+    Buffer buffer = {};
+    uint8_t states = 0;
+    volatile uint16_t overflows = 0; // High word of the time
+    
+    // Pointer to the current instance (for the interrupt)
+    static PowerTrace* instance;
+    
+    // Store the current states at the current time
+    void record();
+};
+
+#endif // POWER_TRACE_H
@@ -0,0 +1,163 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "Config.h"
+#include "HourFrameDecoder.h"
+#include "PowerTrace.h"
+#include <AvrSim.h>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * Entry point of the native build, running the firmware on the peripheral
+ * model of lib/AvrSim.
+ *
+ * The edges come from Sniffer data files (Signal,Edge,Timestamp[,Micros]),
+ * MU, BA and RF on their ClockV1 pins, or are generated: one frame an hour,
+ * each edge off by a random jitter, the oscillator off by a given error, some
+ * frames with a short MU glitch. Generated frames are checked against the
+ * hour they were made from: a glitched frame may be rejected, never decoded
+ * to a wrong hour.
+ *
+ * The report gives the interrupts taken, the captures lost and the estimated
+ * active CPU time per hour: the cycles of each interrupt, wake-up included,
+ * and of each frame decoded are estimates to be given on the command line.
+ * The decoding keeps the modelled CPU busy for its cycles, so the power
+ * trace, printed as PT lines for pygrannytool energy, has the active time of
+ * the main loop. Native build only.
+ */
+class Simulation {
+public:
+    /**
+     * Constructor
+     * @param decoder Hour decoder of the firmware, for the results
+     * @param trace Power trace of the firmware, taken as it comes
+     */
+    Simulation(HourFrameDecoder& decoder, PowerTrace& trace);
+    
+    /**
+     * Run the firmware
+     * @param argc Number of command line arguments
+     * @param argv Command line arguments (see printUsage())
+     * @return Exit status
+     */
+    int run(int argc, char** argv);
+
+private:
+    // Time the firmware runs before the first edge, in microseconds
+    static constexpr int64_t LEAD_IN_US = 1000000;
+    
+    // Hour frame, in microseconds from BA rising
+    static constexpr int64_t FRAME_INTERVAL_US = 3600000000LL;
+    static constexpr int64_t START_PULSE_US = 4000;
+    static constexpr int64_t BIT_DURATION_US = 8000;
+    static constexpr int64_t FRAME_DURATION_US = 64000;
+    static constexpr int64_t GLITCH_DURATION_US = 1000;
+    static constexpr int64_t GLITCH_MARGIN_US = 500; // Off the grid by more than the decoder tolerates
+    static constexpr int NUM_BITS = 7;
+    
+    // A decoded frame ends at most this long after BA falls
+    static constexpr int64_t DECODE_DELAY_MAX_US = 100000;
+    
+    // Generated frame
+    struct TruthFrame {
+        int64_t endTime; // BA falling, in microseconds
+        int hour;
+        bool glitched;
+    };
+    
+    HourFrameDecoder& hourDecoder;
+    PowerTrace& powerTrace;
+    
+    // Options
+    int synthHours = 0;
+    int64_t jitterUs = 300;
+    double glitchRate = 0.0;
+    double clockError = 0.0;
+    uint32_t interruptCycles = 80;
+    uint32_t decodeCycles = 1500;
+    uint32_t seed = 0;
+    bool quiet = false;
+    bool printTrace = false;
+    std::vector<std::string> files;
+    
+    // Edge sources
+    std::mt19937 random;
+    std::vector<AvrSim::Edge> frameEdges; // Generated frame, reversed
+    int framesGenerated = 0;
+    std::vector<TruthFrame> truth;
+    size_t truthIndex = 0;
+    size_t fileIndex = 0;
+    FILE* file = nullptr;
+    int signalColumn = -1;
+    int edgeColumn = -1;
+    int timestampColumn = -1;
+    int microsColumn = -1;
+    int64_t fileOffset = 0; // Stitching the timestamp resets
+    int64_t previousTime = -1;
+    int64_t firstTime = -1;
+    int64_t lastTime = 0;
+    
+    // Results
+    uint32_t framesDecoded = 0;
+    uint32_t framesValid = 0;
+    uint32_t framesCorrect = 0;
+    uint32_t framesWrong = 0;
+    uint32_t cleanRejected = 0;
+    uint32_t glitchedRejected = 0;
+    uint32_t framesMissed = 0;
+    uint32_t traceRecords = 0;
+    
+    /**
+     * Parse the command line
+     * @return true if valid
+     */
+    bool parseArguments(int argc, char** argv);
+    
+    /**
+     * Print the command line help
+     */
+    void printUsage(const char* program) const;
+    
+    /**
+     * Get the next edge, generated or read
+     * @return false after the last one
+     */
+    bool nextEdge(AvrSim::Edge& edge);
+    
+    /**
+     * Generate the edges of the next hour frame
+     * @return false after the last one
+     */
+    bool generateFrame();
+    
+    /**
+     * Open the next data file and find its columns
+     * @return false after the last one
+     */
+    bool openNextFile();
+    
+    /**
+     * Read the next edge of the data files
+     * @return false at the end of the last file
+     */
+    bool readEdge(AvrSim::Edge& edge);
+    
+    /**
+     * Print and check the frame just decoded
+     */
+    void checkFrame();
+    
+    /**
+     * Take the power trace records, printing them if asked
+     */
+    void readTrace();
+    
+    /**
+     * Print the measurements
+     */
+    void printReport() const;
+};
+
+#endif // SIMULATION_H
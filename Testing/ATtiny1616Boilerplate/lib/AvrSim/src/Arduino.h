@@ -0,0 +1,25 @@
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#define LOW 0x0
+#define HIGH 0x1
+
+/*
+ * Subset of megaTinyCore used by the firmware, for the native build: the
+ * firmware drives the registers itself, setup() and loop() are run by the
+ * simulation.
+ */
+
+void setup();
+void loop();
+
+#endif // NATIVE_ARDUINO_H
@@ -0,0 +1,387 @@
+#include "AvrSim.h"
+#include <avr/interrupt.h>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+VPORT_t VPORTA;
+VPORT_t VPORTB;
+VPORT_t VPORTC;
+PORT_t PORTA;
+PORT_t PORTB;
+PORT_t PORTC;
+CLKCTRL_t CLKCTRL;
+SLPCTRL_t SLPCTRL;
+EVSYS_t EVSYS;
+TCB_t TCB0(0);
+TCB_t TCB1(1);
+RTC_t RTC;
+AvrSim::StatusRegister SREG;
+
+// Vectors the firmware does not define
+extern "C" __attribute__((weak)) void AvrSim_TCB0_INT_vect(void) {
+    fprintf(stderr, "TCB0 interrupt without vector\n");
+}
+
+extern "C" __attribute__((weak)) void AvrSim_TCB1_INT_vect(void) {
+    fprintf(stderr, "TCB1 interrupt without vector\n");
+}
+
+extern "C" __attribute__((weak)) void AvrSim_RTC_CNT_vect(void) {
+    fprintf(stderr, "RTC interrupt without vector\n");
+}
+
+namespace {
+    constexpr int64_t NEVER = std::numeric_limits<int64_t>::max();
+    constexpr uint8_t NO_PIN = 0xFF;
+    
+    // Interrupt source after the TCBs
+    constexpr int RTC_INTERRUPT = AvrSim::NUM_TIMERS;
+    
+    // Oscillators, in Hz
+    constexpr double OSC20M_FREQUENCY = 20000000.0;
+    constexpr double OSCULP32K_FREQUENCY = 32768.0;
+    
+    // Main clock prescaler, by PDIV
+    constexpr uint8_t PRESCALER_DIVISIONS[16] = {2, 4, 8, 16, 32, 64, 1, 1, 6, 10, 12, 24, 48, 1, 1, 1};
+    
+    VPORT_t* const VPORTS[] = {&VPORTA, &VPORTB, &VPORTC};
+    PORT_t* const PORTS[] = {&PORTA, &PORTB, &PORTC};
+    TCB_t* const TIMERS[AvrSim::NUM_TIMERS] = {&TCB0, &TCB1};
+    void (*const VECTORS[AvrSim::NUM_TIMERS + 1])() = {AvrSim_TCB0_INT_vect, AvrSim_TCB1_INT_vect,
+                                                       AvrSim_RTC_CNT_vect};
+    
+    struct TimerState {
+        int64_t zeroTicks;   // Clock ticks at which the counter was 0
+        int64_t captureTime; // Time of the last capture, in microseconds
+    };
+    
+    double oscillatorError = 0.0;
+    uint32_t cyclesPerInterrupt = 0;
+    int64_t timeUs = 0;
+    int64_t cpuFreeUs = 0; // End of the interrupt running
+    bool interruptsEnabled = false;
+    bool sleeping = false;
+    bool done = false;
+    TimerState timers[AvrSim::NUM_TIMERS] = {};
+    int64_t rtcOverflows = 0;  // Overflows flagged so far
+    int64_t rtcFlagTime = 0;   // Time of the overflow flagged
+    AvrSim::Stats stats = {};
+    
+    AvrSim::EdgeSource edgeSource;
+    AvrSim::Edge nextEdge = {};
+    bool hasNextEdge = false;
+    
+    // Event user register of a TCB
+    uint8_t eventUser(uint8_t timer) {
+        return timer == 0 ? EVSYS.ASYNCUSER0 : EVSYS.ASYNCUSER11;
+    }
+    
+    /**
+     * Find the pin generating the events of a user, through its channel
+     * @param user Event user register value
+     * @param port Port of the pin
+     * @return Pin in the port, NO_PIN if none
+     */
+    uint8_t eventPin(uint8_t user, uint8_t& port) {
+        port = AvrSim::PORT_C;
+        if (user == EVSYS_ASYNCUSER0_SYNCCH0_gc && EVSYS.SYNCCH0 >= EVSYS_SYNCCH0_PORTC_PIN0_gc &&
+            EVSYS.SYNCCH0 <= EVSYS_SYNCCH0_PORTC_PIN5_gc) {
+            return EVSYS.SYNCCH0 - EVSYS_SYNCCH0_PORTC_PIN0_gc;
+        }
+        if (user == EVSYS_ASYNCUSER0_ASYNCCH2_gc && EVSYS.ASYNCCH2 >= EVSYS_ASYNCCH2_PORTC_PIN0_gc &&
+            EVSYS.ASYNCCH2 <= EVSYS_ASYNCCH2_PORTC_PIN5_gc) {
+            return EVSYS.ASYNCCH2 - EVSYS_ASYNCCH2_PORTC_PIN0_gc;
+        }
+        return NO_PIN;
+    }
+    
+    // Main clock ticks elapsed at a time
+    int64_t ticksAt(int64_t time) {
+        return static_cast<int64_t>(std::floor(time * AvrSim::clockFrequency() / 1000000.0));
+    }
+    
+    uint16_t counterAt(uint8_t timer, int64_t time) {
+        return static_cast<uint16_t>(ticksAt(time) - timers[timer].zeroTicks);
+    }
+    
+    // RTC clock, the ULP oscillator through the prescaler
+    double rtcFrequency() {
+        return OSCULP32K_FREQUENCY * (1.0 + oscillatorError) / (1 << ((RTC.CTRLA & RTC_PRESCALER_gm) >> 3));
+    }
+    
+    // Time of an RTC overflow, from the start
+    int64_t rtcOverflowTime(int64_t overflow) {
+        return static_cast<int64_t>(std::ceil(overflow * (RTC.PER + 1.0) * 1000000.0 / rtcFrequency()));
+    }
+    
+    // Time of the next RTC overflow not flagged yet
+    int64_t nextRtcOverflow() {
+        return (RTC.CTRLA & RTC_RTCEN_bm) ? rtcOverflowTime(rtcOverflows + 1) : NEVER;
+    }
+    
+    // Flag the RTC overflows up to a time, an overflow flagged and not served
+    // yet hides the next ones
+    void updateRtc(int64_t time) {
+        for (int64_t overflowTime = nextRtcOverflow(); overflowTime <= time; overflowTime = nextRtcOverflow()) {
+            if (!(RTC.INTFLAGS & RTC_OVF_bm)) {
+                RTC.INTFLAGS.set(RTC_OVF_bm);
+                rtcFlagTime = overflowTime;
+            }
+            rtcOverflows++;
+        }
+    }
+    
+    void capture(uint8_t timer, int64_t time) {
+        TCB_t& tcb = *TIMERS[timer];
+        if (tcb.INTFLAGS & TCB_CAPT_bm) {
+            stats.overruns[timer]++;
+        }
+        tcb.CCMP = counterAt(timer, time);
+        tcb.INTFLAGS.set(TCB_CAPT_bm);
+        timers[timer].captureTime = time;
+    }
+    
+    void applyEdge(const AvrSim::Edge& edge) {
+        timeUs = edge.time > timeUs ? edge.time : timeUs;
+        if (edge.port >= sizeof(VPORTS) / sizeof(VPORTS[0]) || edge.bit >= 8) {
+            return;
+        }
+        
+        // A disabled input buffer reads low and generates no event
+        VPORT_t& vport = *VPORTS[edge.port];
+        uint8_t mask = 1 << edge.bit;
+        uint8_t pinControl = (&PORTS[edge.port]->PIN0CTRL)[edge.bit];
+        if ((pinControl & PORT_ISC_gm) == PORT_ISC_INPUT_DISABLE_gc) {
+            vport.IN &= ~mask;
+            return;
+        }
+        uint8_t previousLevel = (vport.IN & mask) ? 1 : 0;
+        vport.IN = edge.level ? (vport.IN | mask) : (vport.IN & ~mask);
+        if (previousLevel == edge.level) {
+            return;
+        }
+        
+        bool standby = sleeping && (SLPCTRL.CTRLA & SLPCTRL_SMODE_gm) != SLPCTRL_SMODE_IDLE_gc;
+        for (uint8_t timer = 0; timer < AvrSim::NUM_TIMERS; timer++) {
+            TCB_t& tcb = *TIMERS[timer];
+            uint8_t port;
+            if (!(tcb.CTRLA & TCB_ENABLE_bm) || !(tcb.EVCTRL & TCB_CAPTEI_bm) ||
+                eventPin(eventUser(timer), port) != edge.bit || port != edge.port) {
+                continue;
+            }
+            
+            // TCA does not run in standby
+            if (standby && (!(tcb.CTRLA & TCB_RUNSTDBY_bm) || (tcb.CTRLA & TCB_CLKSEL_gm) == TCB_CLKSEL_CLKTCA_gc)) {
+                stats.standbyLosses++;
+                continue;
+            }
+            
+            // EDGE inverts the event
+            bool positive = (edge.level != 0) != ((tcb.EVCTRL & TCB_EDGE_bm) != 0);
+            switch (tcb.CTRLB & TCB_CNTMODE_gm) {
+                case TCB_CNTMODE_CAPT_gc:
+                    if (positive) {
+                        capture(timer, edge.time);
+                    }
+                    break;
+                case TCB_CNTMODE_PW_gc:
+                    // Cleared on the positive edge, captured on the negative one
+                    if (positive) {
+                        timers[timer].zeroTicks = ticksAt(edge.time);
+                    } else {
+                        capture(timer, edge.time);
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+    
+    // Next interrupt to run and its start time, -1 if none
+    int nextInterrupt(int64_t& startTime) {
+        int next = -1;
+        startTime = NEVER;
+        
+        // The RTC has the higher priority
+        if ((RTC.INTFLAGS & RTC_OVF_bm) && (RTC.INTCTRL & RTC_OVF_bm)) {
+            startTime = rtcFlagTime > cpuFreeUs ? rtcFlagTime : cpuFreeUs;
+            next = RTC_INTERRUPT;
+        }
+        for (uint8_t timer = 0; timer < AvrSim::NUM_TIMERS; timer++) {
+            TCB_t& tcb = *TIMERS[timer];
+            if ((tcb.INTFLAGS & TCB_CAPT_bm) && (tcb.INTCTRL & TCB_CAPT_bm)) {
+                int64_t start = timers[timer].captureTime > cpuFreeUs ? timers[timer].captureTime : cpuFreeUs;
+                if (start < startTime) {
+                    startTime = start;
+                    next = timer;
+                }
+            }
+        }
+        return next;
+    }
+    
+    void runInterrupt(int source, int64_t startTime) {
+        timeUs = startTime;
+        interruptsEnabled = false;
+        VECTORS[source]();
+        interruptsEnabled = true;
+        if (source == RTC_INTERRUPT) {
+            stats.rtcInterrupts++;
+        } else {
+            stats.interrupts[source]++;
+        }
+        stats.interruptCycles += cyclesPerInterrupt;
+        cpuFreeUs = startTime + static_cast<int64_t>(cyclesPerInterrupt * 1000000.0 / AvrSim::clockFrequency());
+        timeUs = cpuFreeUs;
+        
+        // The vector would run again forever
+        if (source == RTC_INTERRUPT) {
+            if (RTC.INTFLAGS & RTC_OVF_bm) {
+                fprintf(stderr, "RTC interrupt left its flag set\n");
+                RTC.INTFLAGS = RTC_OVF_bm;
+            }
+            return;
+        }
+        TCB_t& tcb = *TIMERS[source];
+        if (tcb.INTFLAGS & TCB_CAPT_bm) {
+            fprintf(stderr, "TCB%d interrupt left its flag set\n", source);
+            tcb.INTFLAGS = TCB_CAPT_bm;
+        }
+    }
+}
+
+namespace AvrSim {
+    CounterRegister::operator uint16_t() const {
+        return counterAt(timer, timeUs);
+    }
+    
+    CounterRegister& CounterRegister::operator=(uint16_t value) {
+        timers[timer].zeroTicks = ticksAt(timeUs) - value;
+        return *this;
+    }
+    
+    RtcCounterRegister::operator uint16_t() const {
+        if (!(RTC.CTRLA & RTC_RTCEN_bm)) {
+            return 0;
+        }
+        
+        // The overflow flag follows the counter
+        updateRtc(timeUs);
+        int64_t ticks = static_cast<int64_t>(std::floor(timeUs * rtcFrequency() / 1000000.0)) -
+                        rtcOverflows * (RTC.PER + 1);
+        return static_cast<uint16_t>(ticks < 0 ? 0 : (ticks > RTC.PER ? RTC.PER : ticks));
+    }
+    
+    StatusRegister::operator uint8_t() const {
+        return interruptsEnabled ? CPU_I_bm : 0;
+    }
+    
+    StatusRegister& StatusRegister::operator=(uint8_t value) {
+        interruptsEnabled = (value & CPU_I_bm) != 0;
+        return *this;
+    }
+    
+    void begin(double clockError, uint32_t interruptCycles) {
+        oscillatorError = clockError;
+        cyclesPerInterrupt = interruptCycles;
+        timeUs = 0;
+        cpuFreeUs = 0;
+        done = false;
+        hasNextEdge = false;
+        stats = {};
+        for (TimerState& timer : timers) {
+            timer = {};
+        }
+        rtcOverflows = 0;
+        rtcFlagTime = 0;
+        
+        // The core enables the interrupts before setup()
+        interruptsEnabled = true;
+    }
+    
+    void setPin(uint8_t port, uint8_t bit, uint8_t level) {
+        if (port < sizeof(VPORTS) / sizeof(VPORTS[0]) && bit < 8) {
+            VPORT_t& vport = *VPORTS[port];
+            vport.IN = level ? (vport.IN | (1 << bit)) : (vport.IN & ~(1 << bit));
+        }
+    }
+    
+    void setEdgeSource(EdgeSource source) {
+        edgeSource = source;
+    }
+    
+    int64_t now() {
+        return timeUs;
+    }
+    
+    double clockFrequency() {
+        double frequency = (CLKCTRL.MCLKCTRLA & CLKCTRL_CLKSEL_gm) == CLKCTRL_CLKSEL_OSCULP32K_gc ?
+                           OSCULP32K_FREQUENCY : OSC20M_FREQUENCY;
+        if (CLKCTRL.MCLKCTRLB & CLKCTRL_PEN_bm) {
+            frequency /= PRESCALER_DIVISIONS[(CLKCTRL.MCLKCTRLB & CLKCTRL_PDIV_gm) >> 1];
+        }
+        return frequency * (1.0 + oscillatorError);
+    }
+    
+    void setInterruptsEnabled(bool enabled) {
+        interruptsEnabled = enabled;
+    }
+    
+    void runCycles(uint32_t cycles) {
+        int64_t start = timeUs > cpuFreeUs ? timeUs : cpuFreeUs;
+        cpuFreeUs = start + static_cast<int64_t>(cycles * 1000000.0 / clockFrequency());
+        timeUs = cpuFreeUs;
+    }
+    
+    void sleepCpu() {
+        if (!(SLPCTRL.CTRLA & SLPCTRL_SEN_bm) || done) {
+            return;
+        }
+        if (!interruptsEnabled) {
+            fprintf(stderr, "Sleeping with the interrupts disabled, the CPU never wakes up\n");
+            done = true;
+            return;
+        }
+        
+        sleeping = true;
+        while (true) {
+            int64_t startTime;
+            int source = nextInterrupt(startTime);
+            int64_t overflowTime = nextRtcOverflow();
+            if (!hasNextEdge) {
+                hasNextEdge = edgeSource && edgeSource(nextEdge);
+            }
+            
+            // Edges before the interrupt starts are captured first
+            if (hasNextEdge && nextEdge.time < startTime && nextEdge.time < overflowTime) {
+                applyEdge(nextEdge);
+                hasNextEdge = false;
+                continue;
+            }
+            
+            // Out of edges, the RTC alone would run forever
+            if (!hasNextEdge && source < 0) {
+                done = true;
+                break;
+            }
+            if (overflowTime < startTime) {
+                updateRtc(overflowTime);
+                continue;
+            }
+            runInterrupt(source, startTime);
+            stats.wakeups++;
+            break;
+        }
+        sleeping = false;
+    }
+    
+    bool finished() {
+        return done;
+    }
+    
+    const Stats& getStats() {
+        return stats;
+    }
+}
@@ -0,0 +1,108 @@
+#ifndef AVR_SIM_H
+#define AVR_SIM_H
+
+#include <avr/io.h>
+#include <cstdint>
+#include <functional>
+
+/**
+ * Host side of the native build, standing for the ATtiny1616 peripherals the
+ * firmware uses.
+ *
+ * Time is driven by the edges: the firmware runs setup() and loop() in no
+ * time, sleep_cpu() applies the next edges to the input pins until one raises
+ * an enabled interrupt, then runs its vector and returns, as the CPU waking
+ * up. Pins are routed through the event system to the TCBs as configured in
+ * the registers: a TCB captures its counter, on the modelled clock
+ * (CLKCTRL), in input capture or pulse-width mode, and a TCB not running in
+ * standby misses the events while the CPU sleeps. The RTC counts from the
+ * start on the ULP oscillator and flags its overflows. Each interrupt keeps
+ * the CPU busy for a given number of cycles, a capture made before the
+ * interrupt of the previous one could run overwrites it.
+ */
+namespace AvrSim {
+    constexpr uint8_t NUM_TIMERS = 2;
+    
+    enum Port : uint8_t {
+        PORT_A = 0,
+        PORT_B = 1,
+        PORT_C = 2
+    };
+    
+    // Edge on an input pin
+    struct Edge {
+        int64_t time; // Microseconds
+        uint8_t port; // Port
+        uint8_t bit;  // Pin in the port
+        uint8_t level;
+    };
+    
+    // Gives the edges in time order, false after the last one
+    using EdgeSource = std::function<bool(Edge&)>;
+    
+    struct Stats {
+        uint32_t interrupts[NUM_TIMERS]; // By TCB
+        uint32_t rtcInterrupts;          // RTC overflows served
+        uint32_t overruns[NUM_TIMERS];   // Captures overwritten before their interrupt ran
+        uint32_t standbyLosses;          // Events missed by a TCB stopped in standby
+        uint32_t wakeups;                // Returns from sleep_cpu()
+        uint64_t interruptCycles;        // CPU cycles spent in the interrupts, wake-up included
+    };
+    
+    /**
+     * Reset the model
+     * @param clockError Relative error of the oscillators (0.1 for 10% fast)
+     * @param interruptCycles CPU cycles per interrupt, wake-up included
+     */
+    void begin(double clockError, uint32_t interruptCycles);
+    
+    /**
+     * Set the level of an input pin, without event (before setup())
+     */
+    void setPin(uint8_t port, uint8_t bit, uint8_t level);
+    
+    /**
+     * Set where sleep_cpu() reads the edges from
+     */
+    void setEdgeSource(EdgeSource source);
+    
+    /**
+     * Get the time, in microseconds
+     */
+    int64_t now();
+    
+    /**
+     * Get the main clock frequency, the CPU and the peripherals, in Hz
+     */
+    double clockFrequency();
+    
+    /**
+     * Enable or disable the interrupts (sei()/cli())
+     */
+    void setInterruptsEnabled(bool enabled);
+    
+    /**
+     * Keep the CPU busy, the firmware code running in no time otherwise
+     * @param cycles CPU cycles
+     */
+    void runCycles(uint32_t cycles);
+    
+    /**
+     * Sleep in the mode of SLPCTRL until an interrupt ran (sleep_cpu()).
+     * Returns at once if sleep is not enabled, or when the edges run out
+     * (the RTC alone does not keep the model running).
+     */
+    void sleepCpu();
+    
+    /**
+     * Check if the edges ran out, the firmware sleeping forever
+     */
+    bool finished();
+    
+    /**
+     * Get the counters since begin()
+     */
+    const Stats& getStats();
+}
+
+#endif // AVR_SIM_H
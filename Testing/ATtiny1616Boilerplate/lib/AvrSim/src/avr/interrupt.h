@@ -0,0 +1,19 @@
+#ifndef NATIVE_AVR_INTERRUPT_H
+#define NATIVE_AVR_INTERRUPT_H
+
+#include "AvrSim.h"
+
+/*
+ * Interrupt vectors are plain functions, run by AvrSim while the CPU sleeps
+ */
+
+#define ISR(vector) extern "C" void vector(void)
+
+#define TCB0_INT_vect AvrSim_TCB0_INT_vect
+#define TCB1_INT_vect AvrSim_TCB1_INT_vect
+#define RTC_CNT_vect AvrSim_RTC_CNT_vect
+
+#define sei() AvrSim::setInterruptsEnabled(true)
+#define cli() AvrSim::setInterruptsEnabled(false)
+
+#endif // NATIVE_AVR_INTERRUPT_H
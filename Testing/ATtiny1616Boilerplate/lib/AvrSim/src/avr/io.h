@@ -0,0 +1,224 @@
+#ifndef NATIVE_AVR_IO_H
+#define NATIVE_AVR_IO_H
+
+#include <cstdint>
+
+/*
+ * Subset of the ATtiny1616 registers used by the firmware, for the native
+ * build, with the names and values of the device header. Most registers are
+ * plain memory, the ones with side effects (timer counters, flags cleared by
+ * writing one) are modelled by AvrSim.h.
+ */
+
+namespace AvrSim {
+    /**
+     * Interrupt flags, cleared by writing one
+     */
+    class FlagRegister {
+    public:
+        operator uint8_t() const { return value; }
+        FlagRegister& operator=(uint8_t mask) { value &= ~mask; return *this; }
+        
+        // Set by the peripheral
+        void set(uint8_t mask) { value |= mask; }
+    
+    private:
+        uint8_t value = 0;
+    };
+    
+    /**
+     * Counter of a TCB, running on the peripheral clock
+     */
+    class CounterRegister {
+    public:
+        explicit CounterRegister(uint8_t timerIndex) : timer(timerIndex) {}
+        operator uint16_t() const;
+        CounterRegister& operator=(uint16_t value);
+    
+    private:
+        uint8_t timer;
+    };
+    
+    /**
+     * Counter of the RTC, running on its own clock
+     */
+    class RtcCounterRegister {
+    public:
+        operator uint16_t() const;
+    };
+    
+    /**
+     * Status register, only the global interrupt flag is modelled
+     */
+    class StatusRegister {
+    public:
+        operator uint8_t() const;
+        StatusRegister& operator=(uint8_t value);
+    };
+}
+
+#define _BV(bit) (1 << (bit))
+
+// Pin bits
+#define PIN0_bm 0x01
+#define PIN1_bm 0x02
+#define PIN2_bm 0x04
+#define PIN3_bm 0x08
+#define PIN4_bm 0x10
+#define PIN5_bm 0x20
+#define PIN6_bm 0x40
+#define PIN7_bm 0x80
+
+// Virtual ports
+struct VPORT_t {
+    uint8_t DIR = 0;
+    uint8_t OUT = 0;
+    uint8_t IN = 0;
+    uint8_t INTFLAGS = 0;
+};
+
+// Ports, the set/clear/toggle registers are not modelled (use VPORTx)
+struct PORT_t {
+    uint8_t PIN0CTRL = 0;
+    uint8_t PIN1CTRL = 0;
+    uint8_t PIN2CTRL = 0;
+    uint8_t PIN3CTRL = 0;
+    uint8_t PIN4CTRL = 0;
+    uint8_t PIN5CTRL = 0;
+    uint8_t PIN6CTRL = 0;
+    uint8_t PIN7CTRL = 0;
+};
+
+#define PORT_ISC_gm 0x07
+#define PORT_ISC_INTDISABLE_gc 0x00
+#define PORT_ISC_INPUT_DISABLE_gc 0x04
+#define PORT_PULLUPEN_bm 0x08
+
+// Clock controller
+struct CLKCTRL_t {
+    uint8_t MCLKCTRLA = 0x00;
+    uint8_t MCLKCTRLB = 0x11; // 20MHz / 6 out of reset
+    uint8_t MCLKLOCK = 0;
+    uint8_t MCLKSTATUS = 0;
+};
+
+#define CLKCTRL_CLKSEL_gm 0x03
+#define CLKCTRL_CLKSEL_OSC20M_gc 0x00
+#define CLKCTRL_CLKSEL_OSCULP32K_gc 0x01
+#define CLKCTRL_PEN_bm 0x01
+#define CLKCTRL_PDIV_gm 0x1E
+#define CLKCTRL_SOSC_bm 0x01
+
+// Sleep controller
+struct SLPCTRL_t {
+    uint8_t CTRLA = 0;
+};
+
+#define SLPCTRL_SEN_bm 0x01
+#define SLPCTRL_SMODE_gm 0x06
+#define SLPCTRL_SMODE_IDLE_gc 0x00
+#define SLPCTRL_SMODE_STDBY_gc 0x02
+#define SLPCTRL_SMODE_PDOWN_gc 0x04
+
+// Event system, only the channels and users the firmware can route
+struct EVSYS_t {
+    uint8_t ASYNCCH0 = 0;
+    uint8_t ASYNCCH1 = 0;
+    uint8_t ASYNCCH2 = 0;
+    uint8_t ASYNCCH3 = 0;
+    uint8_t SYNCCH0 = 0;
+    uint8_t SYNCCH1 = 0;
+    uint8_t ASYNCUSER0 = 0;  // TCB0
+    uint8_t ASYNCUSER11 = 0; // TCB1
+};
+
+#define EVSYS_ASYNCCH2_PORTC_PIN0_gc 0x0A
+#define EVSYS_ASYNCCH2_PORTC_PIN1_gc 0x0B
+#define EVSYS_ASYNCCH2_PORTC_PIN2_gc 0x0C
+#define EVSYS_ASYNCCH2_PORTC_PIN3_gc 0x0D
+#define EVSYS_ASYNCCH2_PORTC_PIN4_gc 0x0E
+#define EVSYS_ASYNCCH2_PORTC_PIN5_gc 0x0F
+#define EVSYS_SYNCCH0_PORTC_PIN0_gc 0x07
+#define EVSYS_SYNCCH0_PORTC_PIN1_gc 0x08
+#define EVSYS_SYNCCH0_PORTC_PIN2_gc 0x09
+#define EVSYS_SYNCCH0_PORTC_PIN3_gc 0x0A
+#define EVSYS_SYNCCH0_PORTC_PIN4_gc 0x0B
+#define EVSYS_SYNCCH0_PORTC_PIN5_gc 0x0C
+#define EVSYS_ASYNCUSER0_SYNCCH0_gc 0x01
+#define EVSYS_ASYNCUSER0_ASYNCCH2_gc 0x05
+#define EVSYS_ASYNCUSER11_SYNCCH0_gc 0x01
+#define EVSYS_ASYNCUSER11_ASYNCCH2_gc 0x05
+
+// 16-bit timer/counter type B
+struct TCB_t {
+    explicit TCB_t(uint8_t index) : CNT(index) {}
+    
+    uint8_t CTRLA = 0;
+    uint8_t CTRLB = 0;
+    uint8_t EVCTRL = 0;
+    uint8_t INTCTRL = 0;
+    AvrSim::FlagRegister INTFLAGS;
+    uint8_t STATUS = 0;
+    AvrSim::CounterRegister CNT;
+    uint16_t CCMP = 0;
+};
+
+#define TCB_ENABLE_bm 0x01
+#define TCB_CLKSEL_gm 0x06
+#define TCB_CLKSEL_CLKDIV1_gc 0x00
+#define TCB_CLKSEL_CLKDIV2_gc 0x02
+#define TCB_CLKSEL_CLKTCA_gc 0x04
+#define TCB_RUNSTDBY_bm 0x40
+#define TCB_CNTMODE_gm 0x07
+#define TCB_CNTMODE_INT_gc 0x00
+#define TCB_CNTMODE_CAPT_gc 0x02
+#define TCB_CNTMODE_PW_gc 0x04
+#define TCB_CAPTEI_bm 0x01
+#define TCB_EDGE_bm 0x10
+#define TCB_FILTER_bm 0x40
+#define TCB_CAPT_bm 0x01
+
+// Real-time counter, the counter is read-only here and starts at 0 when the
+// model starts
+struct RTC_t {
+    uint8_t CTRLA = 0;
+    uint8_t STATUS = 0;
+    uint8_t INTCTRL = 0;
+    AvrSim::FlagRegister INTFLAGS;
+    uint8_t CLKSEL = 0;
+    AvrSim::RtcCounterRegister CNT;
+    uint16_t PER = 0xFFFF;
+};
+
+#define RTC_RTCEN_bm 0x01
+#define RTC_PRESCALER_gm 0x78
+#define RTC_PRESCALER_DIV1_gc 0x00
+#define RTC_PRESCALER_DIV32_gc 0x28
+#define RTC_PRESCALER_DIV1024_gc 0x50
+#define RTC_RUNSTDBY_bm 0x80
+#define RTC_CTRLABUSY_bm 0x01
+#define RTC_PERBUSY_bm 0x04
+#define RTC_OVF_bm 0x01
+#define RTC_CLKSEL_gm 0x03
+#define RTC_CLKSEL_INT32K_gc 0x00
+
+#define CPU_I_bm 0x80
+
+extern VPORT_t VPORTA;
+extern VPORT_t VPORTB;
+extern VPORT_t VPORTC;
+extern PORT_t PORTA;
+extern PORT_t PORTB;
+extern PORT_t PORTC;
+extern CLKCTRL_t CLKCTRL;
+extern SLPCTRL_t SLPCTRL;
+extern EVSYS_t EVSYS;
+extern TCB_t TCB0;
+extern TCB_t TCB1;
+extern RTC_t RTC;
+extern AvrSim::StatusRegister SREG;
+
+// Configuration change protection is not modelled
+#define _PROTECTED_WRITE(reg, value) ((reg) = (value))
+
+#endif // NATIVE_AVR_IO_H
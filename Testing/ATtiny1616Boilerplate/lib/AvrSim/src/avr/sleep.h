@@ -0,0 +1,17 @@
+#ifndef NATIVE_AVR_SLEEP_H
+#define NATIVE_AVR_SLEEP_H
+
+#include "AvrSim.h"
+
+#define SLEEP_MODE_IDLE SLPCTRL_SMODE_IDLE_gc
+#define SLEEP_MODE_STANDBY SLPCTRL_SMODE_STDBY_gc
+#define SLEEP_MODE_PWR_DOWN SLPCTRL_SMODE_PDOWN_gc
+
+#define set_sleep_mode(mode) (SLPCTRL.CTRLA = (SLPCTRL.CTRLA & ~SLPCTRL_SMODE_gm) | (mode))
+#define sleep_enable() (SLPCTRL.CTRLA |= SLPCTRL_SEN_bm)
+#define sleep_disable() (SLPCTRL.CTRLA &= ~SLPCTRL_SEN_bm)
+
+// Runs the edges until an interrupt wakes the CPU (see AvrSim::sleepCpu())
+#define sleep_cpu() AvrSim::sleepCpu()
+
+#endif // NATIVE_AVR_SLEEP_H
@@ -0,0 +1,104 @@
+#include "FrameCapture.h"
+#include <avr/interrupt.h>
+
+FrameCapture* FrameCapture::instance = nullptr;
+
+ISR(TCB0_INT_vect) {
+    FrameCapture::handleMuCapture();
+}
+
+ISR(TCB1_INT_vect) {
+    FrameCapture::handleBaCapture();
+}
+
+void FrameCapture::begin() {
+    instance = this;
+    
+    // MU on an asynchronous channel, BA on a synchronous one: the ATtiny1616
+    // has a single asynchronous channel for the PORTC pins
+    EVSYS.ASYNCCH2 = EVSYS_ASYNCCH2_PORTC_PIN0_gc + Pins::MU_BIT;
+    EVSYS.SYNCCH0 = EVSYS_SYNCCH0_PORTC_PIN0_gc + Pins::BA_BIT;
+    EVSYS.ASYNCUSER0 = EVSYS_ASYNCUSER0_ASYNCCH2_gc;  // TCB0
+    EVSYS.ASYNCUSER11 = EVSYS_ASYNCUSER11_SYNCCH0_gc; // TCB1
+    
+    // MU: capture on the edge leaving the current level
+    TCB0.CTRLB = TCB_CNTMODE_CAPT_gc;
+    TCB0.EVCTRL = TCB_CAPTEI_bm | ((VPORTC.IN & _BV(Pins::MU_BIT)) ? TCB_EDGE_bm : 0);
+    TCB0.INTCTRL = TCB_CAPT_bm;
+    
+    // BA: high time, cleared on the rising edge
+    TCB1.CTRLB = TCB_CNTMODE_PW_gc;
+    TCB1.EVCTRL = TCB_CAPTEI_bm;
+    TCB1.INTCTRL = TCB_CAPT_bm;
+    
+    // Same clock for both, kept running in standby
+    TCB0.CTRLA = TCB_CLKSEL_CLKDIV1_gc | TCB_RUNSTDBY_bm | TCB_ENABLE_bm;
+    TCB1.CTRLA = TCB_CLKSEL_CLKDIV1_gc | TCB_RUNSTDBY_bm | TCB_ENABLE_bm;
+}
+
+bool FrameCapture::readFrame(Frame& frame) {
+    cli();
+    bool ready = frameReady;
+    if (ready) {
+        frame.length = frameLength;
+        frame.numEdges = numEdges;
+        frame.incomplete = incomplete;
+        frame.risingMask = risingMask;
+        for (uint8_t i = 0; i < frame.numEdges; i++) {
+            frame.edgeTimes[i] = edgeTimes[i] - frameStart;
+        }
+        
+        numEdges = 0;
+        incomplete = false;
+        risingMask = 0;
+        frameReady = false;
+    }
+    sei();
+    return ready;
+}
+
+void FrameCapture::handleMuCapture() {
+    uint16_t time = TCB0.CCMP;
+    uint8_t falling = TCB0.EVCTRL & TCB_EDGE_bm;
+    TCB0.INTFLAGS = TCB_CAPT_bm;
+    
+    // Wait for the edge leaving the current level: if MU is already back to
+    // the level before the captured edge, an edge came in between, unseen
+    uint8_t high = VPORTC.IN & _BV(Pins::MU_BIT);
+    TCB0.EVCTRL = TCB_CAPTEI_bm | (high ? TCB_EDGE_bm : 0);
+    bool missed = !high == !falling;
+    
+    // MU only matters while BA is high, until the frame is taken
+    FrameCapture& self = *instance;
+    if (!(VPORTC.IN & _BV(Pins::BA_BIT)) || self.frameReady) {
+        return;
+    }
+    
+    uint8_t index = self.numEdges;
+    if (missed || index == CaptureConfig::MAX_FRAME_EDGES) {
+        self.incomplete = true;
+    }
+    if (index == CaptureConfig::MAX_FRAME_EDGES) {
+        return;
+    }
+    self.edgeTimes[index] = time;
+    if (!falling) {
+        self.risingMask |= 1 << index;
+    }
+    self.numEdges = index + 1;
+}
+
+void FrameCapture::handleBaCapture() {
+    uint16_t length = TCB1.CCMP;
+    
+    // TCB1 counts from BA rising, on the clock of TCB0: read back to back,
+    // the counters are a few ticks apart, nothing against the 4ms slots
+    uint16_t elapsed = TCB1.CNT;
+    uint16_t now = TCB0.CNT;
+    TCB1.INTFLAGS = TCB_CAPT_bm;
+    
+    FrameCapture& self = *instance;
+    self.frameStart = now - elapsed;
+    self.frameLength = length;
+    self.frameReady = true;
+}
@@ -0,0 +1,57 @@
+#include "HourFrameDecoder.h"
+
+bool HourFrameDecoder::decode(const FrameCapture::Frame& frame) {
+    Result result = {false, -1, -1, 0};
+    uint32_t length = frame.length;
+    
+    if (length >= FRAME_TICKS_MIN && length <= FRAME_TICKS_MAX && !frame.incomplete) {
+        // Timing error of the edges against the grid, scaled to 64ms
+        uint32_t maxError = 0;
+        for (uint8_t i = 0; i < frame.numEdges; i++) {
+            uint32_t time = frame.edgeTimes[i] * FRAME_DURATION / length;
+            uint32_t gridTime = FRAME_DURATION;
+            if (time < FRAME_DURATION - END_PULSE / 2) {
+                uint32_t slot = time < START_PULSE ? 0 : (time - START_PULSE + BIT_DURATION / 2) / BIT_DURATION;
+                gridTime = START_PULSE + slot * BIT_DURATION;
+            }
+            uint32_t error = time > gridTime ? time - gridTime : gridTime - time;
+            maxError = error > maxError ? error : maxError;
+        }
+        result.maxError = maxError > 0xFFFF ? 0xFFFF : static_cast<uint16_t>(maxError);
+        
+        // MU low in the start pulse and high in the end pulse, the bits in
+        // between, sampled mid-slot
+        if (levelAt(frame, length * (START_PULSE / 2) / FRAME_DURATION) == LOW &&
+            levelAt(frame, length * (FRAME_DURATION - END_PULSE / 2) / FRAME_DURATION) == HIGH) {
+            uint8_t code = 0;
+            for (uint8_t bit = 0; bit < NUM_BITS; bit++) {
+                uint32_t time = START_PULSE + bit * BIT_DURATION + BIT_DURATION / 2;
+                code = (code << 1) | levelAt(frame, length * time / FRAME_DURATION);
+            }
+            
+            // 0b1TTUUUU
+            uint8_t tens = (code >> 4) & 0x3;
+            uint8_t units = code & 0xF;
+            result.code = code;
+            result.valid = (code >> 6) == 1 && units <= 9 && tens * 10 + units <= 23 &&
+                           maxError <= GRID_TOLERANCE;
+            result.hour = result.valid ? tens * 10 + units : -1;
+        }
+    }
+    
+    lastResult = result;
+    framesDecoded++;
+    if (result.valid) {
+        framesValid++;
+    }
+    return result.valid;
+}
+
+uint8_t HourFrameDecoder::levelAt(const FrameCapture::Frame& frame, uint32_t time) {
+    // Before the first edge, MU is at the level it leaves
+    uint8_t level = (frame.numEdges > 0 && !(frame.risingMask & 1)) ? HIGH : LOW;
+    for (uint8_t i = 0; i < frame.numEdges && frame.edgeTimes[i] <= time; i++) {
+        level = (frame.risingMask >> i) & 1 ? HIGH : LOW;
+    }
+    return level;
+}
@@ -0,0 +1,72 @@
+#include "PowerTrace.h"
+#include <avr/interrupt.h>
+
+PowerTrace* PowerTrace::instance = nullptr;
+
+ISR(RTC_CNT_vect) {
+    PowerTrace::handleOverflow();
+}
+
+void PowerTrace::begin(uint8_t initialStates) {
+    instance = this;
+    
+    // 32kHz ULP oscillator / 32, kept running in standby
+    while (RTC.STATUS & (RTC_CTRLABUSY_bm | RTC_PERBUSY_bm)) {
+        // Wait for the RTC clock domain
+    }
+    RTC.CLKSEL = RTC_CLKSEL_INT32K_gc;
+    RTC.PER = 0xFFFF;
+    RTC.INTCTRL = RTC_OVF_bm;
+    RTC.CTRLA = RTC_PRESCALER_DIV32_gc | RTC_RUNSTDBY_bm | RTC_RTCEN_bm;
+    
+    states = initialStates;
+    record();
+}
+
+void PowerTrace::set(uint8_t changed, bool on) {
+    uint8_t next = on ? (states | changed) : (states & ~changed);
+    if (next == states) {
+        return;
+    }
+    states = next;
+    record();
+}
+
+void PowerTrace::record() {
+    buffer.records[buffer.head] = (now() & TIME_MASK) | (static_cast<Record>(states) << TIME_BITS);
+    buffer.head = (buffer.head + 1) % TraceConfig::NUM_RECORDS;
+    if (buffer.count < TraceConfig::NUM_RECORDS) {
+        buffer.count++;
+    } else if (buffer.lost < 0xFFFF) {
+        buffer.lost++;
+    }
+}
+
+uint32_t PowerTrace::now() const {
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t count = RTC.CNT;
+    uint16_t high = overflows;
+    
+    // Overflow not served yet: the counter read after it wrapped
+    if ((RTC.INTFLAGS & RTC_OVF_bm) && count < 0x8000) {
+        high++;
+    }
+    SREG = sreg;
+    return (static_cast<uint32_t>(high) << 16) | count;
+}
+
+bool PowerTrace::read(Record& record) {
+    if (buffer.count == 0) {
+        return false;
+    }
+    uint8_t index = (buffer.head + TraceConfig::NUM_RECORDS - buffer.count) % TraceConfig::NUM_RECORDS;
+    record = buffer.records[index];
+    buffer.count--;
+    return true;
+}
+
+void PowerTrace::handleOverflow() {
+    RTC.INTFLAGS = RTC_OVF_bm;
+    instance->overflows++;
+}
@@ -0,0 +1,350 @@
+#ifdef NATIVE_BUILD
+
+#include "Simulation.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    constexpr size_t MAX_LINE = 256;
+    constexpr size_t MAX_COLUMNS = 16;
+    
+    // Gap inserted where the timestamps reset (reboot of the Sniffer)
+    constexpr int64_t SEAM_GAP_US = 1000000;
+    
+    // Split a CSV line in place, return the number of fields
+    size_t split(char* line, const char* (&fields)[MAX_COLUMNS]) {
+        line[strcspn(line, "\r\n")] = '\0';
+        size_t numFields = 0;
+        char* field = line;
+        while (numFields < MAX_COLUMNS) {
+            fields[numFields++] = field;
+            char* comma = strchr(field, ',');
+            if (!comma) {
+                break;
+            }
+            *comma = '\0';
+            field = comma + 1;
+        }
+        for (size_t i = numFields; i < MAX_COLUMNS; i++) {
+            fields[i] = "";
+        }
+        return numFields;
+    }
+    
+    int findColumn(const char* (&fields)[MAX_COLUMNS], size_t numFields, const char* name) {
+        for (size_t i = 0; i < numFields; i++) {
+            if (strcmp(fields[i], name) == 0) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+}
+
+Simulation::Simulation(HourFrameDecoder& decoder, PowerTrace& trace) : hourDecoder(decoder), powerTrace(trace) {
+    // Nothing else to initialize
+}
+
+int Simulation::run(int argc, char** argv) {
+    if (!parseArguments(argc, argv)) {
+        printUsage(argv[0]);
+        return 2;
+    }
+    random.seed(seed);
+    
+    AvrSim::begin(clockError, interruptCycles);
+    AvrSim::setEdgeSource([this](AvrSim::Edge& edge) { return nextEdge(edge); });
+    setup();
+    readTrace();
+    
+    uint16_t decoded = hourDecoder.getFramesDecoded();
+    while (!AvrSim::finished()) {
+        loop();
+        if (hourDecoder.getFramesDecoded() != decoded) {
+            decoded = hourDecoder.getFramesDecoded();
+            checkFrame();
+            AvrSim::runCycles(decodeCycles);
+        }
+        readTrace();
+    }
+    if (file) {
+        fclose(file);
+    }
+    
+    // Generated frames never decoded
+    framesMissed += truth.size() - truthIndex;
+    
+    fflush(stdout);
+    printReport();
+    return framesWrong > 0 ? 1 : 0;
+}
+
+bool Simulation::parseArguments(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (argument == "--synth" && hasValue) {
+            synthHours = atoi(argv[++i]);
+        } else if (argument == "--jitter" && hasValue) {
+            jitterUs = atoll(argv[++i]);
+        } else if (argument == "--glitch-rate" && hasValue) {
+            glitchRate = atof(argv[++i]) / 100.0;
+        } else if (argument == "--clock-error" && hasValue) {
+            clockError = atof(argv[++i]) / 100.0;
+        } else if (argument == "--isr-cycles" && hasValue) {
+            interruptCycles = static_cast<uint32_t>(atol(argv[++i]));
+        } else if (argument == "--decode-cycles" && hasValue) {
+            decodeCycles = static_cast<uint32_t>(atol(argv[++i]));
+        } else if (argument == "--seed" && hasValue) {
+            seed = static_cast<uint32_t>(atol(argv[++i]));
+        } else if (argument == "--quiet") {
+            quiet = true;
+        } else if (argument == "--trace") {
+            printTrace = true;
+        } else if (argument[0] == '-') {
+            return false;
+        } else {
+            files.push_back(argument);
+        }
+    }
+    
+    // Either generated or read
+    return (synthHours > 0) != !files.empty() && jitterUs >= 0 && jitterUs < BIT_DURATION_US / 4 &&
+           clockError > -1.0;
+}
+
+void Simulation::printUsage(const char* program) const {
+    fprintf(stderr,
+        "Usage: %s [options] (--synth HOURS | data.csv...)\n"
+        "Run the firmware on generated hour frames, or on the edges of Sniffer data\n"
+        "files, and print the decoded frames (HF,Millis,Valid,Hour,Code,MaxError).\n"
+        "  --synth HOURS       Generate a frame per hour, checking the hours decoded\n"
+        "  --jitter US         Random timing error of the generated edges (default 300)\n"
+        "  --glitch-rate PCT   Generated frames with a 1ms MU glitch (default 0)\n"
+        "  --clock-error PCT   Error of the 32kHz oscillator (default 0)\n"
+        "  --isr-cycles N      CPU cycles per interrupt, wake-up included (default 80)\n"
+        "  --decode-cycles N   CPU cycles per frame decoded (default 1500)\n"
+        "  --seed N            Random seed (default 0)\n"
+        "  --quiet             Don't print the frames\n"
+        "  --trace             Print the power trace (PT,Ticks,States)\n",
+        program);
+}
+
+bool Simulation::nextEdge(AvrSim::Edge& edge) {
+    if (synthHours > 0) {
+        if (frameEdges.empty() && !generateFrame()) {
+            return false;
+        }
+        edge = frameEdges.back();
+        frameEdges.pop_back();
+    } else if (!readEdge(edge)) {
+        return false;
+    }
+    
+    if (firstTime < 0) {
+        firstTime = edge.time;
+    }
+    lastTime = edge.time;
+    return true;
+}
+
+bool Simulation::generateFrame() {
+    if (framesGenerated == synthHours) {
+        return false;
+    }
+    int64_t start = LEAD_IN_US + framesGenerated * FRAME_INTERVAL_US;
+    int hour = framesGenerated % 24;
+    framesGenerated++;
+    
+    // 0b1TTUUUU, MSB first
+    int code = 0x40 | ((hour / 10) << 4) | (hour % 10);
+    std::uniform_int_distribution<int64_t> jitter(-jitterUs, jitterUs);
+    std::vector<AvrSim::Edge> edges;
+    edges.push_back({start + jitter(random), AvrSim::PORT_C, Pins::BA_BIT, HIGH});
+    
+    // MU low in the start pulse, then the bits, then high in the end pulse
+    uint8_t slotLevels[NUM_BITS + 1];
+    uint8_t level = LOW;
+    for (int slot = 0; slot <= NUM_BITS; slot++) {
+        slotLevels[slot] = slot < NUM_BITS ? (code >> (NUM_BITS - 1 - slot)) & 1 : HIGH;
+        if (slotLevels[slot] != level) {
+            level = slotLevels[slot];
+            int64_t time = start + START_PULSE_US + slot * BIT_DURATION_US + jitter(random);
+            edges.push_back({time, AvrSim::PORT_C, Pins::MU_BIT, level});
+        }
+    }
+    int64_t end = start + FRAME_DURATION_US;
+    edges.push_back({end + jitter(random), AvrSim::PORT_C, Pins::MU_BIT, LOW});
+    edges.push_back({end + jitter(random), AvrSim::PORT_C, Pins::BA_BIT, LOW});
+    
+    // Glitch in the middle of a bit, clear of the edges
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    bool glitched = chance(random) < glitchRate;
+    if (glitched) {
+        std::uniform_int_distribution<int> slots(0, NUM_BITS - 1);
+        std::uniform_int_distribution<int64_t> offsets(BIT_DURATION_US / 4 + GLITCH_MARGIN_US,
+                                                       BIT_DURATION_US * 3 / 4 - GLITCH_DURATION_US - GLITCH_MARGIN_US);
+        int slot = slots(random);
+        int64_t time = start + START_PULSE_US + slot * BIT_DURATION_US + offsets(random);
+        uint8_t slotLevel = slotLevels[slot];
+        edges.push_back({time, AvrSim::PORT_C, Pins::MU_BIT, static_cast<uint8_t>(!slotLevel)});
+        edges.push_back({time + GLITCH_DURATION_US, AvrSim::PORT_C, Pins::MU_BIT, slotLevel});
+    }
+    
+    // MU and BA fall together, in either order
+    std::stable_sort(edges.begin(), edges.end(), [](const AvrSim::Edge& a, const AvrSim::Edge& b) {
+        return a.time < b.time;
+    });
+    frameEdges.assign(edges.rbegin(), edges.rend());
+    truth.push_back({end, hour, glitched});
+    return true;
+}
+
+bool Simulation::openNextFile() {
+    while (fileIndex < files.size()) {
+        const std::string& path = files[fileIndex++];
+        file = fopen(path.c_str(), "r");
+        if (!file) {
+            fprintf(stderr, "Cannot read %s\n", path.c_str());
+            continue;
+        }
+        
+        char header[MAX_LINE];
+        const char* columns[MAX_COLUMNS];
+        size_t numColumns = fgets(header, sizeof(header), file) ? split(header, columns) : 0;
+        signalColumn = findColumn(columns, numColumns, "Signal");
+        edgeColumn = findColumn(columns, numColumns, "Edge");
+        timestampColumn = findColumn(columns, numColumns, "Timestamp");
+        microsColumn = findColumn(columns, numColumns, "Micros");
+        if (signalColumn >= 0 && edgeColumn >= 0 && timestampColumn >= 0) {
+            return true;
+        }
+        
+        fprintf(stderr, "%s is not a data file\n", path.c_str());
+        fclose(file);
+        file = nullptr;
+    }
+    return false;
+}
+
+bool Simulation::readEdge(AvrSim::Edge& edge) {
+    char line[MAX_LINE];
+    while (file || openNextFile()) {
+        if (!fgets(line, sizeof(line), file)) {
+            fclose(file);
+            file = nullptr;
+            continue;
+        }
+        
+        // Signals on their ClockV1 pins, records have no edge
+        const char* fields[MAX_COLUMNS];
+        split(line, fields);
+        const char* signal = fields[signalColumn];
+        const char* edgeName = fields[edgeColumn];
+        if (strcmp(signal, "MU") == 0) {
+            edge.bit = Pins::MU_BIT;
+        } else if (strcmp(signal, "BA") == 0) {
+            edge.bit = Pins::BA_BIT;
+        } else if (strcmp(signal, "RF") == 0) {
+            edge.bit = Pins::RF_BIT;
+        } else {
+            continue;
+        }
+        if (strcmp(edgeName, "R") != 0 && strcmp(edgeName, "F") != 0) {
+            continue;
+        }
+        edge.port = AvrSim::PORT_C;
+        edge.level = edgeName[0] == 'R' ? HIGH : LOW;
+        
+        const char* micros = microsColumn >= 0 ? fields[microsColumn] : "";
+        int64_t time = atoll(fields[timestampColumn]) * 1000 + atoll(micros);
+        
+        // A reset continues after the previous edge
+        if (previousTime >= 0 && time + fileOffset < previousTime) {
+            fileOffset = previousTime + SEAM_GAP_US - time;
+        }
+        edge.time = time + fileOffset + LEAD_IN_US;
+        previousTime = time + fileOffset;
+        return true;
+    }
+    return false;
+}
+
+void Simulation::checkFrame() {
+    const HourFrameDecoder::Result& result = hourDecoder.getLastResult();
+    int64_t time = AvrSim::now();
+    framesDecoded++;
+    if (result.valid) {
+        framesValid++;
+    }
+    if (!quiet) {
+        printf("HF,%lld,%d,%d,%d,%u\n", static_cast<long long>(time / 1000), result.valid ? 1 : 0,
+               result.hour, result.code, result.maxError);
+    }
+    if (synthHours == 0) {
+        return;
+    }
+    
+    // Generated frames ended too long before were never decoded
+    while (truthIndex < truth.size() && truth[truthIndex].endTime + DECODE_DELAY_MAX_US < time) {
+        framesMissed++;
+        truthIndex++;
+    }
+    if (truthIndex == truth.size() || truth[truthIndex].endTime > time + DECODE_DELAY_MAX_US) {
+        // No frame was generated there
+        if (result.valid) {
+            framesWrong++;
+        }
+        return;
+    }
+    
+    const TruthFrame& frame = truth[truthIndex++];
+    if (result.valid) {
+        if (result.hour == frame.hour) {
+            framesCorrect++;
+        } else {
+            framesWrong++;
+        }
+    } else if (frame.glitched) {
+        glitchedRejected++;
+    } else {
+        cleanRejected++;
+    }
+}
+
+void Simulation::readTrace() {
+    PowerTrace::Record record;
+    while (powerTrace.read(record)) {
+        traceRecords++;
+        if (printTrace) {
+            printf("PT,%lu,%u\n", static_cast<unsigned long>(PowerTrace::timeOf(record)),
+                   PowerTrace::statesOf(record));
+        }
+    }
+}
+
+void Simulation::printReport() const {
+    const AvrSim::Stats& stats = AvrSim::getStats();
+    double hours = synthHours > 0 ? synthHours : (lastTime - firstTime) / 3.6e9;
+    double frequency = AvrSim::clockFrequency();
+    uint64_t cycles = stats.interruptCycles + static_cast<uint64_t>(framesDecoded) * decodeCycles;
+    double activeSeconds = cycles / frequency;
+    
+    fprintf(stderr, "Simulated %.2f hours, clock at %.0f Hz\n", hours, frequency);
+    fprintf(stderr, "Frames: %u decoded, %u valid\n", framesDecoded, framesValid);
+    if (synthHours > 0) {
+        fprintf(stderr, "Hours: %u correct, %u wrong, %u clean frames rejected, %u glitched frames rejected, %u frames not decoded\n",
+                framesCorrect, framesWrong, cleanRejected, glitchedRejected, framesMissed);
+    }
+    fprintf(stderr, "Interrupts: %u MU, %u BA, %u RTC, %u wake-ups\n", stats.interrupts[0], stats.interrupts[1],
+            stats.rtcInterrupts, stats.wakeups);
+    fprintf(stderr, "Captures lost: %u overwritten, %u in standby\n", stats.overruns[0] + stats.overruns[1],
+            stats.standbyLosses);
+    if (hours > 0) {
+        fprintf(stderr, "Active CPU time: %.2f ms per hour (%u cycles per interrupt, %u per frame), duty cycle %.2e\n",
+                activeSeconds * 1000.0 / hours, interruptCycles, decodeCycles, activeSeconds / (hours * 3600.0));
+    }
+    fprintf(stderr, "Power trace: %u records\n", traceRecords);
+}
+
+#endif // NATIVE_BUILD
@@ -1,18 +1,74 @@
 #include <Arduino.h>
+#include <avr/sleep.h>
+#include "Config.h"
+#include "FrameCapture.h"
+#include "HourFrameDecoder.h"
+#include "PowerTrace.h"
 
-#define LED_PIN PIN_PA1
+FrameCapture frameCapture;
+HourFrameDecoder hourDecoder;
+PowerTrace powerTrace;
 
-#define BLINK_INTERVAL 500
+// Disable the input buffers of the pins not read, they draw current when
+// left floating
+void disableUnusedInputs() {
+  for (uint8_t bit = 0; bit < 8; bit++) {
+    (&PORTA.PIN0CTRL)[bit] = PORT_ISC_INPUT_DISABLE_gc;
+    (&PORTB.PIN0CTRL)[bit] = PORT_ISC_INPUT_DISABLE_gc;
+    if (bit != Pins::MU_BIT && bit != Pins::BA_BIT) {
+      (&PORTC.PIN0CTRL)[bit] = PORT_ISC_INPUT_DISABLE_gc;
+    }
+  }
+}
 
 void setup() {
-  // initialize digital pin LED_BUILTIN as an output.
-  pinMode(LED_PIN, OUTPUT);
+  // Run from the 32kHz ULP oscillator, undivided (see CaptureConfig)
+  _PROTECTED_WRITE(CLKCTRL.MCLKCTRLA, CLKCTRL_CLKSEL_OSCULP32K_gc);
+  _PROTECTED_WRITE(CLKCTRL.MCLKCTRLB, 0);
+  while (CLKCTRL.MCLKSTATUS & CLKCTRL_SOSC_bm) {
+    // Wait for the switch
+  }
+
+  disableUnusedInputs();
+  VPORTA.DIR |= _BV(Pins::LED_BIT);
+
+  // DFPlayer powered off until there is something to play
+  VPORTB.OUT &= ~_BV(Pins::DFPLAYER_POWER_BIT);
+  VPORTB.DIR |= _BV(Pins::DFPLAYER_POWER_BIT);
+
+  powerTrace.begin(PowerTrace::CPU_ACTIVE);
+  frameCapture.begin();
+  set_sleep_mode(SLEEP_MODE_STANDBY);
 }
 
-// the loop function runs over and over again forever
+// Standby until a frame is complete, the MU captures and the RTC overflows
+// only take their interrupt meanwhile
 void loop() {
-  digitalWrite(LED_PIN, HIGH);  // turn the LED on (HIGH is the voltage level)
-  delay(BLINK_INTERVAL);        // wait interval
-  digitalWrite(LED_PIN, LOW);   // turn the LED off by making the voltage LOW
-  delay(BLINK_INTERVAL);        // wait interval
+  cli();
+  if (!frameCapture.isFrameReady()) {
+    powerTrace.set(PowerTrace::CPU_ACTIVE, false);
+    sleep_enable();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+    powerTrace.set(PowerTrace::CPU_ACTIVE, true);
+  }
+  sei();
+
+  FrameCapture::Frame frame;
+  if (frameCapture.readFrame(frame)) {
+    VPORTA.OUT |= _BV(Pins::LED_BIT);
+    powerTrace.set(PowerTrace::LED1_ON, true);
+    hourDecoder.decode(frame);
+    VPORTA.OUT &= ~_BV(Pins::LED_BIT);
+    powerTrace.set(PowerTrace::LED1_ON, false);
+  }
+}
+#ifdef NATIVE_BUILD
+#include "Simulation.h"
+
+// Host build: the simulation runs setup() and loop() on the modelled peripherals
+int main(int argc, char** argv) {
+  return Simulation(hourDecoder, powerTrace).run(argc, argv);
 }
+#endif
@@ -0,0 +1,99 @@
+#ifndef CHIME_SCHEDULER_H
+#define CHIME_SCHEDULER_H
+
+#include "Config.h"
+#include "DFPlayer.h"
+#include "PulseScheduler.h"
+
+/**
+ * Hourly chime starting on the tick, with the DFPlayer powered only around
+ * it.
+ *
+ * The chime is due on the tick of the hour (every Chime::INTERVAL_S ticks of
+ * the PulseScheduler, the moment BA rises on the real clock). Ahead of it,
+ * by the worst boot time seen plus the preloading and a margin, the DFPlayer
+ * is powered; once it reports the SD card mounted, the track is preloaded:
+ * started at volume 0 and paused at once, then the volume set. The resume
+ * command is written a frame time before the tick, so the module takes it
+ * on the tick; the power is cut at the end of the track.
+ *
+ * In the dark (LDR) the chime is muted: the DFPlayer is not powered, or
+ * powered off without playing if it got dark after the power-up. An error
+ * reported by the module (no card, no track) gives the chime up.
+ *
+ * Runs from the main loop, update() polled every millisecond or so.
+ */
+class ChimeScheduler {
+public:
+    struct Stats {
+        uint32_t chimes;         // Chimes played
+        uint32_t muted;          // Chimes muted in the dark
+        uint32_t late;           // Chimes not preloaded on time
+        uint32_t errors;         // Chimes given up on a DFPlayer error
+        int64_t lastLatencyUs;   // Resume taken by the module, from the tick
+        int64_t maxLatencyUs;
+        uint32_t lastBootMs;     // Power-up to SD card mounted
+        uint32_t maxBootMs;
+        uint32_t lastOnMs;       // DFPlayer powered for the last chime
+        uint64_t totalOnMs;
+    };
+    
+    /**
+     * Constructor
+     * @param player DFPlayer driven
+     * @param pulses Scheduler of the ticks, giving the chime times
+     */
+    ChimeScheduler(DFPlayer& player, PulseScheduler& pulses);
+    
+    /**
+     * Start waiting for the first chime
+     */
+    void begin();
+    
+    /**
+     * Run the DFPlayer and the power-up, preloading and playing steps
+     */
+    void update();
+    
+    /**
+     * Get the statistics
+     */
+    const Stats& getStats() const { return stats; }
+    
+    /**
+     * Get when the next chime is due, esp_timer microseconds
+     */
+    int64_t getChimeTime() const { return pulses.getTickTime(chimeTick); }
+    
+    /**
+     * Print the chime statistics
+     */
+    void printReport() const;
+
+private:
+    enum State : uint8_t {
+        STATE_IDLE,       // Off until the look-ahead
+        STATE_BOOTING,    // Powered, waiting for the SD card
+        STATE_PRELOADING, // Sending the track and volume
+        STATE_PLAYING     // Resumed, waiting for the end of the track
+    };
+    
+    DFPlayer& player;
+    PulseScheduler& pulses;
+    State state = STATE_IDLE;
+    uint32_t chimeTick = Chime::INTERVAL_S;
+    int64_t powerOnUs = 0;
+    bool resumed = false;    // Resume command sent
+    Stats stats = {};
+    
+    // Power-up time ahead of the chime, microseconds
+    int64_t leadTime() const;
+    
+    // Check if the chime is muted by the darkness
+    static bool isDark();
+    
+    // Cut the power and wait for the next chime
+    void finishChime(int64_t now);
+};
+
+#endif // CHIME_SCHEDULER_H
@@ -10,12 +10,36 @@ namespace Pins {
     constexpr uint8_t SOLENOID_SEC_2 = 26;  // Second seconds solenoid control pin
     constexpr uint8_t SOLENOID_MIN_1 = 33;  // First minutes solenoid control pin
     constexpr uint8_t SOLENOID_MIN_2 = 32;  // Second minutes solenoid control pin
+    
+    // DFPlayer Mini, powered through a high-side switch
+    constexpr uint8_t DFPLAYER_POWER = 25;  // High to power the DFPlayer
+    constexpr uint8_t DFPLAYER_TX = 17;     // ESP32 TX -> DFPlayer RX (1k resistor)
+    constexpr uint8_t DFPLAYER_RX = 16;     // ESP32 RX <- DFPlayer TX
+    
+    // Photoresistor divider, higher reading when brighter (ADC1)
+    constexpr uint8_t LDR = 34;
 }
 
 // Timing configurations
 namespace Timing {
     constexpr uint16_t SOLENOID_PULSE_WIDTH_MS = 40;  // Duration of solenoid pulse in milliseconds
     constexpr uint16_t SECOND_MS = 1000;              // Milliseconds in a second
+    constexpr uint32_t REPORT_INTERVAL_MS = 10000;    // Phase error report interval in milliseconds
+}
+
+// Chime played on the hour by the DFPlayer
+namespace Chime {
+    constexpr uint32_t INTERVAL_S = 3600;        // Ticks between chimes, the first one an interval after start
+    constexpr uint16_t TRACK = 1;                // Track on the SD card (0001.mp3)
+    constexpr uint8_t VOLUME = 20;               // 0-30
+    constexpr uint16_t LDR_DARK_THRESHOLD = 300; // LDR reading below which the chime is muted (0-4095)
+    
+    // Power-up look-ahead: the worst boot time seen (power-up to SD mounted),
+    // starting from this estimate, plus the preloading commands and a margin
+    constexpr uint32_t BOOT_TIME_MS = 1500;
+    constexpr uint32_t BOOT_TIMEOUT_MS = 5000;   // Assumed ready without its power-up message
+    constexpr uint32_t LEAD_MARGIN_MS = 500;
+    constexpr uint32_t MAX_PLAY_MS = 60000;      // Powered off if the end of track is not reported
 }
 
 #endif // CONFIG_H
\ No newline at end of file
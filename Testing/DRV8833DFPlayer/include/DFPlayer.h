@@ -0,0 +1,125 @@
+#ifndef DFPLAYER_H
+#define DFPLAYER_H
+
+#include "Config.h"
+
+/**
+ * DFPlayer Mini behind a power switch, driven over its UART without blocking.
+ *
+ * Commands are queued and sent by update(), one frame at a time, spaced by
+ * COMMAND_GAP_US for the module to take them; update() also parses the
+ * frames the module sends (power-up with the SD card mounted, end of track,
+ * errors). Frames are 10 bytes at 9600 baud, about 10ms: a command takes
+ * effect when its last byte is received, FRAME_US after it is written.
+ *
+ * When powered off, the UART is released and its TX pin left floating, so
+ * the module is not powered through its RX pin.
+ */
+class DFPlayer {
+public:
+    enum Event : uint8_t {
+        EVENT_NONE,
+        EVENT_READY,     // Powered up, SD card mounted
+        EVENT_TRACK_END, // Track finished
+        EVENT_ERROR      // Module error (no card, bad track...)
+    };
+    
+    static constexpr uint32_t BAUD_RATE = 9600;
+    static constexpr uint8_t FRAME_SIZE = 10;
+    static constexpr int64_t FRAME_US = FRAME_SIZE * 10 * 1000000LL / BAUD_RATE;
+    static constexpr int64_t COMMAND_GAP_US = 30000;
+    
+    /**
+     * Constructor
+     * @param serial UART wired to the module
+     */
+    explicit DFPlayer(HardwareSerial& serial);
+    
+    /**
+     * Configure the power switch, module off
+     */
+    void begin();
+    
+    /**
+     * Power the module and open the UART, the module boots
+     */
+    void powerOn();
+    
+    /**
+     * Release the UART and cut the power, dropping the queued commands
+     */
+    void powerOff();
+    
+    /**
+     * Check if the module is powered
+     */
+    bool isPowered() const { return powered; }
+    
+    // Queued commands, false if the queue is full
+    bool playTrack(uint16_t track);
+    bool setVolume(uint8_t volume);
+    bool pause();
+    bool resume();
+    
+    /**
+     * Check if all the queued commands were sent
+     */
+    bool isIdle() const { return queueCount == 0; }
+    
+    /**
+     * Get when the last command sent takes effect (its last byte received),
+     * esp_timer microseconds
+     */
+    int64_t getLastCommandUs() const { return lastCommandUs; }
+    
+    /**
+     * Send the next queued command when due and read the module
+     * @return Event received, EVENT_NONE if none
+     */
+    Event update();
+
+private:
+    static constexpr uint8_t QUEUE_SIZE = 8;
+    
+    // Protocol
+    static constexpr uint8_t START_BYTE = 0x7E;
+    static constexpr uint8_t VERSION = 0xFF;
+    static constexpr uint8_t LENGTH = 0x06;
+    static constexpr uint8_t END_BYTE = 0xEF;
+    static constexpr uint8_t CMD_PLAY_TRACK = 0x03;
+    static constexpr uint8_t CMD_VOLUME = 0x06;
+    static constexpr uint8_t CMD_RESUME = 0x0D;
+    static constexpr uint8_t CMD_PAUSE = 0x0E;
+    static constexpr uint8_t MSG_TRACK_END = 0x3D;
+    static constexpr uint8_t MSG_READY = 0x3F;
+    static constexpr uint8_t MSG_ERROR = 0x40;
+    
+    struct Command {
+        uint8_t code;
+        uint16_t parameter;
+    };
+    
+    HardwareSerial& serial;
+    bool powered = false;
+    
+    Command queue[QUEUE_SIZE];
+    uint8_t queueHead = 0;
+    uint8_t queueCount = 0;
+    int64_t lastCommandUs = 0;
+    
+    uint8_t received[FRAME_SIZE];
+    uint8_t receivedCount = 0;
+    
+    bool enqueue(uint8_t code, uint16_t parameter);
+    
+    // Checksum of a frame, over the version to the parameter
+    static uint16_t checksum(const uint8_t* frame);
+    
+    /**
+     * Parse a received byte
+     * @return Event completed by the byte, EVENT_NONE if none
+     */
+    Event parse(uint8_t byte);
+};
+
+#endif // DFPLAYER_H
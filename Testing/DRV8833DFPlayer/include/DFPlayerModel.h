@@ -0,0 +1,93 @@
+#ifndef DFPLAYER_MODEL_H
+#define DFPLAYER_MODEL_H
+
+#include <EspSim.h>
+#include <random>
+#include <vector>
+
+/**
+ * DFPlayer Mini on the UART of the native build, for the simulation.
+ *
+ * Powered by its switch pin, the module boots for a random time, then
+ * reports the SD card mounted (0x3F); commands received before are lost. It
+ * takes the play track, volume, pause and resume commands at the end of
+ * their frame, and reports the end of the track (0x3D) once it played for
+ * the track duration. Each power-up is recorded as a session: when the
+ * module got ready, started to be heard (playing at a volume above 0) and
+ * was powered off. Native build only.
+ */
+class DFPlayerModel {
+public:
+    struct Session {
+        int64_t powerOnUs;
+        int64_t readyUs;      // -1 if never
+        int64_t audibleUs;    // -1 if never heard
+        int64_t powerOffUs;   // -1 if still powered
+        uint32_t lostCommands; // Received before ready, or malformed
+    };
+    
+    /**
+     * Constructor
+     * @param serial UART the firmware drives the module with
+     * @param powerPin Pin of the power switch, high to power
+     * @param random Random generator of the simulation
+     */
+    DFPlayerModel(HardwareSerial& serial, uint8_t powerPin, std::mt19937& random);
+    
+    /**
+     * Set the boot time range and the track duration
+     */
+    void configure(int64_t bootMinUs, int64_t bootMaxUs, int64_t trackUs);
+    
+    /**
+     * Follow the power switch (pin listener)
+     */
+    void onPin(uint8_t pin, uint8_t level);
+    
+    /**
+     * Get the power-up sessions so far
+     */
+    const std::vector<Session>& getSessions() const { return sessions; }
+
+private:
+    static constexpr uint8_t FRAME_SIZE = 10;
+    static constexpr int64_t BYTE_US = 10 * 1000000LL / 9600;
+    
+    HardwareSerial& serial;
+    uint8_t powerPin;
+    std::mt19937& random;
+    int64_t bootMinUs = 1000000;
+    int64_t bootMaxUs = 2000000;
+    int64_t trackUs = 3000000;
+    
+    // State while powered, the events scheduled for an older power-up or
+    // playback are cancelled by the generation
+    bool powered = false;
+    bool ready = false;
+    uint32_t generation = 0;
+    uint8_t volume = 0;
+    bool trackOpen = false;
+    bool playing = false;
+    int64_t playedUs = 0;    // Position in the track when paused
+    int64_t resumedUs = 0;   // Start of the current playback
+    uint8_t frame[FRAME_SIZE];
+    uint8_t frameCount = 0;
+    std::vector<Session> sessions;
+    
+    // Bytes received from the firmware
+    void receive(uint8_t byte, int64_t timeUs);
+    
+    // Take a command at the end of its frame
+    void handleCommand(uint8_t code, uint16_t parameter, int64_t timeUs);
+    
+    // Start playing from the current position
+    void startPlayback(int64_t timeUs);
+    
+    // Record the time the track is first heard
+    void checkAudible(int64_t timeUs);
+    
+    // Send a message to the firmware
+    void send(uint8_t code, uint16_t parameter, int64_t timeUs);
+};
+
+#endif // DFPLAYER_MODEL_H
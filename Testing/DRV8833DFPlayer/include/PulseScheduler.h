@@ -0,0 +1,106 @@
+#ifndef PULSE_SCHEDULER_H
+#define PULSE_SCHEDULER_H
+
+#include "Config.h"
+#include <esp_timer.h>
+
+/**
+ * Solenoid pulses timed by an esp_timer one-shot, off the main loop.
+ *
+ * Each tick is due at an absolute time: the start time plus the tick number
+ * times a second. The timer is re-armed from that absolute time, never from
+ * the time the callback ran, so the latency of a callback delays its own tick
+ * without delaying the following ones: the hands do not drift. The other
+ * edges of a tick (see STEPS) are timed from the actual start of the tick,
+ * keeping the pulse widths.
+ *
+ * Each solenoid is driven through one DRV8833 H-bridge, one input per
+ * polarity; the polarity is swapped after each pulse so the field alternates.
+ * The phase error of each tick (start of its seconds pulse against its due
+ * time) is measured in the timer callback.
+ */
+class PulseScheduler {
+public:
+    // Phase error of the ticks, from begin()
+    struct Stats {
+        uint32_t ticks;          // Ticks sent
+        int64_t lastErrorUs;     // Phase error of the last tick
+        int64_t maxErrorUs;      // Largest phase error
+        int64_t totalErrorUs;    // Sum of the phase errors
+        uint32_t ticksSkipped;   // Ticks given up, being more than a second late
+    };
+    
+    /**
+     * Configure the pins and start ticking a second later
+     * @return true if the timer started
+     */
+    bool begin();
+    
+    /**
+     * Get when a tick is due, esp_timer microseconds
+     * @param tick Tick number, 0 being a second after begin()
+     */
+    int64_t getTickTime(uint32_t tick) const;
+    
+    /**
+     * Get a consistent copy of the statistics
+     */
+    Stats getStats();
+    
+    /**
+     * Print the phase error statistics
+     */
+    void printReport();
+
+private:
+    enum Coil : uint8_t {
+        COIL_SEC = 0,
+        COIL_MIN = 1
+    };
+    
+    // Edge of a tick
+    struct Step {
+        uint32_t offsetMs; // From the start of the tick
+        Coil coil;
+        bool energize;     // Start of the pulse, or end and polarity swap
+    };
+    
+    // Seconds pulse, a pause, then minutes pulse, each of the pulse width
+    static constexpr Step STEPS[] = {
+        {0, COIL_SEC, true},
+        {Timing::SOLENOID_PULSE_WIDTH_MS, COIL_SEC, false},
+        {2 * Timing::SOLENOID_PULSE_WIDTH_MS, COIL_MIN, true},
+        {3 * Timing::SOLENOID_PULSE_WIDTH_MS, COIL_MIN, false}
+    };
+    static constexpr size_t NUM_STEPS = sizeof(STEPS) / sizeof(STEPS[0]);
+    static_assert(3 * Timing::SOLENOID_PULSE_WIDTH_MS < Timing::SECOND_MS, "The pulses must fit in a second");
+    
+    // Inputs of the H-bridges, by coil then polarity
+    static constexpr uint8_t COIL_PINS[2][2] = {
+        {Pins::SOLENOID_SEC_1, Pins::SOLENOID_SEC_2},
+        {Pins::SOLENOID_MIN_1, Pins::SOLENOID_MIN_2}
+    };
+    
+    esp_timer_handle_t timer = nullptr;
+    int64_t startUs = 0;       // Due time of tick 0, esp_timer microseconds
+    int64_t tickStartUs = 0;   // Actual start of the current tick
+    uint32_t tick = 0;         // Tick of the next edge
+    size_t step = 0;           // Step of the next edge
+    bool polarity[2] = {};     // Input driven by the next pulse, by coil
+    
+    Stats stats = {};
+    portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+    
+    // Timer callback, runs the due edge and arms the next one
+    static void onTimer(void* arg);
+    
+    void runStep();
+    
+    // Due time of the next edge, esp_timer microseconds
+    int64_t dueTime() const;
+    
+    // Arm the timer for the next edge
+    void armTimer();
+};
+
+#endif // PULSE_SCHEDULER_H
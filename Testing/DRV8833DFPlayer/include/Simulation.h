@@ -0,0 +1,77 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "ChimeScheduler.h"
+#include "DFPlayerModel.h"
+#include "PulseScheduler.h"
+#include <random>
+
+/**
+ * Entry point of the native build, running the firmware on the virtual
+ * clock of lib/EspSim with a DFPlayer model on its UART.
+ *
+ * Each chime interval is lit or dark at random (LDR), the DFPlayer boots in
+ * a random time in a given range. Each chime is checked against the model:
+ * a lit chime must be heard within LATENCY_TOLERANCE_US after its tick,
+ * never before, with no command lost; a dark one never heard. The DFPlayer
+ * on-time is reported per chime. Native build only.
+ */
+class Simulation {
+public:
+    /**
+     * Constructor
+     * @param pulses Pulse scheduler of the firmware, for the chime ticks
+     * @param chimes Chime scheduler of the firmware, for its statistics
+     */
+    Simulation(PulseScheduler& pulses, ChimeScheduler& chimes);
+    
+    /**
+     * Run the firmware
+     * @param argc Number of command line arguments
+     * @param argv Command line arguments (see printUsage())
+     * @return Exit status, 1 if a chime failed its checks
+     */
+    int run(int argc, char** argv);
+
+private:
+    // Chime heard at most this long after its tick (the loop polls every ms)
+    static constexpr int64_t LATENCY_TOLERANCE_US = 5000;
+    
+    // LDR readings
+    static constexpr uint16_t LDR_LIT = 2000;
+    static constexpr uint16_t LDR_DARK = 50;
+    
+    PulseScheduler& pulseScheduler;
+    ChimeScheduler& chimeScheduler;
+    
+    // Options
+    int numChimes = 24;
+    int64_t bootMinUs = 1000000;
+    int64_t bootMaxUs = 1400000;
+    int64_t trackUs = 3000000;
+    double darkRate = 0.0;
+    uint32_t seed = 0;
+    bool verbose = false;
+    
+    std::mt19937 random;
+    std::vector<bool> darkChimes;
+    
+    /**
+     * Parse the command line
+     * @return true if valid
+     */
+    bool parseArguments(int argc, char** argv);
+    
+    /**
+     * Print the command line help
+     */
+    void printUsage(const char* program) const;
+    
+    /**
+     * Print and check the chimes against the DFPlayer sessions
+     * @return Number of chimes failing their checks
+     */
+    int checkChimes(const DFPlayerModel& model) const;
+};
+
+#endif // SIMULATION_H
@@ -0,0 +1,109 @@
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <utility>
+
+/*
+ * Subset of the ESP32 Arduino core used by the firmware, for the native
+ * build. Time runs on the virtual clock of EspSim.h: it only moves in
+ * delay(), which runs the timers and the device events due meanwhile.
+ */
+
+#define LOW 0x0
+#define HIGH 0x1
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+
+#define SERIAL_8N1 0x800001c
+
+// A single task runs at a time, nothing to lock
+typedef struct {
+    int unused;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+uint16_t analogRead(uint8_t pin);
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+
+/**
+ * Output stream, the base of the UARTs
+ */
+class Print {
+public:
+    virtual ~Print() = default;
+    
+    virtual size_t write(const uint8_t* buffer, size_t size) = 0;
+    
+    size_t write(uint8_t c) { return write(&c, 1); }
+    size_t print(const char* text) { return write(reinterpret_cast<const uint8_t*>(text), strlen(text)); }
+    size_t println() { return print("\r\n"); }
+    size_t println(const char* text) { return print(text) + println(); }
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+/**
+ * UART: the console (port 0) is written to the standard output; the other
+ * ports are wired to a device model, each byte sent reaching it at the end
+ * of its transmission at the baud rate, each byte it sends readable from its
+ * arrival time.
+ */
+class HardwareSerial : public Print {
+public:
+    // Device side: a byte sent by the firmware and the time it was received
+    using Receiver = std::function<void(uint8_t byte, int64_t timeUs)>;
+    
+    explicit HardwareSerial(uint8_t port) : port(port) {}
+    
+    void begin(unsigned long baudRate, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1);
+    void end();
+    operator bool() const { return open; }
+    int available();
+    int read();
+    int availableForWrite();
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    
+    // Native build: connect the device model
+    void setReceiver(Receiver deviceReceiver) { receiver = deviceReceiver; }
+    
+    // Native build: byte sent by the device, dropped if the UART is closed
+    void inject(uint8_t byte, int64_t timeUs);
+
+private:
+    static constexpr int TX_FIFO_SIZE = 128;
+    
+    uint8_t port;
+    bool open = false;
+    unsigned long baud = 0;
+    int64_t txFreeUs = 0; // End of the transmission of the bytes written
+    std::deque<std::pair<int64_t, uint8_t>> received;
+    Receiver receiver;
+    
+    // Transmission time of a byte (start, 8 bits, stop)
+    int64_t byteTime() const { return 10 * 1000000LL / static_cast<int64_t>(baud); }
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial2;
+
+// Sketch entry points, called by the simulation
+void setup();
+void loop();
+
+#endif // NATIVE_ARDUINO_H
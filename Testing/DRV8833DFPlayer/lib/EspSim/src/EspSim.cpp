@@ -0,0 +1,237 @@
+#include "EspSim.h"
+#include <esp_timer.h>
+#include <algorithm>
+#include <cstdarg>
+#include <queue>
+#include <vector>
+
+HardwareSerial Serial(0);
+HardwareSerial Serial2(2);
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void* arg;
+    uint32_t generation; // Of the last start, cancelling the previous ones
+    bool armed;
+};
+
+namespace {
+    constexpr uint8_t NUM_PINS = 40;
+    constexpr uint16_t ANALOG_MAX = 4095;
+    
+    struct ScheduledEvent {
+        int64_t time;
+        uint64_t sequence; // Same time: in scheduling order
+        EspSim::Event event;
+        
+        bool operator>(const ScheduledEvent& other) const {
+            return time != other.time ? time > other.time : sequence > other.sequence;
+        }
+    };
+    
+    int64_t timeUs = 0;
+    uint64_t sequence = 0;
+    std::priority_queue<ScheduledEvent, std::vector<ScheduledEvent>, std::greater<ScheduledEvent>> events;
+    uint8_t pins[NUM_PINS] = {};
+    uint16_t analogValues[NUM_PINS] = {};
+    EspSim::PinListener pinListener;
+    bool consoleEnabled = true;
+}
+
+namespace EspSim {
+    void begin() {
+        timeUs = 0;
+        sequence = 0;
+        events = {};
+        for (uint8_t pin = 0; pin < NUM_PINS; pin++) {
+            pins[pin] = LOW;
+            analogValues[pin] = ANALOG_MAX;
+        }
+    }
+    
+    int64_t now() {
+        return timeUs;
+    }
+    
+    void advance(int64_t durationUs) {
+        int64_t target = timeUs + durationUs;
+        while (!events.empty() && events.top().time <= target) {
+            ScheduledEvent next = events.top();
+            events.pop();
+            timeUs = next.time > timeUs ? next.time : timeUs;
+            next.event();
+        }
+        timeUs = target;
+    }
+    
+    void schedule(int64_t time, Event event) {
+        events.push({time > timeUs ? time : timeUs, sequence++, std::move(event)});
+    }
+    
+    uint8_t getPin(uint8_t pin) {
+        return pin < NUM_PINS ? pins[pin] : LOW;
+    }
+    
+    void setPinListener(PinListener listener) {
+        pinListener = listener;
+    }
+    
+    void setAnalog(uint8_t pin, uint16_t value) {
+        if (pin < NUM_PINS) {
+            analogValues[pin] = value > ANALOG_MAX ? ANALOG_MAX : value;
+        }
+    }
+    
+    void setConsoleEnabled(bool enabled) {
+        consoleEnabled = enabled;
+    }
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    (void)pin;
+    (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+    if (pin >= NUM_PINS || pins[pin] == level) {
+        return;
+    }
+    pins[pin] = level;
+    if (pinListener) {
+        pinListener(pin, level);
+    }
+}
+
+int digitalRead(uint8_t pin) {
+    return EspSim::getPin(pin);
+}
+
+uint16_t analogRead(uint8_t pin) {
+    return pin < NUM_PINS ? analogValues[pin] : 0;
+}
+
+unsigned long millis() {
+    return static_cast<unsigned long>(timeUs / 1000);
+}
+
+unsigned long micros() {
+    return static_cast<unsigned long>(timeUs);
+}
+
+void delay(uint32_t ms) {
+    EspSim::advance(ms * 1000LL);
+}
+
+size_t Print::printf(const char* format, ...) {
+    char buffer[256];
+    va_list arguments;
+    va_start(arguments, format);
+    int length = vsnprintf(buffer, sizeof(buffer), format, arguments);
+    va_end(arguments);
+    if (length < 0) {
+        return 0;
+    }
+    return write(reinterpret_cast<const uint8_t*>(buffer), std::min<size_t>(length, sizeof(buffer) - 1));
+}
+
+void HardwareSerial::begin(unsigned long baudRate, uint32_t config, int8_t rxPin, int8_t txPin) {
+    (void)config;
+    (void)rxPin;
+    (void)txPin;
+    baud = baudRate;
+    open = true;
+    txFreeUs = timeUs;
+    received.clear();
+}
+
+void HardwareSerial::end() {
+    open = false;
+    received.clear();
+}
+
+int HardwareSerial::available() {
+    int count = 0;
+    for (const auto& byte : received) {
+        if (byte.first > timeUs) {
+            break;
+        }
+        count++;
+    }
+    return count;
+}
+
+int HardwareSerial::read() {
+    if (received.empty() || received.front().first > timeUs) {
+        return -1;
+    }
+    uint8_t byte = received.front().second;
+    received.pop_front();
+    return byte;
+}
+
+int HardwareSerial::availableForWrite() {
+    if (port == 0) {
+        return TX_FIFO_SIZE;
+    }
+    int64_t pending = txFreeUs > timeUs ? (txFreeUs - timeUs + byteTime() - 1) / byteTime() : 0;
+    return pending >= TX_FIFO_SIZE ? 0 : TX_FIFO_SIZE - static_cast<int>(pending);
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+    if (port == 0) {
+        if (consoleEnabled) {
+            fwrite(buffer, 1, size, stdout);
+        }
+        return size;
+    }
+    if (!open) {
+        return 0;
+    }
+    
+    // Each byte after the previous one, received at its stop bit
+    for (size_t i = 0; i < size; i++) {
+        txFreeUs = (txFreeUs > timeUs ? txFreeUs : timeUs) + byteTime();
+        if (receiver) {
+            receiver(buffer[i], txFreeUs);
+        }
+    }
+    return size;
+}
+
+void HardwareSerial::inject(uint8_t byte, int64_t time) {
+    if (open) {
+        received.emplace_back(time, byte);
+    }
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle) {
+    *handle = new esp_timer{args->callback, args->arg, 0, false};
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeoutUs) {
+    if (timer->armed) {
+        return ESP_FAIL;
+    }
+    timer->armed = true;
+    uint32_t generation = ++timer->generation;
+    EspSim::schedule(timeUs + static_cast<int64_t>(timeoutUs), [timer, generation]() {
+        if (timer->armed && timer->generation == generation) {
+            timer->armed = false;
+            timer->callback(timer->arg);
+        }
+    });
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    if (!timer->armed) {
+        return ESP_FAIL;
+    }
+    timer->armed = false;
+    return ESP_OK;
+}
+
+int64_t esp_timer_get_time() {
+    return timeUs;
+}
@@ -0,0 +1,64 @@
+#ifndef ESP_SIM_H
+#define ESP_SIM_H
+
+#include <Arduino.h>
+#include <functional>
+
+/**
+ * Host side of the native build, standing for the ESP32 the firmware uses.
+ *
+ * Time is discrete: it only moves in delay(), which runs in time order the
+ * esp_timer callbacks and the events scheduled by the device models due
+ * meanwhile, the clock reading their time exactly. Pins are levels, output
+ * changes are reported to a listener (power switches); analog inputs are set
+ * by the simulation.
+ */
+namespace EspSim {
+    using Event = std::function<void()>;
+    using PinListener = std::function<void(uint8_t pin, uint8_t level)>;
+    
+    /**
+     * Reset the clock and the pins
+     */
+    void begin();
+    
+    /**
+     * Get the time, in microseconds
+     */
+    int64_t now();
+    
+    /**
+     * Move the time forward, running the events due
+     * @param durationUs Microseconds
+     */
+    void advance(int64_t durationUs);
+    
+    /**
+     * Run a function at a time (device model events)
+     * @param timeUs Virtual time, not before now()
+     * @param event Function to run
+     */
+    void schedule(int64_t timeUs, Event event);
+    
+    /**
+     * Get the level of a pin
+     */
+    uint8_t getPin(uint8_t pin);
+    
+    /**
+     * Set where the output changes are reported
+     */
+    void setPinListener(PinListener listener);
+    
+    /**
+     * Set the reading of an analog input (0-4095)
+     */
+    void setAnalog(uint8_t pin, uint16_t value);
+    
+    /**
+     * Silence the serial console
+     */
+    void setConsoleEnabled(bool enabled);
+}
+
+#endif // ESP_SIM_H
@@ -0,0 +1,124 @@
+#include "ChimeScheduler.h"
+#include <algorithm>
+
+namespace {
+    // Commands preloading the track
+    constexpr uint8_t PRELOAD_COMMANDS = 4;
+}
+
+ChimeScheduler::ChimeScheduler(DFPlayer& player, PulseScheduler& pulses) : player(player), pulses(pulses) {
+    // Nothing else to initialize
+}
+
+void ChimeScheduler::begin() {
+    player.begin();
+    stats.maxBootMs = Chime::BOOT_TIME_MS;
+}
+
+void ChimeScheduler::update() {
+    DFPlayer::Event event = player.update();
+    int64_t now = esp_timer_get_time();
+    int64_t chimeUs = getChimeTime();
+    
+    if (event == DFPlayer::EVENT_ERROR && state != STATE_IDLE) {
+        stats.errors++;
+        finishChime(now);
+        return;
+    }
+    
+    switch (state) {
+        case STATE_IDLE:
+            if (now < chimeUs - leadTime()) {
+                break;
+            }
+            if (isDark()) {
+                stats.muted++;
+                finishChime(now);
+                break;
+            }
+            player.powerOn();
+            powerOnUs = now;
+            resumed = false;
+            state = STATE_BOOTING;
+            break;
+        
+        case STATE_BOOTING:
+            if (event == DFPlayer::EVENT_READY) {
+                stats.lastBootMs = (now - powerOnUs) / 1000;
+                stats.maxBootMs = std::max(stats.maxBootMs, stats.lastBootMs);
+            } else if (now - powerOnUs < Chime::BOOT_TIMEOUT_MS * 1000LL) {
+                break;
+            }
+            
+            // Started silent and paused at once: the track is opened, the
+            // resume only has to unpause it
+            player.setVolume(0);
+            player.playTrack(Chime::TRACK);
+            player.pause();
+            player.setVolume(Chime::VOLUME);
+            state = STATE_PRELOADING;
+            break;
+        
+        case STATE_PRELOADING:
+            // The resume is taken at the end of its frame, on the tick
+            if (now < chimeUs - DFPlayer::FRAME_US) {
+                break;
+            }
+            if (isDark()) {
+                stats.muted++;
+                finishChime(now);
+                break;
+            }
+            
+            // Booted too slowly, the resume waits for the preloading
+            if (!player.isIdle()) {
+                stats.late++;
+            }
+            player.resume();
+            player.update();
+            state = STATE_PLAYING;
+            break;
+        
+        case STATE_PLAYING:
+            if (!resumed && player.isIdle()) {
+                resumed = true;
+                stats.chimes++;
+                stats.lastLatencyUs = player.getLastCommandUs() - chimeUs;
+                stats.maxLatencyUs = std::max(stats.maxLatencyUs, stats.lastLatencyUs);
+            }
+            if (event == DFPlayer::EVENT_TRACK_END || now >= chimeUs + Chime::MAX_PLAY_MS * 1000LL) {
+                finishChime(now);
+            }
+            break;
+    }
+}
+
+int64_t ChimeScheduler::leadTime() const {
+    return (stats.maxBootMs + Chime::LEAD_MARGIN_MS) * 1000LL +
+           PRELOAD_COMMANDS * (DFPlayer::COMMAND_GAP_US + DFPlayer::FRAME_US);
+}
+
+bool ChimeScheduler::isDark() {
+    return analogRead(Pins::LDR) < Chime::LDR_DARK_THRESHOLD;
+}
+
+void ChimeScheduler::finishChime(int64_t now) {
+    if (player.isPowered()) {
+        player.powerOff();
+        stats.lastOnMs = (now - powerOnUs) / 1000;
+        stats.totalOnMs += stats.lastOnMs;
+    }
+    chimeTick += Chime::INTERVAL_S;
+    state = STATE_IDLE;
+}
+
+void ChimeScheduler::printReport() const {
+    Serial.printf("Chimes: %lu played, %lu muted, %lu late, %lu failed, latency %lld us (max %lld us), "
+                  "boot %lu ms (max %lu ms), on %lu ms (total %llu ms)\n",
+                  static_cast<unsigned long>(stats.chimes), static_cast<unsigned long>(stats.muted),
+                  static_cast<unsigned long>(stats.late), static_cast<unsigned long>(stats.errors),
+                  static_cast<long long>(stats.lastLatencyUs),
+                  static_cast<long long>(stats.maxLatencyUs), static_cast<unsigned long>(stats.lastBootMs),
+                  static_cast<unsigned long>(stats.maxBootMs), static_cast<unsigned long>(stats.lastOnMs),
+                  static_cast<unsigned long long>(stats.totalOnMs));
+}
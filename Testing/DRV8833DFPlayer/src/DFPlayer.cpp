@@ -0,0 +1,125 @@
+#include "DFPlayer.h"
+#include <esp_timer.h>
+
+DFPlayer::DFPlayer(HardwareSerial& serial) : serial(serial) {
+    // Nothing else to initialize
+}
+
+void DFPlayer::begin() {
+    pinMode(Pins::DFPLAYER_POWER, OUTPUT);
+    digitalWrite(Pins::DFPLAYER_POWER, LOW);
+    pinMode(Pins::DFPLAYER_TX, INPUT);
+}
+
+void DFPlayer::powerOn() {
+    if (powered) {
+        return;
+    }
+    digitalWrite(Pins::DFPLAYER_POWER, HIGH);
+    serial.begin(BAUD_RATE, SERIAL_8N1, Pins::DFPLAYER_RX, Pins::DFPLAYER_TX);
+    powered = true;
+    queueCount = 0;
+    receivedCount = 0;
+    lastCommandUs = esp_timer_get_time();
+}
+
+void DFPlayer::powerOff() {
+    if (!powered) {
+        return;
+    }
+    serial.end();
+    pinMode(Pins::DFPLAYER_TX, INPUT);
+    digitalWrite(Pins::DFPLAYER_POWER, LOW);
+    powered = false;
+    queueCount = 0;
+}
+
+bool DFPlayer::playTrack(uint16_t track) {
+    return enqueue(CMD_PLAY_TRACK, track);
+}
+
+bool DFPlayer::setVolume(uint8_t volume) {
+    return enqueue(CMD_VOLUME, volume);
+}
+
+bool DFPlayer::pause() {
+    return enqueue(CMD_PAUSE, 0);
+}
+
+bool DFPlayer::resume() {
+    return enqueue(CMD_RESUME, 0);
+}
+
+DFPlayer::Event DFPlayer::update() {
+    if (!powered) {
+        return EVENT_NONE;
+    }
+    
+    // One command at a time, once the module took the previous one
+    int64_t now = esp_timer_get_time();
+    if (queueCount > 0 && now >= lastCommandUs + COMMAND_GAP_US && serial.availableForWrite() >= FRAME_SIZE) {
+        const Command& command = queue[queueHead];
+        uint8_t frame[FRAME_SIZE] = {START_BYTE, VERSION, LENGTH, command.code, 0,
+                                     static_cast<uint8_t>(command.parameter >> 8),
+                                     static_cast<uint8_t>(command.parameter), 0, 0, END_BYTE};
+        uint16_t sum = checksum(frame);
+        frame[7] = sum >> 8;
+        frame[8] = sum & 0xFF;
+        serial.write(frame, FRAME_SIZE);
+        lastCommandUs = now + FRAME_US;
+        queueHead = (queueHead + 1) % QUEUE_SIZE;
+        queueCount--;
+    }
+    
+    while (serial.available() > 0) {
+        Event event = parse(static_cast<uint8_t>(serial.read()));
+        if (event != EVENT_NONE) {
+            return event;
+        }
+    }
+    return EVENT_NONE;
+}
+
+bool DFPlayer::enqueue(uint8_t code, uint16_t parameter) {
+    if (!powered || queueCount == QUEUE_SIZE) {
+        return false;
+    }
+    queue[(queueHead + queueCount) % QUEUE_SIZE] = {code, parameter};
+    queueCount++;
+    return true;
+}
+
+uint16_t DFPlayer::checksum(const uint8_t* frame) {
+    uint16_t sum = 0;
+    for (uint8_t i = 1; i < 7; i++) {
+        sum += frame[i];
+    }
+    return static_cast<uint16_t>(0 - sum);
+}
+
+DFPlayer::Event DFPlayer::parse(uint8_t byte) {
+    // Resynchronize on the start byte
+    if (receivedCount == 0 && byte != START_BYTE) {
+        return EVENT_NONE;
+    }
+    received[receivedCount++] = byte;
+    if (receivedCount < FRAME_SIZE) {
+        return EVENT_NONE;
+    }
+    receivedCount = 0;
+    
+    uint16_t sum = (received[7] << 8) | received[8];
+    if (received[9] != END_BYTE || sum != checksum(received)) {
+        return EVENT_NONE;
+    }
+    switch (received[3]) {
+        case MSG_READY:
+            return EVENT_READY;
+        case MSG_TRACK_END:
+            return EVENT_TRACK_END;
+        case MSG_ERROR:
+            return EVENT_ERROR;
+        default:
+            return EVENT_NONE;
+    }
+}
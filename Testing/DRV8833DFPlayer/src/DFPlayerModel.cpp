@@ -0,0 +1,152 @@
+#ifdef NATIVE_BUILD
+
+#include "DFPlayerModel.h"
+
+namespace {
+    constexpr uint8_t CMD_PLAY_TRACK = 0x03;
+    constexpr uint8_t CMD_VOLUME = 0x06;
+    constexpr uint8_t CMD_RESUME = 0x0D;
+    constexpr uint8_t CMD_PAUSE = 0x0E;
+    constexpr uint8_t MSG_TRACK_END = 0x3D;
+    constexpr uint8_t MSG_READY = 0x3F;
+    constexpr uint16_t DEVICE_SD = 0x02;
+    
+    uint16_t checksum(const uint8_t* frame) {
+        uint16_t sum = 0;
+        for (uint8_t i = 1; i < 7; i++) {
+            sum += frame[i];
+        }
+        return static_cast<uint16_t>(0 - sum);
+    }
+}
+
+DFPlayerModel::DFPlayerModel(HardwareSerial& serial, uint8_t powerPin, std::mt19937& random) :
+    serial(serial), powerPin(powerPin), random(random) {
+    serial.setReceiver([this](uint8_t byte, int64_t timeUs) { receive(byte, timeUs); });
+}
+
+void DFPlayerModel::configure(int64_t bootMin, int64_t bootMax, int64_t track) {
+    bootMinUs = bootMin;
+    bootMaxUs = bootMax;
+    trackUs = track;
+}
+
+void DFPlayerModel::onPin(uint8_t pin, uint8_t level) {
+    if (pin != powerPin || (level == HIGH) == powered) {
+        return;
+    }
+    int64_t now = EspSim::now();
+    generation++;
+    powered = level == HIGH;
+    ready = false;
+    volume = 0;
+    trackOpen = false;
+    playing = false;
+    frameCount = 0;
+    
+    if (!powered) {
+        sessions.back().powerOffUs = now;
+        return;
+    }
+    sessions.push_back({now, -1, -1, -1, 0});
+    
+    // Boots, mounts the SD card, then reports it
+    std::uniform_int_distribution<int64_t> bootTime(bootMinUs, bootMaxUs);
+    uint32_t bootGeneration = generation;
+    EspSim::schedule(now + bootTime(random), [this, bootGeneration]() {
+        if (generation == bootGeneration) {
+            ready = true;
+            sessions.back().readyUs = EspSim::now();
+            send(MSG_READY, DEVICE_SD, EspSim::now());
+        }
+    });
+}
+
+void DFPlayerModel::receive(uint8_t byte, int64_t timeUs) {
+    if (!powered) {
+        return;
+    }
+    if (frameCount == 0 && byte != 0x7E) {
+        sessions.back().lostCommands++;
+        return;
+    }
+    frame[frameCount++] = byte;
+    if (frameCount < FRAME_SIZE) {
+        return;
+    }
+    frameCount = 0;
+    
+    uint16_t sum = (frame[7] << 8) | frame[8];
+    if (!ready || frame[9] != 0xEF || sum != checksum(frame)) {
+        sessions.back().lostCommands++;
+        return;
+    }
+    handleCommand(frame[3], (frame[5] << 8) | frame[6], timeUs);
+}
+
+void DFPlayerModel::handleCommand(uint8_t code, uint16_t parameter, int64_t timeUs) {
+    switch (code) {
+        case CMD_PLAY_TRACK:
+            (void)parameter;
+            trackOpen = true;
+            playedUs = 0;
+            startPlayback(timeUs);
+            break;
+        case CMD_VOLUME:
+            volume = static_cast<uint8_t>(parameter);
+            checkAudible(timeUs);
+            break;
+        case CMD_PAUSE:
+            if (playing) {
+                playedUs += timeUs - resumedUs;
+                playing = false;
+                generation++;
+            }
+            break;
+        case CMD_RESUME:
+            if (trackOpen && !playing) {
+                startPlayback(timeUs);
+            }
+            break;
+        default:
+            sessions.back().lostCommands++;
+            break;
+    }
+}
+
+void DFPlayerModel::startPlayback(int64_t timeUs) {
+    playing = true;
+    resumedUs = timeUs;
+    checkAudible(timeUs);
+    
+    // Reports the end of the track, unless paused or powered off before
+    generation++;
+    uint32_t playGeneration = generation;
+    EspSim::schedule(timeUs + trackUs - playedUs, [this, playGeneration]() {
+        if (generation == playGeneration) {
+            playing = false;
+            trackOpen = false;
+            send(MSG_TRACK_END, 1, EspSim::now());
+        }
+    });
+}
+
+void DFPlayerModel::checkAudible(int64_t timeUs) {
+    Session& session = sessions.back();
+    if (playing && volume > 0 && session.audibleUs < 0) {
+        session.audibleUs = timeUs;
+    }
+}
+
+void DFPlayerModel::send(uint8_t code, uint16_t parameter, int64_t timeUs) {
+    uint8_t message[FRAME_SIZE] = {0x7E, 0xFF, 0x06, code, 0, static_cast<uint8_t>(parameter >> 8),
+                                   static_cast<uint8_t>(parameter), 0, 0, 0xEF};
+    uint16_t sum = checksum(message);
+    message[7] = sum >> 8;
+    message[8] = sum & 0xFF;
+    for (uint8_t i = 0; i < FRAME_SIZE; i++) {
+        serial.inject(message[i], timeUs + (i + 1) * BYTE_US);
+    }
+}
+
+#endif // NATIVE_BUILD
@@ -0,0 +1,107 @@
+#include "PulseScheduler.h"
+#include <algorithm>
+
+namespace {
+    constexpr int64_t SECOND_US = Timing::SECOND_MS * 1000LL;
+}
+
+bool PulseScheduler::begin() {
+    for (const auto& pins : COIL_PINS) {
+        for (uint8_t pin : pins) {
+            pinMode(pin, OUTPUT);
+            digitalWrite(pin, LOW);
+        }
+    }
+    
+    esp_timer_create_args_t timerArgs = {};
+    timerArgs.callback = onTimer;
+    timerArgs.arg = this;
+    timerArgs.dispatch_method = ESP_TIMER_TASK;
+    timerArgs.name = "pulses";
+    if (esp_timer_create(&timerArgs, &timer) != ESP_OK) {
+        return false;
+    }
+    
+    startUs = esp_timer_get_time() + SECOND_US;
+    armTimer();
+    return true;
+}
+
+int64_t PulseScheduler::getTickTime(uint32_t tick) const {
+    return startUs + static_cast<int64_t>(tick) * SECOND_US;
+}
+
+PulseScheduler::Stats PulseScheduler::getStats() {
+    portENTER_CRITICAL(&statsMux);
+    Stats copy = stats;
+    portEXIT_CRITICAL(&statsMux);
+    return copy;
+}
+
+void PulseScheduler::printReport() {
+    Stats current = getStats();
+    int64_t meanErrorUs = current.ticks > 0 ? current.totalErrorUs / current.ticks : 0;
+    Serial.printf("Ticks: %lu, phase error %lld us (max %lld us, mean %lld us), %lu skipped\n",
+                  static_cast<unsigned long>(current.ticks), static_cast<long long>(current.lastErrorUs),
+                  static_cast<long long>(current.maxErrorUs), static_cast<long long>(meanErrorUs),
+                  static_cast<unsigned long>(current.ticksSkipped));
+}
+
+void PulseScheduler::onTimer(void* arg) {
+    static_cast<PulseScheduler*>(arg)->runStep();
+}
+
+void PulseScheduler::runStep() {
+    int64_t now = esp_timer_get_time();
+    const Step& current = STEPS[step];
+    
+    if (step == 0) {
+        // The tick starts now, the pulses keep their width from here
+        int64_t errorUs = now - dueTime();
+        tickStartUs = now;
+        portENTER_CRITICAL(&statsMux);
+        stats.ticks++;
+        stats.lastErrorUs = errorUs;
+        stats.maxErrorUs = std::max(stats.maxErrorUs, errorUs);
+        stats.totalErrorUs += errorUs;
+        portEXIT_CRITICAL(&statsMux);
+    }
+    
+    uint8_t pin = COIL_PINS[current.coil][polarity[current.coil] ? 1 : 0];
+    if (current.energize) {
+        digitalWrite(pin, HIGH);
+    } else {
+        digitalWrite(pin, LOW);
+        polarity[current.coil] = !polarity[current.coil];
+    }
+    
+    if (++step == NUM_STEPS) {
+        step = 0;
+        tick++;
+    }
+    armTimer();
+}
+
+int64_t PulseScheduler::dueTime() const {
+    // Ticks on the absolute schedule, edges within a tick from its start
+    if (step == 0) {
+        return getTickTime(tick);
+    }
+    return tickStartUs + STEPS[step].offsetMs * 1000LL;
+}
+
+void PulseScheduler::armTimer() {
+    int64_t now = esp_timer_get_time();
+    
+    // More than a second late (stalled), give up the ticks missed rather than
+    // rushing them out
+    if (step == 0 && now - dueTime() >= SECOND_US) {
+        uint32_t behind = (now - dueTime()) / SECOND_US;
+        tick += behind;
+        portENTER_CRITICAL(&statsMux);
+        stats.ticksSkipped += behind;
+        portEXIT_CRITICAL(&statsMux);
+    }
+    
+    esp_timer_start_once(timer, std::max<int64_t>(dueTime() - now, 0));
+}
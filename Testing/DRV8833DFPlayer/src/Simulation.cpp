@@ -0,0 +1,148 @@
+#ifdef NATIVE_BUILD
+
+#include "Simulation.h"
+#include <EspSim.h>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+Simulation::Simulation(PulseScheduler& pulses, ChimeScheduler& chimes) :
+    pulseScheduler(pulses), chimeScheduler(chimes) {
+    // Nothing else to initialize
+}
+
+int Simulation::run(int argc, char** argv) {
+    if (!parseArguments(argc, argv)) {
+        printUsage(argv[0]);
+        return 2;
+    }
+    random.seed(seed);
+    
+    EspSim::begin();
+    EspSim::setConsoleEnabled(verbose);
+    DFPlayerModel model(Serial2, Pins::DFPLAYER_POWER, random);
+    model.configure(bootMinUs, bootMaxUs, trackUs);
+    EspSim::setPinListener([&model](uint8_t pin, uint8_t level) { model.onPin(pin, level); });
+    setup();
+    
+    // Light level of each interval, set half an interval before its chime
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    int64_t intervalUs = Chime::INTERVAL_S * 1000000LL;
+    for (int chime = 0; chime < numChimes; chime++) {
+        bool dark = chance(random) < darkRate;
+        darkChimes.push_back(dark);
+        int64_t chimeUs = pulseScheduler.getTickTime((chime + 1) * Chime::INTERVAL_S);
+        EspSim::schedule(chimeUs - intervalUs / 2, [dark]() {
+            EspSim::setAnalog(Pins::LDR, dark ? LDR_DARK : LDR_LIT);
+        });
+    }
+    
+    int64_t endUs = pulseScheduler.getTickTime(numChimes * Chime::INTERVAL_S) + Chime::MAX_PLAY_MS * 1000LL +
+                    intervalUs / 2;
+    while (EspSim::now() < endUs) {
+        loop();
+    }
+    
+    int failures = checkChimes(model);
+    const ChimeScheduler::Stats& stats = chimeScheduler.getStats();
+    fflush(stdout);
+    fprintf(stderr, "Simulated %d chimes, boot %lld-%lld ms, track %lld ms\n", numChimes,
+            static_cast<long long>(bootMinUs / 1000), static_cast<long long>(bootMaxUs / 1000),
+            static_cast<long long>(trackUs / 1000));
+    fprintf(stderr, "Firmware: %u played, %u muted, %u late, %u failed, max latency %lld us, max boot %u ms, "
+            "%llu ms powered\n", stats.chimes, stats.muted, stats.late, stats.errors,
+            static_cast<long long>(stats.maxLatencyUs), stats.maxBootMs,
+            static_cast<unsigned long long>(stats.totalOnMs));
+    fprintf(stderr, "Chimes failing the checks: %d\n", failures);
+    return failures > 0 ? 1 : 0;
+}
+
+bool Simulation::parseArguments(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (argument == "--chimes" && hasValue) {
+            numChimes = atoi(argv[++i]);
+        } else if (argument == "--boot-ms" && i + 2 < argc) {
+            bootMinUs = atoll(argv[++i]) * 1000;
+            bootMaxUs = atoll(argv[++i]) * 1000;
+        } else if (argument == "--track-ms" && hasValue) {
+            trackUs = atoll(argv[++i]) * 1000;
+        } else if (argument == "--dark-rate" && hasValue) {
+            darkRate = atof(argv[++i]) / 100.0;
+        } else if (argument == "--seed" && hasValue) {
+            seed = static_cast<uint32_t>(atol(argv[++i]));
+        } else if (argument == "--verbose") {
+            verbose = true;
+        } else {
+            return false;
+        }
+    }
+    return numChimes > 0 && bootMinUs > 0 && bootMaxUs >= bootMinUs && trackUs > 0;
+}
+
+void Simulation::printUsage(const char* program) const {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "Run the firmware with a simulated DFPlayer and print the chimes\n"
+        "(CH,Chime,Dark,LeadMs,BootMs,LatencyUs,OnMs,Result).\n"
+        "  --chimes N          Chimes to run, one per interval (default 24)\n"
+        "  --boot-ms MIN MAX   DFPlayer boot time range (default 1000 1400)\n"
+        "  --track-ms MS       Track duration (default 3000)\n"
+        "  --dark-rate PCT     Intervals dark at the LDR (default 0)\n"
+        "  --seed N            Random seed (default 0)\n"
+        "  --verbose           Print the firmware console\n",
+        program);
+}
+
+int Simulation::checkChimes(const DFPlayerModel& model) const {
+    const std::vector<DFPlayerModel::Session>& sessions = model.getSessions();
+    size_t sessionIndex = 0;
+    int failures = 0;
+    for (int chime = 0; chime < numChimes; chime++) {
+        int64_t chimeUs = pulseScheduler.getTickTime((chime + 1) * Chime::INTERVAL_S);
+        
+        // Session powered up for this chime, if any
+        const DFPlayerModel::Session* session = nullptr;
+        if (sessionIndex < sessions.size() && sessions[sessionIndex].powerOnUs < chimeUs + Chime::MAX_PLAY_MS * 1000LL &&
+            sessions[sessionIndex].powerOnUs > chimeUs - static_cast<int64_t>(Chime::INTERVAL_S) * 500000) {
+            session = &sessions[sessionIndex++];
+        }
+        
+        const char* result = "OK";
+        long long leadMs = -1;
+        long long bootMs = -1;
+        long long latencyUs = -1;
+        long long onMs = 0;
+        if (session) {
+            leadMs = (chimeUs - session->powerOnUs) / 1000;
+            bootMs = session->readyUs >= 0 ? (session->readyUs - session->powerOnUs) / 1000 : -1;
+            latencyUs = session->audibleUs >= 0 ? session->audibleUs - chimeUs : -1;
+            onMs = session->powerOffUs >= 0 ? (session->powerOffUs - session->powerOnUs) / 1000 : -1;
+        }
+        
+        if (darkChimes[chime]) {
+            if (session && session->audibleUs >= 0) {
+                result = "HEARD_IN_THE_DARK";
+            }
+        } else if (!session || session->audibleUs < 0) {
+            result = "NOT_HEARD";
+        } else if (session->audibleUs < chimeUs) {
+            result = "EARLY";
+        } else if (latencyUs > LATENCY_TOLERANCE_US) {
+            result = "LATE";
+        } else if (session->lostCommands > 0) {
+            result = "COMMANDS_LOST";
+        } else if (session->powerOffUs < 0) {
+            result = "NOT_POWERED_OFF";
+        }
+        if (strcmp(result, "OK") != 0) {
+            failures++;
+        }
+        printf("CH,%d,%d,%lld,%lld,%lld,%lld,%s\n", chime + 1, darkChimes[chime] ? 1 : 0, leadMs, bootMs,
+               latencyUs, onMs, result);
+    }
+    return failures;
+}
+
+#endif // NATIVE_BUILD
@@ -7,6 +7,7 @@ routing commands to the appropriate functionality modules.
 import click
 from rich.console import Console
 
+from .energy import Battery, CurrentProfile, show_energy_report
 from .gps import test_gps_module
 
 console = Console()
@@ -51,5 +52,50 @@ def gps(device: str|None, baud_rate):
     test_gps_module(device, baud_rate)
 
 
+@cli.command()
+@click.argument("trace", type=click.Path(exists=True, dir_okay=False))
+@click.option(
+    "--hex",
+    "hex_dump",
+    is_flag=True,
+    help="The trace is a hex dump of the PowerTrace buffer read over UPDI",
+)
+@click.option("--standby-ua", default=2.0, show_default=True, help="MCU current in standby (uA)")
+@click.option("--active-ua", default=10.0, show_default=True, help="MCU current when running (uA)")
+@click.option("--wake-us", default=2440.0, show_default=True, help="Interrupt time before each wake-up (us)")
+@click.option("--shifter-ua", default=2.0, show_default=True, help="Level shifter current (uA)")
+@click.option("--dfplayer-ma", default=20.0, show_default=True, help="DFPlayer current when powered (mA)")
+@click.option("--led-ma", default=2.0, show_default=True, help="Current of a lit LED (mA)")
+@click.option("--capacity-mah", default=2000.0, show_default=True, help="Battery capacity (mAh)")
+@click.option("--battery-v", default=2.4, show_default=True, help="Mean battery voltage (V)")
+@click.option("--efficiency", default=85.0, show_default=True, help="Step-up efficiency (%)")
+@click.option("--boost-ua", default=0.0, show_default=True, help="Step-up no-load input current (uA)")
+def energy(
+    trace: str,
+    hex_dump: bool,
+    standby_ua: float,
+    active_ua: float,
+    wake_us: float,
+    shifter_ua: float,
+    dfplayer_ma: float,
+    led_ma: float,
+    capacity_mah: float,
+    battery_v: float,
+    efficiency: float,
+    boost_ua: float,
+):
+    """
+    Estimate the battery life of ClockV1 from a power trace.
+
+    The trace is either the PT lines printed by the native simulation of
+    ATtiny1616Boilerplate (--trace), or a hex dump of the PowerTrace buffer
+    of the device. Each power state is given a current, the time spent in
+    each state gives the mean current and the battery life on 2xAA.
+    """
+    profile = CurrentProfile(standby_ua, active_ua, wake_us, shifter_ua, dfplayer_ma, led_ma)
+    battery = Battery(capacity_mah, battery_v, efficiency / 100, boost_ua)
+    show_energy_report(trace, hex_dump, profile, battery)
+
+
 if __name__ == "__main__":
     cli()
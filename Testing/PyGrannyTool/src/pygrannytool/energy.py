@@ -0,0 +1,229 @@
+"""
+Energy model functionality for PyGrannyTool.
+
+This module replays the power trace of the ClockV1 firmware
+(ATtiny1616Boilerplate, PowerTrace) with a current figure per power state,
+and estimates the mean battery current and the battery life on 2xAA.
+"""
+
+from dataclasses import dataclass
+
+from rich.console import Console
+from rich.table import Table
+
+console = Console()
+
+# Power trace records, as stored by PowerTrace
+TICKS_PER_SECOND = 1024
+TIME_BITS = 24
+TIME_WRAP = 1 << TIME_BITS
+BUFFER_HEADER_SIZE = 4
+RECORD_SIZE = 4
+
+# States, PowerTrace::State
+CPU_ACTIVE = 0x01
+DFPLAYER_ON = 0x02
+LED1_ON = 0x04
+LED2_ON = 0x08
+
+# Supply of the board, after the MT3608 step-up
+RAIL_VOLTAGE = 3.3
+
+
+@dataclass
+class CurrentProfile:
+    """
+    Current drawn on the 3.3V rail in each state. The defaults are datasheet
+    typical figures, to be replaced by measurements.
+    """
+
+    standby_ua: float = 2.0  # ATtiny1616 in standby, RTC and TCBs running
+    active_ua: float = 10.0  # ATtiny1616 running at 32kHz
+    wake_us: float = 2440.0  # Interrupt before each wake-up (80 cycles at 32kHz)
+    shifter_ua: float = 2.0  # MAX14611, always powered
+    dfplayer_ma: float = 20.0  # DFPlayer Mini powered, idle
+    led_ma: float = 2.0  # Each LED lit
+
+
+@dataclass
+class Battery:
+    """
+    2xAA cells through the MT3608 step-up converter.
+    """
+
+    capacity_mah: float = 2000.0
+    voltage: float = 2.4  # Mean voltage of two cells over their discharge
+    efficiency: float = 0.85  # Step-up efficiency
+    boost_ua: float = 0.0  # Step-up no-load input current
+
+
+def read_text_trace(path: str) -> list[tuple[int, int]]:
+    """
+    Read the PT,Ticks,States lines of a file, such as the output of the
+    native simulation run with --trace. Other lines are ignored.
+
+    Args:
+        path (str): Path of the file
+
+    Returns:
+        list[tuple[int, int]]: Records as (ticks, states), in time order
+    """
+    records = []
+    with open(path, encoding="utf-8") as file:
+        for line in file:
+            fields = line.strip().split(",")
+            if len(fields) == 3 and fields[0] == "PT":
+                records.append((int(fields[1]), int(fields[2])))
+    return records
+
+
+def read_hex_trace(path: str) -> list[tuple[int, int]]:
+    """
+    Read a hex dump of the PowerTrace buffer read over UPDI. Tokens that are
+    not a single byte (addresses, offsets) are ignored.
+
+    Args:
+        path (str): Path of the dump
+
+    Returns:
+        list[tuple[int, int]]: Records as (ticks, states), oldest first
+    """
+    data = bytearray()
+    with open(path, encoding="utf-8") as file:
+        for token in file.read().split():
+            token = token.removeprefix("0x")
+            if len(token) == 2:
+                try:
+                    data.append(int(token, 16))
+                except ValueError:
+                    pass
+
+    num_records = (len(data) - BUFFER_HEADER_SIZE) // RECORD_SIZE
+    if num_records <= 0:
+        return []
+    head, count = data[0], data[1]
+    lost = data[2] | (data[3] << 8)
+    if lost:
+        console.print(f"[yellow]{lost} records were overwritten before the dump[/yellow]")
+
+    records = []
+    for i in range(min(count, num_records)):
+        index = (head + num_records - count + i) % num_records
+        offset = BUFFER_HEADER_SIZE + index * RECORD_SIZE
+        record = int.from_bytes(data[offset : offset + RECORD_SIZE], "little")
+        records.append((record & (TIME_WRAP - 1), record >> TIME_BITS))
+    return records
+
+
+def unwrap(records: list[tuple[int, int]]) -> list[tuple[float, int]]:
+    """
+    Convert the 24-bit record times to seconds from the first record. The
+    firmware records a wake-up at least every RTC overflow, so consecutive
+    records are less than a wrap apart.
+
+    Args:
+        records (list[tuple[int, int]]): Records as (ticks, states)
+
+    Returns:
+        list[tuple[float, int]]: Records as (seconds, states)
+    """
+    timeline = []
+    elapsed = 0
+    previous = None
+    for ticks, states in records:
+        if previous is not None:
+            elapsed += (ticks - previous) % TIME_WRAP
+        previous = ticks
+        timeline.append((elapsed / TICKS_PER_SECOND, states))
+    return timeline
+
+
+def replay(timeline: list[tuple[float, int]], profile: CurrentProfile) -> dict:
+    """
+    Integrate the current of each component over the trace.
+
+    Args:
+        timeline (list[tuple[float, int]]): Records as (seconds, states)
+        profile (CurrentProfile): Current figures
+
+    Returns:
+        dict: Duration (s), wake-ups, time in each state (s) and mean
+        current of each component (uA, 3.3V rail)
+    """
+    duration = timeline[-1][0] - timeline[0][0] if timeline else 0.0
+    state_time = {CPU_ACTIVE: 0.0, DFPLAYER_ON: 0.0, LED1_ON: 0.0, LED2_ON: 0.0}
+    wakes = 0
+    for (time, states), (next_time, next_states) in zip(timeline, timeline[1:]):
+        for state in state_time:
+            if states & state:
+                state_time[state] += next_time - time
+        if next_states & CPU_ACTIVE and not states & CPU_ACTIVE:
+            wakes += 1
+
+    result = {"duration": duration, "wakes": wakes, "state_time": state_time, "currents": {}}
+    if duration <= 0:
+        return result
+
+    active = state_time[CPU_ACTIVE] + wakes * profile.wake_us / 1e6
+    leds = state_time[LED1_ON] + state_time[LED2_ON]
+    result["currents"] = {
+        "ATtiny1616": (profile.standby_ua * (duration - active) + profile.active_ua * active) / duration,
+        "MAX14611": profile.shifter_ua,
+        "DFPlayer": profile.dfplayer_ma * 1000 * state_time[DFPLAYER_ON] / duration,
+        "LEDs": profile.led_ma * 1000 * leds / duration,
+    }
+    return result
+
+
+def show_energy_report(
+    path: str, hex_dump: bool, profile: CurrentProfile, battery: Battery
+) -> None:
+    """
+    Replay a power trace and print the current budget and the battery life.
+
+    Args:
+        path (str): Trace file, PT lines or hex dump
+        hex_dump (bool): The file is a hex dump of the PowerTrace buffer
+        profile (CurrentProfile): Current figures
+        battery (Battery): Battery and step-up figures
+
+    Returns:
+        None
+    """
+    records = read_hex_trace(path) if hex_dump else read_text_trace(path)
+    result = replay(unwrap(records), profile)
+    duration = result["duration"]
+    if duration <= 0:
+        console.print("[bold red]Not enough records in the trace![/bold red]")
+        return
+
+    rail_ua = sum(result["currents"].values())
+    battery_ua = rail_ua * RAIL_VOLTAGE / (battery.voltage * battery.efficiency) + battery.boost_ua
+    life_hours = battery.capacity_mah * 1000 / battery_ua
+
+    table = Table(title=f"Power trace: {len(records)} records over {duration / 3600:.2f} hours")
+    table.add_column("Component")
+    table.add_column("On time", justify="right")
+    table.add_column("Mean current (uA)", justify="right")
+    table.add_column("Share", justify="right")
+    on_times = {
+        "ATtiny1616": result["state_time"][CPU_ACTIVE],
+        "MAX14611": duration,
+        "DFPlayer": result["state_time"][DFPLAYER_ON],
+        "LEDs": result["state_time"][LED1_ON] + result["state_time"][LED2_ON],
+    }
+    for name, current in result["currents"].items():
+        table.add_row(
+            name,
+            f"{100 * on_times[name] / duration:.4f}%",
+            f"{current:.3f}",
+            f"{100 * current / rail_ua:.1f}%",
+        )
+    console.print(table)
+
+    console.print(f"Wake-ups: {result['wakes'] * 3600 / duration:.1f} per hour")
+    console.print(f"Mean current: {rail_ua:.2f} uA at {RAIL_VOLTAGE}V, {battery_ua:.2f} uA from the cells")
+    console.print(
+        f"[bold green]Estimated battery life: {life_hours / 24:.0f} days "
+        f"({life_hours / 24 / 365:.1f} years)[/bold green]"
+    )
@@ -0,0 +1,151 @@
+#ifndef BINARY_LOG_H
+#define BINARY_LOG_H
+
+#include "Config.h"
+#include "LogRecord.h"
+
+/**
+ * Compact binary log format, an alternative to CSV (see LOG_FORMAT_BINARY).
+ *
+ * The file is a sequence of self-contained blocks. Each block is a BlockHeader
+ * followed by eventCount varint-encoded events (LEB128, 7 bits per byte, low
+ * bits first). Each event value packs:
+ *
+ *   bit 0      edge (0 = rising, 1 = falling)
+ *   bits 1-4   signal type
+ *   bits 5+    time since the previous event of the block (the base timestamp
+ *              for the first event), in microseconds if FLAG_MICROSECONDS is
+ *              set, in milliseconds otherwise; an event earlier than the
+ *              previous one starts a new block
+ *
+ * Records (see LogRecord.h) are events of signal type SIGNAL_RECORD, followed
+ * by varints for the record type, the number of fields and each field
+ * (zigzag-encoded, as protobuf sint32).
+ *
+ * The CRC is a standard CRC-32 (as zlib.crc32) over the header bytes preceding
+ * the crc field followed by the payload. scripts/bin2csv.py decodes the file
+ * back to the usual "Signal,Edge,Timestamp" CSV.
+ */
+namespace BinaryLog {
+    constexpr uint32_t MAGIC = 0x424C4347; // "GCLB" in file byte order
+    constexpr uint8_t VERSION = 2; // 1: no records
+    
+    // Header flags
+    constexpr uint8_t FLAG_MICROSECONDS = 0x01; // Deltas are in microseconds
+    
+    // Event value layout
+    constexpr uint8_t EDGE_BITS = 1;
+    constexpr uint8_t SIGNAL_BITS = 4;
+    constexpr uint8_t DELTA_SHIFT = EDGE_BITS + SIGNAL_BITS;
+    
+    // Signal type escaping a record
+    constexpr uint8_t SIGNAL_RECORD = (1 << SIGNAL_BITS) - 1;
+    
+    // Block size including its header, one block per SD sector at most
+    constexpr size_t MAX_BLOCK_SIZE = 512;
+    
+    // Largest varint for a 64-bit value
+    constexpr size_t MAX_VARINT_SIZE = 10;
+    
+    // Largest record: event, type, number of fields and 32-bit fields
+    constexpr size_t MAX_RECORD_SIZE = MAX_VARINT_SIZE + 2 + MAX_RECORD_FIELDS * 5;
+    
+    struct __attribute__((packed)) BlockHeader {
+        uint32_t magic;         // MAGIC
+        uint8_t version;        // VERSION
+        uint8_t flags;          // FLAG_* bits
+        uint16_t eventCount;    // Number of events in the payload, records included
+        uint32_t baseTimestamp; // millis() value of the first event
+        uint16_t baseMicros;    // Sub-millisecond part of the first event
+        uint16_t payloadSize;   // Payload size in bytes, following the header
+        uint32_t crc;           // CRC-32 of the header up to here and the payload
+    };
+    static_assert(sizeof(BlockHeader) == 20, "BlockHeader layout is part of the file format");
+    
+    /**
+     * Compute a CRC-32 (IEEE 802.3, reflected, as zlib.crc32)
+     * @param data Bytes to checksum
+     * @param length Number of bytes
+     * @param crc Previous CRC to continue from (0 to start)
+     * @return Updated CRC
+     */
+    uint32_t crc32(const uint8_t* data, size_t length, uint32_t crc = 0);
+}
+
+class BinaryLogEncoder {
+public:
+    /**
+     * Constructor, starts with an empty block
+     */
+    BinaryLogEncoder();
+    
+    /**
+     * Append an event to the current block
+     * @param entry Event to encode
+     * @return true if the event was added, false if the block is full or sealed,
+     *         or if the event is earlier than the previous one (it starts the
+     *         next block)
+     */
+    bool append(const EventEntry& entry);
+    
+    /**
+     * Append a record to the current block
+     * @param record Record to encode
+     * @return true if the record was added, false if the block is full or sealed,
+     *         or if the record is earlier than the previous one (it starts the
+     *         next block)
+     */
+    bool append(const LogRecord& record);
+    
+    /**
+     * Finalize the header and CRC of the current block, no event can be
+     * appended until clear() is called
+     * @return Size of the block in bytes (header and payload)
+     */
+    size_t seal();
+    
+    /**
+     * Get the block bytes, valid once sealed
+     * @return Pointer to the first byte of the block
+     */
+    const uint8_t* data() const;
+    
+    /**
+     * Start a new, empty block
+     */
+    void clear();
+    
+    /**
+     * Check if the current block holds no event
+     * @return true if no event was appended since the last clear()
+     */
+    bool isEmpty() const;
+    
+    /**
+     * Check if the current block was sealed and is waiting to be written
+     * @return true if seal() was called since the last clear()
+     */
+    bool isSealed() const;
+
+private:
+    uint8_t block[BinaryLog::MAX_BLOCK_SIZE];
+    size_t size;              // Bytes used, header included
+    uint16_t eventCount;
+    uint32_t lastTimestamp;   // Previous event, for the delta
+    uint16_t lastMicros;
+    bool sealed;
+    
+    BinaryLog::BlockHeader& header();
+    
+    // Check if an event goes back in time from the previous one, the deltas
+    // are unsigned
+    bool isBackward(uint32_t timestamp, uint16_t micros) const;
+    
+    // Encode the time, signal and edge of an event
+    void appendEvent(uint32_t timestamp, uint16_t micros, uint8_t signal, uint8_t edge);
+    
+    // Encode a varint
+    void appendVarint(uint64_t value);
+};
+
+#endif // BINARY_LOG_H
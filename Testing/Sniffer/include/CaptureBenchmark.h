@@ -0,0 +1,72 @@
+#ifndef CAPTURE_BENCHMARK_H
+#define CAPTURE_BENCHMARK_H
+
+#include "Config.h"
+#include "RingBuffer.h"
+
+/**
+ * Edge rate benchmark of the capture backend (CaptureConfig::BENCHMARK).
+ *
+ * Wire Pins::BENCH_OUT to the RF input. A square wave of increasing frequency
+ * is generated with the LEDC peripheral, and the RF events reaching the ring
+ * buffer are counted and checked against the expected edges. The SD card is
+ * not used, events are discarded as soon as they are counted.
+ */
+class CaptureBenchmark {
+public:
+    /**
+     * Constructor
+     * @param buffer Reference to the ring buffer the backend writes to
+     */
+    CaptureBenchmark(RingBuffer& buffer);
+    
+    /**
+     * Run the frequency sweep and print the results on the serial console
+     * The capture backend must be started
+     */
+    void run();
+
+private:
+    // Outcome of one frequency step
+    struct StepResult {
+        uint32_t expectedEdges;
+        uint32_t receivedEdges;
+        uint32_t edgeTypeErrors; // Same edge type twice in a row
+    };
+    
+    // CPU cycles taken by RingBuffer::write()
+    struct WriteCost {
+        uint32_t minCycles;
+        uint32_t maxCycles;
+        uint64_t totalCycles;
+        uint32_t numWrites;
+    };
+    
+    RingBuffer& eventBuffer;
+    
+    /**
+     * Generate a square wave and count the edges captured during the step
+     * @param frequency Square wave frequency in Hz
+     * @return Edge counts of the step
+     */
+    StepResult measure(uint32_t frequency);
+    
+    /**
+     * Time single event writes to a scratch ring buffer and print the costs
+     */
+    void measureWriteCost();
+    
+    /**
+     * Print the cost of a kind of writes
+     * @param name Kind of writes
+     * @param cost Costs measured
+     */
+    void printWriteCost(const char* name, const WriteCost& cost) const;
+    
+    /**
+     * Remove all events from the ring buffer
+     */
+    void discardEvents();
+};
+
+#endif // CAPTURE_BENCHMARK_H
@@ -0,0 +1,130 @@
+#ifndef CARD_PRESENCE_H
+#define CARD_PRESENCE_H
+
+#include "Config.h"
+#include "PipelineMetrics.h"
+
+// States of the SD card
+enum CardState : uint8_t {
+    CARD_ABSENT,   // No card answering
+    CARD_MOUNTING, // Card found, being mounted
+    CARD_READY,    // Mounted, files can be written
+    CARD_FAILED    // Card found but failed to mount or to write, retried after a backoff
+};
+
+/**
+ * Presence of the SD card, mounting it only once it has been found.
+ *
+ * Unmounted, the card is looked for with the detect pin of the socket when
+ * wired (CardConfig::HAS_DETECT_PIN), or by sending it CMD0 over SPI: a card
+ * answers in a few bytes, the bus reads 0xFF without one. Mounted, it is
+ * checked with CMD13 (SEND_STATUS), so a removed card is noticed before
+ * events are read out of the ring buffer for it. A card found but failing to
+ * mount, or failing a write, is mounted again after a backoff doubling at each
+ * failure: SD.begin() is only called for a card that is there, and not at
+ * every flush for a card that does not work.
+ *
+ * Only used by the task owning the SD card.
+ */
+class CardPresence {
+public:
+    /**
+     * Constructor
+     * @param metrics Reference to the pipeline metrics, counting the mounts
+     */
+    CardPresence(PipelineMetrics& metrics);
+    
+    /**
+     * Set up the SPI bus and the detect pin, and mount the card if present
+     * @return true if the card is ready
+     */
+    bool begin();
+    
+    /**
+     * Check the card, mounting it if it has appeared, or unmounting it if it
+     * has been removed
+     * @return true if the card is ready
+     */
+    bool update();
+    
+    /**
+     * Unmount the card after a write error, it is mounted again after the
+     * backoff if still present
+     */
+    void handleError();
+    
+    /**
+     * Check if the card is mounted, without probing it
+     * @return true if the card was ready at the last update()
+     */
+    bool isReady() const;
+    
+    /**
+     * Get the state of the card at the last update()
+     */
+    CardState getState() const;
+
+private:
+    // SD commands in SPI mode
+    static constexpr uint8_t CMD_GO_IDLE_STATE = 0;
+    static constexpr uint8_t CMD_SEND_STATUS = 13;
+    
+    // R1 response bits
+    static constexpr uint8_t R1_IDLE = 0x01;
+    static constexpr uint8_t R1_ERRORS = 0x7E;
+    
+    // Bytes read at most before the response of a command (NCR)
+    static constexpr size_t MAX_RESPONSE_WAIT = 8;
+    
+    PipelineMetrics& pipelineMetrics;
+    CardState state = CARD_ABSENT;
+    
+    // Mount backoff, from the last failure
+    uint32_t failures = 0; // Since the card was last found absent
+    unsigned long lastFailureTime = 0;
+    unsigned long backoff = CardConfig::MOUNT_BACKOFF_MIN;
+    
+    /**
+     * Check if a card is inserted, while unmounted: detect pin or CMD0
+     */
+    bool isInserted();
+    
+    /**
+     * Check if the mounted card still answers: detect pin and CMD13
+     */
+    bool isResponding();
+    
+    /**
+     * Mount the card
+     * @return true if mounted
+     */
+    bool mount();
+    
+    /**
+     * Unmount the card
+     * @param newState State after unmounting
+     */
+    void unmount(CardState newState);
+    
+    /**
+     * Send a command to the card and read its response
+     * @param command Command index
+     * @param response Response bytes, R1 first
+     * @param length Number of response bytes (1 for R1, 2 for R2)
+     * @return true if the card answered
+     */
+    bool sendCommand(uint8_t command, uint8_t* response, size_t length);
+};
+
+// Card state mapping
+inline const char* cardStateToString(CardState state) {
+    switch (state) {
+        case CARD_ABSENT: return "absent";
+        case CARD_MOUNTING: return "mounting";
+        case CARD_READY: return "ready";
+        case CARD_FAILED: return "failed";
+        default: return "unknown";
+    }
+}
+
+#endif // CARD_PRESENCE_H
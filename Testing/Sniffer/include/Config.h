@@ -3,32 +3,31 @@
 
 #include <Arduino.h>
 
-// Pin definitions
+// Pin definitions (clock signals: see Signals::TABLE)
 namespace Pins {
-    // Clock signals
-    constexpr uint8_t sigRF = 36; // Radio Frequency signal
-    constexpr uint8_t sigMU = 39; // Minute Unit signal
-    constexpr uint8_t sigPON = 34; // Power ON signal
-    constexpr uint8_t sigBA = 35; // BA signal
-
     // SD Card
     constexpr uint8_t SD_CS = 17;   // Chip select
     constexpr uint8_t SD_MOSI = 23; // MOSI
     constexpr uint8_t SD_CLK = 18;  // Clock
     constexpr uint8_t SD_MISO = 19; // MISO
-
+    constexpr uint8_t SD_DETECT = 4; // Card detect switch of the socket, if wired (see CardConfig)
+    
     // RGB LED pins
     constexpr uint8_t LED_R = 32; // Red
     constexpr uint8_t LED_G = 33; // Green
     constexpr uint8_t LED_B = 25; // Blue
+    
+    // Capture benchmark square wave output, wire it to the RF input
+    constexpr uint8_t BENCH_OUT = 26;
 }
 
-// Signal types
+// Signal types, indexes in Signals::TABLE
 enum SignalType : uint8_t {
     RF_SIGNAL = 0,
     MU_SIGNAL = 1,
     PON_SIGNAL = 2,
-    BA_SIGNAL = 3
+    BA_SIGNAL = 3,
+    BR_SIGNAL = 4
 };
 
 // Edge types
@@ -37,30 +36,350 @@ enum EdgeType : uint8_t {
     EDGE_FALLING = 1
 };
 
-// Event entry structure (8 bytes total)
+// Log file formats
+enum LogFormat : uint8_t {
+    LOG_FORMAT_CSV = 0,    // One "Signal,Edge,Timestamp" line per event
+    LOG_FORMAT_BINARY = 1  // Delta-encoded blocks (see BinaryLog.h)
+};
+
+// Edge capture backends
+enum CaptureBackend : uint8_t {
+    CAPTURE_GPIO_INTERRUPT = 0, // One GPIO interrupt per edge (SignalLogger)
+    CAPTURE_RMT = 1             // Pulse trains recorded by the RMT receiver (RmtSignalLogger)
+};
+
+// Event entry structure (8 bytes total), packed in 4 bytes in the ring buffer
 struct EventEntry {
     uint8_t signalType;  // RF, MU, PON, BA
     uint8_t edgeType;    // RISING or FALLING
-    uint16_t reserved;   // For future use and alignment
+    uint16_t micros;     // Sub-millisecond part of the timestamp (0-999 us)
     uint32_t timestamp;  // millis() value
 };
 
+// Edge capture configuration
+namespace CaptureConfig {
+    // Backend capturing the signal edges
+    constexpr CaptureBackend BACKEND = CAPTURE_GPIO_INTERRUPT;
+    
+    // Measure the maximum edge rate of the backend instead of logging (see CaptureBenchmark.h)
+    constexpr bool BENCHMARK = false;
+    
+    // RMT tick rate, durations are read in microseconds
+    constexpr uint32_t RMT_RESOLUTION_HZ = 1000000;
+    
+    // Symbols per receive buffer (2 of the 8 RMT memory blocks per signal)
+    constexpr size_t RMT_SYMBOLS = 128;
+    
+    // A pulse train ends after this long without edge (15-bit tick counter, <32.7ms)
+    constexpr uint32_t RMT_IDLE_THRESHOLD_US = 30000;
+    
+    // Hardware glitch filter (at most 255 APB cycles, 3.1us)
+    constexpr uint32_t RMT_FILTER_NS = 3000;
+    
+    // Pulse trains of several signals complete out of order, their edges are
+    // held this long to be written to the ring buffer sorted by time
+    constexpr uint32_t RMT_REORDER_WINDOW_US = 2 * RMT_IDLE_THRESHOLD_US;
+}
+
 // Timing constants
 namespace Timing {
-    // SD Card commit interval
+    // SD Card commit interval (timed flush and sync of the data file)
     constexpr unsigned long SD_COMMIT_INTERVAL = 60 * 1000UL; // 1 minute
+    
+    // Flush retry interval while the buffer is above its high watermark
+    constexpr unsigned long SD_RETRY_INTERVAL = 1000UL; // 1 second
+    
+    // Status LED refresh interval in loop()
+    constexpr unsigned long STATUS_UPDATE_INTERVAL = 100UL;
+    
+    // Stamp edges with esp_timer microseconds instead of millis() only
+    constexpr bool HIGH_RESOLUTION_TIMESTAMPS = true;
+    
+    // Glitch filter: edges closer than this on the same signal are dropped
+    constexpr uint32_t MIN_PULSE_WIDTH_US = CaptureConfig::BENCHMARK
+        ? 0      // Let the benchmark reach the limits of the backend
+        : HIGH_RESOLUTION_TIMESTAMPS
+        ? 50     // Comparator chatter, well below the 4ms protocol slots
+        : 1000;  // 1ms minimum detection time (millis() resolution limit)
+}
+
+// Input of a captured signal
+struct SignalChannel {
+    const char* name;         // Signal column of the CSV file
+    uint8_t pin;
+    uint8_t mode;             // pinMode(): INPUT, INPUT_PULLUP or INPUT_PULLDOWN
+    uint32_t minPulseWidthUs; // Glitch filter: edges closer than this on the signal are dropped
+    bool enabled;             // Disabled signals are not captured, and keep their index
+};
+
+// Captured signals, everything per signal derives from this table: pins and
+// interrupts of the capture backends, per-signal state and statistics, names
+// in the data file. Adding a signal is one more line (with its SignalType if
+// the code refers to it), bin2csv.py and csv2vcd.py/.cpp list the names too.
+namespace Signals {
+    constexpr SignalChannel TABLE[] = {
+        // Name, pin, mode, glitch filter, enabled
+        {"RF", 36, INPUT_PULLUP, Timing::MIN_PULSE_WIDTH_US, true},  // Radio Frequency signal
+        {"MU", 39, INPUT_PULLUP, Timing::MIN_PULSE_WIDTH_US, true},  // Minute Unit signal
+        {"PON", 34, INPUT_PULLUP, Timing::MIN_PULSE_WIDTH_US, true}, // Power ON signal
+        {"BA", 35, INPUT_PULLUP, Timing::MIN_PULSE_WIDTH_US, true},  // BA signal
+        {"BR", 38, INPUT_PULLUP, Timing::MIN_PULSE_WIDTH_US, false}, // Reset during time adjustments, not wired yet
+    };
+    constexpr size_t COUNT = sizeof(TABLE) / sizeof(TABLE[0]);
+    
+    // Number of enabled signals
+    constexpr size_t countEnabled() {
+        size_t count = 0;
+        for (const SignalChannel& channel : TABLE) {
+            count += channel.enabled ? 1 : 0;
+        }
+        return count;
+    }
+    constexpr size_t ENABLED_COUNT = countEnabled();
+    
+    // Bits of the enabled signal pins in a 32-pin GPIO input register
+    constexpr uint32_t inputMask(uint8_t firstPin) {
+        uint32_t mask = 0;
+        for (const SignalChannel& channel : TABLE) {
+            if (channel.enabled && channel.pin >= firstPin && channel.pin < firstPin + 32) {
+                mask |= 1UL << (channel.pin - firstPin);
+            }
+        }
+        return mask;
+    }
+    constexpr uint32_t GPIO_IN_MASK = inputMask(0);   // GPIO 0-31
+    constexpr uint32_t GPIO_IN1_MASK = inputMask(32); // GPIO 32-39
+    
+    // Check the name of a signal, at compile time
+    constexpr bool hasName(SignalType signal, const char* name) {
+        const char* tableName = TABLE[signal].name;
+        while (*tableName && *tableName == *name) {
+            tableName++;
+            name++;
+        }
+        return *tableName == *name;
+    }
+    
+    // Check that the pins exist and that no two enabled signals share one
+    constexpr bool validPins() {
+        for (size_t i = 0; i < COUNT; i++) {
+            for (size_t j = 0; j < i; j++) {
+                if (TABLE[i].enabled && TABLE[j].enabled && TABLE[i].pin == TABLE[j].pin) {
+                    return false;
+                }
+            }
+            if (TABLE[i].pin > 39) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+// Signal type of the trigger markers in the ring buffer, replaced by records
+// before reaching the files (see TriggerCapture.h)
+constexpr uint8_t TRIGGER_MARKER_SIGNAL = 14;
+
+// The binary log and the ring buffer store signals in 4 bits, the last value
+// marks records (see BinaryLog.h) and sync entries (see RingBuffer.h)
+static_assert(Signals::COUNT <= TRIGGER_MARKER_SIGNAL, "At most 14 signals");
+static_assert(Signals::validPins(), "Signal pins must be GPIO 0-39, one signal each");
+static_assert(Signals::COUNT > BR_SIGNAL && Signals::hasName(RF_SIGNAL, "RF") && Signals::hasName(MU_SIGNAL, "MU")
+              && Signals::hasName(PON_SIGNAL, "PON") && Signals::hasName(BA_SIGNAL, "BA")
+              && Signals::hasName(BR_SIGNAL, "BR"), "SignalType must match Signals::TABLE");
+
+// SD card presence (CardPresence)
+namespace CardConfig {
+    // Card detect switch wired to Pins::SD_DETECT, the card is probed over SPI otherwise
+    constexpr bool HAS_DETECT_PIN = false;
+    
+    // Level of the detect pin with a card inserted (switch to ground, pulled up)
+    constexpr uint8_t DETECT_LEVEL = LOW;
+    
+    // SPI clock of the probes, the card identification speed
+    constexpr uint32_t PROBE_FREQUENCY = 400000;
+    
+    // Delay before mounting again a card that failed to mount or to write,
+    // doubled at each failure up to the maximum
+    constexpr unsigned long MOUNT_BACKOFF_MIN = 1000UL;      // 1 second
+    constexpr unsigned long MOUNT_BACKOFF_MAX = 64 * 1000UL; // About a minute
 }
 
 // Buffer configuration
 namespace BufferConfig {
-    // Using about 32KB of memory for the ring buffer (4096 events)
-    constexpr size_t BUFFER_SIZE = 4096; 
+    // Using 32KB of memory for the ring buffer, in 4-byte slots (8192 events,
+    // see RingBuffer.h)
+    constexpr size_t BUFFER_SIZE = 8192;
+    
+    // Events expanded at once on the consumer side of the ring buffer (4KB,
+    // a spill block)
+    constexpr size_t READ_WINDOW_SIZE = 512;
+    
+    // Slot count waking the flush task before the periodic flush
+    constexpr size_t HIGH_WATERMARK = BUFFER_SIZE * 3 / 4;
+    
+    // SD card sector size, file writes end on sector boundaries
+    constexpr size_t SD_SECTOR_SIZE = 512;
+    
+    // Staging buffer events are formatted into before being written (8 sectors)
+    constexpr size_t STAGING_BUFFER_SIZE = 8 * SD_SECTOR_SIZE;
     
-    // File path for data storage
-    const char* const DATA_FILE_PATH = "/data.csv";
+    // Format of the data file
+    constexpr LogFormat LOG_FORMAT = LOG_FORMAT_CSV;
     
-    // CSV header
-    const char* const CSV_HEADER = "Signal,Edge,Timestamp";
+    // CSV header (the Micros column is only written in high resolution mode)
+    const char* const CSV_HEADER = Timing::HIGH_RESOLUTION_TIMESTAMPS
+        ? "Signal,Edge,Timestamp,Micros"
+        : "Signal,Edge,Timestamp";
+}
+
+// Data files on the SD card, "/log/00001.csv" and so on, each with an index
+// ("/log/00001.idx", see LogIndex.h)
+namespace LogFileConfig {
+    // Directory of the data files
+    const char* const DIRECTORY = "/log";
+    
+    // Extension of the data files, the index files take INDEX_EXTENSION
+    const char* const DATA_EXTENSION = BufferConfig::LOG_FORMAT == LOG_FORMAT_BINARY ? ".bin" : ".csv";
+    const char* const INDEX_EXTENSION = ".idx";
+    
+    // Start a new data file at each boot and card insertion, instead of
+    // appending to the last one
+    constexpr bool NEW_FILE_PER_SESSION = true;
+    
+    // Size starting the next data file, checked at sync points
+    constexpr uint32_t MAX_FILE_SIZE = 64 * 1024 * 1024UL; // 64MB
+    
+    // Data covered by an index entry, at least: entries are written at the
+    // first sync point past it
+    constexpr uint32_t INDEX_BLOCK_SIZE = 32 * 1024UL; // 32KB
+}
+
+// Spill tiers, holding events while the SD card is absent
+namespace SpillConfig {
+    // Spill tier in PSRAM, only used on boards having some
+    constexpr bool ENABLE_PSRAM = true;
+    constexpr size_t PSRAM_CAPACITY = 256 * 1024; // Events (2MB)
+    
+    // Spill tier in a LittleFS file on the internal flash ("spiffs" partition)
+    constexpr bool ENABLE_FLASH = true;
+    const char* const FLASH_FILE_PATH = "/spill.bin";
+    constexpr size_t FLASH_RESERVED_BYTES = 16 * 1024; // Left free for LittleFS itself
+    
+    // Events are moved out of RAM in blocks of this size (4KB, one flash sector)
+    constexpr size_t BLOCK_EVENTS = 512;
+    
+    // Spill while the card is absent and the ring buffer holds this many events
+    constexpr size_t SPILL_WATERMARK = BufferConfig::HIGH_WATERMARK;
+}
+
+// On-device decoders, replacing raw events by decoded records in the data file
+namespace DecoderConfig {
+    // Events held while frames are being decoded, before being written
+    constexpr size_t HOLD_CAPACITY = 512;
+    
+    // MU/BA hour frames (HourFrameDecoder)
+    constexpr bool ENABLE_HOUR_FRAME_DECODER = true;
+    
+    // Keep the raw MU/BA events of valid frames too (malformed frames always keep them)
+    constexpr bool KEEP_HOUR_FRAME_EVENTS = false;
+    
+    // DCF77 minutes on RF (DCF77Decoder)
+    constexpr bool ENABLE_DCF77_DECODER = true;
+    
+    // Keep the raw RF events of cleanly decoded minutes too (the others always keep them)
+    constexpr bool KEEP_DCF77_EVENTS = false;
+    
+    // RF level during the 100/200ms second pulses, depends on the receiver module
+    constexpr uint8_t DCF77_PULSE_LEVEL = HIGH;
+    
+    // Log the raw events no decoder claimed. Turn off for soak tests relying on
+    // the statistics records: only records and the raw events of malformed
+    // frames are logged then
+    constexpr bool KEEP_UNCLAIMED_EVENTS = true;
+}
+
+// Edge firing a trigger (see TriggerConfig)
+struct TriggerCondition {
+    SignalType signal;     // Signal of the edge
+    uint8_t edge;          // EdgeType, or TRIGGER_ANY_EDGE
+    SignalType idleSignal; // Signal that must have had no edge for idleUs, if idleUs is not 0
+    uint32_t idleUs;
+};
+constexpr uint8_t TRIGGER_ANY_EDGE = 2;
+
+// Trigger capture: only the events around the triggers are logged, a trigger
+// record marks each trigger (TriggerCapture, GPIO interrupt backend only)
+namespace TriggerConfig {
+    // Log the trigger windows instead of every event
+    constexpr bool ENABLE = false;
+    
+    // Events logged before a trigger, at most PRE_TRIGGER_EVENTS of them
+    constexpr uint32_t PRE_TRIGGER_US = 100000;
+    constexpr size_t PRE_TRIGGER_EVENTS = 256;
+    
+    // Events logged after a trigger, a trigger within extends the capture
+    constexpr uint32_t POST_TRIGGER_US = 1000000;
+    
+    // Any of them fires a trigger
+    constexpr TriggerCondition CONDITIONS[] = {
+        // Signal, edge, idle signal, idle time
+        {BA_SIGNAL, EDGE_RISING, BA_SIGNAL, 0},         // Hour frame, and time adjustments
+        {PON_SIGNAL, EDGE_FALLING, RF_SIGNAL, 2000000}, // Power on while no DCF77 second pulse for 2s
+    };
+    constexpr size_t NUM_CONDITIONS = sizeof(CONDITIONS) / sizeof(CONDITIONS[0]);
+}
+static_assert(!TriggerConfig::ENABLE || CaptureConfig::BACKEND == CAPTURE_GPIO_INTERRUPT,
+              "Trigger capture needs the GPIO interrupt backend");
+
+// Pulse width statistics, logged as records (SignalStatistics)
+namespace StatisticsConfig {
+    // Per-signal histograms of the high and low pulse widths
+    constexpr bool ENABLE = true;
+    
+    // Event time covered by each set of statistics records
+    constexpr unsigned long SUMMARY_INTERVAL = 15 * 60 * 1000UL; // 15 minutes
+    
+    // Character requesting the statistics on the serial console
+    constexpr char REPORT_COMMAND = 's';
+}
+
+// Health metrics of the capture pipeline (PipelineMetrics)
+namespace MetricsConfig {
+    // Log the metrics as records, at the first SD card sync past the interval
+    constexpr bool ENABLE_RECORDS = true;
+    constexpr unsigned long RECORD_INTERVAL = 10 * 60 * 1000UL; // 10 minutes
+}
+
+// Serial console, and live streaming of the events over it (SerialStreamer)
+namespace StreamConfig {
+    // Console speed, and speed while streaming (scripts/streamrecv.cpp follows)
+    constexpr unsigned long CONSOLE_BAUD_RATE = 115200;
+    constexpr unsigned long STREAM_BAUD_RATE = 921600;
+    
+    // Characters starting and stopping the streaming on the serial console,
+    // the SD card is not written meanwhile
+    constexpr char START_COMMAND = 'b';
+    constexpr char STOP_COMMAND = 'e';
+    
+    // Longest time an event waits in the ring buffer while streaming (ms)
+    constexpr unsigned long STREAM_INTERVAL = 100;
+}
+
+// Flush task configuration
+namespace TaskConfig {
+    // Stack size of the flush task, in bytes: FAT and LittleFS writes, NVS,
+    // printf and the metrics records. The part never used is in the PM records
+    constexpr uint32_t FLUSH_TASK_STACK_SIZE = 8192;
+    
+    // Above loop() (priority 1) so flushes are not delayed by the status LED
+    constexpr uint32_t FLUSH_TASK_PRIORITY = 2;
+    
+    // Task decoding the RMT pulse trains (RMT backend only)
+    constexpr uint32_t CAPTURE_TASK_STACK_SIZE = 4096;
+    
+    // Above the flush task, it is the producer of the ring buffer
+    constexpr uint32_t CAPTURE_TASK_PRIORITY = 5;
 }
 
 // Status codes for LED
@@ -73,13 +392,7 @@ enum StatusCode {
 
 // Signal name mapping
 inline const char* signalTypeToString(SignalType type) {
-    switch (type) {
-        case RF_SIGNAL: return "RF";
-        case MU_SIGNAL: return "MU";
-        case PON_SIGNAL: return "PON";
-        case BA_SIGNAL: return "BA";
-        default: return "UN"; // Unknown
-    }
+    return type < Signals::COUNT ? Signals::TABLE[type].name : "UN"; // Unknown
 }
 
 // Edge type mapping
@@ -0,0 +1,110 @@
+#ifndef DCF77_DECODER_H
+#define DCF77_DECODER_H
+
+#include "Config.h"
+#include "EventPipeline.h"
+
+/**
+ * Streaming DCF77 decoder of the RF signal.
+ *
+ * Every second but the 59th starts with a pulse: 100ms for a 0, 200ms for a
+ * 1. The missing pulse marks the minute, the 59 bits received between two
+ * markers hold the time of the minute starting at the second marker (60 bits
+ * when a leap second is inserted).
+ *
+ * Each telegram produces a RECORD_DCF77_MINUTE record, at the position of its
+ * first pulse, with the fields:
+ *   0  valid (1 if all parities and ranges check, 0 otherwise)
+ *   1  minute
+ *   2  hour
+ *   3  day of month
+ *   4  day of week (1 = Monday)
+ *   5  month
+ *   6  year (0-99)
+ *   7  flags: bit 0 CEST, bit 1 CET, bit 2 DST change announced, bit 3 leap
+ *      second announced, bit 4 call bit, bits 8-10 minute/hour/date parity
+ *      errors
+ *   8  lowest bit confidence (0-100)
+ *   9  mean bit confidence (0-100)
+ *   10 weak bits (confidence below 50) among bits 0-31, one bit each
+ *   11 weak bits among bits 32-59
+ * Bit confidence is 100 for a pulse of exactly 100 or 200ms, down to 0 at
+ * 150ms. Fields 1-6 are -1 for telegrams cut short by a reception error, and
+ * the raw events are kept unless the telegram is valid (see
+ * DecoderConfig::KEEP_DCF77_EVENTS).
+ */
+class DCF77Decoder : public EventDecoder {
+public:
+    /**
+     * Constructor
+     * @param eventPipeline Pipeline the decoder is added to, for its records
+     */
+    DCF77Decoder(EventPipeline& eventPipeline);
+    
+    uint8_t process(const EventEntry& event) override;
+
+private:
+    // Protocol timings, in microseconds
+    static constexpr int64_t SECOND_MIN = 900000;
+    static constexpr int64_t SECOND_MAX = 1100000;
+    static constexpr int64_t MARKER_MIN = 1900000;
+    static constexpr int64_t MARKER_MAX = 2100000;
+    static constexpr int64_t PULSE_ZERO = 100000;
+    static constexpr int64_t PULSE_ONE = 200000;
+    static constexpr int64_t PULSE_MIN = 50000;
+    static constexpr int64_t PULSE_MAX = 250000;
+    static constexpr int64_t RECEPTION_TIMEOUT = 2500000;
+    
+    static constexpr size_t NUM_BITS = 59;
+    static constexpr size_t MAX_BITS = NUM_BITS + 1; // Leap second
+    static constexpr uint8_t WEAK_CONFIDENCE = 50;
+    
+    EventPipeline& pipeline;
+    
+    // Last pulse
+    bool inPulse = false;
+    bool hasPulse = false;
+    EventEntry pulseStart = {};
+    
+    // Telegram being received, from its first pulse
+    bool receiving = false;
+    uint8_t owner = EventPipeline::NO_OWNER;
+    EventEntry telegramStart = {};
+    uint8_t bits[MAX_BITS];
+    uint8_t confidence[MAX_BITS];
+    size_t numBits = 0;
+    
+    /**
+     * Handle the start of a second pulse
+     * @param event Edge starting the pulse
+     */
+    void startPulse(const EventEntry& event);
+    
+    /**
+     * Handle the end of a second pulse, classifying it into a bit
+     * @param event Edge ending the pulse
+     */
+    void endPulse(const EventEntry& event);
+    
+    /**
+     * Decode the telegram being received and resolve its record
+     * Telegrams ended early by a reception error are logged as invalid
+     */
+    void endTelegram();
+    
+    /**
+     * Read a BCD number from the telegram
+     * @param first First bit, least significant
+     * @param count Number of bits
+     * @return Value, or -1 if a digit is above 9
+     */
+    int32_t readBCD(size_t first, size_t count) const;
+    
+    /**
+     * Check the even parity of a range of bits, parity bit included
+     * @return true if the parity is right
+     */
+    bool checkParity(size_t first, size_t last) const;
+};
+
+#endif // DCF77_DECODER_H
@@ -0,0 +1,163 @@
+#ifndef EVENT_PIPELINE_H
+#define EVENT_PIPELINE_H
+
+#include "Config.h"
+#include "LogRecord.h"
+
+/**
+ * Streaming decoder fed with the raw events, in time order.
+ *
+ * A decoder claims the events of a frame while it is being received, after
+ * reserving the slot of its record with EventPipeline::reserveRecord(). Once
+ * the frame is complete (or malformed), it resolves the slot with
+ * EventPipeline::resolve(), replacing the claimed events with the record or
+ * keeping them.
+ */
+class EventDecoder {
+public:
+    virtual ~EventDecoder() = default;
+    
+    /**
+     * Process the next event, before it enters the pipeline
+     * Called for the events of all signals, they also tell the time
+     * @param event Next event of the stream
+     * @return Record slot claiming the event, or EventPipeline::NO_OWNER
+     */
+    virtual uint8_t process(const EventEntry& event) = 0;
+};
+
+// Item leaving the pipeline: a raw event or a record
+struct LogItem {
+    const EventEntry* event; // nullptr for a record
+    const LogRecord* record; // nullptr for a raw event
+};
+
+/**
+ * Hold FIFO between the ring buffer and the data file.
+ *
+ * Events go through the decoders, then wait in the FIFO until the decoder
+ * claiming them resolves its frame. Unclaimed events wait behind claimed ones
+ * so that the output stays in time order. Records are written at the position
+ * of the first event of their frame. Unclaimed events are dropped if
+ * DecoderConfig::KEEP_UNCLAIMED_EVENTS is off.
+ *
+ * If the FIFO fills up, the oldest frame is given up and its events are kept.
+ * Only used by the flush task.
+ */
+class EventPipeline {
+public:
+    static constexpr uint8_t NO_OWNER = 0xFF;
+    
+    /**
+     * Add a decoder, fed with all the following events
+     * @param decoder Decoder to add
+     * @return true if added, false if there are too many decoders
+     */
+    bool addDecoder(EventDecoder& decoder);
+    
+    /**
+     * Feed an event through the decoders and hold it
+     * Trigger markers (TriggerCapture) are held as their record instead
+     * @param event Event to add
+     * @return true if added, false if the FIFO is full (write out the ready
+     *         items and try again)
+     */
+    bool push(const EventEntry& event);
+    
+    /**
+     * Add a record at the current position of the stream, from outside the
+     * decoders
+     * @param record Record to add
+     * @return true if added, false if the FIFO or the record slots are full
+     */
+    bool pushRecord(const LogRecord& record);
+    
+    /**
+     * Get the next item ready to be written
+     * @param item Set to the next item, valid until pop()
+     * @return true if an item is ready
+     */
+    bool next(LogItem& item);
+    
+    /**
+     * Remove the item returned by next()
+     */
+    void pop();
+    
+    /**
+     * Check if nothing is held
+     * @return true if the FIFO is empty
+     */
+    bool isEmpty() const;
+    
+    /**
+     * Reserve a record slot at the current position of the stream
+     * For decoders, from process()
+     * @return Record slot, or NO_OWNER if none is left
+     */
+    uint8_t reserveRecord();
+    
+    /**
+     * Resolve a record slot
+     * For decoders, the slot cannot be used afterwards
+     * @param owner Record slot, as returned by reserveRecord()
+     * @param record Record to write, nullptr for none
+     * @param keepEvents Keep the events claimed for the slot, or drop them
+     */
+    void resolve(uint8_t owner, const LogRecord* record, bool keepEvents);
+
+private:
+    static constexpr size_t MAX_DECODERS = 4;
+    static constexpr size_t MAX_RECORDS = 8;
+    
+    // Event or record waiting in the FIFO
+    struct HeldItem {
+        EventEntry event; // Unused for records
+        uint8_t owner;    // Record slot claiming the event or holding the record
+        bool isRecord;
+    };
+    
+    // Record of a frame being decoded
+    struct RecordSlot {
+        LogRecord record;
+        uint16_t references; // Held items referring to the slot
+        bool used;          // Allocated, until closed and no longer referred to
+        bool open;          // Not resolved by its decoder yet
+        bool resolved;      // Outcome known, the items can be written
+        bool hasRecord;
+        bool keepEvents;
+        bool abandoned;     // Given up on FIFO overflow, events kept
+    };
+    
+    EventDecoder* decoders[MAX_DECODERS];
+    size_t numDecoders = 0;
+    
+    HeldItem items[DecoderConfig::HOLD_CAPACITY];
+    size_t readIndex = 0;
+    size_t count = 0;
+    
+    RecordSlot slots[MAX_RECORDS] = {};
+    
+    /**
+     * Append an item to the FIFO, there must be room
+     */
+    void append(const EventEntry& event, uint8_t owner, bool isRecord);
+    
+    /**
+     * Give up the frame of the oldest item if it is not resolved yet, its
+     * events are kept
+     */
+    void abandonOldest();
+    
+    /**
+     * Check if the oldest item can be written out
+     */
+    bool isReady(const HeldItem& item) const;
+    
+    /**
+     * Remove the oldest item, releasing its record slot
+     */
+    void release();
+};
+
+#endif // EVENT_PIPELINE_H
@@ -0,0 +1,119 @@
+#ifndef FLUSH_TASK_H
+#define FLUSH_TASK_H
+
+#include "Config.h"
+#include "RingBuffer.h"
+#include "SDCardManager.h"
+#include "SpillStore.h"
+#include "SignalStatistics.h"
+#include "PipelineMetrics.h"
+#include "SerialStreamer.h"
+#include <atomic>
+
+// Outcome of the last flush, shown on the status LED by loop()
+enum FlushResult : uint8_t {
+    FLUSH_PENDING,  // No flush attempted yet
+    FLUSH_OK,       // All data saved
+    FLUSH_NO_CARD,  // SD card not available, data pending
+    FLUSH_ERROR     // Write error on a present card
+};
+
+/**
+ * FreeRTOS task owning the SD card.
+ *
+ * The task sleeps until either the ring buffer reaches its high watermark (the
+ * producer notifies it from the ISR) or the commit interval elapses. Watermark
+ * flushes write whole sectors only, timed flushes also sync the data file.
+ * Without SD card, the oldest events are spilled out of the ring buffer, and
+ * saved first once the card is back. It also prints the signal statistics on
+ * request, they are only updated by the pipeline it feeds, and logs the
+ * pipeline metrics. While streaming, it sends the events over the serial
+ * console instead, every StreamConfig::STREAM_INTERVAL, and leaves the card
+ * alone.
+ * It runs on the core opposite to the one handling the GPIO interrupts.
+ */
+class FlushTask {
+public:
+    /**
+     * Constructor
+     * @param buffer Reference to the ring buffer to drain
+     * @param sdCard Reference to the SD card manager, only used by the task
+     * @param spill Reference to the spill store, only used by the task
+     * @param statistics Reference to the signal statistics, only used by the task
+     * @param metrics Reference to the pipeline metrics, reported by the task
+     * @param streamer Reference to the serial streamer, only used by the task
+     */
+    FlushTask(RingBuffer& buffer, SDCardManager& sdCard, SpillStore& spill, SignalStatistics& statistics,
+              PipelineMetrics& metrics, SerialStreamer& streamer);
+    
+    /**
+     * Start the task, on the core opposite to the caller's
+     * Call from the core the GPIO interrupts are attached on
+     * @return true if the task was created
+     */
+    bool begin();
+    
+    /**
+     * Get the outcome of the last flush
+     * @return Last flush result
+     */
+    FlushResult getLastResult() const;
+    
+    /**
+     * Have the task print the signal statistics
+     */
+    void requestStatistics();
+    
+    /**
+     * Have the task stream the events over the serial console, or go back to
+     * the SD card
+     * @param enable true to stream
+     */
+    void requestStreaming(bool enable);
+
+private:
+    RingBuffer& eventBuffer;
+    SDCardManager& sdManager;
+    SpillStore& spillStore;
+    SignalStatistics& signalStatistics;
+    PipelineMetrics& pipelineMetrics;
+    SerialStreamer& serialStreamer;
+    TaskHandle_t taskHandle = nullptr;
+    std::atomic<uint8_t> lastResult;
+    std::atomic<bool> statisticsRequested;
+    std::atomic<bool> streamingRequested;
+    bool streaming = false;
+    
+    /**
+     * Task body, never returns
+     */
+    void run();
+    
+    /**
+     * Flush the buffer to the SD card and record the outcome
+     * @param sync Sync the data file, not only whole sectors
+     */
+    void flush(bool sync);
+    
+    /**
+     * Stream the buffer over the serial console
+     * @param sync Also print the periodic report
+     */
+    void stream(bool sync);
+    
+    /**
+     * Queue the metrics records, saved with the next flush
+     */
+    void logMetrics();
+    
+    // FreeRTOS entry point
+    static void taskEntry(void* param);
+    
+    // Watermark handler, runs in the producer context
+    static void IRAM_ATTR onHighWatermark();
+    
+    // Pointer to the current instance (for the watermark handler)
+    static FlushTask* instance;
+};
+
+#endif // FLUSH_TASK_H
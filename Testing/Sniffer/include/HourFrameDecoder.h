@@ -0,0 +1,115 @@
+#ifndef HOUR_FRAME_DECODER_H
+#define HOUR_FRAME_DECODER_H
+
+#include "Config.h"
+#include "EventPipeline.h"
+
+/**
+ * Streaming decoder of the MU/BA hour frames, ported from Analysis.ipynb
+ * (durationsof, findpattern, splitpattern, pulses2bits).
+ *
+ * BA goes high, 4ms later MU pulses the 0b1TTUUUU code, one bit every 8ms
+ * starting with the leading 1, then a final 4ms high pulse; both fall at the
+ * same time, 64ms after BA rose. Like the notebook, the decoder works on the
+ * combined state (0: BA low, 1: BA high and MU low, 2: both high).
+ *
+ * Each frame produces a RECORD_HOUR_FRAME record, with the fields:
+ *   0  valid (1 if the frame decoded to an hour, 0 otherwise)
+ *   1  hour (0-23, -1 if invalid)
+ *   2  code (7 bits as sent, -1 if the frame does not split into 7 bits)
+ *   3  largest timing error of an edge against the 4ms/8ms grid, in us
+ *   4  mean timing error of the edges, in us
+ * The raw events of a valid frame are dropped, unless
+ * DecoderConfig::KEEP_HOUR_FRAME_EVENTS is set. When BA falls first, the
+ * record is resolved on the MU falling edge, up to END_SKEW_MAX later, so
+ * that the edge goes with the frame.
+ */
+class HourFrameDecoder : public EventDecoder {
+public:
+    /**
+     * Constructor
+     * @param eventPipeline Pipeline the decoder is added to, for its records
+     */
+    HourFrameDecoder(EventPipeline& eventPipeline);
+    
+    uint8_t process(const EventEntry& event) override;
+
+private:
+    // Protocol timings, in microseconds
+    static constexpr int64_t START_PULSE_MIN = 3000;
+    static constexpr int64_t START_PULSE_MAX = 5000;
+    static constexpr int64_t START_PULSE = 4000;
+    static constexpr int64_t BIT_DURATION = 8000;
+    static constexpr int64_t END_PULSE = 4000;
+    static constexpr int64_t END_PULSE_MEASURED = 3000; // End pulse is often shortened
+    static constexpr int64_t FRAME_DURATION = 64000;
+    static constexpr int64_t FRAME_END_MIN = 63000;
+    static constexpr int64_t FRAME_TIMEOUT = 100000;
+    static constexpr int64_t END_SKEW_MAX = 1000; // MU and BA fall together, in either order
+    static constexpr size_t NUM_BITS = 7;
+    
+    // At most one pulse per bit, plus the start and end pulses
+    static constexpr size_t MAX_PULSES = NUM_BITS + 2;
+    
+    enum Phase : uint8_t {
+        PHASE_IDLE,  // Waiting for BA high with MU low
+        PHASE_START, // In the 4ms start pulse
+        PHASE_FRAME, // Receiving the bits
+        PHASE_END,   // MU fell at the end of the frame, BA about to
+        PHASE_TRAIL  // BA fell at the end of the frame, MU about to
+    };
+    
+    EventPipeline& pipeline;
+    
+    // Combined state and the event it started with
+    uint8_t baLevel = LOW;
+    uint8_t muLevel = LOW;
+    uint8_t state = 0;
+    EventEntry stateStart = {};
+    
+    // Frame being received
+    Phase phase = PHASE_IDLE;
+    uint8_t owner = EventPipeline::NO_OWNER;
+    EventEntry frameStart = {};
+    int64_t pulseDurations[MAX_PULSES];
+    uint8_t pulseStates[MAX_PULSES];
+    size_t numPulses = 0;
+    int64_t frameDuration = 0;
+    
+    // Frame decoded when BA fell first, waiting for MU to fall
+    EventEntry frameEnd = {};
+    LogRecord frameRecord = {};
+    bool keepFrameEvents = true;
+    
+    /**
+     * Account for a change of the combined state in the frame being received
+     * @param previousState State that just ended
+     * @param duration Duration of the state that just ended, in us
+     */
+    void addPulse(uint8_t previousState, int64_t duration);
+    
+    /**
+     * Decode the complete frame and resolve its record, once MU has fallen
+     */
+    void finishFrame();
+    
+    /**
+     * Resolve the record of the decoded frame
+     */
+    void closeFrame();
+    
+    /**
+     * Give up the frame being received, keeping its events
+     * @param malformed Log a record for a malformed frame, or nothing if the
+     *                  start pulse did not match
+     */
+    void abortFrame(bool malformed);
+    
+    /**
+     * Fill a record for the current frame
+     */
+    void makeRecord(LogRecord& record, bool valid, int32_t hour, int32_t code,
+                    int32_t maxError, int32_t meanError);
+};
+
+#endif // HOUR_FRAME_DECODER_H
@@ -0,0 +1,83 @@
+#ifndef LOG_INDEX_H
+#define LOG_INDEX_H
+
+#include "Config.h"
+#include "LogRecord.h"
+
+/**
+ * Index of a data file, kept in a file next to it
+ * (LogFileConfig::INDEX_EXTENSION).
+ *
+ * The index file is a sequence of fixed-size entries (Entry, little-endian),
+ * each describing a block of the data file: at least
+ * LogFileConfig::INDEX_BLOCK_SIZE bytes, written out by a sync point. A block
+ * starts on a CSV line or a BinaryLog block, so it can be read on its own
+ * after a seek. Entries are in file order. Data no entry covers (the end of
+ * the file, or data written before a restart or a write error) has to be
+ * scanned.
+ *
+ * scripts/query.py reads the index to only read the blocks overlapping a time
+ * range, or holding the signals and records asked for.
+ *
+ * Only used by the task owning the SD card.
+ */
+class LogIndex {
+public:
+    struct __attribute__((packed)) Entry {
+        uint32_t offset;         // Start of the block in the data file
+        uint32_t length;         // Block size in bytes
+        uint32_t firstTimestamp; // millis() value of the first event or record
+        uint32_t lastTimestamp;  // millis() value of the last one, lower across the wrap
+        uint32_t count;          // Events and records in the block
+        uint16_t signals;        // Bit n set if the block holds events of signal n
+        uint16_t records;        // Bit n set if the block holds records of type n
+    };
+    static_assert(sizeof(Entry) == 24, "Entry layout is part of the file format");
+    
+    /**
+     * Continue the block in progress at the end of a data file just opened
+     * Data written before, in this file or another one, is left to the scans
+     * @param offset Size of the data file
+     */
+    void begin(uint32_t offset);
+    
+    /**
+     * Add an event staged for the data file
+     */
+    void add(const EventEntry& event);
+    
+    /**
+     * Add a record staged for the data file
+     */
+    void add(const LogRecord& record);
+    
+    /**
+     * Check if the block in progress holds nothing
+     */
+    bool isEmpty() const;
+    
+    /**
+     * Check if the block in progress is large enough to be indexed
+     * @param end End of the data written so far
+     */
+    bool isComplete(uint32_t end) const;
+    
+    /**
+     * Append the entry of the block in progress to an index file, and start
+     * the next block
+     * @param path Index file
+     * @param end End of the block, all of it written to the card
+     * @return true if the entry was written, the block continues otherwise
+     */
+    bool write(const char* path, uint32_t end);
+
+private:
+    Entry entry = {};
+    
+    /**
+     * Extend the block in progress to an item
+     */
+    void addItem(uint32_t timestamp);
+};
+
+#endif // LOG_INDEX_H
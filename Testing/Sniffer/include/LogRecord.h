@@ -0,0 +1,55 @@
+#ifndef LOG_RECORD_H
+#define LOG_RECORD_H
+
+#include "Config.h"
+
+// Record types, decoded from the raw events (see EventPipeline.h)
+enum RecordType : uint8_t {
+    RECORD_HOUR_FRAME = 0, // MU/BA hour frame (HourFrameDecoder)
+    RECORD_DCF77_MINUTE = 1, // DCF77 telegram on RF (DCF77Decoder)
+    RECORD_SIGNAL_STATS = 2, // Edge and pulse width summary of a signal (SignalStatistics)
+    RECORD_PULSE_HISTOGRAM = 3, // Pulse width histogram bins of a signal (SignalStatistics)
+    RECORD_PIPELINE_METRICS = 4, // Capture pipeline health (PipelineMetrics)
+    RECORD_EDGE_METRICS = 5, // Per-signal event losses (PipelineMetrics)
+    RECORD_TRIGGER = 6, // Trigger of a trigger capture (TriggerCapture)
+    RECORD_SESSION = 7 // Boot session and millis() epoch of the following rows (SessionTracker)
+};
+
+// Most fields a record can carry
+constexpr size_t MAX_RECORD_FIELDS = 13;
+
+/**
+ * Record logged among the raw events, in place of the events it was decoded
+ * from. Its time is the one of the first event it covers, its fields depend on
+ * its type.
+ */
+struct LogRecord {
+    uint8_t type;       // RecordType
+    uint8_t numFields;  // Fields used
+    uint16_t micros;    // Sub-millisecond part of the timestamp (0-999 us)
+    uint32_t timestamp; // millis() value
+    int32_t fields[MAX_RECORD_FIELDS];
+};
+
+// Record name mapping, logged in the Signal column of the CSV file
+inline const char* recordTypeToString(RecordType type) {
+    switch (type) {
+        case RECORD_HOUR_FRAME: return "HF";
+        case RECORD_DCF77_MINUTE: return "DCF";
+        case RECORD_SIGNAL_STATS: return "SS";
+        case RECORD_PULSE_HISTOGRAM: return "PH";
+        case RECORD_PIPELINE_METRICS: return "PM";
+        case RECORD_EDGE_METRICS: return "EM";
+        case RECORD_TRIGGER: return "TR";
+        case RECORD_SESSION: return "SE";
+        default: return "UR"; // Unknown record
+    }
+}
+
+// Time between two events in microseconds, across the millis() wrap
+inline int64_t eventDeltaUs(const EventEntry& from, const EventEntry& to) {
+    int64_t deltaMillis = static_cast<int32_t>(to.timestamp - from.timestamp);
+    return deltaMillis * 1000 + to.micros - from.micros;
+}
+
+#endif // LOG_RECORD_H
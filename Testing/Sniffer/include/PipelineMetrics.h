@@ -0,0 +1,138 @@
+#ifndef PIPELINE_METRICS_H
+#define PIPELINE_METRICS_H
+
+#include "Config.h"
+#include "LogRecord.h"
+#include "RingBuffer.h"
+#include <atomic>
+
+/**
+ * Health counters and gauges of the capture pipeline, from the edge capture
+ * to the SD card.
+ *
+ * The producer side (capture backend) updates them from the interrupt or the
+ * capture task, with atomic operations. The SD card side is only used by the
+ * flush task, which also reads them all. Counters run from boot,
+ * gauges (longest and mean capture latency and flush time) cover the time
+ * since the last call to getRecords().
+ *
+ * getRecords() fills the records logged every MetricsConfig::RECORD_INTERVAL:
+ *   RECORD_PIPELINE_METRICS, fields:
+ *     0  ring buffer high watermark, in slots (one per event, two for an
+ *        event with a sync entry, see RingBuffer.h)
+ *     1  events dropped because the ring buffer was full
+ *     2  edges rejected by the glitch filter
+ *     3  longest capture latency, in CPU cycles (GPIO interrupt backend:
+ *        from the start of the edge processing to the event in the ring
+ *        buffer, 0 with the RMT backend)
+ *     4  mean capture latency, in CPU cycles
+ *     5  flushes to the SD card
+ *     6  data written to the SD card, in KB
+ *     7  longest flush, in us
+ *     8  mean flush, in us
+ *     9  SD card mount attempts (only for a card found present)
+ *    10  triggers (trigger capture, see TriggerCapture.h)
+ *    11  events left out of the trigger captures
+ *    12  flush task stack never used since boot, in bytes (high watermark)
+ *   RECORD_EDGE_METRICS, one per enabled signal, fields:
+ *     0  signal
+ *     1  events dropped
+ *     2  edges rejected by the glitch filter
+ */
+class PipelineMetrics {
+public:
+    static constexpr size_t MAX_RECORDS = 1 + Signals::ENABLED_COUNT;
+    
+    /**
+     * Constructor
+     * @param buffer Ring buffer the backend captures into
+     */
+    PipelineMetrics(RingBuffer& buffer);
+    
+    /**
+     * Count an event the ring buffer had no room for (producer side, ISR safe)
+     */
+    void countDropped(SignalType signal);
+    
+    /**
+     * Count an edge rejected by the glitch filter (producer side, ISR safe)
+     */
+    void countRejected(SignalType signal);
+    
+    /**
+     * Count a trigger of the trigger capture (producer side, ISR safe)
+     */
+    void countTrigger();
+    
+    /**
+     * Count events left out of the trigger captures (producer side, ISR safe)
+     * @param numEvents Number of events
+     */
+    void countDiscarded(size_t numEvents);
+    
+    /**
+     * Add the capture latency of an event (producer side, ISR safe)
+     * @param cycles CPU cycles from the capture to the ring buffer
+     */
+    void addCaptureLatency(uint32_t cycles);
+    
+    /**
+     * Add a flush to the SD card (flush task)
+     * @param bytes Bytes written to the card
+     * @param durationUs Time spent in the flush
+     */
+    void addFlush(uint32_t bytes, uint32_t durationUs);
+    
+    /**
+     * Count an SD card initialization attempt (flush task)
+     */
+    void countCardInit();
+    
+    /**
+     * Fill the metrics records and start new gauge periods (flush task)
+     * Timestamps are left to the caller
+     * @param records Records to fill, room for MAX_RECORDS
+     * @return Number of records filled
+     */
+    size_t getRecords(LogRecord* records);
+    
+    /**
+     * Print the counters and the gauges since the last records (flush task)
+     */
+    void printReport() const;
+    
+    /**
+     * Get the stack of the calling task never used since boot
+     * @return Bytes (the ESP-IDF FreeRTOS counts the stack in bytes)
+     */
+    static uint32_t getStackMargin();
+
+private:
+    static constexpr size_t NUM_SIGNALS = Signals::COUNT;
+    
+    RingBuffer& eventBuffer;
+    
+    // Producer side: counters from boot, then latency gauges
+    std::atomic<uint32_t> dropped[NUM_SIGNALS];
+    std::atomic<uint32_t> rejected[NUM_SIGNALS];
+    std::atomic<uint32_t> triggers;
+    std::atomic<uint32_t> discarded;
+    std::atomic<uint32_t> maxLatency;
+    std::atomic<uint32_t> totalLatency;
+    std::atomic<uint32_t> latencyCount;
+    
+    // SD card side: counters from boot, then flush gauges
+    uint32_t flushes = 0;
+    uint64_t bytesWritten = 0;
+    uint32_t cardInits = 0;
+    uint32_t maxFlushUs = 0;
+    uint64_t totalFlushUs = 0;
+    uint32_t flushCount = 0;
+    
+    /**
+     * Sum of a per-signal counter
+     */
+    static uint32_t total(const std::atomic<uint32_t>* counters);
+};
+
+#endif // PIPELINE_METRICS_H
@@ -0,0 +1,101 @@
+#ifndef REPLAY_ENGINE_H
+#define REPLAY_ENGINE_H
+
+#include "Config.h"
+#include "RingBuffer.h"
+#include <atomic>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Entry point of the native build, replaying recorded edges into the firmware.
+ *
+ * Edges are read from CSV data files (Signal,Edge,Timestamp[,Micros]) and
+ * injected on the signal pins from a thread standing for the GPIO interrupt,
+ * at a multiple of real time. setup() and loop() run as on the device, the
+ * flush task writes to a host directory standing for the SD card (see
+ * lib/NativeHal). Timestamp resets between files or within a file (reboots)
+ * are stitched into one timeline.
+ *
+ * Once the edges are replayed and the last timed flush is done, the engine
+ * reports the throughput, the ring buffer peak and dropped events, the SD
+ * card activity and the time each task spent per wake-up (flush latency).
+ * Native build only.
+ */
+class ReplayEngine {
+public:
+    /**
+     * Constructor
+     * @param buffer Ring buffer the firmware captures into, for the report
+     */
+    ReplayEngine(RingBuffer& buffer);
+    
+    /**
+     * Run the firmware on the recorded edges
+     * @param argc Number of command line arguments
+     * @param argv Command line arguments (see printUsage())
+     * @return Exit status
+     */
+    int run(int argc, char** argv);
+
+private:
+    // Time the firmware gets to start before the first edge, at least one
+    // second of device time and 20ms of host time (both in microseconds)
+    static constexpr int64_t LEAD_IN_US = 1000000;
+    static constexpr int64_t LEAD_IN_HOST_US = 20000;
+    
+    // Edges scanned for the initial pin levels
+    static constexpr size_t PRESCAN_EDGES = 100000;
+    
+    RingBuffer& eventBuffer;
+    
+    // Options
+    double speed = 1000.0;
+    std::string cardDirectory = "_native/sd";
+    std::string flashDirectory = "_native/flash";
+    std::string nvsDirectory = "_native/nvs";
+    int64_t cardWriteLatencyUs = 0;
+    std::vector<std::pair<int64_t, int64_t>> cardMissing; // From the first edge, in microseconds
+    bool quiet = false;
+    std::string serialDevice;
+    std::vector<std::string> files;
+    
+    // Replay progress, written by the replay thread
+    std::atomic<bool> done;
+    uint64_t edgesReplayed = 0;
+    int64_t maxLagUs = 0;
+    size_t peakCount = 0;
+    int64_t firstTime = 0;
+    int64_t lastTime = 0;
+    
+    /**
+     * Parse the command line
+     * @return true if valid
+     */
+    bool parseArguments(int argc, char** argv);
+    
+    /**
+     * Print the command line help
+     */
+    void printUsage(const char* program) const;
+    
+    /**
+     * Set the pins to the level preceding their first recorded edge
+     * @return true if the files hold edges
+     */
+    bool setInitialLevels();
+    
+    /**
+     * Replay the edges, body of the replay thread
+     */
+    void replay();
+    
+    /**
+     * Print the measurements
+     * @param hostSeconds Host time the replay took
+     */
+    void printReport(double hostSeconds) const;
+};
+
+#endif // REPLAY_ENGINE_H
@@ -2,55 +2,168 @@
 #define RINGBUFFER_H
 
 #include "Config.h"
-#include <mutex>
+#include <atomic>
 
+/**
+ * Lock-free single-producer/single-consumer ring buffer.
+ *
+ * The producer is the GPIO interrupt path (all GPIO ISRs are dispatched on the
+ * same core, so they never preempt each other) or the RMT capture task,
+ * depending on CaptureConfig::BACKEND. The consumer is the code
+ * flushing events to the SD card. Head and tail are free-running indices:
+ * only the producer moves the head, only the consumer moves the tail, and the
+ * slot index is obtained by masking, which requires a power-of-two size.
+ *
+ * Events are stored packed in 4-byte slots, half the size of an EventEntry:
+ * signal (4 bits), edge (1 bit) and the time since the previous event (27 bits,
+ * in microseconds, up to 134s). An event coming later than that, or earlier
+ * than the previous one, takes a second slot holding its full timestamp (sync
+ * entry), which anchors the following deltas. The producer encodes in constant
+ * time, the consumer expands the slots back to EventEntry. Counts and
+ * watermarks are in slots: a sync entry counts twice.
+ */
 class RingBuffer {
 public:
+    static_assert((BufferConfig::BUFFER_SIZE & (BufferConfig::BUFFER_SIZE - 1)) == 0,
+                  "BUFFER_SIZE must be a power of two");
+    
     /**
      * Default constructor initializes an empty buffer
      */
     RingBuffer();
-
+    
     /**
-     * Try to write an event to the buffer
+     * Try to write an event to the buffer (producer side, ISR safe)
      * @param signal The signal type that triggered the event
      * @param edge The edge type (rising or falling)
-     * @param timestamp The timestamp when the event occurred
+     * @param timestamp The timestamp when the event occurred (milliseconds)
+     * @param subMillis Sub-millisecond part of the timestamp (0-999)
      * @return true if write was successful, false if buffer was full
      */
-    bool write(SignalType signal, EdgeType edge, uint32_t timestamp);
-
+    bool write(SignalType signal, EdgeType edge, uint32_t timestamp, uint16_t subMillis = 0);
+    
+    /**
+     * Try to write several events at once, published together (producer
+     * side, ISR safe)
+     * @param events Events to write, oldest first
+     * @param numEvents Number of events
+     * @return Number of events written, the first ones, fewer than numEvents
+     *         if the buffer was full
+     */
+    size_t write(const EventEntry* events, size_t numEvents);
+    
     /**
      * Read events from the buffer and transfer them to a destination array
+     * (consumer side)
      * @param dest Destination array where to copy events
      * @param maxEvents Maximum number of events to read
      * @return Number of events actually read
      */
     size_t read(EventEntry* dest, size_t maxEvents);
-
+    
+    /**
+     * Get the next unread events, expanded into a window owned by the consumer
+     * (consumer side). The events stay in the buffer until commit() is called,
+     * the window is valid until the next call to readSpan() or read().
+     * @param events Set to the first unread event
+     * @return Number of events available at events, at most
+     *         BufferConfig::READ_WINDOW_SIZE (0 if empty)
+     */
+    size_t readSpan(const EventEntry*& events);
+    
+    /**
+     * Release events previously obtained with readSpan() (consumer side)
+     * @param numEvents Number of events consumed, at most what readSpan returned
+     */
+    void commit(size_t numEvents);
+    
     /**
      * Check if the buffer is empty
      * @return true if the buffer is empty, false otherwise
      */
     bool isEmpty() const;
-
+    
     /**
-     * Get the number of events currently in the buffer
-     * @return Number of events in buffer
+     * Get the number of slots currently used in the buffer
+     * @return Number of slots in use, one per event plus one per sync entry
      */
     size_t getCount() const;
-
+    
+    /**
+     * Get the number of events rejected because the buffer was full
+     * @return Number of events dropped since startup
+     */
+    uint32_t getDroppedCount() const;
+    
+    /**
+     * Get the highest slot count reached
+     * @return High watermark since startup
+     */
+    size_t getPeakCount() const;
+    
+    /**
+     * Register a function called by write() when the slot count reaches a
+     * level from below. It runs in the producer context and must be ISR safe.
+     * @param level Slot count triggering the call
+     * @param handler Function to call, nullptr to disable
+     */
+    void setWatermarkHandler(size_t level, void (*handler)());
+    
     /**
      * Reset the buffer to empty state
+     * Only call when neither producer nor consumer is active
      */
     void reset();
 
 private:
-    EventEntry buffer[BufferConfig::BUFFER_SIZE];
-    size_t writeIndex;  // Where to write next
-    size_t readIndex;   // Where to read next
-    size_t count;       // Number of items in buffer
-    mutable std::mutex mutex; // Mutex for thread safety
+    static constexpr size_t INDEX_MASK = BufferConfig::BUFFER_SIZE - 1;
+    
+    // Slot layout
+    static constexpr uint32_t DELTA_BITS = 27;
+    static constexpr uint32_t MAX_DELTA = (1UL << DELTA_BITS) - 1;
+    static constexpr uint32_t EDGE_SHIFT = DELTA_BITS;
+    static constexpr uint32_t SIGNAL_SHIFT = DELTA_BITS + 1;
+    
+    // Signal value of a sync entry: the delta bits hold the signal and the
+    // upper bits of the timestamp, the next slot its lower 32 bits
+    static constexpr uint32_t SYNC_SIGNAL = 0xF;
+    static constexpr uint32_t SYNC_SIGNAL_SHIFT = DELTA_BITS - 4;
+    static constexpr size_t SYNC_SLOTS = 2;
+    static_assert(Signals::COUNT <= SYNC_SIGNAL, "Signals must fit in the slots, the last value marks sync entries");
+    
+    uint32_t buffer[BufferConfig::BUFFER_SIZE];
+    std::atomic<size_t> head; // Next slot to write, owned by the producer
+    std::atomic<size_t> tail; // Next slot to read, owned by the consumer
+    std::atomic<uint32_t> dropped; // Rejected writes, owned by the producer
+    std::atomic<size_t> peak; // Highest count, owned by the producer
+    
+    // Timestamps (us) of the last event written and of the last one
+    // committed, the deltas are relative to them
+    uint64_t writeTime = 0; // Owned by the producer
+    uint64_t readTime = 0;  // Owned by the consumer
+    
+    // Events expanded by readSpan(), owned by the consumer
+    EventEntry window[BufferConfig::READ_WINDOW_SIZE];
+    
+    size_t watermarkLevel = 0;
+    void (*watermarkHandler)() = nullptr;
+    
+    /**
+     * Expand events from the buffer (consumer side)
+     * @param dest Destination array
+     * @param maxEvents Maximum number of events to expand
+     * @param slots Set to the number of slots the events take
+     * @param time Timestamp of the event before the first one, set to the
+     *             timestamp of the last one
+     * @return Number of events expanded
+     */
+    size_t decode(EventEntry* dest, size_t maxEvents, size_t& slots, uint64_t& time) const;
+    
+    /**
+     * Release slots to the producer (consumer side)
+     * @param slots Number of slots read
+     */
+    void commitSlots(size_t slots);
 };
 
-#endif // RINGBUFFER_H
\ No newline at end of file
+#endif // RINGBUFFER_H
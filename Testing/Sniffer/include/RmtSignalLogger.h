@@ -0,0 +1,120 @@
+#ifndef RMT_SIGNAL_LOGGER_H
+#define RMT_SIGNAL_LOGGER_H
+
+#include "Config.h"
+#include "RingBuffer.h"
+#include "PipelineMetrics.h"
+#include <driver/rmt_rx.h>
+
+/**
+ * Signal logger recording the edges with the RMT receiver.
+ *
+ * Same interface as SignalLogger, selected with CaptureConfig::BACKEND.
+ * Each signal has its own RMT receive channel, recording pulse trains (level
+ * and duration of each pulse) in hardware until the signal stays idle for
+ * CaptureConfig::RMT_IDLE_THRESHOLD_US. A capture task then turns the pulse
+ * trains into events, in batches, instead of one interrupt per edge.
+ *
+ * Edge types come from the recorded levels, so close edges cannot be
+ * mislabelled. Edges are lost while a channel is re-armed after a pulse
+ * train, and a train longer than CaptureConfig::RMT_SYMBOLS pulses is cut.
+ */
+class RmtSignalLogger {
+public:
+    /**
+     * Constructor
+     * @param buffer Reference to the ring buffer
+     * @param metrics Reference to the pipeline metrics, for the losses
+     */
+    RmtSignalLogger(RingBuffer& buffer, PipelineMetrics& metrics);
+    
+    /**
+     * Initialize the signal logger
+     * Sets up the receive channels and starts the capture task
+     */
+    void begin();
+
+private:
+    static const uint8_t NUM_SIGNALS = Signals::COUNT;
+    
+    // Receive channel of a signal, with two buffers: one receiving while the
+    // other is decoded
+    struct Channel {
+        RmtSignalLogger* owner;
+        SignalType signal;
+        rmt_channel_handle_t handle;
+        uint8_t activeBuffer;
+        rmt_symbol_word_t symbols[2][CaptureConfig::RMT_SYMBOLS];
+    };
+    
+    // Pulse train received, sent from the RMT interrupt to the capture task
+    struct Reception {
+        Channel* channel;
+        uint8_t buffer;
+        uint16_t numSymbols;
+        int64_t doneTime; // esp_timer microseconds
+    };
+    
+    // Decoded edge waiting to be written in time order
+    struct PendingEdge {
+        int64_t time; // esp_timer microseconds
+        SignalType signal;
+        EdgeType edge;
+    };
+    
+    static const size_t MAX_PENDING_EDGES = Signals::ENABLED_COUNT * CaptureConfig::RMT_SYMBOLS;
+    
+    RingBuffer& eventBuffer;
+    PipelineMetrics& pipelineMetrics;
+    Channel channels[NUM_SIGNALS] = {};
+    QueueHandle_t receptions = nullptr;
+    rmt_receive_config_t receiveConfig;
+    
+    // Edges sorted by time, from pendingStart to pendingEnd
+    PendingEdge pending[MAX_PENDING_EDGES];
+    size_t pendingStart = 0;
+    size_t pendingEnd = 0;
+    
+    // Signal validation variables, as in SignalLogger
+    int64_t lastEdgeTime[NUM_SIGNALS] = {}; // esp_timer microseconds
+    uint8_t lastPinState[NUM_SIGNALS] = {};
+    
+    /**
+     * Create, enable and arm the receive channel of a signal
+     * @return true if the channel is receiving
+     */
+    bool setupChannel(SignalType signal, uint8_t pin);
+    
+    /**
+     * Task body, never returns
+     */
+    void run();
+    
+    /**
+     * Turn a received pulse train into pending edges
+     */
+    void decode(const Reception& reception);
+    
+    /**
+     * Insert an edge into the pending edges, keeping them sorted
+     */
+    void addPendingEdge(int64_t time, SignalType signal, EdgeType edge);
+    
+    /**
+     * Write the pending edges older than the given time to the ring buffer
+     */
+    void writePendingEdges(int64_t before);
+    
+    /**
+     * Filter an edge and write it to the ring buffer
+     */
+    void recordEdge(SignalType signal, EdgeType edge, int64_t time);
+    
+    // FreeRTOS entry point
+    static void taskEntry(void* param);
+    
+    // RMT receive done callback, runs in the RMT interrupt
+    static bool IRAM_ATTR onReceiveDone(rmt_channel_handle_t handle, const rmt_rx_done_event_data_t* data, void* context);
+};
+
+#endif // RMT_SIGNAL_LOGGER_H
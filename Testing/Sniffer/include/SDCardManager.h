@@ -3,51 +3,251 @@
 
 #include "Config.h"
 #include "RingBuffer.h"
+#include "BinaryLog.h"
+#include "CardPresence.h"
+#include "EventPipeline.h"
+#include "LogIndex.h"
+#include "SessionTracker.h"
+#include "PipelineMetrics.h"
 #include <SD.h>
 
+// Measurements of the last call to SDCardManager::saveEvents()
+struct FlushStats {
+    uint32_t bytesWritten;   // Bytes written to the card
+    uint32_t durationUs;     // Time spent in the flush
+    uint32_t bytesPerSecond; // Write throughput of the flush
+};
+
 class SDCardManager {
 public:
     /**
      * Constructor
      * @param buffer Reference to the ring buffer to read from
+     * @param pipeline Reference to the decoding pipeline events go through
+     * @param metrics Reference to the pipeline metrics, for the flushes
      */
-    SDCardManager(RingBuffer& buffer);
+    SDCardManager(RingBuffer& buffer, EventPipeline& pipeline, PipelineMetrics& metrics);
     
     /**
-     * Initialize the SD card
+     * Initialize the SD card, and count the boot for the session records
      * @return true if initialization was successful
      */
     bool begin();
     
     /**
-     * Check if SD card is present and accessible
+     * Check if the SD card was ready at the last save, without probing it
      * @return true if SD card is ready
      */
-    bool isCardPresent();
+    bool isCardPresent() const;
+    
+    /**
+     * Get the state of the SD card at the last save
+     */
+    CardState getCardState() const;
     
     /**
      * Save buffered events to the SD card
+     * Events are formatted into a staging buffer which is written to the card
+     * in whole sectors. Bytes past the last sector boundary stay staged until
+     * the next flush, unless sync is requested.
+     * @param sync Also write the staged tail and flush the file to the card
      * @return true if operation was successful, false if card not ready or error occurred
      */
-    bool saveEvents();
+    bool saveEvents(bool sync = true);
+    
+    /**
+     * Save events held outside the ring buffer, such as a spill tier
+     * They are staged like buffered events, call saveEvents() afterwards to
+     * write the ring buffer behind them and sync.
+     * @param events Events to save, oldest first
+     * @param numEvents Number of events
+     * @param resumed The events were captured by the previous boot, they are
+     *   placed on its timeline (SessionTracker)
+     * @return Number of events accepted, the others must be saved again later
+     */
+    size_t saveEvents(const EventEntry* events, size_t numEvents, bool resumed = false);
+    
+    /**
+     * Queue a record for the next saveEvents() call, it is stamped and placed
+     * right after the events drained from the ring buffer
+     * @param record Record to save, its timestamp is ignored
+     * @return true if queued, false if the queue is full
+     */
+    bool queueRecord(const LogRecord& record);
+    
+    /**
+     * Check if formatted data is still waiting to be written to the card
+     * @return true if the record queue, the pipeline, the staging buffer or
+     *         the current binary block is not empty
+     */
+    bool hasStagedData() const;
     
+    /**
+     * Get the measurements of the last flush
+     * @return Statistics of the last call to saveEvents()
+     */
+    const FlushStats& getLastFlushStats() const;
+
 private:
+    static constexpr size_t MAX_QUEUED_RECORDS = 2 * PipelineMetrics::MAX_RECORDS;
+    
+    // "/log/00001.csv"
+    static constexpr size_t MAX_PATH_LENGTH = 32;
+    
     RingBuffer& eventBuffer;
-    bool cardInitialized = false;
+    EventPipeline& eventPipeline;
+    PipelineMetrics& pipelineMetrics;
+    CardPresence cardPresence;
+    
+    // Records waiting for the next flush
+    LogRecord queuedRecords[MAX_QUEUED_RECORDS];
+    size_t numQueuedRecords = 0;
+    
+    // Data file, kept open across flushes, and its index
+    File dataFile;
+    uint32_t fileSize = 0;
+    uint32_t fileNumber = 0; // 0 until chosen on the mounted card
+    char dataPath[MAX_PATH_LENGTH];
+    char indexPath[MAX_PATH_LENGTH];
+    LogIndex logIndex;
+    
+    // Session records among the rows
+    SessionTracker sessionTracker;
+    bool resumedEvents = false; // Events of the previous boot entering the pipeline
+    EventEntry lastEvent = {};  // Latest event of this boot in the pipeline, for the record stamps
+    bool hasLastEvent = false;
+    
+    // Formatted data waiting to be written, kept across flushes on write error
+    uint8_t staging[BufferConfig::STAGING_BUFFER_SIZE];
+    size_t stagedBytes = 0;
+    
+    // Block being filled in binary format
+    BinaryLogEncoder blockEncoder;
+    
+    FlushStats lastFlushStats = {0, 0, 0};
+    
+    /**
+     * Check the card before a save, mounting it if it has appeared
+     * @return true if the card is ready, the data file is closed otherwise
+     */
+    bool checkCard();
     
     /**
-     * Check if the data file exists and create it with header if needed
+     * Open the data file for appending, writing the header if it is new
      * @return true if file is ready for writing
      */
-    bool prepareDataFile();
+    bool openDataFile();
     
     /**
-     * Convert an event entry to a CSV line
+     * Choose the data file on a card just mounted: the one after the last
+     * data file found, or the last one (LogFileConfig::NEW_FILE_PER_SESSION)
+     * @return true if the log directory is there
+     */
+    bool selectDataFile();
+    
+    /**
+     * Set the number of the data file and the paths of the file and its index
+     */
+    void setFileNumber(uint32_t number);
+    
+    /**
+     * At a sync point, index the block written since the last entry if large
+     * enough, and start the next data file once this one is full
+     * @return true if the index is up to date
+     */
+    bool updateIndex();
+    
+    /**
+     * Close the data file and unmount the card after a write error
+     */
+    void handleWriteError();
+    
+    /**
+     * Mark the boundary between events of the previous boot and of this one
+     * in the pipeline, in order with the events around it
+     * @param resumed true if the next events are from the previous boot
+     * @return true if the boundary is in the pipeline
+     */
+    bool setResumedEvents(bool resumed);
+    
+    /**
+     * Drain the ring buffer into the staging buffer
+     * @return true if the buffer was drained
+     */
+    bool stageBufferedEvents();
+    
+    /**
+     * Stamp the queued records and feed them through the pipeline
+     * Records the pipeline has no room for stay queued
+     * @param now Time the ring buffer started to be drained, in microseconds
+     *   (esp_timer_get_time()), the records are stamped no earlier than the
+     *   events before them
+     * @return true if the pipeline was staged
+     */
+    bool stageQueuedRecords(int64_t now);
+    
+    /**
+     * Feed events through the pipeline, staging what comes out of it
+     * @param events Events to stage
+     * @param numEvents Number of events
+     * @return Number of events taken by the pipeline, less than numEvents on
+     *         write error
+     */
+    size_t stageEvents(const EventEntry* events, size_t numEvents);
+    
+    /**
+     * Format the items ready in the pipeline into the staging buffer, writing
+     * whole sectors as it fills up
+     * @return true if all ready items were staged
+     */
+    bool stagePipeline();
+    
+    /**
+     * Stage an item, after its session record if one is due
+     * @param item Item to stage
+     * @return true if the item was staged
+     */
+    bool stageItem(const LogItem& item);
+    
+    /**
+     * Format an event or a record into the staging buffer or the binary block
+     * @param item Item to format
+     * @return true if the item was staged
+     */
+    bool formatItem(const LogItem& item);
+    
+    /**
+     * Seal the current binary block and move it to the staging buffer
+     * @return true if the block was staged, it is kept for a retry otherwise
+     */
+    bool stageBlock();
+    
+    /**
+     * Write the staging buffer to the data file
+     * @param all Write everything, otherwise stop at the last sector boundary
+     * @return true if the write succeeded
+     */
+    bool writeStaged(bool all);
+    
+    /**
+     * Convert an event entry to a CSV line, line ending included
      * @param entry Event entry to convert
-     * @param buffer Output buffer
-     * @param bufferSize Size of output buffer
+     * @param buffer Output buffer, at least MAX_CSV_LINE bytes
+     * @return Length of the line
      */
-    void eventToCSV(const EventEntry& entry, char* buffer, size_t bufferSize);
+    size_t eventToCSV(const EventEntry& entry, char* buffer);
+    
+    /**
+     * Convert a record to a CSV line, line ending included
+     * @param record Record to convert
+     * @param buffer Output buffer, at least MAX_CSV_LINE bytes
+     * @return Length of the line
+     */
+    size_t recordToCSV(const LogRecord& record, char* buffer);
+    
+    // Longest CSV line: a record with all its fields negative,
+    // "DCF,,4294967295,999,-2147483648,...\r\n"
+    static constexpr size_t MAX_CSV_LINE = 24 + MAX_RECORD_FIELDS * 12;
 };
 
-#endif // SDCARD_MANAGER_H
\ No newline at end of file
+#endif // SDCARD_MANAGER_H
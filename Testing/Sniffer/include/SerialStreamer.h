@@ -0,0 +1,92 @@
+#ifndef SERIAL_STREAMER_H
+#define SERIAL_STREAMER_H
+
+#include "Config.h"
+#include "RingBuffer.h"
+#include "BinaryLog.h"
+
+/**
+ * Live streaming of the events over the serial console, in place of the SD
+ * card.
+ *
+ * While streaming (see StreamConfig), the flush task drains the ring buffer
+ * into binary log blocks (see BinaryLog.h), each sent as a frame. Frames are
+ * COBS-encoded, so they hold no zero byte, and delimited by a zero byte on
+ * both sides: console text printed between two frames is never taken for a
+ * frame. Each frame goes out in a single write, which the serial driver does
+ * not interleave with other writes. Decoded, a frame holds:
+ *   0  frame type (FRAME_EVENTS)
+ *   1  sequence number, incremented per frame (uint16)
+ *   3  events dropped by the ring buffer since boot (uint32)
+ *   7  binary log block, header and payload
+ *   .. CRC-32 of all the bytes before, as BinaryLog::crc32 (uint32)
+ * Integers are little-endian. Only raw events are streamed, the decoders and
+ * the statistics are not fed meanwhile. scripts/streamrecv.cpp is the host
+ * side.
+ */
+class SerialStreamer {
+public:
+    static constexpr uint8_t FRAME_EVENTS = 1;
+    
+    /**
+     * Constructor
+     * @param buffer Reference to the ring buffer to drain
+     * @param output Serial port the frames are written to
+     */
+    SerialStreamer(RingBuffer& buffer, Print& output);
+    
+    /**
+     * Send the buffered events, the last frame possibly not full
+     * @return Number of events sent
+     */
+    size_t streamEvents();
+    
+    /**
+     * Print the frames and bytes sent since boot
+     */
+    void printReport() const;
+
+private:
+    struct __attribute__((packed)) FrameHeader {
+        uint8_t type;          // FRAME_EVENTS
+        uint16_t sequence;     // Incremented per frame
+        uint32_t droppedCount; // Events dropped by the ring buffer since boot
+    };
+    static_assert(sizeof(FrameHeader) == 7, "FrameHeader layout is part of the stream format");
+    
+    // Header, block, then the CRC
+    static constexpr size_t MAX_FRAME_SIZE = sizeof(FrameHeader) + BinaryLog::MAX_BLOCK_SIZE + 4;
+    
+    // COBS adds a byte per 254 bytes, and one, then the two delimiters
+    static constexpr size_t MAX_ENCODED_SIZE = MAX_FRAME_SIZE + MAX_FRAME_SIZE / 254 + 1 + 2;
+    
+    RingBuffer& eventBuffer;
+    Print& out;
+    BinaryLogEncoder blockEncoder;
+    uint16_t sequence = 0;
+    
+    uint8_t frame[MAX_FRAME_SIZE];
+    uint8_t encoded[MAX_ENCODED_SIZE];
+    
+    // Counters from boot
+    uint32_t framesSent = 0;
+    uint32_t eventsSent = 0;
+    uint64_t bytesSent = 0;
+    
+    /**
+     * Seal the current block and send it as a frame
+     */
+    void sendBlock();
+    
+    /**
+     * COBS-encode a frame (Consistent Overhead Byte Stuffing)
+     * @param data Bytes to encode
+     * @param length Number of bytes
+     * @param output Encoded bytes, no zero among them, at most
+     *               length + length / 254 + 1
+     * @return Number of encoded bytes
+     */
+    static size_t encodeCobs(const uint8_t* data, size_t length, uint8_t* output);
+};
+
+#endif // SERIAL_STREAMER_H
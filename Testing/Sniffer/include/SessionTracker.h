@@ -0,0 +1,130 @@
+#ifndef SESSION_TRACKER_H
+#define SESSION_TRACKER_H
+
+#include "Config.h"
+#include "EventPipeline.h"
+#include "LogRecord.h"
+
+// Reasons for a session record
+enum SessionReason : uint8_t {
+    SESSION_BOOT = 0,   // First row of the boot
+    SESSION_FILE = 1,   // First row of a data file opened after the boot
+    SESSION_WRAP = 2,   // First row after a millis() wrap
+    SESSION_ANCHOR = 3, // First valid DCF77 minute of the boot, the Unix time is known from here
+    SESSION_RESUME = 4  // First row of events of the previous boot, left in the flash spill tier
+};
+
+/**
+ * Session records, placing the rows of the data files on a single timeline.
+ *
+ * Timestamps are 32-bit millis() values, restarting at each boot and wrapping
+ * every 49.7 days. A RECORD_SESSION record is written right before the first
+ * row of each boot, of each data file, after each wrap, and before the first
+ * valid DCF77 minute, with the fields:
+ *   0  boot counter, kept in NVS
+ *   1  epoch: millis() wraps since the boot
+ *   2  reason (SessionReason)
+ *   3  Unix time (UTC) of the record in seconds, from the last valid DCF77
+ *      minute, 0 if none was decoded since the boot
+ * The time of a row since the boot is then epoch * 2^32 + timestamp, in
+ * milliseconds, in a single pass over the file: no wrap or reboot has to be
+ * guessed from the timestamps going backwards.
+ *
+ * Events of the previous boot left in the flash spill tier are saved before
+ * the ones of this boot. They get a session record of the previous boot
+ * (SESSION_RESUME), starting from the epoch it had reached, and follow their
+ * own timeline; a wrap between the last row the previous boot wrote and its
+ * spilled events is not seen. The rows of this boot get a SESSION_BOOT record
+ * again once they start.
+ *
+ * Wraps are detected on the rows as they are written, which are in time order
+ * (records stamped when queued may be a few microseconds late).
+ *
+ * Only used by the task owning the SD card.
+ */
+class SessionTracker {
+public:
+    /**
+     * Count the boot in NVS, and get the epoch the previous boot reached
+     */
+    void begin();
+    
+    /**
+     * Have a session record written before the next row, a data file was
+     * opened
+     */
+    void startFile();
+    
+    /**
+     * Switch between the timeline of the previous boot and the one of this
+     * boot, for the rows that follow
+     * @param resume true for events of the previous boot
+     */
+    void setResuming(bool resume);
+    
+    /**
+     * Get the session record to write before an item, if any
+     * Until update() is called, the same record is returned for the item.
+     * @param item Item about to be written
+     * @param record Set to the session record
+     * @return true if a session record goes before the item
+     */
+    bool check(const LogItem& item, LogRecord& record) const;
+    
+    /**
+     * Follow the timeline up to an item, once its session record or the item
+     * itself is written (calling it again for the item changes nothing)
+     * @param item Item written
+     */
+    void update(const LogItem& item);
+
+private:
+    // NVS namespace and keys of the boot counter and of the epoch reached
+    static constexpr const char* NVS_NAMESPACE = "sniffer";
+    static constexpr const char* NVS_BOOT_COUNT = "boots";
+    static constexpr const char* NVS_EPOCH = "epoch";
+    
+    // Rows written on the timeline of a boot
+    struct Timeline {
+        uint32_t bootCount = 0; // 0 if NVS is not available
+        uint32_t epoch = 0;
+        uint32_t lastTimestamp = 0;
+        bool hasTime = false;
+    };
+    
+    Timeline current;  // This boot
+    Timeline previous; // Previous boot, for its spilled events
+    bool resuming = false;
+    
+    // Session record due before the next row
+    bool pending = true;
+    bool booted = false; // First session record of this boot written
+    
+    // Unix time of a point of this boot's timeline, from a valid DCF77 minute
+    bool hasAnchor = false;
+    int64_t anchorUnix = 0; // Seconds
+    uint64_t anchorTime = 0; // Milliseconds since the boot
+    
+    /**
+     * Get the timeline of the rows being written
+     */
+    const Timeline& active() const { return resuming ? previous : current; }
+    
+    /**
+     * Check if a timestamp is past a millis() wrap
+     */
+    static bool isWrapped(const Timeline& timeline, uint32_t timestamp);
+    
+    /**
+     * Save the epoch of this boot, for its spilled events after a reboot
+     */
+    void saveEpoch() const;
+    
+    /**
+     * Get the Unix time of the first second of a valid DCF77 minute record
+     * @return Seconds, or -1 if the record is not a valid minute
+     */
+    static int64_t minuteToUnix(const LogRecord& record);
+};
+
+#endif // SESSION_TRACKER_H
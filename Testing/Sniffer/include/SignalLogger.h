@@ -3,14 +3,33 @@
 
 #include "Config.h"
 #include "RingBuffer.h"
+#include "PipelineMetrics.h"
+#include "TriggerCapture.h"
 
+/**
+ * Signal logger taking one GPIO interrupt per edge.
+ *
+ * All the enabled signals of Signals::TABLE share the same handler, which
+ * reads the levels of all the signal pins at once from the GPIO input
+ * registers (GPIO_IN1 for GPIO 32-39, GPIO_IN too if a signal is on GPIO
+ * 0-31) and compares them to the previous snapshot. Every signal that changed
+ * is logged, with the same timestamp, in a single ring buffer write. The
+ * register masks and the loop over the signals are resolved at compile time.
+ * Edges occurring together
+ * (MU and BA falling at the end of an hour frame) are therefore all caught by
+ * the first interrupt, the following ones find nothing new.
+ *
+ * With TriggerConfig::ENABLE, the edges go through a TriggerCapture instead,
+ * and only the captures reach the ring buffer.
+ */
 class SignalLogger {
 public:
     /**
      * Constructor
      * @param buffer Reference to the ring buffer
+     * @param metrics Reference to the pipeline metrics, for the losses and latencies
      */
-    SignalLogger(RingBuffer& buffer);
+    SignalLogger(RingBuffer& buffer, PipelineMetrics& metrics);
     
     /**
      * Initialize the signal logger
@@ -24,28 +43,25 @@ public:
 
 private:
     RingBuffer& eventBuffer;
+    PipelineMetrics& pipelineMetrics;
+    TriggerCapture triggerCapture;
     
     // Signal validation variables
-    static const uint8_t NUM_SIGNALS = 4;
-    unsigned long lastInterruptTime[NUM_SIGNALS] = {0, 0, 0, 0};
-    uint8_t lastPinState[NUM_SIGNALS] = {HIGH, HIGH, HIGH, HIGH};
-    static const unsigned long MIN_PULSE_WIDTH = 1; // 1ms minimum detection time (system resolution limit)
+    int64_t lastInterruptTime[Signals::COUNT] = {}; // esp_timer microseconds
+    uint64_t lastLevels = 0; // Input snapshot, bit n for GPIO n, levels of the signals logged so far
     
-    // ISR handlers for each pin and edge
-    static void IRAM_ATTR handleRF();
-    static void IRAM_ATTR handleMU();
-    static void IRAM_ATTR handlePON();
-    static void IRAM_ATTR handleBA();
+    // ISR handler shared by all signal pins
+    static void IRAM_ATTR handleEdges();
     
     // Enable or disable interrupts for a specific pin
     void enableInterrupt(uint8_t pin);
     void disableInterrupt(uint8_t pin);
     
-    // Helper to process interrupt
-    void processInterrupt(SignalType signal, EdgeType edge);
+    // Log the signals changed since the last snapshot
+    void processInterrupt();
     
     // Pointer to the current instance (for ISR)
     static SignalLogger* instance;
 };
 
-#endif // SIGNAL_LOGGER_H
\ No newline at end of file
+#endif // SIGNAL_LOGGER_H
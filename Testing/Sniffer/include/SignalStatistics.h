@@ -0,0 +1,154 @@
+#ifndef SIGNAL_STATISTICS_H
+#define SIGNAL_STATISTICS_H
+
+#include "Config.h"
+#include "EventPipeline.h"
+
+/**
+ * Per-signal pulse width statistics, in constant memory.
+ *
+ * Fed with the events like the decoders, it claims none of them. Each edge
+ * ends a pulse of the opposite level, its width goes into the high or low
+ * histogram of the signal. Histograms are log-binned, four bins per octave
+ * (a bin spans a quarter of the octave of its lower bound, widths below 8us
+ * have a bin each), up to MAX_WIDTH_US.
+ *
+ * Every StatisticsConfig::SUMMARY_INTERVAL of event time, the period is closed
+ * and written out as records, for each signal seen since boot:
+ *   RECORD_SIGNAL_STATS, fields:
+ *     0  signal
+ *     1  period length, in ms
+ *     2  edges during the period
+ *     3  shortest high pulse, in us (-1 if none)
+ *     4  longest high pulse
+ *     5  mean high pulse
+ *     6  shortest low pulse, in us (-1 if none)
+ *     7  longest low pulse
+ *     8  mean low pulse
+ *     9  time since the last edge at the end of the period, in ms
+ *     10 edges since boot
+ *   RECORD_PULSE_HISTOGRAM, non-empty bins of one histogram, as many records
+ *   as needed, fields:
+ *     0  signal
+ *     1  level (1 for high pulses, 0 for low pulses)
+ *     2+ pairs of bin lower bound (us) and pulse count
+ * Records are stamped with the end of the period. They are written one per
+ * event from the one closing the period, as record slots are available.
+ */
+class SignalStatistics : public EventDecoder {
+public:
+    /**
+     * Constructor
+     * @param eventPipeline Pipeline the statistics are added to, for their records
+     */
+    SignalStatistics(EventPipeline& eventPipeline);
+    
+    uint8_t process(const EventEntry& event) override;
+    
+    /**
+     * Print the statistics of the period in progress, as of the last event
+     * processed
+     * Call from the task feeding the pipeline
+     */
+    void printReport() const;
+
+private:
+    static constexpr size_t NUM_SIGNALS = Signals::COUNT;
+    
+    // Widths above go into the last bin (about 4.5 minutes)
+    static constexpr uint32_t MAX_WIDTH_US = (1UL << 28) - 1;
+    static constexpr size_t NUM_BINS = 4 * 26 + 4;
+    
+    // Histogram bins per record, after the signal and level fields
+    static constexpr size_t BINS_PER_RECORD = (MAX_RECORD_FIELDS - 2) / 2;
+    
+    // Pulses of one level
+    struct PulseHistogram {
+        uint32_t bins[NUM_BINS];
+        uint32_t count;
+        uint32_t minUs;
+        uint32_t maxUs;
+        uint64_t totalUs;
+    };
+    
+    // Statistics of a signal over a period
+    struct SignalPeriod {
+        PulseHistogram pulses[2]; // Indexed by level (LOW, HIGH)
+        uint32_t edges;
+    };
+    
+    // Signal state, across periods
+    struct SignalState {
+        bool seen;
+        EventEntry lastEdge;
+        uint32_t totalEdges;
+    };
+    
+    // Next record of the closed period to write
+    struct ReportCursor {
+        size_t signal;
+        size_t part; // 0 for the summary, then the high and low histograms
+        size_t bin;
+    };
+    
+    EventPipeline& pipeline;
+    
+    SignalState signals[NUM_SIGNALS] = {};
+    
+    // Period in progress and closed period being written out
+    SignalPeriod periods[2][NUM_SIGNALS];
+    size_t current = 0;
+    bool started = false;
+    EventEntry periodStart = {};
+    EventEntry lastEvent = {};
+    
+    bool reporting = false;
+    EventEntry periodEnd = {};
+    int64_t periodLengthUs = 0;
+    ReportCursor cursor = {};
+    
+    /**
+     * Close the period in progress, its records are written from then on
+     * @param event Event ending the period
+     */
+    void closePeriod(const EventEntry& event);
+    
+    /**
+     * Write the next record of the closed period, if a record slot is left
+     */
+    void writeReport();
+    
+    /**
+     * Build the next record of the closed period
+     * @param position Record to build, advanced past it
+     * @param record Record to fill
+     * @return false if all records are written
+     */
+    bool buildRecord(ReportCursor& position, LogRecord& record) const;
+    
+    /**
+     * Clear the statistics of a period
+     */
+    static void clearPeriod(SignalPeriod* period);
+    
+    /**
+     * Get the bin of a pulse width
+     * @param widthUs Pulse width, at most MAX_WIDTH_US
+     * @return Bin index
+     */
+    static size_t binOf(uint32_t widthUs);
+    
+    /**
+     * Get the lower bound of a bin
+     * @param bin Bin index
+     * @return Shortest pulse width going into the bin, in us
+     */
+    static uint32_t binLowerBound(size_t bin);
+    
+    /**
+     * Print the pulses of one level of a signal
+     */
+    static void printPulses(const char* level, const PulseHistogram& histogram);
+};
+
+#endif // SIGNAL_STATISTICS_H
@@ -0,0 +1,184 @@
+#ifndef SPILL_STORE_H
+#define SPILL_STORE_H
+
+#include "Config.h"
+#include "RingBuffer.h"
+#include "SDCardManager.h"
+
+/**
+ * Storage tier receiving events spilled out of the ring buffer.
+ * Tiers are FIFOs of EventEntry records, only used by the flush task.
+ */
+class SpillTier {
+public:
+    virtual ~SpillTier() = default;
+    
+    /**
+     * Initialize the tier
+     * @return true if the tier is usable on this board
+     */
+    virtual bool begin() = 0;
+    
+    /**
+     * Get the tier name, for reports
+     * @return Short name of the tier
+     */
+    virtual const char* getName() const = 0;
+    
+    /**
+     * Get the number of events the tier can hold
+     * @return Capacity in events
+     */
+    virtual size_t getCapacity() const = 0;
+    
+    /**
+     * Get the number of events currently held
+     * @return Number of events
+     */
+    virtual size_t getCount() const = 0;
+    
+    /**
+     * Get the number of events held since before the boot, the oldest ones
+     * @return Number of events of the previous boot
+     */
+    virtual size_t getResumedCount() const { return 0; }
+    
+    /**
+     * Append events, all of them or none
+     * @param events Events to append, oldest first
+     * @param numEvents Number of events
+     * @return true if the events were stored
+     */
+    virtual bool append(const EventEntry* events, size_t numEvents) = 0;
+    
+    /**
+     * Copy the oldest events without removing them
+     * @param dest Destination array
+     * @param maxEvents Maximum number of events to copy
+     * @param skip Number of oldest events to leave out
+     * @return Number of events copied
+     */
+    virtual size_t peek(EventEntry* dest, size_t maxEvents, size_t skip = 0) = 0;
+    
+    /**
+     * Remove the oldest events
+     * @param numEvents Number of events, at most what peek() returned
+     */
+    virtual void consume(size_t numEvents) = 0;
+};
+
+// Spill tier in PSRAM, a plain ring of events
+class PsramSpillTier : public SpillTier {
+public:
+    bool begin() override;
+    const char* getName() const override { return "PSRAM"; }
+    size_t getCapacity() const override { return capacity; }
+    size_t getCount() const override { return count; }
+    bool append(const EventEntry* events, size_t numEvents) override;
+    size_t peek(EventEntry* dest, size_t maxEvents, size_t skip = 0) override;
+    void consume(size_t numEvents) override;
+
+private:
+    EventEntry* storage = nullptr;
+    size_t capacity = 0;
+    size_t readIndex = 0;
+    size_t count = 0;
+};
+
+/**
+ * Spill tier in a LittleFS file on the internal flash
+ * Events are appended to the file and read back from an offset, the file is
+ * removed once fully drained. A file left over by a reboot is drained too,
+ * its events are from the previous boot.
+ */
+class FlashSpillTier : public SpillTier {
+public:
+    bool begin() override;
+    const char* getName() const override { return "flash"; }
+    size_t getCapacity() const override { return capacity; }
+    size_t getCount() const override { return count; }
+    size_t getResumedCount() const override { return resumedCount; }
+    bool append(const EventEntry* events, size_t numEvents) override;
+    size_t peek(EventEntry* dest, size_t maxEvents, size_t skip = 0) override;
+    void consume(size_t numEvents) override;
+
+private:
+    size_t capacity = 0;
+    size_t readOffset = 0; // Bytes already drained from the file
+    size_t count = 0;
+    size_t resumedCount = 0; // Events of the previous boot, first in the file
+};
+
+/**
+ * Tiered overflow storage behind the ring buffer (the hot tier).
+ *
+ * While the SD card is absent, blocks of the oldest events are moved from the
+ * ring buffer to the spill tiers, filling them in order. When the card comes
+ * back, the tiers are drained to it, oldest first, before the ring buffer.
+ */
+class SpillStore {
+public:
+    /**
+     * Constructor
+     * @param buffer Reference to the ring buffer to spill from
+     */
+    SpillStore(RingBuffer& buffer);
+    
+    /**
+     * Initialize the tiers enabled in SpillConfig and available on the board
+     */
+    void begin();
+    
+    /**
+     * Move one block of the oldest events from the ring buffer to a spill tier
+     * @return true if events were moved, false if empty or all tiers are full
+     */
+    bool spill();
+    
+    /**
+     * Save all spilled events to the SD card, oldest first
+     * @param sdCard SD card manager to save to
+     * @return true if no spilled event is left
+     */
+    bool drain(SDCardManager& sdCard);
+    
+    /**
+     * Check if all spill tiers are empty
+     * @return true if no event is spilled
+     */
+    bool isEmpty() const;
+    
+    /**
+     * Print capacity and usage of each tier, throughputs and the age of the
+     * oldest event of this boot not on the SD card yet
+     */
+    void printReport();
+
+private:
+    static constexpr size_t MAX_TIERS = 2;
+    
+    RingBuffer& eventBuffer;
+    PsramSpillTier psramTier;
+    FlashSpillTier flashTier;
+    SpillTier* tiers[MAX_TIERS];
+    size_t numTiers = 0;
+    
+    // Transfer buffer from a spill tier to the SD card
+    EventEntry transfer[SpillConfig::BLOCK_EVENTS];
+    
+    // Throughput measurements
+    uint64_t spilledBytes = 0;
+    uint64_t spillTimeUs = 0;
+    uint64_t drainedBytes = 0;
+    uint64_t drainTimeUs = 0;
+    
+    /**
+     * Get the oldest event of this boot not saved to the SD card yet
+     * Events of the previous boot have timestamps of another millis() run
+     * @param entry Set to the oldest event
+     * @return true if there is any
+     */
+    bool getOldestEvent(EventEntry& entry);
+};
+
+#endif // SPILL_STORE_H
@@ -0,0 +1,111 @@
+#ifndef TRIGGER_CAPTURE_H
+#define TRIGGER_CAPTURE_H
+
+#include "Config.h"
+#include "LogRecord.h"
+#include "PipelineMetrics.h"
+#include "RingBuffer.h"
+
+/**
+ * Trigger capture, as on a logic analyzer (TriggerConfig::ENABLE).
+ *
+ * Events are held in a circular pre-trigger window in RAM instead of being
+ * written to the ring buffer. When an event matches one of
+ * TriggerConfig::CONDITIONS, the window (the events of the last
+ * PRE_TRIGGER_US), a trigger marker and the triggering events are written,
+ * then every event for POST_TRIGGER_US. A trigger during that time extends
+ * the capture. Events outside the captures never reach the ring buffer, the
+ * SD card or the decoders: they are only counted.
+ *
+ * The marker is an event of signal TRIGGER_MARKER_SIGNAL at the time of the
+ * trigger, which the consumers turn into a RECORD_TRIGGER record
+ * (toRecord()), right before the events of the triggering edge, with the
+ * fields:
+ *   0  pre-trigger window, in us
+ *   1  post-trigger time, in us
+ *   2  1 if the pre-trigger window is complete, 0 if it held more than
+ *      PRE_TRIGGER_EVENTS events and the oldest are missing
+ *
+ * Producer side, runs in the GPIO interrupt. A trigger costs a copy of the
+ * window to the ring buffer, other events a condition check and a copy.
+ */
+class TriggerCapture {
+public:
+    /**
+     * Constructor
+     * @param buffer Reference to the ring buffer the captures are written to
+     * @param metrics Reference to the pipeline metrics, for the triggers and losses
+     */
+    TriggerCapture(RingBuffer& buffer, PipelineMetrics& metrics);
+    
+    /**
+     * Process the events of an interrupt (ISR safe)
+     * @param events Events, all at the same time
+     * @param numEvents Number of events
+     * @param time Time of the events, esp_timer microseconds
+     */
+    void write(const EventEntry* events, size_t numEvents, int64_t time);
+    
+    /**
+     * Check if an event from the ring buffer is a trigger marker
+     */
+    static bool isMarker(const EventEntry& event) {
+        return event.signalType == TRIGGER_MARKER_SIGNAL;
+    }
+    
+    /**
+     * Get the record of a trigger marker
+     * @param marker Trigger marker
+     * @return RECORD_TRIGGER record, at the time of the trigger
+     */
+    static LogRecord toRecord(const EventEntry& marker);
+
+private:
+    static constexpr size_t WINDOW_MASK = TriggerConfig::PRE_TRIGGER_EVENTS - 1;
+    static_assert((TriggerConfig::PRE_TRIGGER_EVENTS & WINDOW_MASK) == 0, "PRE_TRIGGER_EVENTS must be a power of two");
+    
+    // Marker edge bit: pre-trigger window complete or truncated
+    static constexpr uint8_t MARKER_COMPLETE = EDGE_RISING;
+    static constexpr uint8_t MARKER_TRUNCATED = EDGE_FALLING;
+    
+    RingBuffer& eventBuffer;
+    PipelineMetrics& pipelineMetrics;
+    
+    // Pre-trigger window, the oldest events are overwritten
+    EventEntry window[TriggerConfig::PRE_TRIGGER_EVENTS];
+    size_t windowEnd = 0;   // Free-running index of the next event
+    size_t windowCount = 0; // Events held, at most PRE_TRIGGER_EVENTS
+    EventEntry overwritten; // Last event overwritten, if any
+    bool hasOverwritten = false;
+    
+    // End of the capture in progress, esp_timer microseconds
+    int64_t captureEnd = INT64_MIN;
+    
+    // Time of the last edge of each signal, for the idle conditions
+    int64_t lastEdgeTime[Signals::COUNT];
+    
+    /**
+     * Check if an event fires a trigger
+     */
+    bool isTrigger(const EventEntry& event, int64_t time) const;
+    
+    /**
+     * Write events to the ring buffer, counting those it has no room for
+     */
+    void writeEvents(const EventEntry* events, size_t numEvents);
+    
+    /**
+     * Write the events of the window that are within the pre-trigger time,
+     * and empty it
+     * @param trigger Triggering event
+     * @return true if no event within the pre-trigger time was overwritten
+     */
+    bool writeWindow(const EventEntry& trigger);
+    
+    /**
+     * Hold events in the window
+     */
+    void hold(const EventEntry* events, size_t numEvents);
+};
+
+#endif // TRIGGER_CAPTURE_H
@@ -0,0 +1,105 @@
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+/*
+ * Subset of the ESP32 Arduino core used by the Sniffer, for the native build.
+ * Time runs on the virtual clock of NativeHal.h, pins are driven by the
+ * replay engine.
+ */
+
+#define IRAM_ATTR
+
+#define LOW 0x0
+#define HIGH 0x1
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define INPUT_PULLDOWN 0x09
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+/**
+ * Output stream, the base of Serial and File
+ */
+class Print {
+public:
+    virtual ~Print() = default;
+    
+    virtual size_t write(const uint8_t* buffer, size_t size) = 0;
+    
+    size_t write(uint8_t c) { return write(&c, 1); }
+    size_t print(const char* text) { return write(reinterpret_cast<const uint8_t*>(text), strlen(text)); }
+    size_t print(long value);
+    size_t print(unsigned long value);
+    size_t print(int value) { return print(static_cast<long>(value)); }
+    size_t print(unsigned int value) { return print(static_cast<unsigned long>(value)); }
+    size_t println() { return print("\r\n"); }
+    size_t println(const char* text) { return print(text) + println(); }
+    size_t println(long value) { return print(value) + println(); }
+    size_t println(unsigned long value) { return print(value) + println(); }
+    size_t println(int value) { return print(value) + println(); }
+    size_t println(unsigned int value) { return print(value) + println(); }
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+/**
+ * Serial console, written to the standard output, or to a device such as a
+ * pseudo-terminal which is also read (see NativeHal::setSerialDevice())
+ */
+class HardwareSerial : public Print {
+public:
+    void begin(unsigned long baudRate) { (void)baudRate; }
+    void updateBaudRate(unsigned long baudRate) { (void)baudRate; }
+    void flush() {}
+    operator bool() const { return true; }
+    int available();
+    int read();
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+// Sketch entry points, called by the replay engine
+void setup();
+void loop();
+
+// Virtual time (see NativeHal.h), 32-bit like on the ESP32
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+// Pins, driven by NativeHal::injectEdge()
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+void analogWrite(uint8_t pin, int value);
+inline int digitalPinToInterrupt(uint8_t pin) { return pin; }
+void attachInterrupt(int interrupt, void (*handler)(), int mode);
+void detachInterrupt(int interrupt);
+
+// LEDC, accepted and ignored (no signal comes out)
+bool ledcAttach(uint8_t pin, uint32_t frequency, uint8_t resolution);
+bool ledcWrite(uint8_t pin, uint32_t duty);
+bool ledcDetach(uint8_t pin);
+
+// No PSRAM, like the devkit the firmware targets
+bool psramFound();
+void* ps_malloc(size_t size);
+
+#endif // NATIVE_ARDUINO_H
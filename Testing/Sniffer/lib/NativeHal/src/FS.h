@@ -0,0 +1,84 @@
+#ifndef NATIVE_FS_H
+#define NATIVE_FS_H
+
+#include <Arduino.h>
+#include <memory>
+#include <string>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+struct NativeFile;
+
+/**
+ * Open file or directory of a NativeFS, copies share the same handle like on
+ * the ESP32
+ */
+class File : public Print {
+public:
+    File() = default;
+    explicit File(std::shared_ptr<NativeFile> file) : handle(std::move(file)) {}
+    
+    operator bool() const;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    int read();
+    size_t read(uint8_t* buffer, size_t size);
+    int available();
+    bool seek(uint32_t position);
+    size_t position() const;
+    size_t size() const;
+    void flush();
+    void close();
+    const char* name() const;
+    bool isDirectory() const;
+    File openNextFile();
+
+private:
+    std::shared_ptr<NativeFile> handle;
+    
+    bool hasStream() const;
+};
+
+/**
+ * File system stored in a host directory
+ * Paths are absolute within the file system ("/data.csv")
+ */
+class NativeFS {
+public:
+    explicit NativeFS(const char* defaultRoot) : root(defaultRoot) {}
+    
+    /**
+     * Set the host directory holding the files, before begin()
+     */
+    void setRoot(const std::string& directory) { root = directory; }
+    
+    bool exists(const char* path);
+    File open(const char* path, const char* mode = FILE_READ, bool create = false);
+    bool remove(const char* path);
+    bool rename(const char* from, const char* to);
+    bool mkdir(const char* path);
+    bool rmdir(const char* path);
+
+protected:
+    std::string root;
+    bool mounted = false;
+    
+    /**
+     * Mount the file system, creating its directory
+     */
+    bool mount();
+    
+    /**
+     * Host path of a file
+     */
+    std::string hostPath(const char* path) const;
+    
+    /**
+     * Check if the files can be accessed (mounted, and the card inserted)
+     */
+    virtual bool isAvailable() const { return mounted; }
+};
+
+#endif // NATIVE_FS_H
@@ -0,0 +1,24 @@
+#ifndef NATIVE_LITTLEFS_H
+#define NATIVE_LITTLEFS_H
+
+#include <FS.h>
+
+/**
+ * Internal flash file system in a host directory, sized like the "spiffs"
+ * partition of the default partition table
+ */
+class LittleFSFS : public NativeFS {
+public:
+    static constexpr size_t TOTAL_BYTES = 1408 * 1024;
+    
+    LittleFSFS() : NativeFS("_native/flash") {}
+    
+    bool begin(bool formatOnFail = false);
+    void end();
+    size_t totalBytes() const { return TOTAL_BYTES; }
+    size_t usedBytes() const;
+};
+
+extern LittleFSFS LittleFS;
+
+#endif // NATIVE_LITTLEFS_H
@@ -0,0 +1,239 @@
+#include "NativeHal.h"
+#include <SD.h>
+#include <LittleFS.h>
+#include <SPI.h>
+#include <algorithm>
+#include <filesystem>
+#include <vector>
+
+// Open host file or directory, shared by the copies of a File
+struct NativeFile {
+    FILE* stream = nullptr;
+    bool onCard = false; // Writes go through the SD card statistics
+    std::string name;    // Name within its directory
+    
+    // Directory: host path and entries, listed when opened
+    bool directory = false;
+    std::string hostPath;
+    std::vector<std::string> entries;
+    size_t nextEntry = 0;
+    
+    ~NativeFile() {
+        if (stream) {
+            fclose(stream);
+        }
+    }
+};
+
+SDFS SD;
+LittleFSFS LittleFS;
+SPIClass SPI;
+
+File::operator bool() const {
+    return handle && (handle->stream || handle->directory);
+}
+
+bool File::hasStream() const {
+    return handle && handle->stream;
+}
+
+size_t File::write(const uint8_t* buffer, size_t size) {
+    if (!hasStream()) {
+        return 0;
+    }
+    if (handle->onCard && NativeHal::beginCardWrite(size) == 0) {
+        return 0; // Card removed
+    }
+    return fwrite(buffer, 1, size, handle->stream);
+}
+
+int File::read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+size_t File::read(uint8_t* buffer, size_t size) {
+    return hasStream() ? fread(buffer, 1, size, handle->stream) : 0;
+}
+
+int File::available() {
+    return hasStream() ? static_cast<int>(size() - position()) : 0;
+}
+
+bool File::seek(uint32_t position) {
+    return hasStream() && fseek(handle->stream, position, SEEK_SET) == 0;
+}
+
+size_t File::position() const {
+    return hasStream() ? static_cast<size_t>(ftell(handle->stream)) : 0;
+}
+
+size_t File::size() const {
+    if (!hasStream()) {
+        return 0;
+    }
+    fflush(handle->stream);
+    long current = ftell(handle->stream);
+    fseek(handle->stream, 0, SEEK_END);
+    long end = ftell(handle->stream);
+    fseek(handle->stream, current, SEEK_SET);
+    return end > 0 ? static_cast<size_t>(end) : 0;
+}
+
+void File::flush() {
+    if (hasStream()) {
+        fflush(handle->stream);
+        if (handle->onCard) {
+            NativeHal::countCardSync();
+        }
+    }
+}
+
+void File::close() {
+    handle.reset();
+}
+
+const char* File::name() const {
+    return handle ? handle->name.c_str() : "";
+}
+
+bool File::isDirectory() const {
+    return handle && handle->directory;
+}
+
+File File::openNextFile() {
+    if (!isDirectory() || handle->nextEntry == handle->entries.size()) {
+        return File();
+    }
+    
+    // Entries are opened for reading, as on the ESP32
+    const std::string& name = handle->entries[handle->nextEntry++];
+    std::string path = handle->hostPath + "/" + name;
+    auto entry = std::make_shared<NativeFile>();
+    entry->name = name;
+    entry->onCard = handle->onCard;
+    std::error_code error;
+    if (std::filesystem::is_directory(path, error)) {
+        entry->directory = true;
+        entry->hostPath = path;
+    } else {
+        entry->stream = fopen(path.c_str(), "rb");
+    }
+    return File(entry);
+}
+
+bool NativeFS::mount() {
+    std::error_code error;
+    std::filesystem::create_directories(root, error);
+    mounted = !error;
+    return mounted;
+}
+
+std::string NativeFS::hostPath(const char* path) const {
+    return root + (path[0] == '/' ? "" : "/") + path;
+}
+
+bool NativeFS::exists(const char* path) {
+    std::error_code error;
+    return isAvailable() && std::filesystem::exists(hostPath(path), error);
+}
+
+File NativeFS::open(const char* path, const char* mode, bool create) {
+    if (!isAvailable()) {
+        return File();
+    }
+    
+    std::string file = hostPath(path);
+    if (create) {
+        std::error_code error;
+        std::filesystem::create_directories(std::filesystem::path(file).parent_path(), error);
+    }
+    
+    auto handle = std::make_shared<NativeFile>();
+    handle->name = std::filesystem::path(file).filename().string();
+    handle->onCard = this == &SD;
+    
+    // Directories list their entries, in name order
+    std::error_code error;
+    if (std::filesystem::is_directory(file, error)) {
+        handle->directory = true;
+        handle->hostPath = file;
+        for (const auto& entry : std::filesystem::directory_iterator(file, error)) {
+            handle->entries.push_back(entry.path().filename().string());
+        }
+        std::sort(handle->entries.begin(), handle->entries.end());
+        return File(handle);
+    }
+    
+    const char* hostMode = strcmp(mode, FILE_WRITE) == 0 ? "wb" : strcmp(mode, FILE_APPEND) == 0 ? "ab" : "rb";
+    handle->stream = fopen(file.c_str(), hostMode);
+    return handle->stream ? File(handle) : File();
+}
+
+bool NativeFS::remove(const char* path) {
+    std::error_code error;
+    return isAvailable() && std::filesystem::remove(hostPath(path), error);
+}
+
+bool NativeFS::rename(const char* from, const char* to) {
+    std::error_code error;
+    if (!isAvailable()) {
+        return false;
+    }
+    std::filesystem::rename(hostPath(from), hostPath(to), error);
+    return !error;
+}
+
+bool NativeFS::mkdir(const char* path) {
+    std::error_code error;
+    return isAvailable() && std::filesystem::create_directory(hostPath(path), error);
+}
+
+bool NativeFS::rmdir(const char* path) {
+    std::error_code error;
+    return isAvailable() && std::filesystem::is_directory(hostPath(path), error)
+        && std::filesystem::remove(hostPath(path), error);
+}
+
+bool SDFS::begin(uint8_t ssPin) {
+    (void)ssPin;
+    if (!NativeHal::isCardPresent()) {
+        return false;
+    }
+    NativeHal::countCardMount();
+    insertion = NativeHal::getCardInsertions();
+    return mount();
+}
+
+void SDFS::end() {
+    mounted = false;
+}
+
+bool SDFS::isAvailable() const {
+    // A card removed and inserted again must be mounted again
+    return mounted && NativeHal::isCardPresent() && insertion == NativeHal::getCardInsertions();
+}
+
+uint8_t SPIClass::transfer(uint8_t data) {
+    return NativeHal::transferCard(data);
+}
+
+bool LittleFSFS::begin(bool formatOnFail) {
+    (void)formatOnFail;
+    return mount();
+}
+
+void LittleFSFS::end() {
+    mounted = false;
+}
+
+size_t LittleFSFS::usedBytes() const {
+    size_t used = 0;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(root, error)) {
+        if (entry.is_regular_file(error)) {
+            used += entry.file_size(error);
+        }
+    }
+    return used;
+}
@@ -0,0 +1,384 @@
+#include "NativeHal.h"
+#include <esp_timer.h>
+#include <esp_cpu.h>
+#include <soc/gpio_reg.h>
+#include <driver/rmt_rx.h>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <mutex>
+#include <thread>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace {
+    using HostClock = std::chrono::steady_clock;
+    
+    constexpr size_t NUM_PINS = 40;
+    
+    // Virtual clock
+    double clockSpeed = 1.0;
+    int64_t clockStartUs = 0;
+    HostClock::time_point hostStart = HostClock::now();
+    
+    // Edge time while the simulated interrupt runs, -1 otherwise
+    thread_local int64_t interruptTime = -1;
+    
+    // Pins
+    std::atomic<uint8_t> pinLevels[NUM_PINS];
+    void (*interruptHandlers[NUM_PINS])() = {};
+    
+    // SD card
+    std::atomic<bool> cardPresent(true);
+    std::atomic<uint32_t> cardInsertions(1);
+    std::atomic<int64_t> cardWriteLatencyUs(0);
+    std::mutex cardMutex;
+    NativeHal::CardStats cardStats = {};
+    
+    // SD card SPI interface: command being received, response being sent
+    uint8_t cardCommand[6];
+    size_t cardCommandLength = 0;
+    uint8_t cardResponse[2];
+    size_t cardResponseLength = 0;
+    size_t cardResponseIndex = 0;
+    uint32_t cardSpiInsertion = 0; // Insertion in SPI mode
+    
+    std::atomic<bool> serialEnabled(true);
+    int serialDevice = -1;
+    std::mutex serialMutex;
+    
+    /**
+     * Sleep for a virtual duration
+     */
+    void sleepVirtual(int64_t durationUs) {
+        if (durationUs > 0) {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(static_cast<int64_t>(durationUs * 1000.0 / clockSpeed)));
+        }
+    }
+}
+
+HardwareSerial Serial;
+
+namespace NativeHal {
+    void begin(double speed, int64_t startUs) {
+        clockSpeed = speed;
+        clockStartUs = startUs;
+        hostStart = HostClock::now();
+    }
+    
+    int64_t now() {
+        if (interruptTime >= 0) {
+            return interruptTime;
+        }
+        int64_t elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(HostClock::now() - hostStart).count();
+        return clockStartUs + static_cast<int64_t>(elapsedNs * clockSpeed / 1000.0);
+    }
+    
+    void sleepUntil(int64_t timeUs) {
+        std::this_thread::sleep_until(toHostTime(timeUs));
+    }
+    
+    HostClock::time_point toHostTime(int64_t timeUs) {
+        return hostStart + std::chrono::nanoseconds(static_cast<int64_t>((timeUs - clockStartUs) * 1000.0 / clockSpeed));
+    }
+    
+    void setPin(uint8_t pin, uint8_t level) {
+        if (pin < NUM_PINS) {
+            pinLevels[pin] = level;
+        }
+    }
+    
+    uint32_t readRegister(uint32_t address) {
+        // GPIO_IN_REG holds pins 0-31, GPIO_IN1_REG the following ones
+        size_t first = address == GPIO_IN1_REG ? 32 : address == GPIO_IN_REG ? 0 : NUM_PINS;
+        uint32_t levels = 0;
+        for (size_t pin = first; pin < NUM_PINS && pin < first + 32; pin++) {
+            levels |= static_cast<uint32_t>(pinLevels[pin].load() ? 1 : 0) << (pin - first);
+        }
+        return levels;
+    }
+    
+    void injectEdge(uint8_t pin, uint8_t level, int64_t timeUs) {
+        if (pin >= NUM_PINS) {
+            return;
+        }
+        pinLevels[pin] = level;
+        
+        // The handler reads the pin and the clock, as on an edge interrupt
+        if (interruptHandlers[pin]) {
+            interruptTime = timeUs;
+            interruptHandlers[pin]();
+            interruptTime = -1;
+        }
+    }
+    
+    void setCardPresent(bool present) {
+        if (present && !cardPresent) {
+            cardInsertions++;
+        }
+        cardPresent = present;
+    }
+    
+    void setCardWriteLatency(int64_t latencyUs) {
+        cardWriteLatencyUs = latencyUs;
+    }
+    
+    void setSerialEnabled(bool enabled) {
+        serialEnabled = enabled;
+    }
+    
+    bool setSerialDevice(const std::string& path) {
+        serialDevice = open(path.c_str(), O_RDWR | O_NOCTTY);
+        if (serialDevice < 0) {
+            return false;
+        }
+        
+        // No echo, no line editing, no CR/LF translation of the frames
+        struct termios settings;
+        if (tcgetattr(serialDevice, &settings) == 0) {
+            cfmakeraw(&settings);
+            tcsetattr(serialDevice, TCSANOW, &settings);
+        }
+        return true;
+    }
+    
+    CardStats getCardStats() {
+        std::lock_guard<std::mutex> lock(cardMutex);
+        return cardStats;
+    }
+    
+    size_t beginCardWrite(size_t size) {
+        sleepVirtual(cardWriteLatencyUs);
+        
+        std::lock_guard<std::mutex> lock(cardMutex);
+        if (!cardPresent) {
+            cardStats.failedWrites++;
+            return 0;
+        }
+        cardStats.writes++;
+        cardStats.bytesWritten += size;
+        return size;
+    }
+    
+    void countCardSync() {
+        std::lock_guard<std::mutex> lock(cardMutex);
+        cardStats.syncs++;
+    }
+    
+    bool isCardPresent() {
+        return cardPresent;
+    }
+    
+    uint32_t getCardInsertions() {
+        return cardInsertions;
+    }
+    
+    void countCardMount() {
+        std::lock_guard<std::mutex> lock(cardMutex);
+        cardStats.mounts++;
+        cardSpiInsertion = cardInsertions;
+    }
+    
+    uint8_t transferCard(uint8_t data) {
+        std::lock_guard<std::mutex> lock(cardMutex);
+        if (!cardPresent) {
+            cardCommandLength = 0;
+            cardResponseLength = 0;
+            return 0xFF;
+        }
+        
+        // Response of the last command, one byte after it
+        uint8_t answer = 0xFF;
+        if (cardResponseIndex < cardResponseLength) {
+            answer = cardResponse[cardResponseIndex++];
+        }
+        
+        // Commands start with 01, then 5 bytes of argument and CRC
+        if (cardCommandLength > 0 || (data & 0xC0) == 0x40) {
+            cardCommand[cardCommandLength++] = data;
+        }
+        if (cardCommandLength == sizeof(cardCommand)) {
+            cardCommandLength = 0;
+            cardStats.commands++;
+            uint8_t command = cardCommand[0] & 0x3F;
+            cardResponseIndex = 0;
+            if (command == 0) {
+                cardSpiInsertion = cardInsertions;
+                cardResponse[0] = 0x01;
+                cardResponseLength = 1;
+            } else if (cardSpiInsertion == cardInsertions) {
+                cardResponse[0] = 0x00;
+                cardResponse[1] = 0x00;
+                cardResponseLength = command == 13 ? 2 : 1;
+            }
+            
+            // Still in SD mode, no answer
+        }
+        return answer;
+    }
+}
+
+BaseType_t xPortInIsrContext() {
+    return interruptTime >= 0 ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xPortGetCoreID() {
+    return 0;
+}
+
+int64_t esp_timer_get_time() {
+    return NativeHal::now();
+}
+
+uint32_t esp_cpu_get_cycle_count() {
+    int64_t elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(HostClock::now() - hostStart).count();
+    return static_cast<uint32_t>(elapsedNs * 240 / 1000);
+}
+
+unsigned long millis() {
+    return static_cast<uint32_t>(NativeHal::now() / 1000);
+}
+
+unsigned long micros() {
+    return static_cast<uint32_t>(NativeHal::now());
+}
+
+void delay(uint32_t ms) {
+    sleepVirtual(static_cast<int64_t>(ms) * 1000);
+}
+
+void delayMicroseconds(uint32_t us) {
+    sleepVirtual(us);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    (void)pin;
+    (void)mode;
+}
+
+int digitalRead(uint8_t pin) {
+    return pin < NUM_PINS ? pinLevels[pin].load() : LOW;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    NativeHal::setPin(pin, value);
+}
+
+void analogWrite(uint8_t pin, int value) {
+    NativeHal::setPin(pin, value > 0 ? HIGH : LOW);
+}
+
+void attachInterrupt(int interrupt, void (*handler)(), int mode) {
+    (void)mode; // The firmware only uses CHANGE
+    if (interrupt >= 0 && static_cast<size_t>(interrupt) < NUM_PINS) {
+        interruptHandlers[interrupt] = handler;
+    }
+}
+
+void detachInterrupt(int interrupt) {
+    attachInterrupt(interrupt, nullptr, CHANGE);
+}
+
+bool ledcAttach(uint8_t pin, uint32_t frequency, uint8_t resolution) {
+    (void)pin;
+    (void)frequency;
+    (void)resolution;
+    return true;
+}
+
+bool ledcWrite(uint8_t pin, uint32_t duty) {
+    (void)pin;
+    (void)duty;
+    return true;
+}
+
+bool ledcDetach(uint8_t pin) {
+    (void)pin;
+    return true;
+}
+
+bool psramFound() {
+    return false;
+}
+
+void* ps_malloc(size_t size) {
+    return malloc(size);
+}
+
+size_t Print::print(long value) {
+    char text[24];
+    int length = snprintf(text, sizeof(text), "%ld", value);
+    return write(reinterpret_cast<const uint8_t*>(text), length);
+}
+
+size_t Print::print(unsigned long value) {
+    char text[24];
+    int length = snprintf(text, sizeof(text), "%lu", value);
+    return write(reinterpret_cast<const uint8_t*>(text), length);
+}
+
+size_t Print::printf(const char* format, ...) {
+    char text[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    if (length < 0) {
+        return 0;
+    }
+    return write(reinterpret_cast<const uint8_t*>(text), std::min(static_cast<size_t>(length), sizeof(text) - 1));
+}
+
+int HardwareSerial::available() {
+    if (serialDevice < 0) {
+        return 0;
+    }
+    struct pollfd device = {serialDevice, POLLIN, 0};
+    return poll(&device, 1, 0) > 0 && (device.revents & POLLIN) ? 1 : 0;
+}
+
+int HardwareSerial::read() {
+    uint8_t c;
+    return available() > 0 && ::read(serialDevice, &c, 1) == 1 ? c : -1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+    if (serialDevice < 0) {
+        if (serialEnabled) {
+            fwrite(buffer, 1, size, stdout);
+        }
+        return size;
+    }
+    
+    // One write at a time, as the UART driver does on the device
+    std::lock_guard<std::mutex> lock(serialMutex);
+    size_t written = 0;
+    while (written < size) {
+        ssize_t result = ::write(serialDevice, buffer + written, size - written);
+        if (result <= 0) {
+            break;
+        }
+        written += static_cast<size_t>(result);
+    }
+    return written;
+}
+
+// The RMT receiver is not simulated
+esp_err_t rmt_new_rx_channel(const rmt_rx_channel_config_t*, rmt_channel_handle_t* channel) {
+    *channel = nullptr;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t rmt_rx_register_event_callbacks(rmt_channel_handle_t, const rmt_rx_event_callbacks_t*, void*) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t rmt_enable(rmt_channel_handle_t) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t rmt_receive(rmt_channel_handle_t, void*, size_t, const rmt_receive_config_t*) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
@@ -0,0 +1,153 @@
+#ifndef NATIVE_HAL_H
+#define NATIVE_HAL_H
+
+#include <Arduino.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+/**
+ * Host side of the native build.
+ *
+ * Time runs on a virtual clock, scaled from the host clock: at speed 1000, a
+ * minute of device time (commit interval, task delays, tick counts) passes in
+ * 60ms. Edges are injected by the replay thread, which runs the attached
+ * handlers as the interrupt would, with the clock reading the edge time
+ * exactly. Flash and SD card are host directories, the card can be removed.
+ */
+namespace NativeHal {
+    /**
+     * Start the virtual clock
+     * @param speed Virtual time elapsed per unit of host time
+     * @param startUs Virtual time now, in microseconds
+     */
+    void begin(double speed, int64_t startUs);
+    
+    /**
+     * Get the virtual time, in microseconds
+     */
+    int64_t now();
+    
+    /**
+     * Sleep until the virtual clock reaches a time
+     * @param timeUs Virtual time, in microseconds
+     */
+    void sleepUntil(int64_t timeUs);
+    
+    /**
+     * Get the host time at which the virtual clock reaches a time
+     * @param timeUs Virtual time, in microseconds
+     */
+    std::chrono::steady_clock::time_point toHostTime(int64_t timeUs);
+    
+    /**
+     * Set the level of an input pin, without interrupt (before begin())
+     */
+    void setPin(uint8_t pin, uint8_t level);
+    
+    /**
+     * Change the level of an input pin and run its interrupt handler, in
+     * interrupt context, with the clock reading the edge time
+     * @param pin Pin changing
+     * @param level New level
+     * @param timeUs Virtual time of the edge, in microseconds
+     */
+    void injectEdge(uint8_t pin, uint8_t level, int64_t timeUs);
+    
+    /**
+     * Read a hardware register, only the GPIO input registers are simulated
+     * @param address Register address (GPIO_IN_REG or GPIO_IN1_REG)
+     * @return Pin levels, one bit per pin
+     */
+    uint32_t readRegister(uint32_t address);
+    
+    /**
+     * Insert or remove the SD card
+     */
+    void setCardPresent(bool present);
+    
+    /**
+     * Set the time each SD card write call takes, in virtual microseconds
+     */
+    void setCardWriteLatency(int64_t latencyUs);
+    
+    /**
+     * Silence the serial console
+     */
+    void setSerialEnabled(bool enabled);
+    
+    /**
+     * Connect the serial console to a device instead of the standard output,
+     * in raw mode if it is a terminal
+     * @param path Device to read and write, such as a pseudo-terminal
+     * @return true if the device was opened
+     */
+    bool setSerialDevice(const std::string& path);
+    
+    // SD card activity
+    struct CardStats {
+        uint64_t bytesWritten;
+        uint32_t writes;
+        uint32_t failedWrites; // Card removed
+        uint32_t syncs;
+        uint32_t mounts;       // SD.begin() calls
+        uint32_t commands;     // Commands received over SPI
+    };
+    
+    /**
+     * Get the SD card activity so far
+     */
+    CardStats getCardStats();
+    
+    // Time a task spent awake, between two notification waits
+    struct TaskStats {
+        std::string name;
+        uint32_t wakes;
+        int64_t totalBusyUs; // Host time
+        int64_t maxBusyUs;   // Host time
+    };
+    
+    /**
+     * Get the activity of the tasks created so far
+     */
+    std::vector<TaskStats> getTaskStats();
+    
+    /**
+     * Count a write to an SD card file (for the file system)
+     * @return Bytes to write, 0 if the card was removed
+     */
+    size_t beginCardWrite(size_t size);
+    
+    /**
+     * Count a sync of an SD card file (for the file system)
+     */
+    void countCardSync();
+    
+    /**
+     * Check if the SD card is inserted (for the file system)
+     */
+    bool isCardPresent();
+    
+    /**
+     * Get the number of times the SD card was inserted, a mount only lasts
+     * until the card is removed (for the file system)
+     */
+    uint32_t getCardInsertions();
+    
+    /**
+     * Count a mount of the SD card, which switches it to SPI mode (for the
+     * file system)
+     */
+    void countCardMount();
+    
+    /**
+     * Exchange a byte with the SD card over SPI (for SPIClass). The card
+     * answers CMD0 with R1 idle, and CMD13 with R2 once in SPI mode (after
+     * CMD0 or a mount, since its insertion). Without card the bus reads 0xFF.
+     * @param data Byte sent
+     * @return Byte received
+     */
+    uint8_t transferCard(uint8_t data);
+}
+
+#endif // NATIVE_HAL_H
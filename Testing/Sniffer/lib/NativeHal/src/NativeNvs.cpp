@@ -0,0 +1,61 @@
+#include <Preferences.h>
+#include <filesystem>
+
+namespace {
+    std::string nvsRoot = "_native/nvs";
+}
+
+void Preferences::setRoot(const std::string& directory) {
+    nvsRoot = directory;
+}
+
+bool Preferences::begin(const char* name, bool readOnlyMode) {
+    std::error_code error;
+    std::filesystem::create_directories(nvsRoot, error);
+    if (error) {
+        return false;
+    }
+    path = nvsRoot + "/" + name;
+    readOnly = readOnlyMode;
+    
+    // One "key value" line per entry
+    values.clear();
+    FILE* file = fopen(path.c_str(), "r");
+    if (file) {
+        char key[16];
+        unsigned long value;
+        while (fscanf(file, "%15s %lu", key, &value) == 2) {
+            values[key] = static_cast<uint32_t>(value);
+        }
+        fclose(file);
+    }
+    return true;
+}
+
+void Preferences::end() {
+    path.clear();
+    values.clear();
+}
+
+uint32_t Preferences::getUInt(const char* key, uint32_t defaultValue) {
+    auto entry = values.find(key);
+    return entry != values.end() ? entry->second : defaultValue;
+}
+
+size_t Preferences::putUInt(const char* key, uint32_t value) {
+    if (path.empty() || readOnly) {
+        return 0;
+    }
+    values[key] = value;
+    
+    // Written through, like an NVS commit
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) {
+        return 0;
+    }
+    for (const auto& entry : values) {
+        fprintf(file, "%s %lu\n", entry.first.c_str(), static_cast<unsigned long>(entry.second));
+    }
+    fclose(file);
+    return sizeof(value);
+}
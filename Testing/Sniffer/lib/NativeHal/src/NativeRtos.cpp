@@ -0,0 +1,198 @@
+#include "NativeHal.h"
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <thread>
+
+// Task: a detached host thread, and its notification value
+struct NativeTask {
+    std::string name;
+    uint32_t stackSize = 0;
+    std::mutex mutex;
+    std::condition_variable notified;
+    uint32_t notifications = 0;
+    
+    // Time spent awake between two waits, for the statistics
+    std::chrono::steady_clock::time_point wakeTime;
+    bool awake = false;
+    uint32_t wakes = 0;
+    int64_t totalBusyUs = 0;
+    int64_t maxBusyUs = 0;
+};
+
+// Queue of fixed size items
+struct NativeQueue {
+    size_t length;
+    size_t itemSize;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t>> items;
+};
+
+namespace {
+    // Tasks are never deleted, the list keeps their addresses stable
+    std::mutex tasksMutex;
+    std::list<NativeTask> tasks;
+    
+    thread_local NativeTask* currentTask = nullptr;
+    
+    /**
+     * Wait on a condition for a number of ticks of the virtual clock
+     * @return Result of the predicate
+     */
+    template <typename Predicate>
+    bool waitTicks(std::condition_variable& condition, std::unique_lock<std::mutex>& lock,
+                   TickType_t ticks, Predicate predicate) {
+        if (ticks == portMAX_DELAY) {
+            condition.wait(lock, predicate);
+            return true;
+        }
+        int64_t end = NativeHal::now() + static_cast<int64_t>(ticks) * portTICK_PERIOD_MS * 1000;
+        return condition.wait_until(lock, NativeHal::toHostTime(end), predicate);
+    }
+    
+    /**
+     * Account for the time the current task spent awake
+     */
+    void endBusy(NativeTask& task) {
+        if (!task.awake) {
+            return;
+        }
+        int64_t busyUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - task.wakeTime).count();
+        task.totalBusyUs += busyUs;
+        task.maxBusyUs = std::max(task.maxBusyUs, busyUs);
+        task.awake = false;
+    }
+    
+    void startBusy(NativeTask& task) {
+        task.wakeTime = std::chrono::steady_clock::now();
+        task.awake = true;
+        task.wakes++;
+    }
+}
+
+namespace NativeHal {
+    std::vector<TaskStats> getTaskStats() {
+        std::vector<TaskStats> stats;
+        std::lock_guard<std::mutex> lock(tasksMutex);
+        for (NativeTask& task : tasks) {
+            std::lock_guard<std::mutex> taskLock(task.mutex);
+            stats.push_back({task.name, task.wakes, task.totalBusyUs, task.maxBusyUs});
+        }
+        return stats;
+    }
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackSize,
+                                   void* parameter, UBaseType_t priority, TaskHandle_t* handle,
+                                   BaseType_t core) {
+    (void)priority;
+    (void)core;
+    
+    NativeTask* task;
+    {
+        std::lock_guard<std::mutex> lock(tasksMutex);
+        tasks.emplace_back();
+        task = &tasks.back();
+        task->name = name;
+        task->stackSize = stackSize;
+    }
+    if (handle) {
+        *handle = task;
+    }
+    
+    std::thread([task, function, parameter]() {
+        currentTask = task;
+        function(parameter);
+    }).detach();
+    return pdPASS;
+}
+
+TickType_t xTaskGetTickCount() {
+    return static_cast<TickType_t>(NativeHal::now() / 1000 / portTICK_PERIOD_MS);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    NativeHal::sleepUntil(NativeHal::now() + static_cast<int64_t>(ticks) * portTICK_PERIOD_MS * 1000);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait) {
+    if (!currentTask) {
+        return 0; // Not called from a task
+    }
+    NativeTask& task = *currentTask;
+    std::unique_lock<std::mutex> lock(task.mutex);
+    endBusy(task);
+    
+    waitTicks(task.notified, lock, ticksToWait, [&task]() { return task.notifications > 0; });
+    uint32_t value = task.notifications;
+    if (value > 0) {
+        task.notifications = clearOnExit ? 0 : value - 1;
+    }
+    
+    startBusy(task);
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    {
+        std::lock_guard<std::mutex> lock(task->mutex);
+        task->notifications++;
+    }
+    task->notified.notify_one();
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPriorityTaskWoken) {
+    xTaskNotifyGive(task);
+    if (higherPriorityTaskWoken) {
+        *higherPriorityTaskWoken = pdFALSE;
+    }
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    if (!task) {
+        task = currentTask;
+    }
+    return task ? task->stackSize : 0;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    NativeQueue* queue = new NativeQueue();
+    queue->length = length;
+    queue->itemSize = itemSize;
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticksToWait) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!waitTicks(queue->changed, lock, ticksToWait, [queue]() { return queue->items.size() < queue->length; })) {
+        return pdFALSE;
+    }
+    const uint8_t* bytes = static_cast<const uint8_t*>(item);
+    queue->items.emplace_back(bytes, bytes + queue->itemSize);
+    lock.unlock();
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void* item, BaseType_t* higherPriorityTaskWoken) {
+    if (higherPriorityTaskWoken) {
+        *higherPriorityTaskWoken = pdFALSE;
+    }
+    return xQueueSend(queue, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticksToWait) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!waitTicks(queue->changed, lock, ticksToWait, [queue]() { return !queue->items.empty(); })) {
+        return pdFALSE;
+    }
+    memcpy(item, queue->items.front().data(), queue->itemSize);
+    queue->items.pop_front();
+    lock.unlock();
+    queue->changed.notify_all();
+    return pdTRUE;
+}
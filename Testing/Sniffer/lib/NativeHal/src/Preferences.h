@@ -0,0 +1,31 @@
+#ifndef NATIVE_PREFERENCES_H
+#define NATIVE_PREFERENCES_H
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+
+/**
+ * NVS namespace, kept in a text file of a host directory so that it survives
+ * the runs like the NVS partition survives reboots
+ * Only the unsigned integer values of the ESP32 API are supported.
+ */
+class Preferences {
+public:
+    /**
+     * Set the host directory holding the namespaces (default _native/nvs)
+     */
+    static void setRoot(const std::string& directory);
+    
+    bool begin(const char* name, bool readOnly = false);
+    void end();
+    uint32_t getUInt(const char* key, uint32_t defaultValue = 0);
+    size_t putUInt(const char* key, uint32_t value);
+
+private:
+    std::string path; // Host file of the namespace, empty until begin()
+    bool readOnly = false;
+    std::map<std::string, uint32_t> values;
+};
+
+#endif // NATIVE_PREFERENCES_H
@@ -0,0 +1,25 @@
+#ifndef NATIVE_SD_H
+#define NATIVE_SD_H
+
+#include <FS.h>
+
+/**
+ * SD card in a host directory, which can be removed (NativeHal::setCardPresent)
+ */
+class SDFS : public NativeFS {
+public:
+    SDFS() : NativeFS("_native/sd") {}
+    
+    bool begin(uint8_t ssPin = 0);
+    void end();
+
+protected:
+    bool isAvailable() const override;
+
+private:
+    uint32_t insertion = 0; // Card insertion mounted
+};
+
+extern SDFS SD;
+
+#endif // NATIVE_SD_H
@@ -0,0 +1,12 @@
+#ifndef NATIVE_ESP_CPU_H
+#define NATIVE_ESP_CPU_H
+
+#include <cstdint>
+
+/**
+ * Get the CPU cycle counter, from the host clock at 240MHz
+ * Measures host time, the virtual clock stands still in the simulated interrupt
+ */
+uint32_t esp_cpu_get_cycle_count();
+
+#endif // NATIVE_ESP_CPU_H
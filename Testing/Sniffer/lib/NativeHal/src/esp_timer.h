@@ -0,0 +1,12 @@
+#ifndef NATIVE_ESP_TIMER_H
+#define NATIVE_ESP_TIMER_H
+
+#include <cstdint>
+
+/**
+ * Get the virtual clock, in microseconds
+ * In the simulated interrupt, the time of the edge being injected
+ */
+int64_t esp_timer_get_time();
+
+#endif // NATIVE_ESP_TIMER_H
@@ -0,0 +1,34 @@
+#ifndef NATIVE_FREERTOS_H
+#define NATIVE_FREERTOS_H
+
+#include <cstdint>
+#include <cstddef>
+
+// FreeRTOS types and constants used by the firmware, ticks are milliseconds
+// of the virtual clock
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define portMAX_DELAY 0xFFFFFFFFUL
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) (static_cast<TickType_t>(ms))
+
+// Interrupts run on the replay thread, no context switch to request
+#define portYIELD_FROM_ISR(...)
+
+/**
+ * Check if the caller is the simulated interrupt
+ */
+BaseType_t xPortInIsrContext();
+
+/**
+ * Get the core of the caller, always 0 on the host
+ */
+BaseType_t xPortGetCoreID();
+
+#endif // NATIVE_FREERTOS_H
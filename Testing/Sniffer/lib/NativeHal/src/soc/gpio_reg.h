@@ -0,0 +1,10 @@
+#ifndef NATIVE_GPIO_REG_H
+#define NATIVE_GPIO_REG_H
+
+#include "soc/soc.h"
+
+// GPIO input levels, pins 0-31 and 32-39 (ESP32 addresses)
+#define GPIO_IN_REG 0x3FF4403C
+#define GPIO_IN1_REG 0x3FF44040
+
+#endif // NATIVE_GPIO_REG_H
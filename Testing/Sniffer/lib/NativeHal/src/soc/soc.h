@@ -0,0 +1,9 @@
+#ifndef NATIVE_SOC_H
+#define NATIVE_SOC_H
+
+#include "NativeHal.h"
+
+// Register reads, served from the simulated pins
+#define REG_READ(reg) NativeHal::readRegister(reg)
+
+#endif // NATIVE_SOC_H
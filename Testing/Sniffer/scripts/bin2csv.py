@@ -0,0 +1,169 @@
+import csv
+import struct
+import warnings
+import zlib
+from itertools import islice
+from pathlib import Path
+from typing import BinaryIO, Iterator
+
+import click
+
+# pyright: strict
+
+# Must match SignalType in include/Config.h
+SIGNALS: list[str] = [
+    "RF",
+    "MU",
+    "PON",
+    "BA",
+    "BR",
+]
+EDGES: list[str] = ["R", "F"]
+# Must match RecordType in include/LogRecord.h
+RECORDS: list[str] = [
+    "HF",
+    "DCF",
+    "SS",
+    "PH",
+    "PM",
+    "EM",
+    "TR",
+    "SE",
+]
+
+# Must match BinaryLog in include/BinaryLog.h
+MAGIC = b"GCLB"
+VERSIONS = [1, 2]  # 2: records
+FLAG_MICROSECONDS = 0x01
+EDGE_BITS = 1
+SIGNAL_BITS = 4
+DELTA_SHIFT = EDGE_BITS + SIGNAL_BITS
+SIGNAL_RECORD = (1 << SIGNAL_BITS) - 1
+HEADER = struct.Struct("<4sBBHIHHI")
+CRC_OFFSET = HEADER.size - 4
+
+
+class Block:
+    def __init__(self, header: bytes, payload: bytes):
+        (
+            _magic,
+            self.version,
+            self.flags,
+            self.count,
+            self.timestamp,
+            self.micros,
+            _size,
+            self.crc,
+        ) = HEADER.unpack(header)
+        self.header = header
+        self.payload = payload
+
+    @property
+    def highres(self) -> bool:
+        return bool(self.flags & FLAG_MICROSECONDS)
+
+    def valid(self) -> bool:
+        crc = zlib.crc32(self.header[:CRC_OFFSET])
+        return zlib.crc32(self.payload, crc) == self.crc
+
+    def varints(self) -> Iterator[int]:
+        value, shift = 0, 0
+        for byte in self.payload:
+            value |= (byte & 0x7F) << shift
+            shift += 7
+            if byte & 0x80:
+                continue
+            yield value
+            value, shift = 0, 0
+
+    def events(self) -> Iterator[tuple[str, str, int, int, list[int]]]:
+        """Decode the events and records as (signal, edge, millis, micros,
+        fields), records have an empty edge."""
+        # Work in the block's unit, then split back into millis/micros
+        scale = 1000 if self.highres else 1
+        time = self.timestamp * scale + (self.micros if self.highres else 0)
+        values = self.varints()
+        for value in values:
+            edge = value & ((1 << EDGE_BITS) - 1)
+            signal = (value >> EDGE_BITS) & ((1 << SIGNAL_BITS) - 1)
+            time += value >> DELTA_SHIFT
+            millis, micros = divmod(time, scale)
+            # Timestamps are 32-bit millis() values on the device
+            millis &= 0xFFFFFFFF
+            if signal == SIGNAL_RECORD and self.version >= 2:
+                rtype = next(values)
+                count = next(values)
+                # Zigzag-encoded fields
+                fields = [(v >> 1) ^ -(v & 1) for v in islice(values, count)]
+                name = RECORDS[rtype] if rtype < len(RECORDS) else "UR"
+                yield name, "", millis, micros, fields
+            else:
+                name = SIGNALS[signal] if signal < len(SIGNALS) else "UN"
+                yield name, EDGES[edge], millis, micros, []
+
+
+def blocks(binfile: BinaryIO) -> Iterator[Block]:
+    """Read the blocks, skipping corrupted ones."""
+    data = binfile.read()
+    offset = 0
+    while offset + HEADER.size <= len(data):
+        if data[offset : offset + 4] != MAGIC:
+            # Resynchronize on the next block
+            next_offset = data.find(MAGIC, offset + 1)
+            warnings.warn(f"Garbage at offset {offset}")
+            if next_offset < 0:
+                return
+            offset = next_offset
+            continue
+        header = data[offset : offset + HEADER.size]
+        size = HEADER.unpack(header)[6]
+        end = offset + HEADER.size + size
+        block = Block(header, data[offset + HEADER.size : end])
+        if block.version not in VERSIONS:
+            warnings.warn(f"Unknown block version {block.version}")
+        elif end > len(data) or not block.valid():
+            warnings.warn(f"Bad CRC for block at offset {offset}")
+        else:
+            yield block
+            offset = end
+            continue
+        offset += 1
+
+
+def convert(binin: Path, csvout: Path) -> None:
+    with binin.open("rb") as binfile, csvout.open("w", newline="") as csvfile:
+        writer = csv.writer(csvfile)
+        header_written = False
+        for block in blocks(binfile):
+            if not header_written:
+                columns = ["Signal", "Edge", "Timestamp"]
+                if block.highres:
+                    columns.append("Micros")
+                writer.writerow(columns)
+                header_written = True
+            for signal, edge, millis, micros, fields in block.events():
+                # Record fields follow the timestamp
+                if block.highres:
+                    writer.writerow([signal, edge, millis, micros, *fields])
+                else:
+                    writer.writerow([signal, edge, millis, *fields])
+
+
+@click.command()
+@click.argument("binin", type=click.Path(exists=True, dir_okay=False))
+@click.argument(
+    "csvout", type=click.Path(dir_okay=False), default=None, required=False
+)
+def main(binin: str, csvout: str | None) -> None:
+    """Convert a binary log file to CSV format."""
+    pbinin = Path(binin)
+    if csvout is None:
+        pcsvout = pbinin.with_suffix(".csv")
+    else:
+        pcsvout = Path(csvout)
+    convert(pbinin, pcsvout)
+
+
+if __name__ == "__main__":
+    main()
+# vim: set filetype=python:
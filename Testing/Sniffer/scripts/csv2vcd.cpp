@@ -0,0 +1,591 @@
+/**
+ * Native CSV to VCD converter, a faster csv2vcd.py for long captures.
+ *
+ * The CSV file is memory-mapped and parsed in place, the VCD is written
+ * through a large buffer. Like csv2vcd.py, the session records (SE) of the
+ * log place the rows on a single timeline. For logs without them, timestamp
+ * resets (reboots) and millis wraps are stitched into a single timeline by
+ * default, with a $comment at each seam. With --split, a new file is started
+ * at each reset instead, like csv2vcd.py, and the output is the same as
+ * PyVCD's byte for byte (no $comment is written).
+ *
+ * Build (Linux, macOS):
+ *   g++ -O2 -std=c++17 -o csv2vcd scripts/csv2vcd.cpp
+ * Usage:
+ *   csv2vcd [--split] CSVIN [VCDOUT]
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    // Wires of the VCD, in PyVCD registration order (identifiers 0-4)
+    // Must match the names in Signals::TABLE (include/Config.h)
+    constexpr const char* WIRES[] = {"RF", "BA", "PON", "MU", "BR"};
+    constexpr size_t NUM_WIRES = sizeof(WIRES) / sizeof(WIRES[0]);
+    
+    // Session records, Boot,Epoch,Reason,UnixTime (include/SessionTracker.h)
+    constexpr std::string_view SESSION = "SE";
+    
+    // Output buffer, written out when full
+    constexpr size_t OUTPUT_BUFFER_SIZE = 4 * 1024 * 1024;
+    
+    // millis() and the esp_timer based timestamps wrap after 2^32 ms
+    constexpr uint64_t WRAP_MS = 1ULL << 32;
+    
+    // A reset this close to the wrap, to a timestamp this small, is a wrap
+    constexpr uint64_t WRAP_WINDOW_MS = 60000;
+    
+    // Gap inserted at a reboot seam or between two boots, in milliseconds
+    constexpr uint64_t SEAM_GAP_MS = 1000;
+    
+    constexpr size_t MAX_COLUMNS = 16;
+    
+    /**
+     * Print a warning once per message, like Python's warnings module
+     */
+    void warn(const std::string& message) {
+        static std::set<std::string> shown;
+        if (shown.insert(message).second) {
+            fprintf(stderr, "Warning: %s\n", message.c_str());
+        }
+    }
+    
+    /**
+     * Read-only memory mapping of a whole file
+     */
+    class MappedFile {
+    public:
+        ~MappedFile() {
+            if (data != nullptr) {
+                munmap(const_cast<char*>(data), size);
+            }
+        }
+        
+        /**
+         * Map a file
+         * @param path File to map
+         * @return true if mapped (an empty file maps to no data)
+         */
+        bool open(const char* path) {
+            int fd = ::open(path, O_RDONLY);
+            if (fd < 0) {
+                return false;
+            }
+            struct stat info;
+            if (fstat(fd, &info) != 0) {
+                close(fd);
+                return false;
+            }
+            size = static_cast<size_t>(info.st_size);
+            if (size > 0) {
+                void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapping == MAP_FAILED) {
+                    close(fd);
+                    return false;
+                }
+                madvise(mapping, size, MADV_SEQUENTIAL);
+                data = static_cast<const char*>(mapping);
+            }
+            close(fd);
+            return true;
+        }
+        
+        const char* begin() const { return data; }
+        const char* end() const { return data + size; }
+    
+    private:
+        const char* data = nullptr;
+        size_t size = 0;
+    };
+    
+    /**
+     * Buffered output file
+     */
+    class OutputFile {
+    public:
+        OutputFile() : buffer(new char[OUTPUT_BUFFER_SIZE]) {}
+        
+        ~OutputFile() {
+            close();
+            delete[] buffer;
+        }
+        
+        bool open(const std::string& path) {
+            fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            return fd >= 0;
+        }
+        
+        /**
+         * Write out the buffer and close the file
+         * @return true if everything was written
+         */
+        bool close() {
+            if (fd < 0) {
+                return ok;
+            }
+            flush();
+            ok = ::close(fd) == 0 && ok;
+            fd = -1;
+            return ok;
+        }
+        
+        void write(std::string_view text) {
+            if (length + text.size() > OUTPUT_BUFFER_SIZE) {
+                flush();
+            }
+            memcpy(buffer + length, text.data(), text.size());
+            length += text.size();
+        }
+        
+        void write(char c) {
+            if (length == OUTPUT_BUFFER_SIZE) {
+                flush();
+            }
+            buffer[length++] = c;
+        }
+        
+        void write(uint64_t value) {
+            char digits[20];
+            size_t numDigits = 0;
+            do {
+                digits[numDigits++] = static_cast<char>('0' + value % 10);
+                value /= 10;
+            } while (value > 0);
+            if (length + numDigits > OUTPUT_BUFFER_SIZE) {
+                flush();
+            }
+            while (numDigits > 0) {
+                buffer[length++] = digits[--numDigits];
+            }
+        }
+    
+    private:
+        char* buffer;
+        size_t length = 0;
+        int fd = -1;
+        bool ok = true;
+        
+        void flush() {
+            const char* data = buffer;
+            while (length > 0 && ok) {
+                ssize_t written = ::write(fd, data, length);
+                if (written <= 0) {
+                    ok = false;
+                    break;
+                }
+                data += written;
+                length -= static_cast<size_t>(written);
+            }
+            length = 0;
+        }
+    };
+    
+    /**
+     * VCD writer producing the same output as PyVCD's VCDWriter, for the
+     * scalar wires of csv2vcd.py
+     */
+    class VcdWriter {
+    public:
+        VcdWriter(OutputFile& file, bool highResolution) : output(file), highres(highResolution) {}
+        
+        /**
+         * Change the value of a wire, writing the header first
+         * @param wire Index of the wire in WIRES
+         * @param time Time of the change, not before the previous one
+         * @param value New value
+         */
+        void change(size_t wire, uint64_t time, uint8_t value) {
+            if (!headerWritten) {
+                writeHeader();
+            }
+            if (values[wire] == value) {
+                return; // PyVCD leaves out unchanged values
+            }
+            if (time > currentTime) {
+                output.write('#');
+                output.write(time);
+                output.write('\n');
+                currentTime = time;
+            }
+            values[wire] = value;
+            output.write(static_cast<char>('0' + value));
+            output.write(static_cast<char>('0' + wire));
+            output.write('\n');
+        }
+        
+        /**
+         * Write a comment among the value changes
+         */
+        void comment(const std::string& text) {
+            if (!headerWritten) {
+                writeHeader();
+            }
+            output.write("$comment ");
+            output.write(text);
+            output.write(" $end\n");
+        }
+        
+        /**
+         * End the file, writing the header if there was no change
+         */
+        void close() {
+            if (!headerWritten) {
+                writeHeader();
+            }
+        }
+    
+    private:
+        OutputFile& output;
+        bool highres;
+        bool headerWritten = false;
+        uint64_t currentTime = 0;
+        uint8_t values[NUM_WIRES] = {};
+        
+        void writeHeader() {
+            output.write("$date today $end\n");
+            output.write(highres ? "$timescale 1 us $end\n" : "$timescale 1 ms $end\n");
+            output.write("$scope module TFA $end\n");
+            for (size_t i = 0; i < NUM_WIRES; i++) {
+                output.write("$var wire 1 ");
+                output.write(static_cast<char>('0' + i));
+                output.write(' ');
+                output.write(WIRES[i]);
+                output.write(" $end\n");
+            }
+            output.write("$upscope $end\n$enddefinitions $end\n#0\n$dumpvars\n");
+            for (size_t i = 0; i < NUM_WIRES; i++) {
+                output.write('0');
+                output.write(static_cast<char>('0' + i));
+                output.write('\n');
+            }
+            output.write("$end\n");
+            headerWritten = true;
+        }
+    };
+    
+    /**
+     * Split the next line of the CSV file into fields, without copying
+     * @param cursor Start of the line, moved to the next one
+     * @param end End of the file
+     * @param fields Set to the fields of the line, missing ones empty
+     * @return Number of fields on the line, 0 for an empty line
+     */
+    size_t nextLine(const char*& cursor, const char* end, std::string_view (&fields)[MAX_COLUMNS]) {
+        const char* newline = static_cast<const char*>(memchr(cursor, '\n', end - cursor));
+        const char* lineEnd = newline != nullptr ? newline : end;
+        const char* next = newline != nullptr ? newline + 1 : end;
+        if (lineEnd > cursor && lineEnd[-1] == '\r') {
+            lineEnd--;
+        }
+        
+        size_t numFields = 0;
+        const char* field = cursor;
+        if (lineEnd > cursor) {
+            while (true) {
+                const char* comma = static_cast<const char*>(memchr(field, ',', lineEnd - field));
+                const char* fieldEnd = comma != nullptr ? comma : lineEnd;
+                if (numFields < MAX_COLUMNS) {
+                    fields[numFields] = std::string_view(field, fieldEnd - field);
+                }
+                numFields++;
+                if (comma == nullptr) {
+                    break;
+                }
+                field = comma + 1;
+            }
+        }
+        for (size_t i = numFields; i < MAX_COLUMNS; i++) {
+            fields[i] = std::string_view();
+        }
+        
+        cursor = next;
+        return numFields;
+    }
+    
+    /**
+     * Parse a decimal number
+     * @return true if the field holds a number
+     */
+    bool parseNumber(std::string_view field, uint64_t& value) {
+        if (field.empty()) {
+            return false;
+        }
+        value = 0;
+        for (char c : field) {
+            if (c < '0' || c > '9') {
+                return false;
+            }
+            value = value * 10 + static_cast<uint64_t>(c - '0');
+        }
+        return true;
+    }
+    
+    /**
+     * Parse the time of a row
+     * @param time Set to the time, in microseconds with a Micros column else
+     *   milliseconds
+     * @return true if the row holds a valid time
+     */
+    bool parseTime(const std::string_view (&fields)[MAX_COLUMNS], int timestampColumn, int microsColumn,
+                   uint64_t& time) {
+        uint64_t timestamp;
+        uint64_t micros = 0;
+        std::string_view microsField = microsColumn >= 0 ? fields[microsColumn] : std::string_view();
+        if (!parseNumber(fields[timestampColumn], timestamp)
+            || (!microsField.empty() && !parseNumber(microsField, micros))) {
+            return false;
+        }
+        time = timestamp * (microsColumn >= 0 ? 1000 : 1) + micros;
+        return true;
+    }
+    
+    int findColumn(const std::string_view (&fields)[MAX_COLUMNS], size_t numFields, std::string_view name) {
+        for (size_t i = 0; i < numFields && i < MAX_COLUMNS; i++) {
+            if (fields[i] == name) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+    
+    int findWire(std::string_view name) {
+        for (size_t i = 0; i < NUM_WIRES; i++) {
+            if (name == WIRES[i]) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+    
+    /**
+     * Path of the output file of a chunk, like Path.with_stem() in csv2vcd.py
+     */
+    std::string chunkPath(const std::string& path, size_t chunk) {
+        if (chunk == 0) {
+            return path;
+        }
+        size_t nameStart = path.find_last_of('/');
+        nameStart = nameStart == std::string::npos ? 0 : nameStart + 1;
+        size_t dot = path.find_last_of('.');
+        if (dot == std::string::npos || dot <= nameStart) {
+            dot = path.size();
+        }
+        return path.substr(0, dot) + "_" + std::to_string(chunk) + path.substr(dot);
+    }
+    
+    /**
+     * Default output path, like Path.with_suffix(".vcd") in csv2vcd.py
+     */
+    std::string defaultOutputPath(const std::string& path) {
+        size_t nameStart = path.find_last_of('/');
+        nameStart = nameStart == std::string::npos ? 0 : nameStart + 1;
+        size_t dot = path.find_last_of('.');
+        if (dot == std::string::npos || dot <= nameStart) {
+            dot = path.size();
+        }
+        return path.substr(0, dot) + ".vcd";
+    }
+    
+    int convert(const char* csvPath, const std::string& vcdPath, bool split) {
+        MappedFile input;
+        if (!input.open(csvPath)) {
+            fprintf(stderr, "Error: cannot read %s: %s\n", csvPath, strerror(errno));
+            return 1;
+        }
+        const char* cursor = input.begin();
+        const char* end = input.end();
+        
+        // Columns, from the header
+        std::string_view fields[MAX_COLUMNS];
+        size_t numFields = 0;
+        while (cursor < end && numFields == 0) {
+            numFields = nextLine(cursor, end, fields);
+        }
+        if (numFields == 0) {
+            return 0; // Empty file, nothing to convert
+        }
+        int signalColumn = findColumn(fields, numFields, "Signal");
+        int edgeColumn = findColumn(fields, numFields, "Edge");
+        int timestampColumn = findColumn(fields, numFields, "Timestamp");
+        int microsColumn = findColumn(fields, numFields, "Micros");
+        if (signalColumn < 0 || edgeColumn < 0 || timestampColumn < 0) {
+            fprintf(stderr, "Error: %s lacks the Signal, Edge and Timestamp columns\n", csvPath);
+            return 1;
+        }
+        
+        // Fields of the records come after the columns of the header
+        size_t numColumns = numFields;
+        
+        // High resolution captures carry the sub-millisecond part separately
+        bool highres = microsColumn >= 0;
+        uint64_t unitsPerMs = highres ? 1000 : 1;
+        
+        OutputFile output;
+        std::optional<VcdWriter> writer;
+        size_t chunk = 0;
+        size_t lineNumber = 1;
+        bool hasTime = false;
+        uint64_t previousTime = 0; // As logged
+        uint64_t offset = 0;       // Added to the logged times when stitching
+        uint64_t lastTime = 0;     // On the timeline
+        bool sessions = false;     // Session records seen, placing the rows
+        std::string boot;          // Boot counter of the last session record
+        uint64_t bootOffset = 0;   // Time of the boot on the timeline
+        std::string sessionComment; // Session record read before the first edge
+        int result = 0;
+        
+        while (cursor < end) {
+            numFields = nextLine(cursor, end, fields);
+            lineNumber++;
+            if (numFields == 0) {
+                continue;
+            }
+            
+            // Keep the rows of known wires and edges, skipping decoded records
+            std::string_view signal = fields[signalColumn];
+            std::string_view edge = fields[edgeColumn];
+            if (signal == SESSION) {
+                uint64_t time;
+                uint64_t epoch;
+                if (numColumns + 2 > MAX_COLUMNS
+                    || !parseTime(fields, timestampColumn, microsColumn, time)
+                    || !parseNumber(fields[numColumns + 1], epoch)) {
+                    warn("Invalid session record at line " + std::to_string(lineNumber));
+                    continue;
+                }
+                uint64_t epochTime = epoch * WRAP_MS * unitsPerMs;
+                if (!sessions || fields[numColumns] != boot) {
+                    // A new boot continues after the last edge
+                    bootOffset = hasTime ? lastTime + SEAM_GAP_MS * unitsPerMs - epochTime - time : 0;
+                    boot = std::string(fields[numColumns]);
+                }
+                offset = bootOffset + epochTime;
+                sessions = true;
+                if (!split) {
+                    std::string_view unixTime = numColumns + 3 < MAX_COLUMNS ? fields[numColumns + 3] : "";
+                    sessionComment = "Session record at line " + std::to_string(lineNumber) + ": boot " + boot
+                        + ", epoch " + std::to_string(epoch) + ", Unix time " + std::string(unixTime)
+                        + ", shifted by " + std::to_string(static_cast<int64_t>(offset));
+                    if (writer) {
+                        writer->comment(sessionComment);
+                        sessionComment.clear();
+                    }
+                }
+                continue;
+            }
+            int wire = findWire(signal);
+            if (wire < 0) {
+                // Records have no edge (see include/LogRecord.h)
+                if (!edge.empty()) {
+                    warn("Unknown wire: " + std::string(signal));
+                }
+                continue;
+            }
+            if (edge != "R" && edge != "F") {
+                warn("Unknown edge: " + std::string(edge));
+                continue;
+            }
+            
+            uint64_t time;
+            if (!parseTime(fields, timestampColumn, microsColumn, time)) {
+                fprintf(stderr, "Error: %s:%zu: invalid timestamp\n", csvPath, lineNumber);
+                result = 1;
+                break;
+            }
+            
+            if (sessions) {
+                // Placed by the session records
+                if (hasTime && time + offset < lastTime) {
+                    warn("Out of order timestamp: " + std::to_string(time + offset));
+                }
+            } else if (hasTime && time < previousTime) {
+                warn("Out of order timestamp: " + std::to_string(time));
+                if (split) {
+                    // New file, like csv2vcd.py
+                    writer->close();
+                    writer.reset();
+                    if (!output.close()) {
+                        break;
+                    }
+                    chunk++;
+                } else {
+                    bool wrapped = previousTime >= (WRAP_MS - WRAP_WINDOW_MS) * unitsPerMs
+                        && time < WRAP_WINDOW_MS * unitsPerMs;
+                    uint64_t stitchedPrevious = previousTime + offset;
+                    if (wrapped) {
+                        offset += WRAP_MS * unitsPerMs;
+                    } else {
+                        offset = stitchedPrevious + SEAM_GAP_MS * unitsPerMs - time;
+                    }
+                    writer->comment(std::string(wrapped ? "Timestamp wrap" : "Timestamp reset (reboot)")
+                        + " at line " + std::to_string(lineNumber) + ": " + std::to_string(time)
+                        + " after " + std::to_string(previousTime) + ", shifted by " + std::to_string(offset));
+                }
+            }
+            previousTime = time;
+            hasTime = true;
+            
+            if (!writer) {
+                std::string path = chunkPath(vcdPath, chunk);
+                if (!output.open(path)) {
+                    fprintf(stderr, "Error: cannot write %s: %s\n", path.c_str(), strerror(errno));
+                    return 1;
+                }
+                writer.emplace(output, highres);
+            }
+            if (!sessionComment.empty()) {
+                writer->comment(sessionComment);
+                sessionComment.clear();
+            }
+            lastTime = std::max(lastTime, time + offset);
+            writer->change(static_cast<size_t>(wire), time + offset, edge == "R" ? 1 : 0);
+        }
+        
+        if (writer) {
+            writer->close();
+        }
+        if (!output.close()) {
+            fprintf(stderr, "Error: cannot write %s\n", chunkPath(vcdPath, chunk).c_str());
+            result = 1;
+        }
+        return result;
+    }
+}
+
+int main(int argc, char** argv) {
+    bool split = false;
+    const char* paths[2] = {nullptr, nullptr};
+    size_t numPaths = 0;
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--split") == 0) {
+            split = true;
+        } else if (argv[i][0] == '-' || numPaths == 2) {
+            numPaths = 3; // Usage error
+            break;
+        } else {
+            paths[numPaths++] = argv[i];
+        }
+    }
+    if (numPaths == 0 || numPaths > 2) {
+        fprintf(stderr, "Usage: %s [--split] CSVIN [VCDOUT]\n", argv[0]);
+        fprintf(stderr, "Convert a CSV file to VCD format.\n");
+        return 2;
+    }
+    
+    std::string vcdPath = paths[1] != nullptr ? paths[1] : defaultOutputPath(paths[0]);
+    return convert(paths[0], vcdPath, split);
+}
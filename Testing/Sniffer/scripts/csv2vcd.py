@@ -1,5 +1,5 @@
 import csv
-from typing import cast
+from typing import Iterable, Iterator, cast
 import warnings
 from pathlib import Path
 
@@ -12,29 +12,112 @@ from vcd.common import VarType
 # pyright: strict
 # pyright: reportUnknownMemberType=false
 
+# Must match the names in Signals::TABLE (include/Config.h)
 WIRES: list[str] = [
     "RF",
     "BA",
     "PON",
     "MU",
+    "BR",
 ]
 
+# Session records, Boot,Epoch,Reason,UnixTime (include/SessionTracker.h)
+SESSION = "SE"
+WRAP_MS = 1 << 32
+# Gap between two boots on the timeline, in milliseconds
+BOOT_GAP_MS = 1000
+
+
+def rowtime(row: dict[str, str], highres: bool) -> int:
+    """Timestamp of a row, in microseconds if highres else milliseconds."""
+    if highres:
+        return int(row["Timestamp"]) * 1000 + int(row["Micros"] or 0)
+    return int(row["Timestamp"])
+
+
+def edgerows(rows: Iterable[dict[str, str]]) -> Iterator[dict[str, str]]:
+    """Keep the rows of known wires and edges and the session records,
+    skipping the other decoded records."""
+    for row in rows:
+        if row["Signal"] == SESSION:
+            yield row
+            continue
+        if row["Signal"] not in WIRES:
+            # Records have no edge (see include/LogRecord.h)
+            if row["Edge"]:
+                warnings.warn(f"Unknown wire: {row['Signal']}")
+            continue
+        if row["Edge"] not in ["R", "F"]:
+            warnings.warn(f"Unknown edge: {row['Edge']}")
+            continue
+        yield row
+
+
+def timedrows(
+    rows: Iterable[dict[str, str]], highres: bool
+) -> Iterator[tuple[dict[str, str], int, bool]]:
+    """Edge rows with their time, and whether they start a new chunk.
+
+    From the first session record on, the rows are placed on a single
+    timeline: the millis() wraps counted by the records are added to the
+    timestamps, and a new boot starts BOOT_GAP_MS after the last edge. Logs
+    without session records get a new chunk at each timestamp going back.
+    """
+    unit = 1000 if highres else 1
+    sessions = False
+    boot = ""
+    base = 0  # Time of the boot on the timeline
+    epoch = 0
+    last: int | None = None
+    for row in edgerows(rows):
+        time = rowtime(row, highres)
+        if row["Signal"] == SESSION:
+            fields = cast(list[str], row.get("Fields") or [])
+            if len(fields) < 2:
+                warnings.warn(f"Short session record: {time}")
+                continue
+            epoch = int(fields[1]) * WRAP_MS * unit
+            if not sessions or fields[0] != boot:
+                # A new boot continues after the last edge
+                base = 0
+                if last is not None:
+                    base = last + BOOT_GAP_MS * unit - epoch - time
+            sessions = True
+            boot = fields[0]
+            continue
+        if sessions:
+            time += base + epoch
+            if last is not None and time < last:
+                warnings.warn(f"Out of order timestamp: {time}")
+                time = last
+            yield row, time, False
+        else:
+            restart = last is not None and time < last
+            if restart:
+                warnings.warn(f"Out of order timestamp: {time}")
+            yield row, time, restart
+        last = time
+
 
 def convert(csvin: Path, vcdout: Path) -> None:
     with csvin.open(newline="") as csvfile:
-        reader = csv.DictReader(csvfile)
+        # Fields of the records past the header
+        reader = csv.DictReader(csvfile, restkey="Fields")
+        # High resolution captures carry the sub-millisecond part separately
+        highres = "Micros" in (reader.fieldnames or [])
+        timescale = "1 us" if highres else "1 ms"
         chunk: int = 0
-        row = next(reader, None)
-        if row is None:
-            return
-        time: int = int(row["Timestamp"])
-        while row is not None:
+        rows = timedrows(reader, highres)
+        item = next(rows, None)
+        while item is not None:
             if chunk > 0:
                 chunkedvcdout = vcdout.with_stem(f"{vcdout.stem}_{chunk}")
             else:
                 chunkedvcdout = vcdout
             with chunkedvcdout.open("w") as vcd:
-                with VCDWriter(vcd, timescale="1 ms", date="today") as writer:
+                with VCDWriter(
+                    vcd, timescale=timescale, date="today"
+                ) as writer:
                     variables: dict[str, ScalarVariable] = {
                         wire: cast(
                             ScalarVariable,
@@ -45,29 +128,15 @@ def convert(csvin: Path, vcdout: Path) -> None:
                         for wire in WIRES
                     }
                     while True:
-                        wire = row["Signal"]
-                        var = variables.get(wire)
-                        if var is None:
-                            warnings.warn(f"Unknown wire: {wire}")
-                            continue
-                        if row["Edge"] not in ["R", "F"]:
-                            warnings.warn(f"Unknown edge: {row['Edge']}")
-                            continue
+                        row, time, _ = item
+                        var = variables[row["Signal"]]
                         value = 1 if row["Edge"] == "R" else 0
                         writer.change(var, time, value)
-                        row = next(reader, None)
-                        if row is None:
-                            break
-                        next_time = int(row["Timestamp"])
-                        if next_time < time:
-                            time = next_time
-                            chunk += 1
-                            warnings.warn(
-                                f"Out of order timestamp: {next_time}"
-                            )
-                            # Exit the loop to create a new file
+                        item = next(rows, None)
+                        # Exit the loop to create a new file
+                        if item is None or item[2]:
                             break
-                        time = next_time
+            chunk += 1
 
 
 @click.command()
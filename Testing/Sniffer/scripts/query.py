@@ -0,0 +1,209 @@
+import csv
+import io
+import struct
+import sys
+import warnings
+from dataclasses import dataclass
+from pathlib import Path
+from typing import BinaryIO, Iterator, TextIO
+
+import click
+
+from bin2csv import FLAG_MICROSECONDS, HEADER, RECORDS, SIGNALS, blocks
+
+# pyright: strict
+
+# Must match LogIndex::Entry in include/LogIndex.h
+ENTRY = struct.Struct("<IIIIIHH")
+INDEX_SUFFIX = ".idx"
+DATA_SUFFIXES = [".csv", ".bin"]
+ALL_BITS = 0xFFFF
+
+
+@dataclass
+class Region:
+    """Part of a data file, described by an index entry or not indexed."""
+
+    offset: int
+    length: int
+    indexed: bool = False
+    first: int = 0
+    last: int = 0
+    signals: int = ALL_BITS
+    records: int = ALL_BITS
+
+    def overlaps(self, start: int | None, end: int | None) -> bool:
+        # Not indexed, or across the millis() wrap: could hold anything
+        if not self.indexed or self.first > self.last:
+            return True
+        return (start is None or self.last >= start) and (
+            end is None or self.first <= end
+        )
+
+    def holds(self, signals: int, records: int) -> bool:
+        return bool(self.signals & signals or self.records & records)
+
+
+def regions(datafile: Path) -> list[Region]:
+    """Split a data file into the blocks of its index and the data between
+    them, which has to be scanned."""
+    size = datafile.stat().st_size
+    indexfile = datafile.with_suffix(INDEX_SUFFIX)
+    data = indexfile.read_bytes() if indexfile.exists() else b""
+    if len(data) % ENTRY.size:
+        warnings.warn(f"Truncated entry at the end of {indexfile}")
+    result: list[Region] = []
+    position = 0
+    for fields in ENTRY.iter_unpack(data[: len(data) - len(data) % ENTRY.size]):
+        offset, length, first, last, _count, signals, records = fields
+        if offset < position or offset + length > size:
+            warnings.warn(f"Bad entry in {indexfile}, scanning the rest")
+            break
+        if offset > position:
+            result.append(Region(position, offset - position))
+        result.append(Region(offset, length, True, first, last, signals, records))
+        position = offset + length
+    if position < size:
+        result.append(Region(position, size - position))
+    return result
+
+
+def csvrows(datafile: BinaryIO, region: Region) -> Iterator[list[str]]:
+    datafile.seek(region.offset)
+    text = datafile.read(region.length).decode(errors="replace")
+    for row in csv.reader(io.StringIO(text, newline="")):
+        # Header, or a line cut by a write error
+        if len(row) < 3 or not row[2].isdigit():
+            continue
+        yield row
+
+
+def binrows(datafile: BinaryIO, region: Region) -> Iterator[list[str]]:
+    datafile.seek(region.offset)
+    data = io.BytesIO(datafile.read(region.length))
+    for block in blocks(data):
+        for signal, edge, millis, micros, fields in block.events():
+            times = [millis, micros] if block.highres else [millis]
+            yield [signal, edge, *map(str, times), *map(str, fields)]
+
+
+def columns(datafile: BinaryIO, binary: bool) -> list[str]:
+    """Columns of a data file: its CSV header, or the ones bin2csv.py writes
+    for the resolution of its first block."""
+    datafile.seek(0)
+    if not binary:
+        return datafile.readline().decode().strip().split(",")
+    header = datafile.read(HEADER.size)
+    flags = HEADER.unpack(header)[2] if len(header) == HEADER.size else 0
+    highres = flags & FLAG_MICROSECONDS
+    return ["Signal", "Edge", "Timestamp", *(["Micros"] if highres else [])]
+
+
+def masks(names: tuple[str, ...]) -> tuple[int, int]:
+    """Index bits of signal and record names, everything if none."""
+    if not names:
+        return ALL_BITS, ALL_BITS
+    signals, records = 0, 0
+    for name in names:
+        if name in SIGNALS:
+            signals |= 1 << SIGNALS.index(name)
+        elif name in RECORDS:
+            records |= 1 << RECORDS.index(name)
+        else:
+            raise click.BadParameter(f"Unknown signal or record: {name}")
+    return signals, records
+
+
+def datafiles(paths: tuple[str, ...]) -> list[Path]:
+    """Data files given, or found in the directories given."""
+    result: list[Path] = []
+    for path in map(Path, paths):
+        if path.is_dir():
+            result.extend(
+                sorted(p for p in path.iterdir() if p.suffix in DATA_SUFFIXES)
+            )
+        else:
+            result.append(path)
+    return result
+
+
+def query(
+    files: list[Path],
+    start: int | None,
+    end: int | None,
+    names: tuple[str, ...],
+    out: TextIO,
+) -> None:
+    signals, records = masks(names)
+    writer = csv.writer(out)
+    header_written = False
+    read, total, scanned = 0, 0, 0
+    for datafile in files:
+        total += datafile.stat().st_size
+        binary = datafile.suffix == ".bin"
+        with datafile.open("rb") as data:
+            if not header_written:
+                writer.writerow(columns(data, binary))
+                header_written = True
+            for region in regions(datafile):
+                if not region.overlaps(start, end) or not region.holds(
+                    signals, records
+                ):
+                    continue
+                read += region.length
+                scanned += not region.indexed
+                rows = binrows(data, region) if binary else csvrows(data, region)
+                for row in rows:
+                    if names and row[0] not in names:
+                        continue
+                    time = int(row[2])
+                    if (start is None or time >= start) and (
+                        end is None or time <= end
+                    ):
+                        writer.writerow(row)
+    print(
+        f"Read {read // 1024} KB of {total // 1024} KB "
+        f"({scanned} parts not indexed)",
+        file=sys.stderr,
+    )
+
+
+@click.command()
+@click.argument("paths", nargs=-1, required=True, type=click.Path(exists=True))
+@click.option("--from", "start", type=int, help="First timestamp, in ms.")
+@click.option("--to", "end", type=int, help="Last timestamp, in ms.")
+@click.option(
+    "--signal",
+    "names",
+    multiple=True,
+    help="Signal or record to keep (BA, HF...), repeat for more.",
+)
+@click.option(
+    "--output", type=click.Path(dir_okay=False), help="CSV file, default stdout."
+)
+def main(
+    paths: tuple[str, ...],
+    start: int | None,
+    end: int | None,
+    names: tuple[str, ...],
+    output: str | None,
+) -> None:
+    """Extract the rows of data files between two timestamps, or of some
+    signals and records, reading only the blocks listed in their index
+    (.idx) that can hold them.
+
+    PATHS are data files (.csv or .bin) or directories holding them, as in
+    the /log directory of the SD card. Timestamps are millis() values of the
+    device, which restart at each boot (each data file by default).
+    """
+    files = datafiles(paths)
+    if output is None:
+        query(files, start, end, names, sys.stdout)
+    else:
+        with open(output, "w", newline="") as out:
+            query(files, start, end, names, out)
+
+
+if __name__ == "__main__":
+    main()
+# vim: set filetype=python:
@@ -0,0 +1,534 @@
+/**
+ * Receiver of the events streamed over the serial console (see
+ * include/SerialStreamer.h), writing them out as they arrive.
+ *
+ * The streaming is started on the device with the start command, sent at the
+ * console speed, after which the port is switched to the streaming speed. The
+ * frames are checked (COBS framing, CRC) and decoded to the usual
+ * "Signal,Edge,Timestamp[,Micros]" CSV, and optionally to VCD. Console text
+ * between the frames is copied to the standard error. On Ctrl-C or when the
+ * device goes away, the streaming is stopped and a summary printed: frames,
+ * events, CRC failures, frames lost (sequence gaps) and events dropped on the
+ * device.
+ *
+ * With --pty, a pseudo-terminal is created in place of the serial port, for
+ * the native build (see ReplayEngine.h) to stream into:
+ *   streamrecv --pty stream.csv             # prints /dev/pts/N
+ *   .pio/build/native/program --serial /dev/pts/N _data/data.csv
+ *
+ * Build (Linux, macOS):
+ *   g++ -O2 -std=c++17 -o streamrecv scripts/streamrecv.cpp
+ * Usage:
+ *   streamrecv [--vcd VCDOUT] (DEVICE | --pty) [CSVOUT]
+ */
+
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace {
+    // Must match StreamConfig in include/Config.h
+    constexpr speed_t CONSOLE_BAUD_RATE = B115200;
+    constexpr speed_t STREAM_BAUD_RATE = B921600;
+    constexpr char START_COMMAND = 'b';
+    constexpr char STOP_COMMAND = 'e';
+    
+    // Must match SerialStreamer in include/SerialStreamer.h
+    constexpr uint8_t FRAME_EVENTS = 1;
+    constexpr size_t FRAME_HEADER_SIZE = 7;
+    constexpr size_t CRC_SIZE = 4;
+    
+    // Must match BinaryLog in include/BinaryLog.h
+    constexpr uint8_t MAGIC[] = {'G', 'C', 'L', 'B'};
+    constexpr uint8_t VERSION = 2;
+    constexpr uint8_t FLAG_MICROSECONDS = 0x01;
+    constexpr uint8_t EDGE_BITS = 1;
+    constexpr uint8_t SIGNAL_BITS = 4;
+    constexpr uint8_t DELTA_SHIFT = EDGE_BITS + SIGNAL_BITS;
+    constexpr uint8_t SIGNAL_RECORD = (1 << SIGNAL_BITS) - 1;
+    constexpr size_t BLOCK_HEADER_SIZE = 20;
+    constexpr size_t MAX_BLOCK_SIZE = 512;
+    
+    // Must match the names in Signals::TABLE (include/Config.h)
+    constexpr const char* SIGNALS[] = {"RF", "MU", "PON", "BA", "BR"};
+    constexpr size_t NUM_SIGNALS = sizeof(SIGNALS) / sizeof(SIGNALS[0]);
+    
+    // Must match RecordType in include/LogRecord.h
+    constexpr const char* RECORDS[] = {"HF", "DCF", "SS", "PH", "PM", "EM", "TR", "SE"};
+    constexpr size_t NUM_RECORDS = sizeof(RECORDS) / sizeof(RECORDS[0]);
+    
+    // Wires of the VCD, in the order of csv2vcd (identifiers 0-4)
+    constexpr const char* WIRES[] = {"RF", "BA", "PON", "MU", "BR"};
+    constexpr size_t NUM_WIRES = sizeof(WIRES) / sizeof(WIRES[0]);
+    
+    // Largest frame, and longest console text kept between two delimiters
+    constexpr size_t MAX_FRAME_SIZE = FRAME_HEADER_SIZE + MAX_BLOCK_SIZE + CRC_SIZE;
+    constexpr size_t MAX_CHUNK_SIZE = 4096;
+    
+    // millis() wraps after 2^32 ms, a reset this close to it is a wrap
+    constexpr uint64_t WRAP_MS = 1ULL << 32;
+    constexpr uint64_t WRAP_WINDOW_MS = 60000;
+    
+    // Gap inserted at a reboot seam, in milliseconds
+    constexpr uint64_t SEAM_GAP_MS = 1000;
+    
+    volatile sig_atomic_t interrupted = 0;
+    
+    void onInterrupt(int) {
+        interrupted = 1;
+    }
+    
+    uint32_t crc32(const uint8_t* data, size_t length) {
+        uint32_t crc = 0xFFFFFFFF;
+        for (size_t i = 0; i < length; i++) {
+            crc ^= data[i];
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc >> 1) ^ (0xEDB88320 & (0U - (crc & 1)));
+            }
+        }
+        return ~crc;
+    }
+    
+    uint32_t readUint32(const uint8_t* data) {
+        return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+    }
+    
+    uint16_t readUint16(const uint8_t* data) {
+        return static_cast<uint16_t>(data[0] | (data[1] << 8));
+    }
+    
+    /**
+     * Decode a COBS frame, delimiters excluded
+     * @return false if the framing is invalid
+     */
+    bool decodeCobs(const std::vector<uint8_t>& encoded, std::vector<uint8_t>& decoded) {
+        decoded.clear();
+        size_t i = 0;
+        while (i < encoded.size()) {
+            uint8_t code = encoded[i++];
+            if (code == 0 || i + code - 1 > encoded.size()) {
+                return false;
+            }
+            decoded.insert(decoded.end(), encoded.begin() + i, encoded.begin() + i + code - 1);
+            i += code - 1;
+            
+            // Each group but the last and the full ones stood for a zero
+            if (code < 0xFF && i < encoded.size()) {
+                decoded.push_back(0);
+            }
+        }
+        return true;
+    }
+    
+    /**
+     * Check if a chunk between two delimiters is console text
+     */
+    bool isText(const std::vector<uint8_t>& chunk) {
+        for (uint8_t c : chunk) {
+            if ((c < 0x20 || c > 0x7E) && c != '\r' && c != '\n' && c != '\t') {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    /**
+     * VCD output, written as the events arrive. Timestamp resets (reboots) and
+     * millis() wraps are stitched into a single timeline, like csv2vcd.
+     */
+    class VcdWriter {
+    public:
+        VcdWriter(FILE* file, bool highResolution) : output(file), unitsPerMs(highResolution ? 1000 : 1) {
+            fprintf(output, "$date today $end\n");
+            fprintf(output, highResolution ? "$timescale 1 us $end\n" : "$timescale 1 ms $end\n");
+            fprintf(output, "$scope module TFA $end\n");
+            for (size_t i = 0; i < NUM_WIRES; i++) {
+                fprintf(output, "$var wire 1 %zu %s $end\n", i, WIRES[i]);
+            }
+            fprintf(output, "$upscope $end\n$enddefinitions $end\n#0\n$dumpvars\n");
+            for (size_t i = 0; i < NUM_WIRES; i++) {
+                fprintf(output, "0%zu\n", i);
+            }
+            fprintf(output, "$end\n");
+        }
+        
+        /**
+         * Change the value of a wire
+         * @param name Signal name, ignored if not a wire
+         * @param time Device time, in the unit of the timescale
+         * @param value New value
+         */
+        void change(const char* name, uint64_t time, uint8_t value) {
+            size_t wire = 0;
+            while (wire < NUM_WIRES && strcmp(WIRES[wire], name) != 0) {
+                wire++;
+            }
+            if (wire == NUM_WIRES) {
+                return;
+            }
+            
+            if (hasTime && time < previousTime) {
+                bool wrapped = previousTime >= (WRAP_MS - WRAP_WINDOW_MS) * unitsPerMs
+                    && time < WRAP_WINDOW_MS * unitsPerMs;
+                uint64_t stitchedPrevious = previousTime + offset;
+                offset = wrapped ? offset + WRAP_MS * unitsPerMs : stitchedPrevious + SEAM_GAP_MS * unitsPerMs - time;
+                fprintf(output, "$comment %s: %llu after %llu, shifted by %llu $end\n",
+                    wrapped ? "Timestamp wrap" : "Timestamp reset (reboot)", static_cast<unsigned long long>(time),
+                    static_cast<unsigned long long>(previousTime), static_cast<unsigned long long>(offset));
+            }
+            previousTime = time;
+            hasTime = true;
+            
+            if (values[wire] == value) {
+                return;
+            }
+            uint64_t stitched = time + offset;
+            if (stitched > currentTime) {
+                fprintf(output, "#%llu\n", static_cast<unsigned long long>(stitched));
+                currentTime = stitched;
+            }
+            values[wire] = value;
+            fprintf(output, "%u%zu\n", value, wire);
+        }
+    
+    private:
+        FILE* output;
+        uint64_t unitsPerMs;
+        bool hasTime = false;
+        uint64_t previousTime = 0;
+        uint64_t offset = 0;
+        uint64_t currentTime = 0;
+        uint8_t values[NUM_WIRES] = {};
+    };
+    
+    /**
+     * Frame decoder, from the raw serial bytes to the CSV and VCD outputs
+     */
+    class StreamDecoder {
+    public:
+        StreamDecoder(FILE* csvFile, FILE* vcdFile) : csv(csvFile), vcdOutput(vcdFile) {}
+        
+        ~StreamDecoder() {
+            delete vcd;
+        }
+        
+        /**
+         * Feed bytes read from the serial port
+         */
+        void feed(const uint8_t* data, size_t length) {
+            for (size_t i = 0; i < length; i++) {
+                if (data[i] == 0) {
+                    endChunk();
+                } else if (chunk.size() < MAX_CHUNK_SIZE) {
+                    chunk.push_back(data[i]);
+                } else {
+                    // Too long for a frame, console text without frames
+                    endChunk();
+                    chunk.push_back(data[i]);
+                }
+            }
+            fflush(csv);
+            if (vcdOutput) {
+                fflush(vcdOutput);
+            }
+        }
+        
+        /**
+         * Handle the bytes left after the last delimiter
+         */
+        void finish() {
+            endChunk();
+            fflush(csv);
+            if (vcdOutput) {
+                fflush(vcdOutput);
+            }
+        }
+        
+        bool receivedFrames() const {
+            return frames > 0;
+        }
+        
+        void printSummary() const {
+            fprintf(stderr, "Frames: %llu, events: %llu, records: %llu\n",
+                static_cast<unsigned long long>(frames), static_cast<unsigned long long>(events),
+                static_cast<unsigned long long>(records));
+            fprintf(stderr, "CRC failures: %llu, unknown frames: %llu, frames lost: %llu, events dropped on the device: %lu\n",
+                static_cast<unsigned long long>(crcFailures), static_cast<unsigned long long>(unknownFrames),
+                static_cast<unsigned long long>(lostFrames),
+                static_cast<unsigned long>(droppedCount - firstDroppedCount));
+        }
+    
+    private:
+        FILE* csv;
+        FILE* vcdOutput;
+        VcdWriter* vcd = nullptr;
+        bool headerWritten = false;
+        
+        std::vector<uint8_t> chunk;
+        std::vector<uint8_t> frame;
+        
+        // Summary
+        uint64_t frames = 0;
+        uint64_t events = 0;
+        uint64_t records = 0;
+        uint64_t crcFailures = 0;
+        uint64_t unknownFrames = 0; // Valid CRC, other version of the format
+        uint64_t lostFrames = 0;
+        uint16_t nextSequence = 0;
+        uint32_t firstDroppedCount = 0;
+        uint32_t droppedCount = 0;
+        
+        void endChunk() {
+            if (chunk.empty()) {
+                return;
+            }
+            if (decodeCobs(chunk, frame) && frame.size() >= FRAME_HEADER_SIZE + BLOCK_HEADER_SIZE + CRC_SIZE
+                && frame.size() <= MAX_FRAME_SIZE
+                && crc32(frame.data(), frame.size() - CRC_SIZE) == readUint32(frame.data() + frame.size() - CRC_SIZE)) {
+                handleFrame();
+            } else if (isText(chunk)) {
+                fwrite(chunk.data(), 1, chunk.size(), stderr);
+            } else {
+                crcFailures++;
+            }
+            chunk.clear();
+        }
+        
+        void handleFrame() {
+            if (frame[0] != FRAME_EVENTS) {
+                unknownFrames++;
+                return;
+            }
+            
+            // Sequence gaps, counted from the first frame received
+            uint16_t sequence = readUint16(frame.data() + 1);
+            droppedCount = readUint32(frame.data() + 3);
+            if (frames == 0) {
+                firstDroppedCount = droppedCount;
+            } else {
+                lostFrames += static_cast<uint16_t>(sequence - nextSequence);
+            }
+            nextSequence = sequence + 1;
+            frames++;
+            
+            decodeBlock(frame.data() + FRAME_HEADER_SIZE, frame.size() - FRAME_HEADER_SIZE - CRC_SIZE);
+        }
+        
+        void decodeBlock(const uint8_t* block, size_t size) {
+            uint16_t payloadSize = readUint16(block + 14);
+            if (memcmp(block, MAGIC, sizeof(MAGIC)) != 0 || block[4] != VERSION
+                || BLOCK_HEADER_SIZE + payloadSize != size) {
+                unknownFrames++;
+                return;
+            }
+            bool highres = block[5] & FLAG_MICROSECONDS;
+            uint64_t scale = highres ? 1000 : 1;
+            uint64_t time = readUint32(block + 8) * scale + (highres ? readUint16(block + 12) : 0);
+            
+            if (!headerWritten) {
+                fprintf(csv, highres ? "Signal,Edge,Timestamp,Micros\n" : "Signal,Edge,Timestamp\n");
+                if (vcdOutput) {
+                    vcd = new VcdWriter(vcdOutput, highres);
+                }
+                headerWritten = true;
+            }
+            
+            const uint8_t* payload = block + BLOCK_HEADER_SIZE;
+            size_t position = 0;
+            uint64_t value;
+            while (readVarint(payload, payloadSize, position, value)) {
+                uint8_t edge = value & ((1 << EDGE_BITS) - 1);
+                uint8_t signal = (value >> EDGE_BITS) & ((1 << SIGNAL_BITS) - 1);
+                time += value >> DELTA_SHIFT;
+                
+                // Timestamps are 32-bit millis() values on the device
+                unsigned long millis = static_cast<unsigned long>((time / scale) & 0xFFFFFFFF);
+                unsigned micros = static_cast<unsigned>(time % scale);
+                
+                if (signal == SIGNAL_RECORD) {
+                    uint64_t type;
+                    uint64_t count;
+                    if (!readVarint(payload, payloadSize, position, type)
+                        || !readVarint(payload, payloadSize, position, count)) {
+                        break;
+                    }
+                    fprintf(csv, "%s,,%lu", type < NUM_RECORDS ? RECORDS[type] : "UR", millis);
+                    if (highres) {
+                        fprintf(csv, ",%u", micros);
+                    }
+                    for (uint64_t i = 0; i < count && readVarint(payload, payloadSize, position, value); i++) {
+                        // Zigzag-encoded fields
+                        int64_t field = static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+                        fprintf(csv, ",%lld", static_cast<long long>(field));
+                    }
+                    fprintf(csv, "\n");
+                    records++;
+                    continue;
+                }
+                
+                const char* name = signal < NUM_SIGNALS ? SIGNALS[signal] : "UN";
+                fprintf(csv, "%s,%s,%lu", name, edge ? "F" : "R", millis);
+                if (highres) {
+                    fprintf(csv, ",%u", micros);
+                }
+                fprintf(csv, "\n");
+                if (vcd) {
+                    vcd->change(name, time & ((WRAP_MS * scale) - 1), edge ? 0 : 1);
+                }
+                events++;
+            }
+        }
+        
+        static bool readVarint(const uint8_t* data, size_t size, size_t& position, uint64_t& value) {
+            value = 0;
+            for (unsigned shift = 0; position < size && shift < 64; shift += 7) {
+                uint8_t byte = data[position++];
+                value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if (!(byte & 0x80)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+    
+    /**
+     * Set a terminal to raw mode at a speed
+     */
+    bool setRaw(int fd, speed_t speed) {
+        struct termios settings;
+        if (tcgetattr(fd, &settings) != 0) {
+            return false;
+        }
+        cfmakeraw(&settings);
+        cfsetispeed(&settings, speed);
+        cfsetospeed(&settings, speed);
+        return tcsetattr(fd, TCSANOW, &settings) == 0;
+    }
+    
+    /**
+     * Open a pseudo-terminal, print the path of its device side
+     * @return File descriptor of the receiver side, -1 on error
+     */
+    int openPseudoTerminal() {
+        int fd = posix_openpt(O_RDWR | O_NOCTTY);
+        if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) {
+            return -1;
+        }
+        
+        // The settings are those of the device side
+        setRaw(fd, STREAM_BAUD_RATE);
+        printf("%s\n", ptsname(fd));
+        fflush(stdout);
+        return fd;
+    }
+    
+    void sendCommand(int fd, char command) {
+        if (write(fd, &command, 1) == 1) {
+            tcdrain(fd);
+        }
+    }
+    
+    int receive(int fd, bool pseudoTerminal, FILE* csv, FILE* vcd) {
+        // Start at the console speed, the device switches after the command
+        if (!pseudoTerminal && isatty(fd)) {
+            setRaw(fd, CONSOLE_BAUD_RATE);
+            tcflush(fd, TCIOFLUSH);
+            sendCommand(fd, START_COMMAND);
+            usleep(50000);
+            setRaw(fd, STREAM_BAUD_RATE);
+        } else if (pseudoTerminal) {
+            sendCommand(fd, START_COMMAND);
+        }
+        
+        StreamDecoder decoder(csv, vcd);
+        uint8_t buffer[4096];
+        while (!interrupted) {
+            ssize_t length = read(fd, buffer, sizeof(buffer));
+            if (length > 0) {
+                decoder.feed(buffer, static_cast<size_t>(length));
+            } else if (length == 0) {
+                break; // End of a file
+            } else if (errno == EINTR) {
+                continue;
+            } else if (errno == EIO && pseudoTerminal && !decoder.receivedFrames()) {
+                usleep(50000); // Sender not started yet
+            } else {
+                break; // Device gone
+            }
+        }
+        decoder.finish();
+        
+        if (isatty(fd)) {
+            sendCommand(fd, STOP_COMMAND);
+        }
+        decoder.printSummary();
+        return 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    const char* device = nullptr;
+    const char* csvPath = nullptr;
+    const char* vcdPath = nullptr;
+    bool pseudoTerminal = false;
+    bool usage = false;
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--vcd") == 0 && i + 1 < argc) {
+            vcdPath = argv[++i];
+        } else if (strcmp(argv[i], "--pty") == 0) {
+            pseudoTerminal = true;
+        } else if (argv[i][0] == '-') {
+            usage = true;
+        } else if (!device && !pseudoTerminal) {
+            device = argv[i];
+        } else if (!csvPath) {
+            csvPath = argv[i];
+        } else {
+            usage = true;
+        }
+    }
+    if (usage || (!device && !pseudoTerminal) || (device && pseudoTerminal)) {
+        fprintf(stderr, "Usage: %s [--vcd VCDOUT] (DEVICE | --pty) [CSVOUT]\n", argv[0]);
+        fprintf(stderr, "Receive the events streamed by the device, as CSV (standard output by default).\n");
+        return 2;
+    }
+    
+    int fd = pseudoTerminal ? openPseudoTerminal() : open(device, O_RDWR | O_NOCTTY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: cannot open %s: %s\n", device ? device : "a pseudo-terminal", strerror(errno));
+        return 1;
+    }
+    FILE* csv = csvPath ? fopen(csvPath, "w") : stdout;
+    FILE* vcd = vcdPath ? fopen(vcdPath, "w") : nullptr;
+    if (!csv || (vcdPath && !vcd)) {
+        fprintf(stderr, "Error: cannot write %s: %s\n", !csv ? csvPath : vcdPath, strerror(errno));
+        return 1;
+    }
+    
+    // Interrupt the read on Ctrl-C, to stop the streaming and print the summary
+    struct sigaction action = {};
+    action.sa_handler = onInterrupt;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    
+    int result = receive(fd, pseudoTerminal, csv, vcd);
+    close(fd);
+    if (csv != stdout) {
+        fclose(csv);
+    }
+    if (vcd) {
+        fclose(vcd);
+    }
+    return result;
+}
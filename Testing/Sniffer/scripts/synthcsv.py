@@ -0,0 +1,112 @@
+import random
+from pathlib import Path
+from typing import Iterator
+
+import click
+
+# pyright: strict
+
+# Rows are generated in batches, then written at once
+BATCH_ROWS = 100000
+
+# Hour frame code, 0b1TTUUUU
+FRAME_HOUR = 13
+FRAME_CODE = 0b1000000 | (FRAME_HOUR // 10) << 4 | FRAME_HOUR % 10
+
+
+def timecolumns(time: int, highres: bool) -> str:
+    """Timestamp columns of a time in microseconds, millis() wraps at 2^32."""
+    millis, micros = divmod(time, 1000)
+    millis &= 0xFFFFFFFF
+    return f"{millis},{micros}" if highres else f"{millis}"
+
+
+def rfseconds(
+    rng: random.Random, start: int
+) -> Iterator[tuple[str, str, int]]:
+    """DCF77-like RF pulses, one per second, with some noise spikes."""
+    time = start
+    while True:
+        width = rng.choice([100000, 200000]) + rng.randint(-8000, 8000)
+        yield "RF", "R", time
+        if rng.random() < 0.05:
+            spike = time + rng.randint(1000, width - 1000)
+            yield "RF", "F", spike
+            yield "RF", "R", spike + rng.randint(50, 500)
+        yield "RF", "F", time + width
+        time += 1000000
+
+
+def rows(seed: int, highres: bool, reset_rows: int) -> Iterator[str]:
+    """Endless CSV rows, restarting the timestamps every reset_rows rows."""
+    rng = random.Random(seed)
+    count = 0
+    while True:
+        # Like a reboot, the clock starts over
+        start = rng.randint(1000000, 5000000)
+        hour = start
+        for signal, edge, time in rfseconds(rng, start):
+            yield f"{signal},{edge},{timecolumns(time, highres)}\n"
+            count += 1
+            # An hour frame once an hour, as BA/MU pulses between two seconds
+            if edge == "F" and time >= hour:
+                yield from framerows(time + 300000, highres)
+                hour += 3600000000
+            if reset_rows and count % reset_rows == 0:
+                break
+
+
+def framerows(time: int, highres: bool) -> Iterator[str]:
+    """A BA/MU hour frame of FRAME_HOUR, with its HF record."""
+    # BA high, 4ms later MU sends the code MSB first, 8ms per bit, then a 4ms
+    # high end pulse; both fall together 64ms after BA rose
+    edges = [("BA", "R", 0)]
+    level = 0
+    for i in range(7):
+        bit = (FRAME_CODE >> (6 - i)) & 1
+        if bit != level:
+            edges.append(("MU", "R" if bit else "F", 4000 + i * 8000))
+            level = bit
+    if not level:
+        edges.append(("MU", "R", 60000))
+    edges += [("MU", "F", 64000), ("BA", "F", 64000)]
+
+    # As decoded by the firmware, on the grid: no timing error
+    yield f"HF,,{timecolumns(time, highres)},1,{FRAME_HOUR},{FRAME_CODE},0,0\n"
+    for signal, edge, offset in edges:
+        yield f"{signal},{edge},{timecolumns(time + offset, highres)}\n"
+
+
+@click.command()
+@click.argument("csvout", type=click.Path(dir_okay=False))
+@click.option("--size", default=1024, help="Size of the file, in MiB")
+@click.option("--micros/--no-micros", default=True, help="Micros column")
+@click.option(
+    "--reset-rows",
+    default=10000000,
+    help="Rows between timestamp resets, 0 for none",
+)
+@click.option("--seed", default=0, help="Random seed")
+def main(
+    csvout: str, size: int, micros: bool, reset_rows: int, seed: int
+) -> None:
+    """Generate a synthetic CSV log, to benchmark the converters."""
+    limit = size * 1024 * 1024
+    written = 0
+    generator = rows(seed, micros, reset_rows)
+    with Path(csvout).open("w", newline="") as csvfile:
+        columns = ["Signal", "Edge", "Timestamp"]
+        if micros:
+            columns.append("Micros")
+        header = ",".join(columns) + "\n"
+        csvfile.write(header)
+        written += len(header)
+        while written < limit:
+            batch = "".join(next(generator) for _ in range(BATCH_ROWS))
+            csvfile.write(batch)
+            written += len(batch)
+
+
+if __name__ == "__main__":
+    main()
+# vim: set filetype=python:
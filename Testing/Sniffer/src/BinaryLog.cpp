@@ -0,0 +1,139 @@
+#include "BinaryLog.h"
+#include <string.h>
+
+uint32_t BinaryLog::crc32(const uint8_t* data, size_t length, uint32_t crc) {
+    // Half-byte lookup table: 64 bytes of flash instead of 1KB
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+        0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+        0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+    
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc = table[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+        crc = table[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+BinaryLogEncoder::BinaryLogEncoder() {
+    clear();
+}
+
+bool BinaryLogEncoder::append(const EventEntry& entry) {
+    // Leave room for the largest possible event
+    if (sealed || size + BinaryLog::MAX_VARINT_SIZE > sizeof(block) || isBackward(entry.timestamp, entry.micros)) {
+        return false;
+    }
+    
+    appendEvent(entry.timestamp, entry.micros, entry.signalType, entry.edgeType);
+    return true;
+}
+
+bool BinaryLogEncoder::append(const LogRecord& record) {
+    // Leave room for the largest possible record
+    if (sealed || size + BinaryLog::MAX_RECORD_SIZE > sizeof(block) || isBackward(record.timestamp, record.micros)) {
+        return false;
+    }
+    
+    appendEvent(record.timestamp, record.micros, BinaryLog::SIGNAL_RECORD, 0);
+    appendVarint(record.type);
+    appendVarint(record.numFields);
+    for (size_t i = 0; i < record.numFields; i++) {
+        // Zigzag: small negative values stay short
+        int32_t field = record.fields[i];
+        appendVarint((static_cast<uint32_t>(field) << 1) ^ static_cast<uint32_t>(field >> 31));
+    }
+    return true;
+}
+
+size_t BinaryLogEncoder::seal() {
+    if (!sealed) {
+        BinaryLog::BlockHeader& hdr = header();
+        hdr.magic = BinaryLog::MAGIC;
+        hdr.version = BinaryLog::VERSION;
+        hdr.flags = Timing::HIGH_RESOLUTION_TIMESTAMPS ? BinaryLog::FLAG_MICROSECONDS : 0;
+        hdr.eventCount = eventCount;
+        hdr.payloadSize = size - sizeof(BinaryLog::BlockHeader);
+        
+        // CRC covers the header up to the crc field, then the payload
+        const size_t crcOffset = offsetof(BinaryLog::BlockHeader, crc);
+        uint32_t crc = BinaryLog::crc32(block, crcOffset);
+        hdr.crc = BinaryLog::crc32(block + sizeof(BinaryLog::BlockHeader), hdr.payloadSize, crc);
+        
+        sealed = true;
+    }
+    return size;
+}
+
+const uint8_t* BinaryLogEncoder::data() const {
+    return block;
+}
+
+void BinaryLogEncoder::clear() {
+    memset(block, 0, sizeof(BinaryLog::BlockHeader));
+    size = sizeof(BinaryLog::BlockHeader);
+    eventCount = 0;
+    lastTimestamp = 0;
+    lastMicros = 0;
+    sealed = false;
+}
+
+bool BinaryLogEncoder::isEmpty() const {
+    return eventCount == 0;
+}
+
+bool BinaryLogEncoder::isSealed() const {
+    return sealed;
+}
+
+BinaryLog::BlockHeader& BinaryLogEncoder::header() {
+    return *reinterpret_cast<BinaryLog::BlockHeader*>(block);
+}
+
+bool BinaryLogEncoder::isBackward(uint32_t timestamp, uint16_t micros) const {
+    if (eventCount == 0) {
+        return false; // Base timestamp of the block
+    }
+    
+    // Signed difference, across the millis() wrap
+    int64_t delta = static_cast<int32_t>(timestamp - lastTimestamp);
+    if (Timing::HIGH_RESOLUTION_TIMESTAMPS) {
+        delta = delta * 1000 + micros - lastMicros;
+    }
+    return delta < 0;
+}
+
+void BinaryLogEncoder::appendEvent(uint32_t timestamp, uint16_t micros, uint8_t signal, uint8_t edge) {
+    uint64_t delta = 0;
+    if (eventCount == 0) {
+        // First event of the block becomes the base timestamp
+        header().baseTimestamp = timestamp;
+        header().baseMicros = micros;
+    } else {
+        // Unsigned difference keeps working across the millis() wrap
+        delta = static_cast<uint32_t>(timestamp - lastTimestamp);
+        if (Timing::HIGH_RESOLUTION_TIMESTAMPS) {
+            delta = delta * 1000 + micros - lastMicros;
+        }
+    }
+    lastTimestamp = timestamp;
+    lastMicros = micros;
+    
+    // Pack edge, signal and delta, then write as a varint
+    appendVarint((delta << BinaryLog::DELTA_SHIFT)
+        | ((signal & ((1 << BinaryLog::SIGNAL_BITS) - 1)) << BinaryLog::EDGE_BITS)
+        | (edge & 1));
+    
+    eventCount++;
+}
+
+void BinaryLogEncoder::appendVarint(uint64_t value) {
+    while (value >= 0x80) {
+        block[size++] = static_cast<uint8_t>(value) | 0x80;
+        value >>= 7;
+    }
+    block[size++] = static_cast<uint8_t>(value);
+}
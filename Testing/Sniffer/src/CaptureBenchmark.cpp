@@ -0,0 +1,145 @@
+#include "CaptureBenchmark.h"
+#include <algorithm>
+#include <esp_cpu.h>
+#include <esp_timer.h>
+#include <memory>
+
+namespace {
+    // Square wave frequencies, in Hz (two edges per period)
+    constexpr uint32_t FREQUENCIES[] = {100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000};
+    
+    // Counting window of each step, after a settling time
+    constexpr int64_t SETTLE_TIME_US = 100000;
+    constexpr int64_t STEP_TIME_US = 1000000;
+    
+    // Edges reach the ring buffer up to the RMT reorder window late
+    constexpr int64_t DRAIN_TIME_US = 2 * CaptureConfig::RMT_REORDER_WINDOW_US;
+    
+    // 50% duty cycle at 8-bit resolution, down to a few Hz on the 80MHz APB clock
+    constexpr uint8_t PWM_RESOLUTION = 8;
+    constexpr uint32_t PWM_DUTY = 128;
+    
+    // A step is sustained below this loss rate, in parts per thousand
+    constexpr uint32_t MAX_LOSS_PERMILLE = 10;
+    
+    // Writes timed per kind of ring buffer entry
+    constexpr uint32_t WRITE_COST_SAMPLES = 1000;
+    
+    // Time between the timed events: packed as a delta, or needing a sync entry
+    constexpr uint64_t SHORT_GAP_US = 1234;
+    constexpr uint64_t LONG_GAP_US = 200 * 1000000ULL;
+}
+
+CaptureBenchmark::CaptureBenchmark(RingBuffer& buffer) : eventBuffer(buffer) {
+    // Nothing else to initialize
+}
+
+void CaptureBenchmark::run() {
+    Serial.println("Capture benchmark, wire the benchmark output to RF");
+    Serial.printf("Backend: %s\n", CaptureConfig::BACKEND == CAPTURE_RMT ? "RMT" : "GPIO interrupt");
+    measureWriteCost();
+    
+    uint32_t maxSustainedRate = 0;
+    bool sustained = true;
+    
+    for (uint32_t frequency : FREQUENCIES) {
+        StepResult result = measure(frequency);
+        uint32_t lost = result.expectedEdges > result.receivedEdges ? result.expectedEdges - result.receivedEdges : 0;
+        uint32_t lossPermille = result.expectedEdges > 0 ? 1000ULL * lost / result.expectedEdges : 0;
+        
+        Serial.printf("%6lu Hz: %7lu/%7lu edges, %3lu.%lu%% lost, %lu edge type errors\n",
+            static_cast<unsigned long>(frequency), static_cast<unsigned long>(result.receivedEdges),
+            static_cast<unsigned long>(result.expectedEdges), static_cast<unsigned long>(lossPermille / 10),
+            static_cast<unsigned long>(lossPermille % 10), static_cast<unsigned long>(result.edgeTypeErrors));
+        
+        // Only count rates up to the first failing step
+        sustained = sustained && lossPermille < MAX_LOSS_PERMILLE && result.edgeTypeErrors == 0;
+        if (sustained) {
+            maxSustainedRate = 2 * frequency;
+        }
+    }
+    
+    Serial.printf("Maximum sustained edge rate: %lu edges/s\n", static_cast<unsigned long>(maxSustainedRate));
+}
+
+CaptureBenchmark::StepResult CaptureBenchmark::measure(uint32_t frequency) {
+    StepResult result = {0, 0, 0};
+    
+    ledcAttach(Pins::BENCH_OUT, frequency, PWM_RESOLUTION);
+    ledcWrite(Pins::BENCH_OUT, PWM_DUTY);
+    
+    // Let the backend settle, then count the edges dated within the step
+    delay(SETTLE_TIME_US / 1000);
+    discardEvents();
+    int64_t start = esp_timer_get_time();
+    int64_t end = start + STEP_TIME_US;
+    uint8_t lastEdge = 0xFF;
+    
+    while (esp_timer_get_time() < end + DRAIN_TIME_US) {
+        const EventEntry* events;
+        size_t numEvents = eventBuffer.readSpan(events);
+        for (size_t i = 0; i < numEvents; i++) {
+            int64_t time = static_cast<int64_t>(events[i].timestamp) * 1000 + events[i].micros;
+            if (events[i].signalType != RF_SIGNAL || time < start || time >= end) {
+                continue;
+            }
+            
+            if (events[i].edgeType == lastEdge) {
+                result.edgeTypeErrors++;
+            }
+            lastEdge = events[i].edgeType;
+            result.receivedEdges++;
+        }
+        eventBuffer.commit(numEvents);
+        
+        // Let the lower priority tasks run, the buffer holds several ms of edges
+        delay(1);
+    }
+    
+    ledcDetach(Pins::BENCH_OUT);
+    result.expectedEdges = 2ULL * frequency * STEP_TIME_US / 1000000;
+    return result;
+}
+
+void CaptureBenchmark::measureWriteCost() {
+    // Scratch buffer, the backend writes to the other one
+    std::unique_ptr<RingBuffer> buffer(new RingBuffer());
+    WriteCost deltaCost = {UINT32_MAX, 0, 0, 0};
+    WriteCost syncCost = {UINT32_MAX, 0, 0, 0};
+    uint64_t time = 0;
+    
+    for (uint32_t i = 0; i < 2 * WRITE_COST_SAMPLES; i++) {
+        // Alternate short and long gaps
+        bool sync = (i & 1) != 0;
+        time += sync ? LONG_GAP_US : SHORT_GAP_US;
+        EventEntry event = {RF_SIGNAL, static_cast<uint8_t>(i & 1), static_cast<uint16_t>(time % 1000),
+                            static_cast<uint32_t>(time / 1000)};
+        
+        uint32_t startCycles = esp_cpu_get_cycle_count();
+        buffer->write(&event, 1);
+        uint32_t cycles = esp_cpu_get_cycle_count() - startCycles;
+        
+        WriteCost& cost = sync ? syncCost : deltaCost;
+        cost.minCycles = std::min(cost.minCycles, cycles);
+        cost.maxCycles = std::max(cost.maxCycles, cycles);
+        cost.totalCycles += cycles;
+        cost.numWrites++;
+    }
+    
+    printWriteCost("delta", deltaCost);
+    printWriteCost("sync", syncCost);
+}
+
+void CaptureBenchmark::printWriteCost(const char* name, const WriteCost& cost) const {
+    Serial.printf("Ring buffer write (%s): %lu-%lu cycles, mean %lu\n", name,
+        static_cast<unsigned long>(cost.minCycles), static_cast<unsigned long>(cost.maxCycles),
+        static_cast<unsigned long>(cost.totalCycles / cost.numWrites));
+}
+
+void CaptureBenchmark::discardEvents() {
+    const EventEntry* events;
+    size_t numEvents;
+    while ((numEvents = eventBuffer.readSpan(events)) > 0) {
+        eventBuffer.commit(numEvents);
+    }
+}
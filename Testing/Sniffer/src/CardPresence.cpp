@@ -0,0 +1,163 @@
+#include "CardPresence.h"
+#include <SD.h>
+#include <SPI.h>
+#include <algorithm>
+
+namespace {
+    // Clock cycles with CS high before the first command of a card, in bytes (at least 74 cycles)
+    constexpr size_t WAKE_UP_BYTES = 10;
+    
+    // CRC7 of a command frame, shifted with its end bit. The card checks it
+    // for CMD0, and for every command if the driver turned CRC checks on
+    uint8_t commandCrc(const uint8_t* frame, size_t length) {
+        uint8_t crc = 0;
+        for (size_t i = 0; i < length; i++) {
+            uint8_t data = frame[i];
+            for (int bit = 0; bit < 8; bit++) {
+                crc <<= 1;
+                if ((data ^ crc) & 0x80) {
+                    crc ^= 0x09;
+                }
+                data <<= 1;
+            }
+        }
+        return static_cast<uint8_t>((crc << 1) | 1);
+    }
+}
+
+CardPresence::CardPresence(PipelineMetrics& metrics) : pipelineMetrics(metrics) {
+    // Nothing else to initialize
+}
+
+bool CardPresence::begin() {
+    // Configure SPI pins for SD card
+    SPI.begin(Pins::SD_CLK, Pins::SD_MISO, Pins::SD_MOSI, Pins::SD_CS);
+    if (CardConfig::HAS_DETECT_PIN) {
+        pinMode(Pins::SD_DETECT, INPUT_PULLUP);
+    }
+    
+    return update();
+}
+
+bool CardPresence::update() {
+    switch (state) {
+        case CARD_READY:
+            if (isResponding()) {
+                return true;
+            }
+            Serial.println("SD card removed");
+            unmount(CARD_ABSENT);
+            return false;
+        
+        case CARD_FAILED:
+            // Leave a card that does not work alone for a while
+            if (millis() - lastFailureTime < backoff) {
+                return false;
+            }
+            if (!isInserted()) {
+                state = CARD_ABSENT;
+                failures = 0;
+                return false;
+            }
+            return mount();
+        
+        default:
+            // Only pay for the mount once a card answers
+            return isInserted() && mount();
+    }
+}
+
+void CardPresence::handleError() {
+    unmount(CARD_FAILED);
+}
+
+bool CardPresence::isReady() const {
+    return state == CARD_READY;
+}
+
+CardState CardPresence::getState() const {
+    return state;
+}
+
+bool CardPresence::isInserted() {
+    if (CardConfig::HAS_DETECT_PIN) {
+        return digitalRead(Pins::SD_DETECT) == CardConfig::DETECT_LEVEL;
+    }
+    
+    // The card may have been inserted since the last probe: let it wake up
+    // with CS high, then CMD0 switches it to SPI mode, answered by R1 idle
+    pinMode(Pins::SD_CS, OUTPUT);
+    digitalWrite(Pins::SD_CS, HIGH);
+    SPI.beginTransaction(SPISettings(CardConfig::PROBE_FREQUENCY, MSBFIRST, SPI_MODE0));
+    for (size_t i = 0; i < WAKE_UP_BYTES; i++) {
+        SPI.transfer(0xFF);
+    }
+    SPI.endTransaction();
+    
+    uint8_t response;
+    return sendCommand(CMD_GO_IDLE_STATE, &response, 1) && response == R1_IDLE;
+}
+
+bool CardPresence::isResponding() {
+    if (CardConfig::HAS_DETECT_PIN && digitalRead(Pins::SD_DETECT) != CardConfig::DETECT_LEVEL) {
+        return false;
+    }
+    
+    // A card swapped meanwhile does not answer until it gets CMD0
+    uint8_t response[2];
+    return sendCommand(CMD_SEND_STATUS, response, 2) && (response[0] & R1_ERRORS) == 0;
+}
+
+bool CardPresence::mount() {
+    state = CARD_MOUNTING;
+    pipelineMetrics.countCardInit();
+    if (SD.begin(Pins::SD_CS)) {
+        state = CARD_READY;
+        Serial.println("SD card mounted");
+        return true;
+    }
+    
+    unmount(CARD_FAILED);
+    Serial.printf("SD card failed to mount, next attempt in %lu ms\n", backoff);
+    return false;
+}
+
+void CardPresence::unmount(CardState newState) {
+    SD.end();
+    
+    // Back off further at each failure, until the card is removed
+    if (newState == CARD_FAILED) {
+        backoff = failures++ == 0 ? CardConfig::MOUNT_BACKOFF_MIN : std::min(2 * backoff, CardConfig::MOUNT_BACKOFF_MAX);
+        lastFailureTime = millis();
+    } else {
+        failures = 0;
+    }
+    state = newState;
+}
+
+bool CardPresence::sendCommand(uint8_t command, uint8_t* response, size_t length) {
+    uint8_t frame[6] = {static_cast<uint8_t>(0x40 | command), 0, 0, 0, 0, 0};
+    frame[5] = commandCrc(frame, 5);
+    
+    SPI.beginTransaction(SPISettings(CardConfig::PROBE_FREQUENCY, MSBFIRST, SPI_MODE0));
+    digitalWrite(Pins::SD_CS, LOW);
+    SPI.transfer(0xFF);
+    for (uint8_t byte : frame) {
+        SPI.transfer(byte);
+    }
+    
+    // R1 starts with a 0 bit, the bus stays high without card
+    uint8_t r1 = 0xFF;
+    for (size_t i = 0; i < MAX_RESPONSE_WAIT && (r1 & 0x80); i++) {
+        r1 = SPI.transfer(0xFF);
+    }
+    response[0] = r1;
+    for (size_t i = 1; i < length; i++) {
+        response[i] = SPI.transfer(0xFF);
+    }
+    
+    digitalWrite(Pins::SD_CS, HIGH);
+    SPI.transfer(0xFF);
+    SPI.endTransaction();
+    return (r1 & 0x80) == 0;
+}
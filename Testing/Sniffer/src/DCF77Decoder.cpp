@@ -0,0 +1,169 @@
+#include "DCF77Decoder.h"
+
+DCF77Decoder::DCF77Decoder(EventPipeline& eventPipeline) : pipeline(eventPipeline) {
+    // Nothing else to initialize
+}
+
+uint8_t DCF77Decoder::process(const EventEntry& event) {
+    // Events of the other signals tell when the reception was lost
+    if (receiving && eventDeltaUs(pulseStart, event) > RECEPTION_TIMEOUT) {
+        endTelegram();
+    }
+    
+    if (event.signalType != RF_SIGNAL) {
+        return EventPipeline::NO_OWNER;
+    }
+    
+    // The edge ending a telegram belongs to it, the one after a minute
+    // marker to the next telegram
+    uint8_t claim = owner;
+    uint8_t level = event.edgeType == EDGE_RISING ? HIGH : LOW;
+    if (level == DecoderConfig::DCF77_PULSE_LEVEL) {
+        startPulse(event);
+        if (receiving) {
+            claim = owner;
+        }
+    } else {
+        endPulse(event);
+    }
+    
+    return claim;
+}
+
+void DCF77Decoder::startPulse(const EventEntry& event) {
+    if (inPulse) {
+        return; // Edge lost before, wait for the pulse to end
+    }
+    inPulse = true;
+    
+    // One second since the last pulse, or two at the minute marker
+    int64_t interval = hasPulse ? eventDeltaUs(pulseStart, event) : 0;
+    bool second = hasPulse && interval >= SECOND_MIN && interval <= SECOND_MAX;
+    bool marker = hasPulse && interval >= MARKER_MIN && interval <= MARKER_MAX;
+    pulseStart = event;
+    hasPulse = true;
+    
+    if (receiving && !second) {
+        endTelegram();
+    }
+    
+    // Second 0 of a new telegram
+    if (marker) {
+        owner = pipeline.reserveRecord();
+        telegramStart = event;
+        numBits = 0;
+        receiving = true;
+    }
+}
+
+void DCF77Decoder::endPulse(const EventEntry& event) {
+    if (!inPulse) {
+        return; // Edge lost before, wait for the next pulse
+    }
+    inPulse = false;
+    
+    if (!receiving) {
+        return;
+    }
+    
+    // 100ms for a 0, 200ms for a 1, anything else is a reception error
+    int64_t width = eventDeltaUs(pulseStart, event);
+    if (width < PULSE_MIN || width > PULSE_MAX || numBits == MAX_BITS) {
+        endTelegram();
+        return;
+    }
+    
+    uint8_t bit = width >= (PULSE_ZERO + PULSE_ONE) / 2 ? 1 : 0;
+    int64_t error = width - (bit ? PULSE_ONE : PULSE_ZERO);
+    error = error < 0 ? -error : error;
+    int64_t margin = (PULSE_ONE - PULSE_ZERO) / 2;
+    
+    bits[numBits] = bit;
+    confidence[numBits] = error < margin ? static_cast<uint8_t>(100 - error * 100 / margin) : 0;
+    numBits++;
+}
+
+void DCF77Decoder::endTelegram() {
+    LogRecord record = {};
+    record.type = RECORD_DCF77_MINUTE;
+    record.timestamp = telegramStart.timestamp;
+    record.micros = telegramStart.micros;
+    record.numFields = 12;
+    
+    // Confidence of the bits received
+    int32_t lowest = numBits > 0 ? 100 : 0;
+    int32_t total = 0;
+    uint32_t weakBits[2] = {0, 0};
+    for (size_t i = 0; i < numBits; i++) {
+        lowest = confidence[i] < lowest ? confidence[i] : lowest;
+        total += confidence[i];
+        if (confidence[i] < WEAK_CONFIDENCE) {
+            weakBits[i / 32] |= 1UL << (i % 32);
+        }
+    }
+    record.fields[8] = lowest;
+    record.fields[9] = numBits > 0 ? total / static_cast<int32_t>(numBits) : 0;
+    record.fields[10] = static_cast<int32_t>(weakBits[0]);
+    record.fields[11] = static_cast<int32_t>(weakBits[1]);
+    
+    // 59 bits, or 60 with a leap second announced
+    bool complete = numBits == NUM_BITS || (numBits == MAX_BITS && bits[19]);
+    bool valid = false;
+    for (size_t i = 1; i <= 6; i++) {
+        record.fields[i] = -1;
+    }
+    
+    if (complete) {
+        int32_t minute = readBCD(21, 7);
+        int32_t hour = readBCD(29, 6);
+        int32_t day = readBCD(36, 6);
+        int32_t weekday = readBCD(42, 3);
+        int32_t month = readBCD(45, 5);
+        int32_t year = readBCD(50, 8);
+        
+        int32_t flags = bits[17] | (bits[18] << 1) | (bits[16] << 2) | (bits[19] << 3) | (bits[15] << 4);
+        flags |= (checkParity(21, 28) ? 0 : 1 << 8)
+            | (checkParity(29, 35) ? 0 : 1 << 9)
+            | (checkParity(36, 58) ? 0 : 1 << 10);
+        
+        // Fixed bits, exactly one time zone, no parity error and sane values
+        valid = bits[0] == 0 && bits[20] == 1 && bits[17] != bits[18] && (flags >> 8) == 0
+            && minute >= 0 && minute <= 59 && hour >= 0 && hour <= 23
+            && day >= 1 && day <= 31 && weekday >= 1 && weekday <= 7
+            && month >= 1 && month <= 12 && year >= 0;
+        
+        record.fields[1] = minute;
+        record.fields[2] = hour;
+        record.fields[3] = day;
+        record.fields[4] = weekday;
+        record.fields[5] = month;
+        record.fields[6] = year;
+        record.fields[7] = flags;
+    }
+    record.fields[0] = valid ? 1 : 0;
+    
+    pipeline.resolve(owner, &record, !valid || DecoderConfig::KEEP_DCF77_EVENTS);
+    receiving = false;
+    owner = EventPipeline::NO_OWNER;
+}
+
+int32_t DCF77Decoder::readBCD(size_t first, size_t count) const {
+    int32_t units = 0;
+    int32_t tens = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (i < 4) {
+            units |= bits[first + i] << i;
+        } else {
+            tens |= bits[first + i] << (i - 4);
+        }
+    }
+    return units <= 9 && tens <= 9 ? tens * 10 + units : -1;
+}
+
+bool DCF77Decoder::checkParity(size_t first, size_t last) const {
+    uint8_t parity = 0;
+    for (size_t i = first; i <= last; i++) {
+        parity ^= bits[i];
+    }
+    return parity == 0;
+}
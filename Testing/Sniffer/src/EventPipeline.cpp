@@ -0,0 +1,176 @@
+#include "EventPipeline.h"
+#include "TriggerCapture.h"
+
+bool EventPipeline::addDecoder(EventDecoder& decoder) {
+    if (numDecoders == MAX_DECODERS) {
+        return false;
+    }
+    decoders[numDecoders++] = &decoder;
+    return true;
+}
+
+bool EventPipeline::push(const EventEntry& event) {
+    // Room for the event and a record reserved by each decoder
+    if (DecoderConfig::HOLD_CAPACITY - count < 1 + numDecoders) {
+        // Give up the oldest frame so that its events can be written out
+        abandonOldest();
+        return false;
+    }
+    
+    // Trigger markers are written as records, the decoders never see them
+    if (TriggerCapture::isMarker(event)) {
+        if (!pushRecord(TriggerCapture::toRecord(event))) {
+            abandonOldest();
+            return false;
+        }
+        return true;
+    }
+    
+    // The first decoder claiming the event owns it
+    uint8_t owner = NO_OWNER;
+    for (size_t i = 0; i < numDecoders; i++) {
+        uint8_t claim = decoders[i]->process(event);
+        if (owner == NO_OWNER) {
+            owner = claim;
+        }
+    }
+    
+    append(event, owner, false);
+    return true;
+}
+
+bool EventPipeline::pushRecord(const LogRecord& record) {
+    // Leave push() the room it needs for the next event
+    if (DecoderConfig::HOLD_CAPACITY - count < 2 + numDecoders) {
+        return false;
+    }
+    
+    uint8_t owner = reserveRecord();
+    if (owner == NO_OWNER) {
+        return false;
+    }
+    resolve(owner, &record, true);
+    return true;
+}
+
+bool EventPipeline::next(LogItem& item) {
+    while (count > 0) {
+        const HeldItem& front = items[readIndex];
+        if (!isReady(front)) {
+            return false;
+        }
+        
+        // Unclaimed events are written unless configured otherwise, the
+        // others as resolved
+        if (front.owner == NO_OWNER) {
+            if (DecoderConfig::KEEP_UNCLAIMED_EVENTS) {
+                item = {&front.event, nullptr};
+                return true;
+            }
+        } else {
+            const RecordSlot& slot = slots[front.owner];
+            if (front.isRecord && slot.hasRecord) {
+                item = {nullptr, &slot.record};
+                return true;
+            }
+            if (!front.isRecord && slot.keepEvents) {
+                item = {&front.event, nullptr};
+                return true;
+            }
+        }
+        
+        // Dropped
+        release();
+    }
+    return false;
+}
+
+void EventPipeline::pop() {
+    if (count > 0) {
+        release();
+    }
+}
+
+bool EventPipeline::isEmpty() const {
+    return count == 0;
+}
+
+uint8_t EventPipeline::reserveRecord() {
+    for (uint8_t i = 0; i < MAX_RECORDS; i++) {
+        RecordSlot& slot = slots[i];
+        if (!slot.used) {
+            slot.references = 0;
+            slot.used = true;
+            slot.open = true;
+            slot.resolved = false;
+            slot.hasRecord = false;
+            slot.keepEvents = true;
+            slot.abandoned = false;
+            
+            // The record takes the place of the frame in the FIFO
+            append(EventEntry(), i, true);
+            return i;
+        }
+    }
+    return NO_OWNER;
+}
+
+void EventPipeline::resolve(uint8_t owner, const LogRecord* record, bool keepEvents) {
+    if (owner == NO_OWNER) {
+        return;
+    }
+    
+    // An abandoned frame already had its events kept, without record
+    RecordSlot& slot = slots[owner];
+    if (!slot.abandoned) {
+        slot.hasRecord = record != nullptr;
+        if (record) {
+            slot.record = *record;
+        }
+        slot.keepEvents = keepEvents;
+        slot.resolved = true;
+    }
+    
+    slot.open = false;
+    if (slot.references == 0) {
+        slot.used = false;
+    }
+}
+
+void EventPipeline::append(const EventEntry& event, uint8_t owner, bool isRecord) {
+    items[(readIndex + count) % DecoderConfig::HOLD_CAPACITY] = {event, owner, isRecord};
+    count++;
+    if (owner != NO_OWNER) {
+        slots[owner].references++;
+    }
+}
+
+void EventPipeline::abandonOldest() {
+    const HeldItem& oldest = items[readIndex];
+    if (count > 0 && !isReady(oldest)) {
+        RecordSlot& slot = slots[oldest.owner];
+        slot.resolved = true;
+        slot.hasRecord = false;
+        slot.keepEvents = true;
+        slot.abandoned = true;
+    }
+}
+
+bool EventPipeline::isReady(const HeldItem& item) const {
+    return item.owner == NO_OWNER || slots[item.owner].resolved;
+}
+
+void EventPipeline::release() {
+    uint8_t owner = items[readIndex].owner;
+    readIndex = (readIndex + 1) % DecoderConfig::HOLD_CAPACITY;
+    count--;
+    
+    // Free the record slot once its decoder is done and no item refers to it
+    if (owner != NO_OWNER) {
+        RecordSlot& slot = slots[owner];
+        slot.references--;
+        if (!slot.open && slot.references == 0) {
+            slot.used = false;
+        }
+    }
+}
@@ -0,0 +1,198 @@
+#include "FlushTask.h"
+#include <algorithm>
+
+// Initialize static instance pointer
+FlushTask* FlushTask::instance = nullptr;
+
+FlushTask::FlushTask(RingBuffer& buffer, SDCardManager& sdCard, SpillStore& spill, SignalStatistics& statistics,
+                     PipelineMetrics& metrics, SerialStreamer& streamer)
+    : eventBuffer(buffer), sdManager(sdCard), spillStore(spill), signalStatistics(statistics),
+      pipelineMetrics(metrics), serialStreamer(streamer), lastResult(FLUSH_PENDING), statisticsRequested(false),
+      streamingRequested(false) {
+    // Store instance pointer for the watermark handler
+    instance = this;
+}
+
+bool FlushTask::begin() {
+    // Keep the SD card work away from the core taking the GPIO interrupts
+    BaseType_t core = xPortGetCoreID() == 0 ? 1 : 0;
+    
+    if (xTaskCreatePinnedToCore(taskEntry, "flush", TaskConfig::FLUSH_TASK_STACK_SIZE, this,
+                                TaskConfig::FLUSH_TASK_PRIORITY, &taskHandle, core) != pdPASS) {
+        return false;
+    }
+    
+    // Wake the task early when the buffer fills up
+    eventBuffer.setWatermarkHandler(BufferConfig::HIGH_WATERMARK, onHighWatermark);
+    return true;
+}
+
+FlushResult FlushTask::getLastResult() const {
+    return static_cast<FlushResult>(lastResult.load());
+}
+
+void FlushTask::requestStatistics() {
+    statisticsRequested = true;
+    if (taskHandle) {
+        xTaskNotifyGive(taskHandle);
+    }
+}
+
+void FlushTask::requestStreaming(bool enable) {
+    streamingRequested = enable;
+    if (taskHandle) {
+        xTaskNotifyGive(taskHandle);
+    }
+}
+
+void FlushTask::run() {
+    const TickType_t commitInterval = pdMS_TO_TICKS(Timing::SD_COMMIT_INTERVAL);
+    const TickType_t retryInterval = pdMS_TO_TICKS(Timing::SD_RETRY_INTERVAL);
+    const TickType_t metricsInterval = pdMS_TO_TICKS(MetricsConfig::RECORD_INTERVAL);
+    const TickType_t streamInterval = pdMS_TO_TICKS(StreamConfig::STREAM_INTERVAL);
+    TickType_t lastSyncTime = xTaskGetTickCount();
+    TickType_t lastMetricsTime = lastSyncTime;
+    
+    for (;;) {
+        // Sleep until the next sync point, or less if a watermark flush failed
+        TickType_t elapsed = xTaskGetTickCount() - lastSyncTime;
+        TickType_t timeout = elapsed < commitInterval ? commitInterval - elapsed : 0;
+        if (eventBuffer.getCount() >= BufferConfig::HIGH_WATERMARK) {
+            timeout = std::min(timeout, retryInterval);
+        }
+        if (streaming) {
+            timeout = std::min(timeout, streamInterval);
+        }
+        
+        // Woken up by the watermark handler, or timed out
+        ulTaskNotifyTake(pdTRUE, timeout);
+        
+        // Tick arithmetic is unsigned, no special case for the counter wrap
+        bool sync = xTaskGetTickCount() - lastSyncTime >= commitInterval;
+        
+        // Streaming started or stopped from the console. The card gets what
+        // was captured before the stream, the stream what comes after
+        bool streamRequest = streamingRequested;
+        if (streamRequest != streaming) {
+            if (streamRequest) {
+                flush(true);
+            }
+            streaming = streamRequest;
+            Serial.println(streaming ? "Streaming events" : "Streaming stopped, logging to the SD card");
+        }
+        
+        // Woken up for the statistics only, no need to flush
+        if (statisticsRequested.exchange(false)) {
+            signalStatistics.printReport();
+            pipelineMetrics.printReport();
+            if (!sync && eventBuffer.getCount() < BufferConfig::HIGH_WATERMARK) {
+                continue;
+            }
+        }
+        
+        if (sync) {
+            lastSyncTime = xTaskGetTickCount();
+            
+            // Metrics records are saved with the sync
+            if (MetricsConfig::ENABLE_RECORDS && lastSyncTime - lastMetricsTime >= metricsInterval) {
+                lastMetricsTime = lastSyncTime;
+                logMetrics();
+            }
+        }
+        
+        if (streaming) {
+            stream(sync);
+        } else {
+            flush(sync);
+        }
+    }
+}
+
+void FlushTask::flush(bool sync) {
+    // Nothing to do, don't wake the card up
+    if (eventBuffer.isEmpty() && !sdManager.hasStagedData() && spillStore.isEmpty()) {
+        return;
+    }
+    
+    if (!sync) {
+        Serial.println("Emergency buffer flush");
+    }
+    
+    // Spilled events are older than the ones in RAM, save them first
+    bool success = spillStore.drain(sdManager) && sdManager.saveEvents(sync);
+    
+    if (success) {
+        // All data saved
+        const FlushStats& stats = sdManager.getLastFlushStats();
+        lastResult = FLUSH_OK;
+        Serial.printf("Data saved to SD card (%lu bytes in %lu us, %lu B/s)\n",
+            static_cast<unsigned long>(stats.bytesWritten), static_cast<unsigned long>(stats.durationUs),
+            static_cast<unsigned long>(stats.bytesPerSecond));
+    } else if (!sdManager.isCardPresent()) {
+        // SD card not available
+        lastResult = FLUSH_NO_CARD;
+        Serial.printf("Failed to save: SD card %s\n", cardStateToString(sdManager.getCardState()));
+        
+        // Make room in RAM by moving the oldest events to the spill tiers
+        size_t spilledBlocks = 0;
+        while (eventBuffer.getCount() >= SpillConfig::SPILL_WATERMARK && spillStore.spill()) {
+            spilledBlocks++;
+        }
+        if (spilledBlocks > 0) {
+            Serial.printf("Spilled %lu blocks of events\n", static_cast<unsigned long>(spilledBlocks));
+        }
+    } else {
+        // Other error
+        lastResult = FLUSH_ERROR;
+        Serial.println("Error saving to SD card");
+    }
+    
+    // Periodic report of where the events are waiting and of the losses
+    if (sync) {
+        spillStore.printReport();
+        pipelineMetrics.printReport();
+    }
+}
+
+void FlushTask::stream(bool sync) {
+    serialStreamer.streamEvents();
+    lastResult = FLUSH_OK;
+    
+    if (sync) {
+        serialStreamer.printReport();
+        pipelineMetrics.printReport();
+    }
+}
+
+void FlushTask::logMetrics() {
+    LogRecord records[PipelineMetrics::MAX_RECORDS];
+    size_t numRecords = pipelineMetrics.getRecords(records);
+    
+    // Without SD card for a while, the queue holds the oldest records, the
+    // counters of the next ones cover the gap
+    for (size_t i = 0; i < numRecords; i++) {
+        sdManager.queueRecord(records[i]);
+    }
+}
+
+void FlushTask::taskEntry(void* param) {
+    static_cast<FlushTask*>(param)->run();
+}
+
+void IRAM_ATTR FlushTask::onHighWatermark() {
+    if (!instance || !instance->taskHandle) {
+        return;
+    }
+    
+    // The producer is an ISR or the RMT capture task, depending on the backend
+    if (!xPortInIsrContext()) {
+        xTaskNotifyGive(instance->taskHandle);
+        return;
+    }
+    
+    BaseType_t higherPriorityTaskWoken = pdFALSE;
+    vTaskNotifyGiveFromISR(instance->taskHandle, &higherPriorityTaskWoken);
+    if (higherPriorityTaskWoken) {
+        portYIELD_FROM_ISR();
+    }
+}
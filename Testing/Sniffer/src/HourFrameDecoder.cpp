@@ -0,0 +1,195 @@
+#include "HourFrameDecoder.h"
+
+HourFrameDecoder::HourFrameDecoder(EventPipeline& eventPipeline) : pipeline(eventPipeline) {
+    // Nothing else to initialize
+}
+
+uint8_t HourFrameDecoder::process(const EventEntry& event) {
+    // MU falling right after BA, as if both fell together, belongs to the
+    // frame BA closed. Anything else closes it for good
+    if (phase == PHASE_TRAIL) {
+        bool late = eventDeltaUs(frameEnd, event) > END_SKEW_MAX;
+        if (!late && event.signalType == MU_SIGNAL && event.edgeType == EDGE_FALLING) {
+            muLevel = LOW;
+            uint8_t claim = owner;
+            closeFrame();
+            return claim;
+        }
+        if (late || event.signalType == MU_SIGNAL || event.signalType == BA_SIGNAL) {
+            closeFrame();
+        }
+    }
+    
+    // Events of the other signals tell when a frame end never came
+    if (phase != PHASE_IDLE && phase != PHASE_TRAIL && eventDeltaUs(frameStart, event) > FRAME_TIMEOUT) {
+        abortFrame(phase == PHASE_FRAME);
+    }
+    
+    if (event.signalType != MU_SIGNAL && event.signalType != BA_SIGNAL) {
+        return EventPipeline::NO_OWNER;
+    }
+    
+    // Update the combined state
+    uint8_t level = event.edgeType == EDGE_RISING ? HIGH : LOW;
+    if (event.signalType == MU_SIGNAL) {
+        muLevel = level;
+    } else {
+        baLevel = level;
+    }
+    uint8_t newState = baLevel ? (muLevel ? 2 : 1) : 0;
+    if (newState == state) {
+        return owner; // No change, part of the frame if any
+    }
+    
+    uint8_t previousState = state;
+    int64_t duration = eventDeltaUs(stateStart, event);
+    state = newState;
+    stateStart = event;
+    
+    // The edge ending a state belongs to the frame it ends
+    uint8_t claim = owner;
+    
+    if (phase == PHASE_START) {
+        if (duration >= START_PULSE_MIN && duration <= START_PULSE_MAX) {
+            phase = PHASE_FRAME;
+            numPulses = 0;
+            frameDuration = 0;
+            addPulse(previousState, duration);
+        } else {
+            abortFrame(false);
+        }
+    } else if (phase == PHASE_FRAME) {
+        addPulse(previousState, duration);
+    } else if (phase == PHASE_END) {
+        // BA falling right after MU, as if both fell together
+        if (newState == 0 && duration <= END_SKEW_MAX) {
+            finishFrame();
+        } else {
+            abortFrame(true);
+        }
+    }
+    
+    // BA high with MU low may be the start pulse of a new frame
+    if (phase == PHASE_IDLE && newState == 1) {
+        owner = pipeline.reserveRecord();
+        frameStart = event;
+        phase = PHASE_START;
+        claim = owner;
+    }
+    
+    return claim;
+}
+
+void HourFrameDecoder::addPulse(uint8_t previousState, int64_t duration) {
+    pulseDurations[numPulses] = duration;
+    pulseStates[numPulses] = previousState;
+    numPulses++;
+    frameDuration += duration;
+    
+    if (frameDuration >= FRAME_END_MIN) {
+        // Long enough, the frame ends when BA falls, MU may fall just before
+        if (state == 0) {
+            finishFrame();
+        } else if (state == 1 && previousState == 2) {
+            phase = PHASE_END;
+        } else {
+            abortFrame(true);
+        }
+    } else if (state == 0 || numPulses == MAX_PULSES) {
+        // BA fell early, or too many pulses
+        abortFrame(true);
+    }
+}
+
+void HourFrameDecoder::finishFrame() {
+    // Split the pulses into bits (splitpattern), the first pulse is the start
+    // pulse and the last one ends with the end pulse
+    uint8_t bits[MAX_PULSES * 2];
+    size_t numBits = 0;
+    int64_t maxError = 0;
+    int64_t totalError = 0;
+    int64_t time = 0;
+    int64_t expectedTime = START_PULSE;
+    
+    for (size_t i = 0; i < numPulses; i++) {
+        int64_t duration = pulseDurations[i];
+        int64_t pulseBits = 0;
+        if (i == numPulses - 1) {
+            // Last pulse: bits then the end pulse, measured shorter (up to
+            // 4ms at millisecond resolution: end pulse only)
+            pulseBits = duration < END_PULSE + 1000 ? 0 : (duration - END_PULSE_MEASURED + BIT_DURATION / 2) / BIT_DURATION;
+            expectedTime += pulseBits * BIT_DURATION + END_PULSE;
+        } else if (i > 0) {
+            pulseBits = (duration + BIT_DURATION / 2) / BIT_DURATION;
+            expectedTime += pulseBits * BIT_DURATION;
+        }
+        for (int64_t b = 0; b < pulseBits && numBits < sizeof(bits); b++) {
+            bits[numBits++] = pulseStates[i] - 1;
+        }
+        
+        // Timing error of the edge ending the pulse against the grid
+        time += duration;
+        int64_t error = time > expectedTime ? time - expectedTime : expectedTime - time;
+        maxError = error > maxError ? error : maxError;
+        totalError += error;
+    }
+    int32_t meanError = static_cast<int32_t>(totalError / static_cast<int64_t>(numPulses));
+    
+    // The start, 7 bits and the end must fill the 64ms
+    int32_t code = -1;
+    int32_t hour = -1;
+    bool valid = false;
+    if (START_PULSE + static_cast<int64_t>(numBits) * BIT_DURATION + END_PULSE == FRAME_DURATION) {
+        // 0b1TTUUUU, sent MSB first, ended by MU high
+        code = 0;
+        for (size_t i = 0; i < numBits; i++) {
+            code = (code << 1) | bits[i];
+        }
+        int32_t tens = (code >> 4) & 0x3;
+        int32_t units = code & 0xF;
+        valid = (code >> 6) == 1 && pulseStates[numPulses - 1] == 2 && units <= 9 && tens * 10 + units <= 23;
+        hour = valid ? tens * 10 + units : -1;
+    }
+    
+    makeRecord(frameRecord, valid, hour, code, static_cast<int32_t>(maxError), meanError);
+    keepFrameEvents = !valid || DecoderConfig::KEEP_HOUR_FRAME_EVENTS;
+    
+    // BA fell first: the frame keeps its claim until MU falls too
+    if (muLevel == HIGH) {
+        phase = PHASE_TRAIL;
+        frameEnd = stateStart;
+    } else {
+        closeFrame();
+    }
+}
+
+void HourFrameDecoder::closeFrame() {
+    pipeline.resolve(owner, &frameRecord, keepFrameEvents);
+    phase = PHASE_IDLE;
+    owner = EventPipeline::NO_OWNER;
+}
+
+void HourFrameDecoder::abortFrame(bool malformed) {
+    if (malformed) {
+        LogRecord record;
+        makeRecord(record, false, -1, -1, 0, 0);
+        pipeline.resolve(owner, &record, true);
+    } else {
+        pipeline.resolve(owner, nullptr, true);
+    }
+    phase = PHASE_IDLE;
+    owner = EventPipeline::NO_OWNER;
+}
+
+void HourFrameDecoder::makeRecord(LogRecord& record, bool valid, int32_t hour, int32_t code,
+                                  int32_t maxError, int32_t meanError) {
+    record.type = RECORD_HOUR_FRAME;
+    record.timestamp = frameStart.timestamp;
+    record.micros = frameStart.micros;
+    record.numFields = 5;
+    record.fields[0] = valid ? 1 : 0;
+    record.fields[1] = hour;
+    record.fields[2] = code;
+    record.fields[3] = maxError;
+    record.fields[4] = meanError;
+}
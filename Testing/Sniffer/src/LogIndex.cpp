@@ -0,0 +1,55 @@
+#include "LogIndex.h"
+#include <SD.h>
+
+void LogIndex::begin(uint32_t offset) {
+    // Items already counted stay in the block, the data before the offset is
+    // left out of it
+    entry.offset = offset;
+}
+
+void LogIndex::add(const EventEntry& event) {
+    addItem(event.timestamp);
+    entry.signals |= static_cast<uint16_t>(1U << event.signalType);
+}
+
+void LogIndex::add(const LogRecord& record) {
+    addItem(record.timestamp);
+    if (record.type < 16) {
+        entry.records |= static_cast<uint16_t>(1U << record.type);
+    }
+}
+
+bool LogIndex::isEmpty() const {
+    return entry.count == 0;
+}
+
+bool LogIndex::isComplete(uint32_t end) const {
+    return entry.count > 0 && end - entry.offset >= LogFileConfig::INDEX_BLOCK_SIZE;
+}
+
+bool LogIndex::write(const char* path, uint32_t end) {
+    entry.length = end - entry.offset;
+    
+    // Opened for each entry: a few per hour
+    File indexFile = SD.open(path, FILE_APPEND);
+    if (!indexFile) {
+        return false;
+    }
+    size_t written = indexFile.write(reinterpret_cast<const uint8_t*>(&entry), sizeof(entry));
+    indexFile.close();
+    if (written != sizeof(entry)) {
+        return false;
+    }
+    
+    entry = {};
+    entry.offset = end;
+    return true;
+}
+
+void LogIndex::addItem(uint32_t timestamp) {
+    if (entry.count == 0) {
+        entry.firstTimestamp = timestamp;
+    }
+    entry.lastTimestamp = timestamp;
+    entry.count++;
+}
@@ -0,0 +1,145 @@
+#include "PipelineMetrics.h"
+
+PipelineMetrics::PipelineMetrics(RingBuffer& buffer)
+    : eventBuffer(buffer), triggers(0), discarded(0), maxLatency(0), totalLatency(0), latencyCount(0) {
+    for (size_t i = 0; i < NUM_SIGNALS; i++) {
+        dropped[i] = 0;
+        rejected[i] = 0;
+    }
+}
+
+void IRAM_ATTR PipelineMetrics::countDropped(SignalType signal) {
+    if (signal < NUM_SIGNALS) {
+        dropped[signal].fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void IRAM_ATTR PipelineMetrics::countRejected(SignalType signal) {
+    if (signal < NUM_SIGNALS) {
+        rejected[signal].fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void IRAM_ATTR PipelineMetrics::countTrigger() {
+    triggers.fetch_add(1, std::memory_order_relaxed);
+}
+
+void IRAM_ATTR PipelineMetrics::countDiscarded(size_t numEvents) {
+    discarded.fetch_add(numEvents, std::memory_order_relaxed);
+}
+
+void IRAM_ATTR PipelineMetrics::addCaptureLatency(uint32_t cycles) {
+    totalLatency.fetch_add(cycles, std::memory_order_relaxed);
+    latencyCount.fetch_add(1, std::memory_order_relaxed);
+    
+    // The flush task may reset the maximum meanwhile
+    uint32_t longest = maxLatency.load(std::memory_order_relaxed);
+    while (cycles > longest && !maxLatency.compare_exchange_weak(longest, cycles, std::memory_order_relaxed)) {
+    }
+}
+
+void PipelineMetrics::addFlush(uint32_t bytes, uint32_t durationUs) {
+    flushes++;
+    bytesWritten += bytes;
+    flushCount++;
+    totalFlushUs += durationUs;
+    maxFlushUs = durationUs > maxFlushUs ? durationUs : maxFlushUs;
+}
+
+void PipelineMetrics::countCardInit() {
+    cardInits++;
+}
+
+size_t PipelineMetrics::getRecords(LogRecord* records) {
+    // Take the gauges, the producer starts over
+    uint32_t longest = maxLatency.exchange(0, std::memory_order_relaxed);
+    uint32_t latencies = latencyCount.exchange(0, std::memory_order_relaxed);
+    uint32_t latencyTotal = totalLatency.exchange(0, std::memory_order_relaxed);
+    
+    LogRecord& pipeline = records[0];
+    pipeline = {};
+    pipeline.type = RECORD_PIPELINE_METRICS;
+    pipeline.numFields = 13;
+    pipeline.fields[0] = static_cast<int32_t>(eventBuffer.getPeakCount());
+    pipeline.fields[1] = static_cast<int32_t>(eventBuffer.getDroppedCount());
+    pipeline.fields[2] = static_cast<int32_t>(total(rejected));
+    pipeline.fields[3] = static_cast<int32_t>(longest);
+    pipeline.fields[4] = latencies > 0 ? static_cast<int32_t>(latencyTotal / latencies) : 0;
+    pipeline.fields[5] = static_cast<int32_t>(flushes);
+    pipeline.fields[6] = static_cast<int32_t>(bytesWritten / 1024);
+    pipeline.fields[7] = static_cast<int32_t>(maxFlushUs);
+    pipeline.fields[8] = flushCount > 0 ? static_cast<int32_t>(totalFlushUs / flushCount) : 0;
+    pipeline.fields[9] = static_cast<int32_t>(cardInits);
+    pipeline.fields[10] = static_cast<int32_t>(triggers.load(std::memory_order_relaxed));
+    pipeline.fields[11] = static_cast<int32_t>(discarded.load(std::memory_order_relaxed));
+    pipeline.fields[12] = static_cast<int32_t>(getStackMargin());
+    
+    size_t numRecords = 1;
+    for (size_t i = 0; i < NUM_SIGNALS; i++) {
+        if (!Signals::TABLE[i].enabled) {
+            continue;
+        }
+        LogRecord& edges = records[numRecords++];
+        edges = {};
+        edges.type = RECORD_EDGE_METRICS;
+        edges.numFields = 3;
+        edges.fields[0] = static_cast<int32_t>(i);
+        edges.fields[1] = static_cast<int32_t>(dropped[i].load(std::memory_order_relaxed));
+        edges.fields[2] = static_cast<int32_t>(rejected[i].load(std::memory_order_relaxed));
+    }
+    
+    maxFlushUs = 0;
+    totalFlushUs = 0;
+    flushCount = 0;
+    return numRecords;
+}
+
+void PipelineMetrics::printReport() const {
+    uint32_t latencies = latencyCount.load(std::memory_order_relaxed);
+    Serial.printf("Ring buffer: peak %lu/%lu slots, %lu dropped; glitch filter: %lu rejected; capture latency: %lu cycles max, %lu mean\n",
+        static_cast<unsigned long>(eventBuffer.getPeakCount()), static_cast<unsigned long>(BufferConfig::BUFFER_SIZE),
+        static_cast<unsigned long>(eventBuffer.getDroppedCount()), static_cast<unsigned long>(total(rejected)),
+        static_cast<unsigned long>(maxLatency.load(std::memory_order_relaxed)),
+        static_cast<unsigned long>(latencies > 0 ? totalLatency.load(std::memory_order_relaxed) / latencies : 0));
+    
+    // Per-signal losses, only when there are some
+    if (eventBuffer.getDroppedCount() > 0 || total(rejected) > 0) {
+        const char* separator = "";
+        for (size_t i = 0; i < NUM_SIGNALS; i++) {
+            if (!Signals::TABLE[i].enabled) {
+                continue;
+            }
+            Serial.printf("%s%s: %lu dropped, %lu rejected", separator,
+                signalTypeToString(static_cast<SignalType>(i)),
+                static_cast<unsigned long>(dropped[i].load(std::memory_order_relaxed)),
+                static_cast<unsigned long>(rejected[i].load(std::memory_order_relaxed)));
+            separator = ", ";
+        }
+        Serial.println();
+    }
+    
+    if (TriggerConfig::ENABLE) {
+        Serial.printf("Trigger capture: %lu triggers, %lu events left out\n",
+            static_cast<unsigned long>(triggers.load(std::memory_order_relaxed)),
+            static_cast<unsigned long>(discarded.load(std::memory_order_relaxed)));
+    }
+    
+    Serial.printf("SD card: %lu flushes, %llu KB written, flush %lu us max, %llu us mean, %lu mount attempts; "
+        "flush task stack: %lu bytes never used\n",
+        static_cast<unsigned long>(flushes), static_cast<unsigned long long>(bytesWritten / 1024),
+        static_cast<unsigned long>(maxFlushUs),
+        static_cast<unsigned long long>(flushCount > 0 ? totalFlushUs / flushCount : 0),
+        static_cast<unsigned long>(cardInits), static_cast<unsigned long>(getStackMargin()));
+}
+
+uint32_t PipelineMetrics::getStackMargin() {
+    return static_cast<uint32_t>(uxTaskGetStackHighWaterMark(nullptr));
+}
+
+uint32_t PipelineMetrics::total(const std::atomic<uint32_t>* counters) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < NUM_SIGNALS; i++) {
+        sum += counters[i].load(std::memory_order_relaxed);
+    }
+    return sum;
+}
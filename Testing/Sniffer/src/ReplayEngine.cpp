@@ -0,0 +1,363 @@
+#ifdef NATIVE_BUILD
+
+#include "ReplayEngine.h"
+#include <NativeHal.h>
+#include <SD.h>
+#include <LittleFS.h>
+#include <Preferences.h>
+#include <chrono>
+#include <thread>
+
+namespace {
+    // Signals, by SignalType
+    constexpr size_t NUM_SIGNALS = Signals::COUNT;
+    
+    // millis() wraps after 2^32 ms, a reset this close to it is a wrap
+    constexpr int64_t WRAP_US = (1LL << 32) * 1000;
+    constexpr int64_t WRAP_WINDOW_US = 60000000;
+    
+    // Gap inserted at a reboot, between the last and the next edge
+    constexpr int64_t SEAM_GAP_US = 1000000;
+    
+    constexpr size_t MAX_LINE = 256;
+    constexpr size_t MAX_COLUMNS = 16;
+    
+    // Recorded edge, on the stitched timeline
+    struct Edge {
+        int64_t time; // Microseconds
+        uint8_t signal;
+        uint8_t level;
+    };
+    
+    /**
+     * Reader of the edges of CSV data files, in sequence
+     */
+    class EdgeReader {
+    public:
+        explicit EdgeReader(const std::vector<std::string>& paths) : files(paths) {}
+        
+        ~EdgeReader() {
+            if (file) {
+                fclose(file);
+            }
+        }
+        
+        /**
+         * Read the next edge, skipping records and malformed rows
+         * @return false at the end of the last file
+         */
+        bool next(Edge& edge) {
+            char line[MAX_LINE];
+            while (file || openNext()) {
+                if (!fgets(line, sizeof(line), file)) {
+                    fclose(file);
+                    file = nullptr;
+                    continue;
+                }
+                if (parse(line, edge)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+    
+    private:
+        const std::vector<std::string>& files;
+        size_t fileIndex = 0;
+        FILE* file = nullptr;
+        
+        // Columns of the current file
+        int signalColumn = -1;
+        int edgeColumn = -1;
+        int timestampColumn = -1;
+        int microsColumn = -1;
+        
+        // Stitching
+        bool hasTime = false;
+        int64_t previousTime = 0; // As recorded
+        int64_t offset = 0;
+        
+        bool openNext() {
+            while (fileIndex < files.size()) {
+                const std::string& path = files[fileIndex++];
+                file = fopen(path.c_str(), "r");
+                if (!file) {
+                    fprintf(stderr, "Cannot read %s\n", path.c_str());
+                    continue;
+                }
+                
+                char header[MAX_LINE];
+                const char* columns[MAX_COLUMNS];
+                size_t numColumns = fgets(header, sizeof(header), file) ? split(header, columns) : 0;
+                signalColumn = findColumn(columns, numColumns, "Signal");
+                edgeColumn = findColumn(columns, numColumns, "Edge");
+                timestampColumn = findColumn(columns, numColumns, "Timestamp");
+                microsColumn = findColumn(columns, numColumns, "Micros");
+                if (signalColumn >= 0 && edgeColumn >= 0 && timestampColumn >= 0) {
+                    return true;
+                }
+                
+                fprintf(stderr, "%s is not a data file\n", path.c_str());
+                fclose(file);
+                file = nullptr;
+            }
+            return false;
+        }
+        
+        // Split a line in place, return the number of fields
+        static size_t split(char* line, const char* (&fields)[MAX_COLUMNS]) {
+            line[strcspn(line, "\r\n")] = '\0';
+            size_t numFields = 0;
+            char* field = line;
+            while (numFields < MAX_COLUMNS) {
+                fields[numFields++] = field;
+                char* comma = strchr(field, ',');
+                if (!comma) {
+                    break;
+                }
+                *comma = '\0';
+                field = comma + 1;
+            }
+            for (size_t i = numFields; i < MAX_COLUMNS; i++) {
+                fields[i] = "";
+            }
+            return numFields;
+        }
+        
+        static int findColumn(const char* (&fields)[MAX_COLUMNS], size_t numFields, const char* name) {
+            for (size_t i = 0; i < numFields; i++) {
+                if (strcmp(fields[i], name) == 0) {
+                    return static_cast<int>(i);
+                }
+            }
+            return -1;
+        }
+        
+        static bool parseNumber(const char* text, int64_t& value) {
+            if (*text == '\0') {
+                return false;
+            }
+            value = 0;
+            for (; *text; text++) {
+                if (*text < '0' || *text > '9') {
+                    return false;
+                }
+                value = value * 10 + (*text - '0');
+            }
+            return true;
+        }
+        
+        bool parse(char* line, Edge& edge) {
+            const char* fields[MAX_COLUMNS];
+            split(line, fields);
+            
+            // Known signals only, records have no edge
+            edge.signal = NUM_SIGNALS;
+            for (uint8_t i = 0; i < NUM_SIGNALS; i++) {
+                if (strcmp(fields[signalColumn], signalTypeToString(static_cast<SignalType>(i))) == 0) {
+                    edge.signal = i;
+                }
+            }
+            const char* edgeName = fields[edgeColumn];
+            if (edge.signal == NUM_SIGNALS || (strcmp(edgeName, "R") != 0 && strcmp(edgeName, "F") != 0)) {
+                return false;
+            }
+            edge.level = edgeName[0] == 'R' ? HIGH : LOW;
+            
+            int64_t timestamp;
+            int64_t micros = 0;
+            const char* microsField = microsColumn >= 0 ? fields[microsColumn] : "";
+            if (!parseNumber(fields[timestampColumn], timestamp) || (*microsField && !parseNumber(microsField, micros))) {
+                return false;
+            }
+            int64_t time = timestamp * 1000 + micros;
+            
+            // A reboot continues after the previous edge, a wrap 2^32 ms later
+            if (hasTime && time < previousTime) {
+                if (previousTime >= WRAP_US - WRAP_WINDOW_US && time < WRAP_WINDOW_US) {
+                    offset += WRAP_US;
+                } else {
+                    offset = previousTime + offset + SEAM_GAP_US - time;
+                }
+            }
+            previousTime = time;
+            hasTime = true;
+            edge.time = time + offset;
+            return true;
+        }
+    };
+}
+
+ReplayEngine::ReplayEngine(RingBuffer& buffer) : eventBuffer(buffer), done(false) {
+    // Nothing else to initialize
+}
+
+int ReplayEngine::run(int argc, char** argv) {
+    if (!parseArguments(argc, argv)) {
+        printUsage(argv[0]);
+        return 2;
+    }
+    if (!setInitialLevels()) {
+        fprintf(stderr, "No edge to replay\n");
+        return 1;
+    }
+    
+    SD.setRoot(cardDirectory);
+    LittleFS.setRoot(flashDirectory);
+    Preferences::setRoot(nvsDirectory);
+    NativeHal::setCardWriteLatency(cardWriteLatencyUs);
+    NativeHal::setSerialEnabled(!quiet);
+    if (!serialDevice.empty() && !NativeHal::setSerialDevice(serialDevice)) {
+        fprintf(stderr, "Cannot open %s\n", serialDevice.c_str());
+        return 1;
+    }
+    
+    // The firmware starts shortly before the first edge, or at boot time like
+    // on the device if the edges start early
+    int64_t leadIn = std::max(LEAD_IN_US, static_cast<int64_t>(LEAD_IN_HOST_US * speed));
+    NativeHal::begin(speed, std::max<int64_t>(0, firstTime - leadIn));
+    auto hostStart = std::chrono::steady_clock::now();
+    setup();
+    
+    std::thread replayThread(&ReplayEngine::replay, this);
+    while (!done) {
+        loop();
+    }
+    replayThread.join();
+    double hostSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - hostStart).count();
+    
+    // Let the flush task write out everything with its timed flush
+    int64_t end = NativeHal::now() + Timing::SD_COMMIT_INTERVAL * 1000 + LEAD_IN_US;
+    while (NativeHal::now() < end) {
+        loop();
+    }
+    
+    fflush(stdout);
+    printReport(hostSeconds);
+    return 0;
+}
+
+bool ReplayEngine::parseArguments(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (argument == "--speed" && hasValue) {
+            speed = atof(argv[++i]);
+        } else if (argument == "--sd" && hasValue) {
+            cardDirectory = argv[++i];
+        } else if (argument == "--flash" && hasValue) {
+            flashDirectory = argv[++i];
+        } else if (argument == "--nvs" && hasValue) {
+            nvsDirectory = argv[++i];
+        } else if (argument == "--sd-latency" && hasValue) {
+            cardWriteLatencyUs = atoll(argv[++i]);
+        } else if (argument == "--sd-missing" && hasValue) {
+            double from;
+            double to;
+            if (sscanf(argv[++i], "%lf:%lf", &from, &to) != 2 || to <= from) {
+                return false;
+            }
+            cardMissing.emplace_back(static_cast<int64_t>(from * 1e6), static_cast<int64_t>(to * 1e6));
+        } else if (argument == "--serial" && hasValue) {
+            serialDevice = argv[++i];
+        } else if (argument == "--quiet") {
+            quiet = true;
+        } else if (argument[0] == '-') {
+            return false;
+        } else {
+            files.push_back(argument);
+        }
+    }
+    return !files.empty() && speed > 0;
+}
+
+void ReplayEngine::printUsage(const char* program) const {
+    fprintf(stderr,
+        "Usage: %s [options] data.csv...\n"
+        "Replay recorded edges into the firmware, the files in sequence.\n"
+        "  --speed N          Virtual time per host time (default 1000)\n"
+        "  --sd DIR           Directory of the SD card (default _native/sd)\n"
+        "  --flash DIR        Directory of the internal flash (default _native/flash)\n"
+        "  --nvs DIR          Directory of the NVS, boot counter (default _native/nvs)\n"
+        "  --sd-latency US    Duration of each SD card write, in device microseconds\n"
+        "  --sd-missing A:B   Remove the SD card from A to B seconds after the first edge\n"
+        "  --serial DEV       Serial console on a device, such as a pseudo-terminal\n"
+        "  --quiet            Hide the serial console\n",
+        program);
+}
+
+bool ReplayEngine::setInitialLevels() {
+    // Before its first edge, a signal is at the opposite level
+    bool seen[NUM_SIGNALS] = {};
+    EdgeReader reader(files);
+    Edge edge;
+    size_t numEdges = 0;
+    while (numEdges < PRESCAN_EDGES && reader.next(edge)) {
+        if (numEdges++ == 0) {
+            firstTime = edge.time;
+        }
+        if (!seen[edge.signal]) {
+            seen[edge.signal] = true;
+            NativeHal::setPin(Signals::TABLE[edge.signal].pin, edge.level == HIGH ? LOW : HIGH);
+        }
+    }
+    return numEdges > 0;
+}
+
+void ReplayEngine::replay() {
+    EdgeReader reader(files);
+    Edge edge;
+    size_t missingIndex = 0;
+    bool cardRemoved = false;
+    
+    while (reader.next(edge)) {
+        // Scheduled SD card removals
+        int64_t elapsed = edge.time - firstTime;
+        while (missingIndex < cardMissing.size()) {
+            if (!cardRemoved && elapsed >= cardMissing[missingIndex].first) {
+                NativeHal::setCardPresent(false);
+                cardRemoved = true;
+            } else if (cardRemoved && elapsed >= cardMissing[missingIndex].second) {
+                NativeHal::setCardPresent(true);
+                cardRemoved = false;
+                missingIndex++;
+            } else {
+                break;
+            }
+        }
+        
+        NativeHal::sleepUntil(edge.time);
+        maxLagUs = std::max(maxLagUs, NativeHal::now() - edge.time);
+        NativeHal::injectEdge(Signals::TABLE[edge.signal].pin, edge.level, edge.time);
+        peakCount = std::max(peakCount, eventBuffer.getCount());
+        edgesReplayed++;
+        lastTime = edge.time;
+    }
+    
+    NativeHal::setCardPresent(true);
+    done = true;
+}
+
+void ReplayEngine::printReport(double hostSeconds) const {
+    NativeHal::CardStats card = NativeHal::getCardStats();
+    
+    printf("Replay report\n");
+    printf("  Edges: %llu in %.2f s of device time, replayed in %.2f s (%.0f edges/s, %.0fx)\n",
+        static_cast<unsigned long long>(edgesReplayed), (lastTime - firstTime) / 1e6, hostSeconds,
+        hostSeconds > 0 ? edgesReplayed / hostSeconds : 0.0, speed);
+    printf("  Replay lag: up to %.3f ms of device time\n", maxLagUs / 1e3);
+    printf("  Ring buffer: peak %zu/%zu slots, %lu dropped\n",
+        peakCount, BufferConfig::BUFFER_SIZE, static_cast<unsigned long>(eventBuffer.getDroppedCount()));
+    printf("  SD card: %llu bytes in %lu writes, %lu syncs, %lu failed writes, %lu mounts, %lu probe commands\n",
+        static_cast<unsigned long long>(card.bytesWritten), static_cast<unsigned long>(card.writes),
+        static_cast<unsigned long>(card.syncs), static_cast<unsigned long>(card.failedWrites),
+        static_cast<unsigned long>(card.mounts), static_cast<unsigned long>(card.commands));
+    for (const NativeHal::TaskStats& task : NativeHal::getTaskStats()) {
+        printf("  Task %s: %lu wake-ups, %.0f us mean, %lld us max busy (host time)\n",
+            task.name.c_str(), static_cast<unsigned long>(task.wakes),
+            task.wakes > 0 ? static_cast<double>(task.totalBusyUs) / task.wakes : 0.0,
+            static_cast<long long>(task.maxBusyUs));
+    }
+}
+
+#endif // NATIVE_BUILD
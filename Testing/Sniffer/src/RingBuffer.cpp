@@ -1,59 +1,156 @@
 #include "RingBuffer.h"
+#include <algorithm>
 
-RingBuffer::RingBuffer() : writeIndex(0), readIndex(0), count(0) {
+RingBuffer::RingBuffer() : head(0), tail(0), dropped(0), peak(0) {
     // Nothing else to initialize
 }
 
-bool RingBuffer::write(SignalType signal, EdgeType edge, uint32_t timestamp) {
-    std::lock_guard<std::mutex> lock(mutex);
+bool IRAM_ATTR RingBuffer::write(SignalType signal, EdgeType edge, uint32_t timestamp, uint16_t subMillis) {
+    EventEntry entry = {signal, edge, subMillis, timestamp};
+    return write(&entry, 1) == 1;
+}
+
+size_t IRAM_ATTR RingBuffer::write(const EventEntry* events, size_t numEvents) {
+    size_t writeIndex = head.load(std::memory_order_relaxed);
+    size_t count = writeIndex - tail.load(std::memory_order_acquire);
+    size_t room = count < BufferConfig::BUFFER_SIZE ? BufferConfig::BUFFER_SIZE - count : 0;
     
-    // Check if buffer is full
-    if (count >= BufferConfig::BUFFER_SIZE) {
-        return false;  // Buffer is full, reject write
+    // Pack the events while they fit, a sync entry when the delta does not
+    size_t eventsWritten = 0;
+    size_t slots = 0;
+    uint64_t time = writeTime;
+    for (; eventsWritten < numEvents; eventsWritten++) {
+        const EventEntry& event = events[eventsWritten];
+        uint64_t eventTime = static_cast<uint64_t>(event.timestamp) * 1000 + event.micros;
+        uint32_t flags = static_cast<uint32_t>(event.edgeType & 1) << EDGE_SHIFT;
+        if (eventTime >= time && eventTime - time <= MAX_DELTA) {
+            if (slots + 1 > room) {
+                break;
+            }
+            buffer[(writeIndex + slots++) & INDEX_MASK] = (static_cast<uint32_t>(event.signalType) << SIGNAL_SHIFT) |
+                                                          flags | static_cast<uint32_t>(eventTime - time);
+        } else {
+            if (slots + SYNC_SLOTS > room) {
+                break;
+            }
+            buffer[(writeIndex + slots++) & INDEX_MASK] = (SYNC_SIGNAL << SIGNAL_SHIFT) | flags |
+                                                          (static_cast<uint32_t>(event.signalType) << SYNC_SIGNAL_SHIFT) |
+                                                          static_cast<uint32_t>(eventTime >> 32);
+            buffer[(writeIndex + slots++) & INDEX_MASK] = static_cast<uint32_t>(eventTime);
+        }
+        time = eventTime;
     }
     
-    // Write the event
-    buffer[writeIndex].signalType = signal;
-    buffer[writeIndex].edgeType = edge;
-    buffer[writeIndex].reserved = 0; // Clear reserved field
-    buffer[writeIndex].timestamp = timestamp;
-    
-    // Advance write index
-    writeIndex = (writeIndex + 1) % BufferConfig::BUFFER_SIZE;
-    count++;
+    // Reject what does not fit
+    if (eventsWritten < numEvents) {
+        dropped.store(dropped.load(std::memory_order_relaxed) + (numEvents - eventsWritten), std::memory_order_relaxed);
+    }
+    if (eventsWritten == 0) {
+        return 0;
+    }
     
-    return true;
-}
-
-size_t RingBuffer::read(EventEntry* dest, size_t maxEvents) {
-    std::lock_guard<std::mutex> lock(mutex);
+    // Publish the events to the consumer, all at once
+    writeTime = time;
+    head.store(writeIndex + slots, std::memory_order_release);
     
-    // Limit to actual available events
-    size_t eventsToRead = std::min(maxEvents, count);
+    size_t newCount = count + slots;
+    if (newCount > peak.load(std::memory_order_relaxed)) {
+        peak.store(newCount, std::memory_order_relaxed);
+    }
     
-    // Read events
-    for (size_t i = 0; i < eventsToRead; i++) {
-        dest[i] = buffer[readIndex];
-        readIndex = (readIndex + 1) % BufferConfig::BUFFER_SIZE;
+    // Call the handler when the count goes past the level
+    if (count < watermarkLevel && newCount >= watermarkLevel && watermarkHandler) {
+        watermarkHandler();
     }
     
-    count -= eventsToRead;
-    return eventsToRead;
+    return eventsWritten;
+}
+
+size_t RingBuffer::read(EventEntry* dest, size_t maxEvents) {
+    // Expand straight into the destination
+    size_t slots;
+    size_t eventsRead = decode(dest, maxEvents, slots, readTime);
+    commitSlots(slots);
+    return eventsRead;
+}
+
+size_t RingBuffer::readSpan(const EventEntry*& events) {
+    size_t slots;
+    uint64_t time = readTime;
+    events = window;
+    return decode(window, BufferConfig::READ_WINDOW_SIZE, slots, time);
+}
+
+void RingBuffer::commit(size_t numEvents) {
+    // Walk the slots of the events again, to know where they end and the
+    // time the next delta is relative to
+    size_t slots;
+    decode(nullptr, numEvents, slots, readTime);
+    commitSlots(slots);
+}
+
+void RingBuffer::commitSlots(size_t slots) {
+    // Hand the slots back to the producer
+    tail.store(tail.load(std::memory_order_relaxed) + slots, std::memory_order_release);
 }
 
 bool RingBuffer::isEmpty() const {
-    std::lock_guard<std::mutex> lock(mutex);
-    return count == 0;
+    return getCount() == 0;
 }
 
 size_t RingBuffer::getCount() const {
-    std::lock_guard<std::mutex> lock(mutex);
-    return count;
+    // Load the tail first: concurrent activity may only make the count
+    // overestimated, never underflow
+    size_t readIndex = tail.load(std::memory_order_acquire);
+    return head.load(std::memory_order_acquire) - readIndex;
+}
+
+uint32_t RingBuffer::getDroppedCount() const {
+    return dropped.load(std::memory_order_relaxed);
+}
+
+size_t RingBuffer::getPeakCount() const {
+    return peak.load(std::memory_order_relaxed);
+}
+
+void RingBuffer::setWatermarkHandler(size_t level, void (*handler)()) {
+    watermarkLevel = level;
+    watermarkHandler = handler;
 }
 
 void RingBuffer::reset() {
-    std::lock_guard<std::mutex> lock(mutex);
-    writeIndex = 0;
-    readIndex = 0;
-    count = 0;
-}
\ No newline at end of file
+    head.store(0, std::memory_order_relaxed);
+    tail.store(0, std::memory_order_relaxed);
+    writeTime = 0;
+    readTime = 0;
+    dropped.store(0, std::memory_order_relaxed);
+    peak.store(0, std::memory_order_relaxed);
+}
+
+size_t RingBuffer::decode(EventEntry* dest, size_t maxEvents, size_t& slots, uint64_t& time) const {
+    size_t readIndex = tail.load(std::memory_order_relaxed);
+    size_t available = head.load(std::memory_order_acquire) - readIndex;
+    
+    size_t numEvents = 0;
+    slots = 0;
+    while (numEvents < maxEvents && slots < available) {
+        uint32_t slot = buffer[(readIndex + slots++) & INDEX_MASK];
+        uint32_t signal = slot >> SIGNAL_SHIFT;
+        if (signal == SYNC_SIGNAL) {
+            // Full timestamp, the producer publishes both slots at once
+            signal = (slot >> SYNC_SIGNAL_SHIFT) & SYNC_SIGNAL;
+            time = (static_cast<uint64_t>(slot & ((1UL << SYNC_SIGNAL_SHIFT) - 1)) << 32) |
+                   buffer[(readIndex + slots++) & INDEX_MASK];
+        } else {
+            time += slot & MAX_DELTA;
+        }
+        
+        if (dest) {
+            dest[numEvents] = {static_cast<uint8_t>(signal), static_cast<uint8_t>((slot >> EDGE_SHIFT) & 1),
+                               static_cast<uint16_t>(time % 1000), static_cast<uint32_t>(time / 1000)};
+        }
+        numEvents++;
+    }
+    
+    return numEvents;
+}
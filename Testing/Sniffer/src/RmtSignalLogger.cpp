@@ -0,0 +1,206 @@
+#include "RmtSignalLogger.h"
+#include <esp_timer.h>
+#include <algorithm>
+
+static_assert(CaptureConfig::RMT_RESOLUTION_HZ == 1000000, "RMT durations are read in microseconds");
+// The ESP32 RMT memory is 8 blocks of 64 symbols, shared by all channels
+static_assert(Signals::ENABLED_COUNT * ((CaptureConfig::RMT_SYMBOLS + 63) / 64) <= 8,
+              "Not enough RMT memory for the enabled signals");
+
+namespace {
+    // Pulse i of a train, two pulses per RMT symbol
+    inline uint16_t pulseDuration(const rmt_symbol_word_t* symbols, size_t i) {
+        return i % 2 ? symbols[i / 2].duration1 : symbols[i / 2].duration0;
+    }
+    
+    inline uint8_t pulseLevel(const rmt_symbol_word_t* symbols, size_t i) {
+        return i % 2 ? symbols[i / 2].level1 : symbols[i / 2].level0;
+    }
+}
+
+RmtSignalLogger::RmtSignalLogger(RingBuffer& buffer, PipelineMetrics& metrics)
+    : eventBuffer(buffer), pipelineMetrics(metrics) {
+    // Nothing else to initialize
+}
+
+void RmtSignalLogger::begin() {
+    // Glitch filter and end of pulse train detection
+    receiveConfig.signal_range_min_ns = CaptureConfig::RMT_FILTER_NS;
+    receiveConfig.signal_range_max_ns = CaptureConfig::RMT_IDLE_THRESHOLD_US * 1000;
+    
+    // Each channel has at most one reception waiting to be decoded
+    receptions = xQueueCreate(Signals::ENABLED_COUNT, sizeof(Reception));
+    
+    // The capture task stays on the core taking the RMT interrupts
+    if (!receptions || xTaskCreatePinnedToCore(taskEntry, "capture", TaskConfig::CAPTURE_TASK_STACK_SIZE, this,
+                                               TaskConfig::CAPTURE_TASK_PRIORITY, nullptr, xPortGetCoreID()) != pdPASS) {
+        Serial.println("ERROR: Cannot start RMT capture task");
+        return;
+    }
+    
+    // Set up a receive channel for all enabled signals
+    for (uint8_t signal = 0; signal < NUM_SIGNALS; signal++) {
+        if (!Signals::TABLE[signal].enabled) {
+            continue;
+        }
+        if (!setupChannel(static_cast<SignalType>(signal), Signals::TABLE[signal].pin)) {
+            Serial.printf("ERROR: Cannot set up RMT channel for %s\n", signalTypeToString(static_cast<SignalType>(signal)));
+        }
+    }
+}
+
+bool RmtSignalLogger::setupChannel(SignalType signal, uint8_t pin) {
+    Channel& channel = channels[signal];
+    channel.owner = this;
+    channel.signal = signal;
+    channel.activeBuffer = 0;
+    
+    // Set up pin for input and initialize last pin state
+    pinMode(pin, Signals::TABLE[signal].mode);
+    lastPinState[signal] = digitalRead(pin);
+    
+    rmt_rx_channel_config_t config = {};
+    config.gpio_num = pin;
+    config.clk_src = RMT_CLK_SRC_DEFAULT;
+    config.resolution_hz = CaptureConfig::RMT_RESOLUTION_HZ;
+    config.mem_block_symbols = CaptureConfig::RMT_SYMBOLS;
+    
+    rmt_rx_event_callbacks_t callbacks = {};
+    callbacks.on_recv_done = onReceiveDone;
+    
+    return rmt_new_rx_channel(&config, &channel.handle) == ESP_OK
+        && rmt_rx_register_event_callbacks(channel.handle, &callbacks, &channel) == ESP_OK
+        && rmt_enable(channel.handle) == ESP_OK
+        && rmt_receive(channel.handle, channel.symbols[0], sizeof(channel.symbols[0]), &receiveConfig) == ESP_OK;
+}
+
+void RmtSignalLogger::run() {
+    const TickType_t reorderWindow = pdMS_TO_TICKS(CaptureConfig::RMT_REORDER_WINDOW_US / 1000);
+    Reception reception;
+    
+    for (;;) {
+        // Wake up in time to write the pending edges
+        TickType_t timeout = pendingStart < pendingEnd ? reorderWindow : portMAX_DELAY;
+        
+        if (xQueueReceive(receptions, &reception, timeout) == pdTRUE) {
+            // Re-arm first on the other buffer, the channel is blind until then
+            Channel& channel = *reception.channel;
+            channel.activeBuffer = reception.buffer ^ 1;
+            rmt_receive(channel.handle, channel.symbols[channel.activeBuffer], sizeof(channel.symbols[0]), &receiveConfig);
+            
+            decode(reception);
+        }
+        
+        // Other channels may still be receiving edges up to the reorder window
+        writePendingEdges(esp_timer_get_time() - CaptureConfig::RMT_REORDER_WINDOW_US);
+    }
+}
+
+void RmtSignalLogger::decode(const Reception& reception) {
+    const rmt_symbol_word_t* symbols = reception.channel->symbols[reception.buffer];
+    size_t maxPulses = 2 * reception.numSymbols;
+    
+    // A zero duration ends the train when the signal went idle, otherwise the
+    // buffer was full and the train was cut
+    size_t numPulses = 0;
+    int64_t trainDuration = 0;
+    bool idleEnd = false;
+    for (; numPulses < maxPulses; numPulses++) {
+        uint16_t duration = pulseDuration(symbols, numPulses);
+        if (duration == 0) {
+            idleEnd = true;
+            break;
+        }
+        trainDuration += duration;
+    }
+    
+    // Go back from the interrupt to the first edge
+    int64_t time = reception.doneTime - trainDuration;
+    if (idleEnd) {
+        time -= CaptureConfig::RMT_IDLE_THRESHOLD_US;
+    }
+    
+    // Each pulse starts with an edge to its level, the idle level included
+    size_t numEdges = idleEnd ? numPulses + 1 : numPulses;
+    for (size_t i = 0; i < numEdges; i++) {
+        addPendingEdge(time, reception.channel->signal, pulseLevel(symbols, i) ? EDGE_RISING : EDGE_FALLING);
+        time += pulseDuration(symbols, i);
+    }
+}
+
+void RmtSignalLogger::addPendingEdge(int64_t time, SignalType signal, EdgeType edge) {
+    // Out of room, write the oldest edge early
+    if (pendingEnd - pendingStart == MAX_PENDING_EDGES) {
+        const PendingEdge& oldest = pending[pendingStart++];
+        recordEdge(oldest.signal, oldest.edge, oldest.time);
+    }
+    
+    // Move the edges back to the start of the array
+    if (pendingEnd == MAX_PENDING_EDGES) {
+        std::copy(pending + pendingStart, pending + pendingEnd, pending);
+        pendingEnd -= pendingStart;
+        pendingStart = 0;
+    }
+    
+    // Insertion from the end, edges mostly come in order
+    size_t i = pendingEnd++;
+    while (i > pendingStart && pending[i - 1].time > time) {
+        pending[i] = pending[i - 1];
+        i--;
+    }
+    pending[i] = {time, signal, edge};
+}
+
+void RmtSignalLogger::writePendingEdges(int64_t before) {
+    while (pendingStart < pendingEnd && pending[pendingStart].time < before) {
+        const PendingEdge& edge = pending[pendingStart++];
+        recordEdge(edge.signal, edge.edge, edge.time);
+    }
+    
+    if (pendingStart == pendingEnd) {
+        pendingStart = 0;
+        pendingEnd = 0;
+    }
+}
+
+void RmtSignalLogger::recordEdge(SignalType signal, EdgeType edge, int64_t time) {
+    // Validate that this is actually a state change, the edge before may have
+    // been lost while re-arming the channel
+    bool currentState = (edge == EDGE_RISING) ? HIGH : LOW;
+    if (currentState == lastPinState[signal]) {
+        return;
+    }
+    
+    // Check for glitches (transitions too close together)
+    int64_t minPulseWidth = Signals::TABLE[signal].minPulseWidthUs;
+    if ((time - lastEdgeTime[signal]) < minPulseWidth && lastEdgeTime[signal] > 0) {
+        pipelineMetrics.countRejected(signal);
+        return;
+    }
+    
+    lastPinState[signal] = currentState;
+    lastEdgeTime[signal] = time;
+    
+    // Write to buffer, splitting into the millis() value and its sub-millisecond part
+    uint32_t timestamp = static_cast<uint32_t>(time / 1000);
+    uint16_t subMillis = Timing::HIGH_RESOLUTION_TIMESTAMPS ? static_cast<uint16_t>(time % 1000) : 0;
+    if (!eventBuffer.write(signal, edge, timestamp, subMillis)) {
+        pipelineMetrics.countDropped(signal);
+    }
+}
+
+void RmtSignalLogger::taskEntry(void* param) {
+    static_cast<RmtSignalLogger*>(param)->run();
+}
+
+bool IRAM_ATTR RmtSignalLogger::onReceiveDone(rmt_channel_handle_t, const rmt_rx_done_event_data_t* data, void* context) {
+    // Timestamp first, the whole train is dated from it
+    int64_t now = esp_timer_get_time();
+    
+    Channel* channel = static_cast<Channel*>(context);
+    Reception reception = {channel, channel->activeBuffer, static_cast<uint16_t>(data->num_symbols), now};
+    
+    BaseType_t higherPriorityTaskWoken = pdFALSE;
+    xQueueSendFromISR(channel->owner->receptions, &reception, &higherPriorityTaskWoken);
+    return higherPriorityTaskWoken == pdTRUE;
+}
@@ -1,107 +1,502 @@
 #include "SDCardManager.h"
-#include <SPI.h>
+#include <esp_timer.h>
+#include <stdio.h>
+#include <stdlib.h>
 
-SDCardManager::SDCardManager(RingBuffer& buffer) : eventBuffer(buffer) {
+namespace {
+    // Append the decimal representation of value, return the end of the text
+    char* appendDecimal(char* out, uint32_t value) {
+        char digits[10];
+        size_t count = 0;
+        do {
+            digits[count++] = '0' + (value % 10);
+            value /= 10;
+        } while (value > 0);
+        while (count > 0) {
+            *out++ = digits[--count];
+        }
+        return out;
+    }
+    
+    // Append the decimal representation of a signed value
+    char* appendInteger(char* out, int32_t value) {
+        if (value < 0) {
+            *out++ = '-';
+            return appendDecimal(out, 0U - static_cast<uint32_t>(value));
+        }
+        return appendDecimal(out, value);
+    }
+    
+    // Append a NUL-terminated string, return the end of the text
+    char* appendString(char* out, const char* text) {
+        while (*text) {
+            *out++ = *text++;
+        }
+        return out;
+    }
+}
+
+SDCardManager::SDCardManager(RingBuffer& buffer, EventPipeline& pipeline, PipelineMetrics& metrics)
+    : eventBuffer(buffer), eventPipeline(pipeline), pipelineMetrics(metrics), cardPresence(metrics) {
     // Nothing else to initialize
 }
 
 bool SDCardManager::begin() {
-    // Configure SPI pins for SD card
-    SPI.begin(Pins::SD_CLK, Pins::SD_MISO, Pins::SD_MOSI, Pins::SD_CS);
+    sessionTracker.begin();
     
-    // Initialize SD card
-    cardInitialized = SD.begin(Pins::SD_CS);
-    
-    return cardInitialized;
+    // Mount the SD card if present
+    return cardPresence.begin();
 }
 
-bool SDCardManager::isCardPresent() {
-    // Try to reinitialize if not already initialized
-    if (!cardInitialized) {
-        cardInitialized = SD.begin(Pins::SD_CS);
-    }
-    
-    return cardInitialized;
+bool SDCardManager::isCardPresent() const {
+    return cardPresence.isReady();
+}
+
+CardState SDCardManager::getCardState() const {
+    return cardPresence.getState();
 }
 
-bool SDCardManager::saveEvents() {
+bool SDCardManager::saveEvents(bool sync) {
+    uint32_t startTime = micros();
+    
     // Check if SD card is available
-    if (!isCardPresent()) {
+    if (!checkCard()) {
         return false;
     }
     
-    // Prepare the data file
-    if (!prepareDataFile()) {
+    // Open the data file, if not already open
+    if (!openDataFile()) {
         return false;
     }
+    uint32_t startSize = fileSize;
+    
+    // Queued records go after every event captured until now, which the drain
+    // below takes out of the ring buffer
+    int64_t now = esp_timer_get_time();
+    
+    // Format events in the configured format, writing whole sectors as the
+    // staging buffer fills up. The ring buffer holds events of this boot
+    bool success = setResumedEvents(false) && stageBufferedEvents();
+    
+    // Queued records go right after the events drained so far
+    if (success && numQueuedRecords > 0) {
+        success = stageQueuedRecords(now);
+    }
     
-    // If buffer is empty, nothing to do
-    if (eventBuffer.isEmpty()) {
+    // The binary block being filled is only closed at sync points
+    if (success && sync && !blockEncoder.isEmpty()) {
+        success = stageBlock();
+    }
+    
+    // Write out what is staged, down to the last byte on sync points
+    if (success) {
+        success = writeStaged(sync);
+    }
+    if (success && sync) {
+        dataFile.flush();
+        success = updateIndex();
+    }
+    
+    // Measure the flush
+    lastFlushStats.bytesWritten = fileSize - startSize;
+    lastFlushStats.durationUs = micros() - startTime;
+    lastFlushStats.bytesPerSecond = lastFlushStats.durationUs > 0
+        ? static_cast<uint32_t>(1000000ULL * lastFlushStats.bytesWritten / lastFlushStats.durationUs)
+        : 0;
+    pipelineMetrics.addFlush(lastFlushStats.bytesWritten, lastFlushStats.durationUs);
+    
+    return success;
+}
+
+size_t SDCardManager::saveEvents(const EventEntry* events, size_t numEvents, bool resumed) {
+    // Check if SD card is available and the data file open
+    if (!checkCard() || !openDataFile() || !setResumedEvents(resumed)) {
+        return 0;
+    }
+    
+    return stageEvents(events, numEvents);
+}
+
+bool SDCardManager::queueRecord(const LogRecord& record) {
+    if (numQueuedRecords == MAX_QUEUED_RECORDS) {
+        return false;
+    }
+    queuedRecords[numQueuedRecords++] = record;
+    return true;
+}
+
+bool SDCardManager::hasStagedData() const {
+    return numQueuedRecords > 0 || !eventPipeline.isEmpty() || stagedBytes > 0 || !blockEncoder.isEmpty();
+}
+
+const FlushStats& SDCardManager::getLastFlushStats() const {
+    return lastFlushStats;
+}
+
+bool SDCardManager::checkCard() {
+    if (cardPresence.update()) {
         return true;
     }
     
-    // Open the file for appending
-    File dataFile = SD.open(BufferConfig::DATA_FILE_PATH, FILE_APPEND);
+    // A removed card takes its file along, the next card gets its own
+    dataFile.close();
+    fileNumber = 0;
+    return false;
+}
+
+bool SDCardManager::openDataFile() {
+    if (dataFile) {
+        return true; // Still open from a previous flush
+    }
+    
+    // First file since the card was mounted
+    if (fileNumber == 0 && !selectDataFile()) {
+        return false;
+    }
+    
+    // Open the file for appending, creating it if needed
+    dataFile = SD.open(dataPath, FILE_APPEND);
     if (!dataFile) {
         return false;
     }
+    fileSize = dataFile.size();
     
-    // Process events in batches to avoid large memory allocations
-    constexpr size_t BATCH_SIZE = 64;
-    EventEntry eventBatch[BATCH_SIZE];
-    char csvLine[64]; // Buffer for CSV line (should be plenty for "XX,Y,4294967295\n")
+    // New CSV file, write header (binary files have none)
+    if (fileSize == 0 && BufferConfig::LOG_FORMAT == LOG_FORMAT_CSV) {
+        size_t headerSize = dataFile.println(BufferConfig::CSV_HEADER);
+        if (headerSize == 0) {
+            handleWriteError();
+            return false;
+        }
+        fileSize += headerSize;
+    }
     
-    size_t eventsRead;
-    bool success = true;
+    // The block being indexed continues from here, after a session record
+    logIndex.begin(fileSize);
+    sessionTracker.startFile();
+    return true;
+}
+
+bool SDCardManager::selectDataFile() {
+    File directory = SD.open(LogFileConfig::DIRECTORY);
+    if (!directory) {
+        SD.mkdir(LogFileConfig::DIRECTORY);
+        directory = SD.open(LogFileConfig::DIRECTORY);
+    }
+    if (!directory || !directory.isDirectory()) {
+        return false;
+    }
     
-    do {
-        // Read a batch of events from the buffer
-        eventsRead = eventBuffer.read(eventBatch, BATCH_SIZE);
+    // Highest numbered data file, the directory is not sorted
+    uint32_t lastNumber = 0;
+    File entry;
+    while ((entry = directory.openNextFile())) {
+        // Older cores give the full path
+        const char* name = entry.name();
+        const char* slash = strrchr(name, '/');
+        if (slash) {
+            name = slash + 1;
+        }
         
-        // Process each event in the batch
-        for (size_t i = 0; i < eventsRead; i++) {
-            // Convert event to CSV
-            eventToCSV(eventBatch[i], csvLine, sizeof(csvLine));
-            
-            // Write to file
-            if (dataFile.println(csvLine) == 0) {
-                success = false;
+        char* end;
+        uint32_t number = strtoul(name, &end, 10);
+        if (end != name && strcmp(end, LogFileConfig::DATA_EXTENSION) == 0 && number > lastNumber) {
+            lastNumber = number;
+        }
+    }
+    
+    setFileNumber(LogFileConfig::NEW_FILE_PER_SESSION || lastNumber == 0 ? lastNumber + 1 : lastNumber);
+    return true;
+}
+
+void SDCardManager::setFileNumber(uint32_t number) {
+    fileNumber = number;
+    snprintf(dataPath, sizeof(dataPath), "%s/%05lu%s", LogFileConfig::DIRECTORY,
+             static_cast<unsigned long>(number), LogFileConfig::DATA_EXTENSION);
+    snprintf(indexPath, sizeof(indexPath), "%s/%05lu%s", LogFileConfig::DIRECTORY,
+             static_cast<unsigned long>(number), LogFileConfig::INDEX_EXTENSION);
+}
+
+bool SDCardManager::updateIndex() {
+    // Everything staged is on the card: the block ends at the file size
+    bool full = fileSize >= LogFileConfig::MAX_FILE_SIZE;
+    if ((full && !logIndex.isEmpty()) || logIndex.isComplete(fileSize)) {
+        if (!logIndex.write(indexPath, fileSize)) {
+            handleWriteError();
+            return false;
+        }
+    }
+    
+    // Next data file, opened by the next save
+    if (full) {
+        dataFile.close();
+        setFileNumber(fileNumber + 1);
+    }
+    return true;
+}
+
+void SDCardManager::handleWriteError() {
+    // Most likely the card was removed: the next save looks for it again,
+    // staged data is kept for the next card
+    dataFile.close();
+    fileNumber = 0;
+    cardPresence.handleError();
+}
+
+bool SDCardManager::stageBufferedEvents() {
+    // Drain the buffer in place, one contiguous span at a time
+    const EventEntry* events;
+    size_t eventsAvailable;
+    
+    while ((eventsAvailable = eventBuffer.readSpan(events)) > 0) {
+        size_t eventsStaged = stageEvents(events, eventsAvailable);
+        
+        // Staged events now live in the pipeline, the staging buffer or the
+        // binary block
+        eventBuffer.commit(eventsStaged);
+        
+        if (eventsStaged < eventsAvailable) {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+bool SDCardManager::setResumedEvents(bool resumed) {
+    if (resumed == resumedEvents) {
+        return true;
+    }
+    
+    // Placeholder session record, the tracker switches timelines on it
+    LogRecord boundary = {};
+    boundary.type = RECORD_SESSION;
+    boundary.fields[0] = resumed ? 1 : 0;
+    if (!eventPipeline.pushRecord(boundary)) {
+        if (!stagePipeline() || !eventPipeline.pushRecord(boundary)) {
+            return false;
+        }
+    }
+    resumedEvents = resumed;
+    return true;
+}
+
+bool SDCardManager::stageQueuedRecords(int64_t now) {
+    // Same time base as the events, and not before the events drained after
+    // now: the rows stay in time order
+    EventEntry stamp = {};
+    stamp.timestamp = static_cast<uint32_t>(now / 1000);
+    stamp.micros = Timing::HIGH_RESOLUTION_TIMESTAMPS ? static_cast<uint16_t>(now % 1000) : 0;
+    if (hasLastEvent && eventDeltaUs(stamp, lastEvent) > 0) {
+        stamp = lastEvent;
+    }
+    
+    size_t recordsStaged = 0;
+    while (recordsStaged < numQueuedRecords) {
+        LogRecord& record = queuedRecords[recordsStaged];
+        record.timestamp = stamp.timestamp;
+        record.micros = stamp.micros;
+        
+        // Pipeline full: write out what is ready and try again
+        if (!eventPipeline.pushRecord(record)) {
+            if (!stagePipeline() || !eventPipeline.pushRecord(record)) {
                 break;
             }
         }
-    } while (eventsRead > 0 && success);
+        recordsStaged++;
+    }
     
-    // Close the file
-    dataFile.close();
+    // Keep the records left for the next flush, all the record slots may be
+    // taken by frames being decoded
+    memmove(queuedRecords, queuedRecords + recordsStaged, (numQueuedRecords - recordsStaged) * sizeof(LogRecord));
+    numQueuedRecords -= recordsStaged;
     
-    return success;
+    return stagePipeline();
 }
 
-bool SDCardManager::prepareDataFile() {
-    // Check if file exists
-    if (SD.exists(BufferConfig::DATA_FILE_PATH)) {
-        return true; // File exists, no header needed
+size_t SDCardManager::stageEvents(const EventEntry* events, size_t numEvents) {
+    // Retry what is left over by a failed write first
+    if (!stagePipeline()) {
+        return 0;
     }
     
-    // Create new file and write header
-    File dataFile = SD.open(BufferConfig::DATA_FILE_PATH, FILE_WRITE);
-    if (!dataFile) {
+    size_t eventsStaged = 0;
+    while (eventsStaged < numEvents) {
+        // Pipeline full: write out what is ready, it gives up the oldest frame
+        // if nothing is
+        if (!eventPipeline.push(events[eventsStaged])) {
+            if (!stagePipeline()) {
+                break;
+            }
+            continue;
+        }
+        
+        // Events of the previous boot have their own timeline
+        if (!resumedEvents) {
+            lastEvent = events[eventsStaged];
+            hasLastEvent = true;
+        }
+        eventsStaged++;
+        
+        // The event now belongs to the pipeline, even if staging fails
+        if (!stagePipeline()) {
+            break;
+        }
+    }
+    
+    return eventsStaged;
+}
+
+bool SDCardManager::stagePipeline() {
+    // Retry a block left over by a failed write first
+    if (blockEncoder.isSealed() && !stageBlock()) {
         return false;
     }
     
-    // Write header
-    bool success = (dataFile.println(BufferConfig::CSV_HEADER) > 0);
+    LogItem item;
+    while (eventPipeline.next(item)) {
+        if (!stageItem(item)) {
+            return false;
+        }
+        eventPipeline.pop();
+    }
+    return true;
+}
+
+bool SDCardManager::stageItem(const LogItem& item) {
+    // Boundary between the events of the previous boot and this one's, only
+    // for the tracker
+    if (item.record && item.record->type == RECORD_SESSION) {
+        sessionTracker.setResuming(item.record->fields[0] != 0);
+        return true;
+    }
     
-    // Close file
-    dataFile.close();
+    // Start of a file, millis() wrap...
+    LogRecord session;
+    if (sessionTracker.check(item, session)) {
+        if (!formatItem({nullptr, &session})) {
+            return false;
+        }
+        
+        // Staged: not written again if the item has to be retried
+        sessionTracker.update(item);
+    }
     
-    return success;
+    if (!formatItem(item)) {
+        return false;
+    }
+    sessionTracker.update(item);
+    return true;
+}
+
+bool SDCardManager::formatItem(const LogItem& item) {
+    if (BufferConfig::LOG_FORMAT == LOG_FORMAT_BINARY) {
+        // Block is full, stage it and start the next one
+        while (!(item.record ? blockEncoder.append(*item.record) : blockEncoder.append(*item.event))) {
+            if (!stageBlock()) {
+                return false;
+            }
+        }
+    } else {
+        // Make room for the line by writing out the whole sectors
+        if (sizeof(staging) - stagedBytes < MAX_CSV_LINE && !writeStaged(false)) {
+            return false;
+        }
+        
+        // Convert to CSV, straight into the staging buffer
+        char* line = reinterpret_cast<char*>(staging + stagedBytes);
+        stagedBytes += item.record ? recordToCSV(*item.record, line) : eventToCSV(*item.event, line);
+    }
+    
+    if (item.record) {
+        logIndex.add(*item.record);
+    } else {
+        logIndex.add(*item.event);
+    }
+    return true;
+}
+
+bool SDCardManager::stageBlock() {
+    size_t blockSize = blockEncoder.seal();
+    
+    // Make room for the block by writing out the whole sectors
+    if (sizeof(staging) - stagedBytes < blockSize && !writeStaged(false)) {
+        return false;
+    }
+    
+    memcpy(staging + stagedBytes, blockEncoder.data(), blockSize);
+    stagedBytes += blockSize;
+    blockEncoder.clear();
+    return true;
+}
+
+bool SDCardManager::writeStaged(bool all) {
+    size_t length = stagedBytes;
+    
+    // Stop at the last sector boundary of the file
+    if (!all) {
+        size_t end = fileSize + stagedBytes;
+        size_t alignedEnd = end - (end % BufferConfig::SD_SECTOR_SIZE);
+        length = alignedEnd > fileSize ? alignedEnd - fileSize : 0;
+    }
+    if (length == 0) {
+        return true;
+    }
+    
+    size_t written = dataFile.write(staging, length);
+    
+    // Keep whatever did not make it to the card
+    memmove(staging, staging + written, stagedBytes - written);
+    stagedBytes -= written;
+    fileSize += written;
+    
+    if (written != length) {
+        handleWriteError();
+        return false;
+    }
+    return true;
 }
 
-void SDCardManager::eventToCSV(const EventEntry& entry, char* buffer, size_t bufferSize) {
-    // Format: "XX,Y,timestamp" (Signal, Edge, Timestamp)
-    snprintf(buffer, bufferSize, "%s,%s,%lu", 
-        signalTypeToString(static_cast<SignalType>(entry.signalType)),
-        edgeTypeToString(static_cast<EdgeType>(entry.edgeType)),
-        entry.timestamp);
-}
\ No newline at end of file
+size_t SDCardManager::eventToCSV(const EventEntry& entry, char* buffer) {
+    // Format: "XX,Y,timestamp[,micros]" (Signal, Edge, Timestamp[, Micros])
+    char* end = buffer;
+    end = appendString(end, signalTypeToString(static_cast<SignalType>(entry.signalType)));
+    *end++ = ',';
+    end = appendString(end, edgeTypeToString(static_cast<EdgeType>(entry.edgeType)));
+    *end++ = ',';
+    end = appendDecimal(end, entry.timestamp);
+    if (Timing::HIGH_RESOLUTION_TIMESTAMPS) {
+        *end++ = ',';
+        end = appendDecimal(end, entry.micros);
+    }
+    
+    // Same line ending as println()
+    *end++ = '\r';
+    *end++ = '\n';
+    
+    return end - buffer;
+}
+
+size_t SDCardManager::recordToCSV(const LogRecord& record, char* buffer) {
+    // Format: "XX,,timestamp[,micros],field..." (record name in the Signal
+    // column, no Edge)
+    char* end = buffer;
+    end = appendString(end, recordTypeToString(static_cast<RecordType>(record.type)));
+    *end++ = ',';
+    *end++ = ',';
+    end = appendDecimal(end, record.timestamp);
+    if (Timing::HIGH_RESOLUTION_TIMESTAMPS) {
+        *end++ = ',';
+        end = appendDecimal(end, record.micros);
+    }
+    for (size_t i = 0; i < record.numFields && i < MAX_RECORD_FIELDS; i++) {
+        *end++ = ',';
+        end = appendInteger(end, record.fields[i]);
+    }
+    
+    // Same line ending as println()
+    *end++ = '\r';
+    *end++ = '\n';
+    
+    return end - buffer;
+}
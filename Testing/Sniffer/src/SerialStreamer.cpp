@@ -0,0 +1,102 @@
+#include "SerialStreamer.h"
+#include "TriggerCapture.h"
+#include <string.h>
+
+SerialStreamer::SerialStreamer(RingBuffer& buffer, Print& output) : eventBuffer(buffer), out(output) {
+    // Nothing else to initialize
+}
+
+size_t SerialStreamer::streamEvents() {
+    // Drain the buffer in place, one contiguous span at a time
+    const EventEntry* events;
+    size_t eventsAvailable;
+    size_t eventsStreamed = 0;
+    
+    while ((eventsAvailable = eventBuffer.readSpan(events)) > 0) {
+        size_t eventsEncoded = 0;
+        while (eventsEncoded < eventsAvailable) {
+            // Trigger markers go out as their record
+            const EventEntry& event = events[eventsEncoded];
+            bool encoded = TriggerCapture::isMarker(event) ? blockEncoder.append(TriggerCapture::toRecord(event))
+                                                           : blockEncoder.append(event);
+            if (!encoded) {
+                break;
+            }
+            eventsEncoded++;
+        }
+        
+        // Encoded events now live in the block, make room for the producer
+        // before the frame goes out
+        eventBuffer.commit(eventsEncoded);
+        eventsStreamed += eventsEncoded;
+        
+        // Block full, or the next event goes back in time and starts a new one
+        if (eventsEncoded < eventsAvailable) {
+            sendBlock();
+        }
+    }
+    
+    // Don't keep the last events for the next call, latency matters more
+    // than frame size here
+    if (!blockEncoder.isEmpty()) {
+        sendBlock();
+    }
+    
+    eventsSent += eventsStreamed;
+    return eventsStreamed;
+}
+
+void SerialStreamer::printReport() const {
+    Serial.printf("Stream: %lu frames, %lu events, %llu KB sent\n", static_cast<unsigned long>(framesSent),
+        static_cast<unsigned long>(eventsSent), static_cast<unsigned long long>(bytesSent / 1024));
+}
+
+void SerialStreamer::sendBlock() {
+    size_t blockSize = blockEncoder.seal();
+    
+    FrameHeader& header = *reinterpret_cast<FrameHeader*>(frame);
+    header.type = FRAME_EVENTS;
+    header.sequence = sequence++;
+    header.droppedCount = eventBuffer.getDroppedCount();
+    memcpy(frame + sizeof(FrameHeader), blockEncoder.data(), blockSize);
+    blockEncoder.clear();
+    
+    size_t frameSize = sizeof(FrameHeader) + blockSize;
+    uint32_t crc = BinaryLog::crc32(frame, frameSize);
+    memcpy(frame + frameSize, &crc, sizeof(crc));
+    frameSize += sizeof(crc);
+    
+    // Delimiters on both sides, the receiver resynchronizes on any of them
+    size_t encodedSize = 0;
+    encoded[encodedSize++] = 0;
+    encodedSize += encodeCobs(frame, frameSize, encoded + encodedSize);
+    encoded[encodedSize++] = 0;
+    
+    // Blocks while the UART catches up, the ring buffer absorbs the events
+    // captured meanwhile
+    out.write(encoded, encodedSize);
+    framesSent++;
+    bytesSent += encodedSize;
+}
+
+size_t SerialStreamer::encodeCobs(const uint8_t* data, size_t length, uint8_t* output) {
+    // Each group starts with a code byte: the distance to the next zero (the
+    // zero itself is dropped), 0xFF for 254 bytes without zero
+    size_t codeIndex = 0;
+    size_t size = 1;
+    uint8_t code = 1;
+    
+    for (size_t i = 0; i < length; i++) {
+        if (data[i] != 0) {
+            output[size++] = data[i];
+            code++;
+        }
+        if (data[i] == 0 || code == 0xFF) {
+            output[codeIndex] = code;
+            code = 1;
+            codeIndex = size++;
+        }
+    }
+    output[codeIndex] = code;
+    return size;
+}
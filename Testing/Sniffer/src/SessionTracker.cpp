@@ -0,0 +1,150 @@
+#include "SessionTracker.h"
+#include <Preferences.h>
+
+namespace {
+    // Days from 1970-01-01 to a date of the proleptic Gregorian calendar
+    int64_t daysFromCivil(int32_t year, int32_t month, int32_t day) {
+        year -= month <= 2;
+        int32_t era = (year >= 0 ? year : year - 399) / 400;
+        int32_t yearOfEra = year - era * 400;
+        int32_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+        int32_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+        return static_cast<int64_t>(era) * 146097 + dayOfEra - 719468;
+    }
+    
+    uint32_t itemTimestamp(const LogItem& item) {
+        return item.record ? item.record->timestamp : item.event->timestamp;
+    }
+}
+
+void SessionTracker::begin() {
+    Preferences preferences;
+    if (!preferences.begin(NVS_NAMESPACE)) {
+        return;
+    }
+    previous.bootCount = preferences.getUInt(NVS_BOOT_COUNT, 0);
+    previous.epoch = preferences.getUInt(NVS_EPOCH, 0);
+    current.bootCount = previous.bootCount + 1;
+    preferences.putUInt(NVS_BOOT_COUNT, current.bootCount);
+    if (previous.epoch != 0) {
+        preferences.putUInt(NVS_EPOCH, 0);
+    }
+    preferences.end();
+}
+
+void SessionTracker::startFile() {
+    pending = true;
+}
+
+void SessionTracker::setResuming(bool resume) {
+    if (resume != resuming) {
+        resuming = resume;
+        pending = true;
+    }
+}
+
+bool SessionTracker::check(const LogItem& item, LogRecord& record) const {
+    const Timeline& timeline = active();
+    uint32_t timestamp = itemTimestamp(item);
+    bool wrapped = isWrapped(timeline, timestamp);
+    int64_t minuteUnix = !resuming && !hasAnchor && item.record ? minuteToUnix(*item.record) : -1;
+    if (!pending && !wrapped && minuteUnix < 0) {
+        return false;
+    }
+    
+    // Same time as the item, on the epoch of the item
+    uint32_t itemEpoch = timeline.epoch + (wrapped ? 1 : 0);
+    uint64_t time = (static_cast<uint64_t>(itemEpoch) << 32) | timestamp;
+    int64_t unixTime = 0;
+    if (minuteUnix >= 0) {
+        unixTime = minuteUnix;
+    } else if (hasAnchor && !resuming) {
+        unixTime = anchorUnix + static_cast<int64_t>(time - anchorTime) / 1000;
+    }
+    
+    SessionReason reason = SESSION_ANCHOR;
+    if (resuming) {
+        reason = pending ? SESSION_RESUME : SESSION_WRAP;
+    } else if (!booted) {
+        reason = SESSION_BOOT;
+    } else if (pending) {
+        reason = SESSION_FILE;
+    } else if (wrapped) {
+        reason = SESSION_WRAP;
+    }
+    
+    record = {};
+    record.type = RECORD_SESSION;
+    record.numFields = 4;
+    record.micros = item.record ? item.record->micros : item.event->micros;
+    record.timestamp = timestamp;
+    record.fields[0] = static_cast<int32_t>(timeline.bootCount);
+    record.fields[1] = static_cast<int32_t>(itemEpoch);
+    record.fields[2] = reason;
+    record.fields[3] = static_cast<int32_t>(unixTime);
+    return true;
+}
+
+void SessionTracker::update(const LogItem& item) {
+    Timeline& timeline = resuming ? previous : current;
+    uint32_t timestamp = itemTimestamp(item);
+    if (isWrapped(timeline, timestamp)) {
+        timeline.epoch++;
+        if (!resuming) {
+            saveEpoch();
+        }
+    }
+    
+    // Records stamped when queued can be slightly behind the events
+    if (!timeline.hasTime || static_cast<int32_t>(timestamp - timeline.lastTimestamp) > 0) {
+        timeline.lastTimestamp = timestamp;
+        timeline.hasTime = true;
+    }
+    pending = false;
+    if (resuming) {
+        return;
+    }
+    booted = true;
+    
+    // Latest valid minute, the closest anchor
+    int64_t minuteUnix = item.record ? minuteToUnix(*item.record) : -1;
+    if (minuteUnix >= 0) {
+        hasAnchor = true;
+        anchorUnix = minuteUnix;
+        anchorTime = (static_cast<uint64_t>(timeline.epoch) << 32) | timestamp;
+    }
+}
+
+bool SessionTracker::isWrapped(const Timeline& timeline, uint32_t timestamp) {
+    // Earlier as unsigned, but ahead within half the range: past the wrap
+    return timeline.hasTime && timestamp < timeline.lastTimestamp
+        && static_cast<int32_t>(timestamp - timeline.lastTimestamp) > 0;
+}
+
+void SessionTracker::saveEpoch() const {
+    // Once every 49.7 days
+    Preferences preferences;
+    if (preferences.begin(NVS_NAMESPACE)) {
+        preferences.putUInt(NVS_EPOCH, current.epoch);
+        preferences.end();
+    }
+}
+
+int64_t SessionTracker::minuteToUnix(const LogRecord& record) {
+    if (record.type != RECORD_DCF77_MINUTE || record.fields[0] != 1) {
+        return -1;
+    }
+    
+    // Local time, CEST is UTC+2 and CET UTC+1
+    const int32_t* fields = record.fields;
+    int32_t utcOffset = (fields[7] & 0x01) ? 2 : (fields[7] & 0x02) ? 1 : 0;
+    if (utcOffset == 0) {
+        return -1;
+    }
+    int64_t minute = daysFromCivil(2000 + fields[6], fields[5], fields[3]) * 1440
+        + (fields[2] - utcOffset) * 60 + fields[1];
+    
+    // The record is at the first pulse of the telegram, a minute before the
+    // minute it holds
+    return (minute - 1) * 60;
+}
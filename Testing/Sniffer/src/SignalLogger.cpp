@@ -1,101 +1,133 @@
 #include "SignalLogger.h"
+#include <esp_timer.h>
+#include <esp_cpu.h>
+#include <soc/soc.h>
+#include <soc/gpio_reg.h>
+
+namespace {
+    // Bit of a signal in the input snapshot
+    constexpr uint64_t signalBit(uint8_t signal) {
+        return 1ULL << Signals::TABLE[signal].pin;
+    }
+    
+    // Levels of the signal pins, only the registers holding some are read
+    inline uint64_t IRAM_ATTR readLevels() {
+        uint64_t levels = 0;
+        if (Signals::GPIO_IN_MASK != 0) {
+            levels |= REG_READ(GPIO_IN_REG) & Signals::GPIO_IN_MASK;
+        }
+        if (Signals::GPIO_IN1_MASK != 0) {
+            levels |= static_cast<uint64_t>(REG_READ(GPIO_IN1_REG) & Signals::GPIO_IN1_MASK) << 32;
+        }
+        return levels;
+    }
+}
 
 // Initialize static instance pointer
 SignalLogger* SignalLogger::instance = nullptr;
 
-SignalLogger::SignalLogger(RingBuffer& buffer) : eventBuffer(buffer) {
+SignalLogger::SignalLogger(RingBuffer& buffer, PipelineMetrics& metrics)
+    : eventBuffer(buffer), pipelineMetrics(metrics), triggerCapture(buffer, metrics) {
     // Store instance pointer for ISR access
     instance = this;
 }
 
 void SignalLogger::begin() {
     // Set up pins for input
-    pinMode(Pins::sigRF, INPUT_PULLUP);
-    pinMode(Pins::sigMU, INPUT_PULLUP);
-    pinMode(Pins::sigPON, INPUT_PULLUP);
-    pinMode(Pins::sigBA, INPUT_PULLUP);
+    for (const SignalChannel& channel : Signals::TABLE) {
+        if (channel.enabled) {
+            pinMode(channel.pin, channel.mode);
+        }
+    }
     
     // Initialize last pin states
-    lastPinState[RF_SIGNAL] = digitalRead(Pins::sigRF);
-    lastPinState[MU_SIGNAL] = digitalRead(Pins::sigMU);
-    lastPinState[PON_SIGNAL] = digitalRead(Pins::sigPON);
-    lastPinState[BA_SIGNAL] = digitalRead(Pins::sigBA);
+    lastLevels = readLevels();
     
     // Set up interrupts for all signals (always active)
     setupInterrupts();
 }
 
 void SignalLogger::setupInterrupts() {
-    // Set up interrupts for all signals
-    enableInterrupt(Pins::sigRF);
-    enableInterrupt(Pins::sigMU);
-    enableInterrupt(Pins::sigPON);
-    enableInterrupt(Pins::sigBA);
+    // Set up interrupts for all enabled signals
+    for (const SignalChannel& channel : Signals::TABLE) {
+        if (channel.enabled) {
+            enableInterrupt(channel.pin);
+        }
+    }
 }
 
 void SignalLogger::enableInterrupt(uint8_t pin) {
-    // Attach interrupt for both rising and falling edges
-    attachInterrupt(digitalPinToInterrupt(pin), 
-        pin == Pins::sigRF ? handleRF : 
-        pin == Pins::sigMU ? handleMU :
-        pin == Pins::sigPON ? handlePON : 
-        handleBA, CHANGE);
+    // Attach interrupt for both rising and falling edges, all signals share
+    // the same handler
+    attachInterrupt(digitalPinToInterrupt(pin), handleEdges, CHANGE);
 }
 
 void SignalLogger::disableInterrupt(uint8_t pin) {
     detachInterrupt(digitalPinToInterrupt(pin));
 }
 
-void IRAM_ATTR SignalLogger::handleRF() {
-    if (instance) {
-        instance->processInterrupt(RF_SIGNAL, digitalRead(Pins::sigRF) ? EDGE_RISING : EDGE_FALLING);
-    }
-}
-
-void IRAM_ATTR SignalLogger::handleMU() {
-    if (instance) {
-        instance->processInterrupt(MU_SIGNAL, digitalRead(Pins::sigMU) ? EDGE_RISING : EDGE_FALLING);
-    }
-}
-
-void IRAM_ATTR SignalLogger::handlePON() {
-    if (instance) {
-        instance->processInterrupt(PON_SIGNAL, digitalRead(Pins::sigPON) ? EDGE_RISING : EDGE_FALLING);
-    }
-}
-
-void IRAM_ATTR SignalLogger::handleBA() {
+void IRAM_ATTR SignalLogger::handleEdges() {
     if (instance) {
-        instance->processInterrupt(BA_SIGNAL, digitalRead(Pins::sigBA) ? EDGE_RISING : EDGE_FALLING);
+        instance->processInterrupt();
     }
 }
 
-void SignalLogger::processInterrupt(SignalType signal, EdgeType edge) {
-    // Get current timestamp
-    uint32_t timestamp = millis();
+void IRAM_ATTR SignalLogger::processInterrupt() {
+    // Start of the capture latency, in CPU cycles
+    uint32_t startCycles = esp_cpu_get_cycle_count();
     
-    // Get the current digital state
-    bool currentState = (edge == EDGE_RISING) ? HIGH : LOW;
+    // Levels of all signals in one read, and the current timestamp, same time
+    // base as millis() but in microseconds
+    uint64_t levels = readLevels();
+    int64_t now = esp_timer_get_time();
     
-    // Validate that this is actually a state change
-    if (currentState == lastPinState[signal]) {
-        // Current state is the same as last recorded state
-        // This is likely a spurious interrupt, so ignore it
+    // Nothing changed: spurious interrupt, or edges already logged by the
+    // interrupt of another pin
+    uint64_t changed = levels ^ lastLevels;
+    if (changed == 0) {
         return;
     }
     
-    // Check for glitches (transitions too close together)
-    if ((timestamp - lastInterruptTime[signal]) <= MIN_PULSE_WIDTH && lastInterruptTime[signal] > 0) {
-        // This transition happened very quickly after the last one
-        // Only filter if it's unreasonably fast (below system resolution)
+    // Split the timestamp into the millis() value and its sub-millisecond part
+    uint32_t timestamp = static_cast<uint32_t>(now / 1000);
+    uint16_t subMillis = Timing::HIGH_RESOLUTION_TIMESTAMPS ? static_cast<uint16_t>(now % 1000) : 0;
+    
+    EventEntry events[Signals::COUNT];
+    size_t numEvents = 0;
+    for (uint8_t signal = 0; signal < Signals::COUNT; signal++) {
+        uint64_t bit = signalBit(signal);
+        if (!Signals::TABLE[signal].enabled || !(changed & bit)) {
+            continue;
+        }
+        
+        // Check for glitches (transitions too close together)
+        int64_t minPulseWidth = Signals::TABLE[signal].minPulseWidthUs;
+        if ((now - lastInterruptTime[signal]) < minPulseWidth && lastInterruptTime[signal] > 0) {
+            // This transition happened very quickly after the last one, keep
+            // the previous level: the edge back is not a change then
+            pipelineMetrics.countRejected(static_cast<SignalType>(signal));
+            continue;
+        }
+        
+        // This appears to be a legitimate state change
+        // Update last state and time
+        lastLevels ^= bit;
+        lastInterruptTime[signal] = now;
+        events[numEvents++] = {signal, static_cast<uint8_t>((levels & bit) ? EDGE_RISING : EDGE_FALLING),
+                               subMillis, timestamp};
+    }
+    if (numEvents == 0) {
         return;
     }
     
-    // This appears to be a legitimate state change
-    // Update last state and time
-    lastPinState[signal] = currentState;
-    lastInterruptTime[signal] = timestamp;
-    
-    // Write to buffer
-    eventBuffer.write(signal, edge, timestamp);
-}
\ No newline at end of file
+    // Write to buffer, all the edges at once, or hold them until a trigger
+    if (TriggerConfig::ENABLE) {
+        triggerCapture.write(events, numEvents, now);
+    } else {
+        size_t eventsWritten = eventBuffer.write(events, numEvents);
+        for (size_t i = eventsWritten; i < numEvents; i++) {
+            pipelineMetrics.countDropped(static_cast<SignalType>(events[i].signalType));
+        }
+    }
+    pipelineMetrics.addCaptureLatency(esp_cpu_get_cycle_count() - startCycles);
+}
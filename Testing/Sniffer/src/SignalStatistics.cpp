@@ -0,0 +1,204 @@
+#include "SignalStatistics.h"
+#include <string.h>
+
+SignalStatistics::SignalStatistics(EventPipeline& eventPipeline) : pipeline(eventPipeline) {
+    clearPeriod(periods[0]);
+    clearPeriod(periods[1]);
+}
+
+uint8_t SignalStatistics::process(const EventEntry& event) {
+    if (!started) {
+        periodStart = event;
+        started = true;
+    }
+    
+    // Close the period on the first event past its end
+    int64_t elapsedUs = eventDeltaUs(periodStart, event);
+    if (elapsedUs >= static_cast<int64_t>(StatisticsConfig::SUMMARY_INTERVAL) * 1000) {
+        closePeriod(event);
+    }
+    
+    // Records of the closed period, one per event as the pipeline only has
+    // room for one record per decoder
+    if (reporting) {
+        writeReport();
+    }
+    
+    if (event.signalType >= NUM_SIGNALS) {
+        return EventPipeline::NO_OWNER;
+    }
+    SignalState& state = signals[event.signalType];
+    SignalPeriod& period = periods[current][event.signalType];
+    period.edges++;
+    state.totalEdges++;
+    
+    // The edge ends a pulse of the opposite level, unless an edge was lost
+    if (state.seen && state.lastEdge.edgeType != event.edgeType) {
+        int64_t width = eventDeltaUs(state.lastEdge, event);
+        uint32_t widthUs = width < 0 ? 0
+            : width > MAX_WIDTH_US ? MAX_WIDTH_US
+            : static_cast<uint32_t>(width);
+        
+        PulseHistogram& histogram = period.pulses[event.edgeType == EDGE_FALLING ? HIGH : LOW];
+        histogram.bins[binOf(widthUs)]++;
+        histogram.count++;
+        histogram.totalUs += widthUs;
+        histogram.minUs = widthUs < histogram.minUs ? widthUs : histogram.minUs;
+        histogram.maxUs = widthUs > histogram.maxUs ? widthUs : histogram.maxUs;
+    }
+    state.seen = true;
+    state.lastEdge = event;
+    lastEvent = event;
+    
+    return EventPipeline::NO_OWNER;
+}
+
+void SignalStatistics::printReport() const {
+    if (!started) {
+        Serial.println("Signal statistics: no event yet");
+        return;
+    }
+    
+    int64_t periodUs = eventDeltaUs(periodStart, lastEvent);
+    Serial.printf("Signal statistics, last %lld s:\n", static_cast<long long>(periodUs / 1000000));
+    
+    for (size_t i = 0; i < NUM_SIGNALS; i++) {
+        const SignalState& state = signals[i];
+        if (!state.seen) {
+            continue;
+        }
+        const SignalPeriod& period = periods[current][i];
+        uint32_t perMinute = periodUs > 0 ? static_cast<uint32_t>(period.edges * 60000000LL / periodUs) : 0;
+        Serial.printf("%s: %lu edges (%lu/min), %lu since boot, last at %lu ms\n",
+            signalTypeToString(static_cast<SignalType>(i)), static_cast<unsigned long>(period.edges), static_cast<unsigned long>(perMinute),
+            static_cast<unsigned long>(state.totalEdges), static_cast<unsigned long>(state.lastEdge.timestamp));
+        printPulses("high", period.pulses[HIGH]);
+        printPulses("low", period.pulses[LOW]);
+    }
+}
+
+void SignalStatistics::closePeriod(const EventEntry& event) {
+    // A report still waiting for record slots a whole period later is given up
+    periodEnd = event;
+    periodLengthUs = eventDeltaUs(periodStart, event);
+    current = 1 - current;
+    clearPeriod(periods[current]);
+    periodStart = event;
+    
+    reporting = true;
+    cursor = {};
+}
+
+void SignalStatistics::writeReport() {
+    ReportCursor position = cursor;
+    LogRecord record = {};
+    if (!buildRecord(position, record)) {
+        reporting = false;
+        return;
+    }
+    
+    // Try again on the next event if no slot is left
+    uint8_t owner = pipeline.reserveRecord();
+    if (owner == EventPipeline::NO_OWNER) {
+        return;
+    }
+    pipeline.resolve(owner, &record, true);
+    cursor = position;
+}
+
+bool SignalStatistics::buildRecord(ReportCursor& position, LogRecord& record) const {
+    record.timestamp = periodEnd.timestamp;
+    record.micros = periodEnd.micros;
+    
+    for (; position.signal < NUM_SIGNALS; position.signal++, position.part = 0, position.bin = 0) {
+        const SignalState& state = signals[position.signal];
+        const SignalPeriod& period = periods[1 - current][position.signal];
+        if (!state.seen) {
+            continue;
+        }
+        
+        // Summary of the signal
+        if (position.part == 0) {
+            record.type = RECORD_SIGNAL_STATS;
+            record.numFields = 11;
+            record.fields[0] = static_cast<int32_t>(position.signal);
+            record.fields[1] = static_cast<int32_t>(periodLengthUs / 1000);
+            record.fields[2] = static_cast<int32_t>(period.edges);
+            for (size_t level = 0; level < 2; level++) {
+                const PulseHistogram& histogram = period.pulses[level == 0 ? HIGH : LOW];
+                int32_t* fields = record.fields + 3 + level * 3;
+                fields[0] = histogram.count > 0 ? static_cast<int32_t>(histogram.minUs) : -1;
+                fields[1] = histogram.count > 0 ? static_cast<int32_t>(histogram.maxUs) : -1;
+                fields[2] = histogram.count > 0 ? static_cast<int32_t>(histogram.totalUs / histogram.count) : -1;
+            }
+            record.fields[9] = static_cast<int32_t>(eventDeltaUs(state.lastEdge, periodEnd) / 1000);
+            record.fields[10] = static_cast<int32_t>(state.totalEdges);
+            position.part = 1;
+            return true;
+        }
+        
+        // Non-empty bins of the high, then the low histogram
+        for (; position.part <= 2; position.part++, position.bin = 0) {
+            uint8_t level = position.part == 1 ? HIGH : LOW;
+            const PulseHistogram& histogram = period.pulses[level];
+            record.type = RECORD_PULSE_HISTOGRAM;
+            record.numFields = 2;
+            record.fields[0] = static_cast<int32_t>(position.signal);
+            record.fields[1] = level;
+            for (; position.bin < NUM_BINS && record.numFields < 2 + 2 * BINS_PER_RECORD; position.bin++) {
+                if (histogram.bins[position.bin] > 0) {
+                    record.fields[record.numFields++] = static_cast<int32_t>(binLowerBound(position.bin));
+                    record.fields[record.numFields++] = static_cast<int32_t>(histogram.bins[position.bin]);
+                }
+            }
+            if (record.numFields > 2) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void SignalStatistics::clearPeriod(SignalPeriod* period) {
+    memset(period, 0, sizeof(SignalPeriod) * NUM_SIGNALS);
+    for (size_t i = 0; i < NUM_SIGNALS; i++) {
+        period[i].pulses[LOW].minUs = UINT32_MAX;
+        period[i].pulses[HIGH].minUs = UINT32_MAX;
+    }
+}
+
+size_t SignalStatistics::binOf(uint32_t widthUs) {
+    if (widthUs < 8) {
+        return widthUs;
+    }
+    
+    // Octave, then its quarter from the two bits below the leading one
+    size_t octave = 31 - __builtin_clz(widthUs);
+    size_t quarter = (widthUs >> (octave - 2)) & 3;
+    return 4 * (octave - 1) + quarter;
+}
+
+uint32_t SignalStatistics::binLowerBound(size_t bin) {
+    if (bin < 8) {
+        return bin;
+    }
+    
+    size_t octave = bin / 4 + 1;
+    return static_cast<uint32_t>(4 + bin % 4) << (octave - 2);
+}
+
+void SignalStatistics::printPulses(const char* level, const PulseHistogram& histogram) {
+    if (histogram.count == 0) {
+        return;
+    }
+    
+    Serial.printf("  %s: %lu pulses, %lu-%lu us, mean %lu us\n   ", level, static_cast<unsigned long>(histogram.count),
+        static_cast<unsigned long>(histogram.minUs), static_cast<unsigned long>(histogram.maxUs),
+        static_cast<unsigned long>(histogram.totalUs / histogram.count));
+    for (size_t bin = 0; bin < NUM_BINS; bin++) {
+        if (histogram.bins[bin] > 0) {
+            Serial.printf(" %lu:%lu", static_cast<unsigned long>(binLowerBound(bin)), static_cast<unsigned long>(histogram.bins[bin]));
+        }
+    }
+    Serial.println();
+}
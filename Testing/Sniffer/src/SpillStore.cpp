@@ -0,0 +1,252 @@
+#include "SpillStore.h"
+#include <LittleFS.h>
+#include <algorithm>
+
+bool PsramSpillTier::begin() {
+    if (!SpillConfig::ENABLE_PSRAM || !psramFound()) {
+        return false;
+    }
+    
+    storage = static_cast<EventEntry*>(ps_malloc(SpillConfig::PSRAM_CAPACITY * sizeof(EventEntry)));
+    if (!storage) {
+        return false;
+    }
+    capacity = SpillConfig::PSRAM_CAPACITY;
+    return true;
+}
+
+bool PsramSpillTier::append(const EventEntry* events, size_t numEvents) {
+    if (capacity - count < numEvents) {
+        return false;
+    }
+    
+    // Copy in up to two parts around the end of the storage
+    size_t writeIndex = (readIndex + count) % capacity;
+    size_t firstPart = std::min(numEvents, capacity - writeIndex);
+    std::copy(events, events + firstPart, storage + writeIndex);
+    std::copy(events + firstPart, events + numEvents, storage);
+    count += numEvents;
+    return true;
+}
+
+size_t PsramSpillTier::peek(EventEntry* dest, size_t maxEvents, size_t skip) {
+    size_t eventsToRead = std::min(maxEvents, count - std::min(skip, count));
+    if (eventsToRead == 0) {
+        return 0;
+    }
+    
+    // Copy in up to two parts around the end of the storage
+    size_t start = (readIndex + skip) % capacity;
+    size_t firstPart = std::min(eventsToRead, capacity - start);
+    std::copy(storage + start, storage + start + firstPart, dest);
+    std::copy(storage, storage + eventsToRead - firstPart, dest + firstPart);
+    return eventsToRead;
+}
+
+void PsramSpillTier::consume(size_t numEvents) {
+    readIndex = (readIndex + numEvents) % capacity;
+    count -= numEvents;
+}
+
+bool FlashSpillTier::begin() {
+    // Format the partition if it was never used
+    if (!SpillConfig::ENABLE_FLASH || !LittleFS.begin(true)) {
+        return false;
+    }
+    
+    // Resume a file left over by a reboot
+    size_t fileSize = 0;
+    if (LittleFS.exists(SpillConfig::FLASH_FILE_PATH)) {
+        File spillFile = LittleFS.open(SpillConfig::FLASH_FILE_PATH, FILE_READ);
+        fileSize = spillFile.size();
+        spillFile.close();
+    }
+    count = fileSize / sizeof(EventEntry);
+    resumedCount = count;
+    readOffset = 0;
+    
+    // Whatever the partition can hold besides the file system itself
+    size_t freeBytes = LittleFS.totalBytes() - LittleFS.usedBytes() + fileSize;
+    capacity = freeBytes > SpillConfig::FLASH_RESERVED_BYTES
+        ? (freeBytes - SpillConfig::FLASH_RESERVED_BYTES) / sizeof(EventEntry)
+        : 0;
+    return capacity > 0;
+}
+
+bool FlashSpillTier::append(const EventEntry* events, size_t numEvents) {
+    // Drained events still occupy the file until it is removed
+    size_t usedEvents = readOffset / sizeof(EventEntry) + count;
+    if (capacity - std::min(capacity, usedEvents) < numEvents) {
+        return false;
+    }
+    
+    File spillFile = LittleFS.open(SpillConfig::FLASH_FILE_PATH, FILE_APPEND);
+    if (!spillFile) {
+        return false;
+    }
+    
+    size_t length = numEvents * sizeof(EventEntry);
+    size_t written = spillFile.write(reinterpret_cast<const uint8_t*>(events), length);
+    spillFile.close();
+    
+    // A partial record would shift all the following ones
+    if (written != length) {
+        return false;
+    }
+    count += numEvents;
+    return true;
+}
+
+size_t FlashSpillTier::peek(EventEntry* dest, size_t maxEvents, size_t skip) {
+    size_t eventsToRead = std::min(maxEvents, count - std::min(skip, count));
+    if (eventsToRead == 0) {
+        return 0;
+    }
+    
+    File spillFile = LittleFS.open(SpillConfig::FLASH_FILE_PATH, FILE_READ);
+    if (!spillFile || !spillFile.seek(readOffset + skip * sizeof(EventEntry))) {
+        return 0;
+    }
+    size_t length = spillFile.read(reinterpret_cast<uint8_t*>(dest), eventsToRead * sizeof(EventEntry));
+    spillFile.close();
+    
+    return length / sizeof(EventEntry);
+}
+
+void FlashSpillTier::consume(size_t numEvents) {
+    readOffset += numEvents * sizeof(EventEntry);
+    count -= numEvents;
+    resumedCount -= std::min(resumedCount, numEvents);
+    
+    // Fully drained, give the space back
+    if (count == 0) {
+        LittleFS.remove(SpillConfig::FLASH_FILE_PATH);
+        readOffset = 0;
+    }
+}
+
+SpillStore::SpillStore(RingBuffer& buffer) : eventBuffer(buffer) {
+    // Nothing else to initialize
+}
+
+void SpillStore::begin() {
+    // Fastest tier first
+    if (psramTier.begin()) {
+        tiers[numTiers++] = &psramTier;
+    }
+    if (flashTier.begin()) {
+        tiers[numTiers++] = &flashTier;
+    }
+}
+
+bool SpillStore::spill() {
+    const EventEntry* events;
+    size_t numEvents = std::min(eventBuffer.readSpan(events), SpillConfig::BLOCK_EVENTS);
+    if (numEvents == 0) {
+        return false;
+    }
+    
+    // Tiers are filled in order: never write before the last non-empty one,
+    // so that draining them in order keeps the events in order
+    size_t first = 0;
+    for (size_t i = 0; i < numTiers; i++) {
+        if (tiers[i]->getCount() > 0) {
+            first = i;
+        }
+    }
+    
+    uint32_t startTime = micros();
+    for (size_t i = first; i < numTiers; i++) {
+        if (tiers[i]->append(events, numEvents)) {
+            eventBuffer.commit(numEvents);
+            spilledBytes += numEvents * sizeof(EventEntry);
+            spillTimeUs += micros() - startTime;
+            return true;
+        }
+    }
+    
+    return false; // All tiers are full
+}
+
+bool SpillStore::drain(SDCardManager& sdCard) {
+    uint32_t startTime = micros();
+    size_t bytes = 0;
+    
+    for (size_t i = 0; i < numTiers; i++) {
+        SpillTier& tier = *tiers[i];
+        while (tier.getCount() > 0) {
+            // Blocks hold events of the previous boot or of this one, not both
+            size_t resumed = tier.getResumedCount();
+            size_t numEvents = tier.peek(transfer, resumed > 0 ? std::min(resumed, SpillConfig::BLOCK_EVENTS)
+                                                               : SpillConfig::BLOCK_EVENTS);
+            size_t saved = numEvents > 0 ? sdCard.saveEvents(transfer, numEvents, resumed > 0) : 0;
+            tier.consume(saved);
+            bytes += saved * sizeof(EventEntry);
+            
+            // Card gone or read error, retry on the next flush
+            if (saved < numEvents || numEvents == 0) {
+                drainedBytes += bytes;
+                drainTimeUs += micros() - startTime;
+                return false;
+            }
+        }
+    }
+    
+    if (bytes > 0) {
+        drainedBytes += bytes;
+        drainTimeUs += micros() - startTime;
+    }
+    return true;
+}
+
+bool SpillStore::isEmpty() const {
+    for (size_t i = 0; i < numTiers; i++) {
+        if (tiers[i]->getCount() > 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SpillStore::printReport() {
+    Serial.printf("RAM: %lu/%lu events", static_cast<unsigned long>(eventBuffer.getCount()), static_cast<unsigned long>(BufferConfig::BUFFER_SIZE));
+    for (size_t i = 0; i < numTiers; i++) {
+        Serial.printf(", %s: %lu/%lu events", tiers[i]->getName(), static_cast<unsigned long>(tiers[i]->getCount()),
+            static_cast<unsigned long>(tiers[i]->getCapacity()));
+    }
+    Serial.println();
+    
+    // Throughputs in bytes per second, since boot
+    Serial.printf("Spill: %llu B/s, drain: %llu B/s",
+        spillTimeUs > 0 ? 1000000ULL * spilledBytes / spillTimeUs : 0ULL,
+        drainTimeUs > 0 ? 1000000ULL * drainedBytes / drainTimeUs : 0ULL);
+    
+    EventEntry oldest;
+    if (getOldestEvent(oldest)) {
+        Serial.printf(", oldest unflushed event: %lu ms ago", static_cast<unsigned long>(millis() - oldest.timestamp));
+    }
+    size_t resumed = 0;
+    for (size_t i = 0; i < numTiers; i++) {
+        resumed += tiers[i]->getResumedCount();
+    }
+    if (resumed > 0) {
+        Serial.printf(", %lu events of the previous boot", static_cast<unsigned long>(resumed));
+    }
+    Serial.println();
+}
+
+bool SpillStore::getOldestEvent(EventEntry& entry) {
+    // Spilled events are older than the ones in RAM
+    for (size_t i = 0; i < numTiers; i++) {
+        if (tiers[i]->peek(&entry, 1, tiers[i]->getResumedCount()) == 1) {
+            return true;
+        }
+    }
+    
+    const EventEntry* events;
+    if (eventBuffer.readSpan(events) > 0) {
+        entry = events[0];
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,112 @@
+#include "TriggerCapture.h"
+#include <algorithm>
+
+TriggerCapture::TriggerCapture(RingBuffer& buffer, PipelineMetrics& metrics)
+    : eventBuffer(buffer), pipelineMetrics(metrics) {
+    // No edge yet: every signal has been idle forever
+    for (int64_t& edgeTime : lastEdgeTime) {
+        edgeTime = INT64_MIN / 2;
+    }
+}
+
+void IRAM_ATTR TriggerCapture::write(const EventEntry* events, size_t numEvents, int64_t time) {
+    // First event firing a trigger, conditions see the edges before this interrupt
+    size_t trigger = numEvents;
+    for (size_t i = 0; i < numEvents && trigger == numEvents; i++) {
+        if (isTrigger(events[i], time)) {
+            trigger = i;
+        }
+    }
+    for (size_t i = 0; i < numEvents; i++) {
+        lastEdgeTime[events[i].signalType] = time;
+    }
+    
+    if (trigger < numEvents) {
+        // Start a capture with the window, or extend the one in progress
+        bool complete = time > captureEnd ? writeWindow(events[trigger]) : true;
+        EventEntry marker = {TRIGGER_MARKER_SIGNAL, complete ? MARKER_COMPLETE : MARKER_TRUNCATED,
+                             events[trigger].micros, events[trigger].timestamp};
+        writeEvents(&marker, 1);
+        captureEnd = time + TriggerConfig::POST_TRIGGER_US;
+        pipelineMetrics.countTrigger();
+    }
+    
+    if (time <= captureEnd) {
+        writeEvents(events, numEvents);
+    } else {
+        hold(events, numEvents);
+    }
+}
+
+LogRecord TriggerCapture::toRecord(const EventEntry& marker) {
+    LogRecord record = {};
+    record.type = RECORD_TRIGGER;
+    record.numFields = 3;
+    record.micros = marker.micros;
+    record.timestamp = marker.timestamp;
+    record.fields[0] = static_cast<int32_t>(TriggerConfig::PRE_TRIGGER_US);
+    record.fields[1] = static_cast<int32_t>(TriggerConfig::POST_TRIGGER_US);
+    record.fields[2] = marker.edgeType == MARKER_TRUNCATED ? 0 : 1;
+    return record;
+}
+
+bool IRAM_ATTR TriggerCapture::isTrigger(const EventEntry& event, int64_t time) const {
+    for (const TriggerCondition& condition : TriggerConfig::CONDITIONS) {
+        if (event.signalType == condition.signal
+            && (condition.edge == TRIGGER_ANY_EDGE || event.edgeType == condition.edge)
+            && (condition.idleUs == 0 || time - lastEdgeTime[condition.idleSignal] >= condition.idleUs)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void IRAM_ATTR TriggerCapture::writeEvents(const EventEntry* events, size_t numEvents) {
+    size_t eventsWritten = eventBuffer.write(events, numEvents);
+    for (size_t i = eventsWritten; i < numEvents; i++) {
+        if (!isMarker(events[i])) {
+            pipelineMetrics.countDropped(static_cast<SignalType>(events[i].signalType));
+        }
+    }
+}
+
+bool IRAM_ATTR TriggerCapture::writeWindow(const EventEntry& trigger) {
+    // Skip the events older than the pre-trigger time
+    size_t first = windowEnd - windowCount;
+    size_t skipped = 0;
+    while (skipped < windowCount
+           && eventDeltaUs(window[(first + skipped) & WINDOW_MASK], trigger) > TriggerConfig::PRE_TRIGGER_US) {
+        skipped++;
+    }
+    pipelineMetrics.countDiscarded(skipped);
+    bool complete = !hasOverwritten || eventDeltaUs(overwritten, trigger) > TriggerConfig::PRE_TRIGGER_US;
+    
+    // At most two runs: up to the end of the storage, then from its start
+    size_t start = first + skipped;
+    size_t remaining = windowCount - skipped;
+    while (remaining > 0) {
+        size_t slot = start & WINDOW_MASK;
+        size_t run = std::min(remaining, TriggerConfig::PRE_TRIGGER_EVENTS - slot);
+        writeEvents(&window[slot], run);
+        start += run;
+        remaining -= run;
+    }
+    
+    windowCount = 0;
+    hasOverwritten = false;
+    return complete;
+}
+
+void IRAM_ATTR TriggerCapture::hold(const EventEntry* events, size_t numEvents) {
+    for (size_t i = 0; i < numEvents; i++) {
+        // Full: the oldest event leaves the window
+        if (windowCount == TriggerConfig::PRE_TRIGGER_EVENTS) {
+            overwritten = window[windowEnd & WINDOW_MASK];
+            hasOverwritten = true;
+            pipelineMetrics.countDiscarded(1);
+            windowCount--;
+        }
+        window[windowEnd++ & WINDOW_MASK] = events[i];
+        windowCount++;
+    }
+}
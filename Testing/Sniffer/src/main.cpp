@@ -2,26 +2,64 @@
 #include "Config.h"
 #include "RingBuffer.h"
 #include "SignalLogger.h"
+#include "RmtSignalLogger.h"
+#include "CaptureBenchmark.h"
 #include "SDCardManager.h"
+#include "EventPipeline.h"
+#include "HourFrameDecoder.h"
+#include "DCF77Decoder.h"
+#include "SignalStatistics.h"
+#include "PipelineMetrics.h"
+#include "SpillStore.h"
+#include "SerialStreamer.h"
+#include "FlushTask.h"
 #include "StatusIndicator.h"
+#include <type_traits>
+
+// Capture backend selected at build time, both share the same interface
+using CaptureLogger = std::conditional<CaptureConfig::BACKEND == CAPTURE_RMT,
+                                       RmtSignalLogger, SignalLogger>::type;
 
 // Create the global objects
 RingBuffer eventBuffer;
-SignalLogger signalLogger(eventBuffer);
-SDCardManager sdManager(eventBuffer);
+PipelineMetrics pipelineMetrics(eventBuffer);
+CaptureLogger signalLogger(eventBuffer, pipelineMetrics);
+EventPipeline eventPipeline;
+HourFrameDecoder hourFrameDecoder(eventPipeline);
+DCF77Decoder dcf77Decoder(eventPipeline);
+SignalStatistics signalStatistics(eventPipeline);
+SDCardManager sdManager(eventBuffer, eventPipeline, pipelineMetrics);
+SpillStore spillStore(eventBuffer);
+SerialStreamer serialStreamer(eventBuffer, Serial);
+FlushTask flushTask(eventBuffer, sdManager, spillStore, signalStatistics, pipelineMetrics, serialStreamer);
 StatusIndicator statusIndicator;
 
-// Timing variables for periodic tasks
-unsigned long lastSDWriteTime = 0;
-
 void setup() {
   // Initialize serial for debugging (optional, can be removed for production)
-  Serial.begin(115200);
+  Serial.begin(StreamConfig::CONSOLE_BAUD_RATE);
   Serial.println("Clock Signal Sniffer Starting...");
   
   // Initialize status indicator first to show boot progress
   statusIndicator.begin();
   
+  // Measure the capture backend instead of logging, the SD card is not used
+  if (CaptureConfig::BENCHMARK) {
+    signalLogger.begin();
+    CaptureBenchmark(eventBuffer).run();
+    return;
+  }
+  
+  // Decoders replacing raw events by records in the data file
+  if (DecoderConfig::ENABLE_HOUR_FRAME_DECODER) {
+    eventPipeline.addDecoder(hourFrameDecoder);
+  }
+  if (DecoderConfig::ENABLE_DCF77_DECODER) {
+    eventPipeline.addDecoder(dcf77Decoder);
+  }
+  if (StatisticsConfig::ENABLE) {
+    eventPipeline.addDecoder(signalStatistics);
+  }
+  
   // Initialize SD card
   bool sdInitialized = sdManager.begin();
   if (!sdInitialized) {
@@ -31,12 +69,21 @@ void setup() {
     Serial.println("SD card initialized");
   }
   
+  // Initialize the spill tiers holding events while the SD card is absent
+  spillStore.begin();
+  spillStore.printReport();
+  
   // Initialize signal logging
   signalLogger.begin();
   Serial.println("Signal logger initialized");
   
-  // Record startup time for SD write timing
-  lastSDWriteTime = millis();
+  // Start flushing to the SD card, from now on only the flush task uses it
+  if (!flushTask.begin()) {
+    Serial.println("ERROR: Cannot start flush task");
+    statusIndicator.setStatus(STATUS_PANIC);
+    return;
+  }
+  Serial.println("Flush task started");
   
   Serial.println("Setup complete, monitoring signals...");
 }
@@ -45,48 +92,58 @@ void loop() {
   // Update status indicator
   statusIndicator.update();
   
-  // Try to write to SD card if enough time has passed
-  unsigned long currentTime = millis();
-  if (currentTime - lastSDWriteTime >= Timing::SD_COMMIT_INTERVAL || 
-      currentTime < lastSDWriteTime) { // Handle millis overflow
-    
-    // Try to save events to SD card
-    if (!eventBuffer.isEmpty()) {
-      bool success = sdManager.saveEvents();
-      
-      if (success) {
-        // All data saved
-        statusIndicator.setStatus(STATUS_OK);
-        Serial.println("Data saved to SD card");
-      } else if (!sdManager.isCardPresent()) {
-        // SD card not available
-        statusIndicator.setStatus(STATUS_SD_MISSING);
-        Serial.println("Failed to save: SD card not available");
-      } else {
-        // Other error
-        Serial.println("Error saving to SD card");
-      }
+  // Reflect the outcome of the flush task on the LED
+  StatusCode status = statusIndicator.getStatus();
+  switch (flushTask.getLastResult()) {
+    case FLUSH_OK:
+      status = STATUS_OK;
+      break;
+    case FLUSH_NO_CARD:
+      status = STATUS_SD_MISSING;
+      break;
+    default:
+      break;
+  }
+  
+  // If buffer is full (no SD card), we'll have to stop logging
+  if (eventBuffer.getCount() >= BufferConfig::BUFFER_SIZE) {
+    if (statusIndicator.getStatus() != STATUS_BUFFER_OVERFLOW) {
+      Serial.println("ERROR: Buffer overflow, logging stopped");
     }
-    
-    // Update last write time
-    lastSDWriteTime = currentTime;
+    status = STATUS_BUFFER_OVERFLOW;
+  }
+  
+  if (status != statusIndicator.getStatus()) {
+    statusIndicator.setStatus(status);
   }
   
-  // Check if buffer is getting full (at 90% capacity)
-  if (eventBuffer.getCount() >= (BufferConfig::BUFFER_SIZE * 0.9)) {
-    // If SD card is present, try emergency write
-    if (sdManager.isCardPresent()) {
-      Serial.println("Emergency buffer flush");
-      sdManager.saveEvents();
-    } else {
-      // If buffer is full and no SD card, we'll have to stop logging
-      if (eventBuffer.getCount() >= BufferConfig::BUFFER_SIZE) {
-        statusIndicator.setStatus(STATUS_BUFFER_OVERFLOW);
-        Serial.println("ERROR: Buffer overflow, logging stopped");
-      }
+  // Commands from the serial console
+  while (Serial.available() > 0) {
+    int command = Serial.read();
+    if (command == StatisticsConfig::REPORT_COMMAND) {
+      flushTask.requestStatistics();
+    } else if (command == StreamConfig::START_COMMAND || command == StreamConfig::STOP_COMMAND) {
+      // The receiver switches its speed after the command
+      bool start = command == StreamConfig::START_COMMAND;
+      Serial.flush();
+      Serial.updateBaudRate(start ? StreamConfig::STREAM_BAUD_RATE : StreamConfig::CONSOLE_BAUD_RATE);
+      flushTask.requestStreaming(start);
     }
   }
   
-  // Short delay to prevent CPU from running at 100%
-  delay(10);
-}
\ No newline at end of file
+  // Flushing is event driven, this loop only drives the LED
+  delay(Timing::STATUS_UPDATE_INTERVAL);
+}
+#if defined(NATIVE_BUILD) && !defined(PIO_UNIT_TESTING)
+#include "ReplayEngine.h"
+
+// Host build: the replay engine runs setup() and loop() on recorded edges,
+// the tests (test/) have their own main()
+int main(int argc, char** argv) {
+  int result = ReplayEngine(eventBuffer).run(argc, argv);
+  
+  // The tasks never return, leave without destroying the objects they use
+  fflush(stdout);
+  _Exit(result);
+}
+#endif
@@ -0,0 +1,232 @@
+/**
+ * DCF77 decoder against synthesized minutes.
+ *
+ * Telegrams are encoded from a date and time, then turned into RF edges: a
+ * 100 or 200ms pulse at the start of each second, none in the 59th second to
+ * mark the minute. The edges go through an EventPipeline holding the decoder
+ * and the DCF77 records coming out of it are checked.
+ */
+
+#include <unity.h>
+#include "DCF77Decoder.h"
+#include <vector>
+
+namespace {
+    constexpr int64_t SECOND_US = 1000000;
+    
+    // Time of the first minute, 10s after the boot
+    constexpr int64_t START_US = 10 * SECOND_US;
+    
+    // Bits of a telegram, up to the leap second
+    struct Telegram {
+        uint8_t bits[60] = {};
+        size_t numBits = 59;
+    };
+    
+    void setBCD(Telegram& telegram, size_t first, size_t count, int32_t value) {
+        int32_t bcd = (value / 10) << 4 | (value % 10);
+        for (size_t i = 0; i < count; i++) {
+            telegram.bits[first + i] = (bcd >> i) & 1;
+        }
+    }
+    
+    void setParity(Telegram& telegram, size_t first, size_t last) {
+        uint8_t parity = 0;
+        for (size_t i = first; i < last; i++) {
+            parity ^= telegram.bits[i];
+        }
+        telegram.bits[last] = parity;
+    }
+    
+    /**
+     * Encode the telegram of a minute, in CEST
+     */
+    Telegram encode(int32_t minute, int32_t hour, int32_t day, int32_t weekday, int32_t month, int32_t year) {
+        Telegram telegram;
+        telegram.bits[17] = 1; // CEST
+        telegram.bits[20] = 1; // Start of the time
+        setBCD(telegram, 21, 7, minute);
+        setParity(telegram, 21, 28);
+        setBCD(telegram, 29, 6, hour);
+        setParity(telegram, 29, 35);
+        setBCD(telegram, 36, 6, day);
+        setBCD(telegram, 42, 3, weekday);
+        setBCD(telegram, 45, 5, month);
+        setBCD(telegram, 50, 8, year);
+        setParity(telegram, 36, 58);
+        return telegram;
+    }
+    
+    // RF edges of the receiver output
+    class Signal {
+    public:
+        std::vector<EventEntry> events;
+        
+        /**
+         * Add the pulse of a second
+         * @param startUs Start of the second
+         * @param bit Value sent, 100ms pulse for 0 and 200ms for 1
+         */
+        void addPulse(int64_t startUs, uint8_t bit) {
+            int64_t widthUs = bit ? 200000 : 100000;
+            addEdge(startUs, DecoderConfig::DCF77_PULSE_LEVEL == HIGH ? EDGE_RISING : EDGE_FALLING);
+            addEdge(startUs + widthUs, DecoderConfig::DCF77_PULSE_LEVEL == HIGH ? EDGE_FALLING : EDGE_RISING);
+        }
+        
+        /**
+         * Add the pulses of a telegram, from second 0
+         * @return Start of the second after its last pulse
+         */
+        int64_t addTelegram(int64_t startUs, const Telegram& telegram) {
+            for (size_t i = 0; i < telegram.numBits; i++) {
+                addPulse(startUs + static_cast<int64_t>(i) * SECOND_US, telegram.bits[i]);
+            }
+            return startUs + static_cast<int64_t>(telegram.numBits) * SECOND_US;
+        }
+    
+    private:
+        void addEdge(int64_t timeUs, EdgeType edge) {
+            events.push_back({RF_SIGNAL, static_cast<uint8_t>(edge), static_cast<uint16_t>(timeUs % 1000),
+                              static_cast<uint32_t>(timeUs / 1000)});
+        }
+    };
+    
+    /**
+     * Decode the edges, getting the DCF77 records resolved
+     */
+    std::vector<LogRecord> decode(const Signal& signal) {
+        EventPipeline pipeline;
+        DCF77Decoder decoder(pipeline);
+        pipeline.addDecoder(decoder);
+        
+        std::vector<LogRecord> records;
+        LogItem item;
+        for (const EventEntry& event : signal.events) {
+            if (!pipeline.push(event)) {
+                break;
+            }
+            while (pipeline.next(item)) {
+                if (item.record && item.record->type == RECORD_DCF77_MINUTE) {
+                    records.push_back(*item.record);
+                }
+                pipeline.pop();
+            }
+        }
+        return records;
+    }
+    
+    /**
+     * Check the date and time of a record
+     */
+    void assertTime(const LogRecord& record, int32_t minute, int32_t hour, int32_t day, int32_t weekday,
+                    int32_t month, int32_t year) {
+        TEST_ASSERT_EQUAL(minute, record.fields[1]);
+        TEST_ASSERT_EQUAL(hour, record.fields[2]);
+        TEST_ASSERT_EQUAL(day, record.fields[3]);
+        TEST_ASSERT_EQUAL(weekday, record.fields[4]);
+        TEST_ASSERT_EQUAL(month, record.fields[5]);
+        TEST_ASSERT_EQUAL(year, record.fields[6]);
+    }
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_consecutive_minutes() {
+    // Second 58 of the previous minute, then 14:37 and 14:38 of Saturday
+    // 2026-10-17, ended by the marker of 14:39
+    Signal signal;
+    signal.addPulse(START_US - 2 * SECOND_US, 0);
+    int64_t time = signal.addTelegram(START_US, encode(37, 14, 17, 6, 10, 26));
+    time = signal.addTelegram(time + SECOND_US, encode(38, 14, 17, 6, 10, 26));
+    signal.addPulse(time + SECOND_US, 0);
+    
+    std::vector<LogRecord> records = decode(signal);
+    TEST_ASSERT_EQUAL(2, records.size());
+    for (size_t i = 0; i < 2; i++) {
+        const LogRecord& record = records[i];
+        TEST_ASSERT_EQUAL(1, record.fields[0]);
+        assertTime(record, 37 + static_cast<int32_t>(i), 14, 17, 6, 10, 26);
+        TEST_ASSERT_EQUAL(0x1, record.fields[7]); // CEST
+        TEST_ASSERT_EQUAL(100, record.fields[8]);
+        TEST_ASSERT_EQUAL(0, record.fields[10]);
+        TEST_ASSERT_EQUAL(0, record.fields[11]);
+    }
+    
+    // At the first pulse of the minute
+    TEST_ASSERT_EQUAL(START_US / 1000, records[0].timestamp);
+    TEST_ASSERT_EQUAL((START_US + 60 * SECOND_US) / 1000, records[1].timestamp);
+}
+
+void test_parity_error() {
+    // Minute parity and a date bit flipped
+    Telegram telegram = encode(37, 14, 17, 6, 10, 26);
+    telegram.bits[28] ^= 1;
+    telegram.bits[50] ^= 1;
+    
+    Signal signal;
+    signal.addPulse(START_US - 2 * SECOND_US, 0);
+    int64_t time = signal.addTelegram(START_US, telegram);
+    signal.addPulse(time + SECOND_US, 0);
+    
+    std::vector<LogRecord> records = decode(signal);
+    TEST_ASSERT_EQUAL(1, records.size());
+    TEST_ASSERT_EQUAL(0, records[0].fields[0]);
+    assertTime(records[0], 37, 14, 17, 6, 10, 27);
+    TEST_ASSERT_EQUAL((1 << 8) | (1 << 10) | 0x1, records[0].fields[7]);
+}
+
+void test_missing_minute_marker() {
+    // A pulse in second 59 hides the marker: the telegram runs over 60 bits
+    // and is given up, the next marker starts over
+    Signal signal;
+    signal.addPulse(START_US - 2 * SECOND_US, 0);
+    int64_t time = signal.addTelegram(START_US, encode(37, 14, 17, 6, 10, 26));
+    signal.addPulse(time, 0);
+    time = signal.addTelegram(time + SECOND_US, encode(38, 14, 17, 6, 10, 26));
+    time = signal.addTelegram(time + SECOND_US, encode(39, 14, 17, 6, 10, 26));
+    signal.addPulse(time + SECOND_US, 0);
+    
+    std::vector<LogRecord> records = decode(signal);
+    TEST_ASSERT_EQUAL(2, records.size());
+    TEST_ASSERT_EQUAL(0, records[0].fields[0]);
+    assertTime(records[0], -1, -1, -1, -1, -1, -1);
+    TEST_ASSERT_EQUAL(1, records[1].fields[0]);
+    assertTime(records[1], 39, 14, 17, 6, 10, 26);
+}
+
+void test_leap_second() {
+    // Leap second announced, inserted as a 0 in second 59, the marker follows
+    // in second 60
+    Telegram telegram = encode(59, 1, 1, 4, 1, 26);
+    telegram.bits[19] = 1;
+    telegram.numBits = 60;
+    
+    Signal signal;
+    signal.addPulse(START_US - 2 * SECOND_US, 0);
+    int64_t time = signal.addTelegram(START_US, telegram);
+    telegram = encode(0, 2, 1, 4, 1, 26);
+    time = signal.addTelegram(time + SECOND_US, telegram);
+    signal.addPulse(time + SECOND_US, 0);
+    
+    std::vector<LogRecord> records = decode(signal);
+    TEST_ASSERT_EQUAL(2, records.size());
+    TEST_ASSERT_EQUAL(1, records[0].fields[0]);
+    assertTime(records[0], 59, 1, 1, 4, 1, 26);
+    TEST_ASSERT_EQUAL(0x8 | 0x1, records[0].fields[7]);
+    
+    // The minute after is 61s later
+    TEST_ASSERT_EQUAL(1, records[1].fields[0]);
+    assertTime(records[1], 0, 2, 1, 4, 1, 26);
+    TEST_ASSERT_EQUAL((START_US + 61 * SECOND_US) / 1000, records[1].timestamp);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_consecutive_minutes);
+    RUN_TEST(test_parity_error);
+    RUN_TEST(test_missing_minute_marker);
+    RUN_TEST(test_leap_second);
+    return UNITY_END();
+}
@@ -0,0 +1,208 @@
+/**
+ * Replay of captured MU/BA rows through the hour frame decoder.
+ *
+ * Each capture is in the data file format (Signal,Edge,Timestamp[,Micros]), fed
+ * through an EventPipeline holding the decoder. The rows coming out of the
+ * pipeline must be the capture with each decoded frame replaced by its HF
+ * record, whatever the order in which MU and BA fall at the end of the frame.
+ */
+
+#include <unity.h>
+#include "HourFrameDecoder.h"
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+    /**
+     * Parse the rows of a capture into events
+     */
+    std::vector<EventEntry> parseCapture(const char* capture) {
+        std::vector<EventEntry> events;
+        std::istringstream rows(capture);
+        std::string row;
+        while (std::getline(rows, row)) {
+            char signal[8];
+            char edge;
+            unsigned long timestamp;
+            unsigned micros = 0;
+            if (sscanf(row.c_str(), " %7[^,],%c,%lu,%u", signal, &edge, &timestamp, &micros) < 3) {
+                continue;
+            }
+            EventEntry event = {0, static_cast<uint8_t>(edge == 'R' ? EDGE_RISING : EDGE_FALLING),
+                                static_cast<uint16_t>(micros), static_cast<uint32_t>(timestamp)};
+            while (event.signalType < Signals::COUNT && strcmp(Signals::TABLE[event.signalType].name, signal) != 0) {
+                event.signalType++;
+            }
+            events.push_back(event);
+        }
+        return events;
+    }
+    
+    /**
+     * Replay a capture through the decoder, and get the rows written out,
+     * followed by an error line if the pipeline did not take every event or
+     * still holds some at the end
+     */
+    std::string replay(const char* capture) {
+        EventPipeline pipeline;
+        HourFrameDecoder decoder(pipeline);
+        pipeline.addDecoder(decoder);
+        bool pushed = true;
+        for (const EventEntry& event : parseCapture(capture)) {
+            pushed = pipeline.push(event) && pushed;
+        }
+        
+        std::string output;
+        char row[128];
+        LogItem item;
+        while (pipeline.next(item)) {
+            if (item.record) {
+                const LogRecord& record = *item.record;
+                int length = snprintf(row, sizeof(row), "%s,,%lu,%u", recordTypeToString(static_cast<RecordType>(record.type)),
+                                      static_cast<unsigned long>(record.timestamp), static_cast<unsigned>(record.micros));
+                for (uint8_t i = 0; i < record.numFields; i++) {
+                    length += snprintf(row + length, sizeof(row) - length, ",%ld", static_cast<long>(record.fields[i]));
+                }
+            } else {
+                const EventEntry& event = *item.event;
+                snprintf(row, sizeof(row), "%s,%s,%lu,%u", signalTypeToString(static_cast<SignalType>(event.signalType)),
+                         edgeTypeToString(static_cast<EdgeType>(event.edgeType)),
+                         static_cast<unsigned long>(event.timestamp), static_cast<unsigned>(event.micros));
+            }
+            output += row;
+            output += '\n';
+            pipeline.pop();
+        }
+        
+        if (!pushed) {
+            output += "(pipeline full)\n";
+        }
+        if (!pipeline.isEmpty()) {
+            output += "(held back)\n";
+        }
+        return output;
+    }
+}
+
+// Frame of 13:00 (0b1010011) from BA rising at 10000ms, up to the start of
+// the end pulse
+#define FRAME_13H \
+    "BA,R,10000,0\n" \
+    "MU,R,10004,0\n" \
+    "MU,F,10012,0\n" \
+    "MU,R,10020,0\n" \
+    "MU,F,10028,0\n" \
+    "MU,R,10044,0\n"
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_mu_falls_first() {
+    TEST_ASSERT_EQUAL_STRING(
+        "RF,R,9900,0\n"
+        "HF,,10000,0,1,13,83,0,0\n"
+        "RF,F,10100,0\n",
+        replay("RF,R,9900,0\n" FRAME_13H
+               "MU,F,10064,0\n"
+               "BA,F,10064,300\n"
+               "RF,F,10100,0\n").c_str());
+}
+
+void test_ba_falls_first() {
+    // The MU edge after the record belongs to the frame
+    TEST_ASSERT_EQUAL_STRING(
+        "RF,R,9900,0\n"
+        "HF,,10000,0,1,13,83,0,0\n"
+        "RF,F,10100,0\n",
+        replay("RF,R,9900,0\n" FRAME_13H
+               "BA,F,10064,0\n"
+               "MU,F,10064,400\n"
+               "RF,F,10100,0\n").c_str());
+}
+
+void test_ba_falls_first_same_millisecond() {
+    // Capture at millisecond resolution, the end pulse measured 3ms
+    TEST_ASSERT_EQUAL_STRING(
+        "HF,,5046,0,1,13,83,1000,166\n"
+        "RF,R,5200,0\n",
+        replay("BA,R,5046\n"
+               "MU,R,5050\n"
+               "MU,F,5058\n"
+               "MU,R,5066\n"
+               "MU,F,5074\n"
+               "MU,R,5090\n"
+               "BA,F,5109\n"
+               "MU,F,5109\n"
+               "RF,R,5200\n").c_str());
+}
+
+void test_edge_between_ba_and_mu_falling() {
+    // Another signal in between does not close the frame
+    TEST_ASSERT_EQUAL_STRING(
+        "HF,,10000,0,1,13,83,0,0\n"
+        "RF,R,10064,200\n"
+        "RF,F,10100,0\n",
+        replay(FRAME_13H
+               "BA,F,10064,0\n"
+               "RF,R,10064,200\n"
+               "MU,F,10064,500\n"
+               "RF,F,10100,0\n").c_str());
+}
+
+void test_mu_falls_late() {
+    // Past END_SKEW_MAX, MU no longer ends the frame
+    TEST_ASSERT_EQUAL_STRING(
+        "HF,,10000,0,1,13,83,0,0\n"
+        "MU,F,10066,0\n",
+        replay(FRAME_13H
+               "BA,F,10064,0\n"
+               "MU,F,10066,0\n").c_str());
+}
+
+void test_consecutive_frames() {
+    // Hourly frames, BA falling first on the first one
+    TEST_ASSERT_EQUAL_STRING(
+        "HF,,10000,0,1,13,83,0,0\n"
+        "HF,,3610000,0,1,14,84,0,0\n",
+        replay(FRAME_13H
+               "BA,F,10064,0\n"
+               "MU,F,10064,100\n"
+               "BA,R,3610000,0\n"
+               "MU,R,3610004,0\n"
+               "MU,F,3610012,0\n"
+               "MU,R,3610020,0\n"
+               "MU,F,3610028,0\n"
+               "MU,R,3610036,0\n"
+               "MU,F,3610044,0\n"
+               "MU,R,3610060,0\n"
+               "MU,F,3610064,0\n"
+               "BA,F,3610064,0\n").c_str());
+}
+
+void test_malformed_frame_keeps_events() {
+    // BA falls early: invalid record, the events are kept
+    TEST_ASSERT_EQUAL_STRING(
+        "HF,,10000,0,0,-1,-1,0,0\n"
+        "BA,R,10000,0\n"
+        "MU,R,10004,0\n"
+        "MU,F,10012,0\n"
+        "BA,F,10030,0\n",
+        replay("BA,R,10000,0\n"
+               "MU,R,10004,0\n"
+               "MU,F,10012,0\n"
+               "BA,F,10030,0\n").c_str());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_mu_falls_first);
+    RUN_TEST(test_ba_falls_first);
+    RUN_TEST(test_ba_falls_first_same_millisecond);
+    RUN_TEST(test_edge_between_ba_and_mu_falling);
+    RUN_TEST(test_mu_falls_late);
+    RUN_TEST(test_consecutive_frames);
+    RUN_TEST(test_malformed_frame_keeps_events);
+    return UNITY_END();
+}
@@ -0,0 +1,238 @@
+/**
+ * Stress test of the lock-free SPSC ring buffer (RingBuffer.h).
+ *
+ * Events follow a deterministic pattern, with small deltas packed in one slot
+ * and jumps ahead, back and across the 32-bit millis() wrap taking a sync
+ * entry. A producer thread writes them as the ISR would, dropping what does
+ * not fit, while a consumer thread drains them with readSpan()/commit() and
+ * read(). Every event accepted must come out once, in order and unchanged.
+ */
+
+#include <unity.h>
+#include "RingBuffer.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace {
+    // Events of the concurrent test, about 60 passes over the buffer
+    constexpr size_t STRESS_EVENTS = 60 * BufferConfig::BUFFER_SIZE;
+    
+    // Delta limit of a packed slot, in microseconds (27 bits)
+    constexpr uint64_t MAX_PACKED_DELTA_US = (1ULL << 27) - 1;
+    
+    RingBuffer buffer;
+    
+    /**
+     * Event number i of the pattern
+     * Every 997th event jumps 200s ahead and every 1999th goes 1s back, both
+     * taking a sync entry. The pattern starts 10s before the millis() wrap.
+     */
+    EventEntry patternEvent(size_t i) {
+        static std::vector<uint64_t> times;
+        while (times.size() <= i) {
+            size_t n = times.size();
+            uint64_t time = n == 0 ? (1ULL << 32) * 1000 - 10000000 : times.back();
+            if (n % 997 == 996) {
+                time += 200000000;
+            } else if (n % 1999 == 1998) {
+                time -= 1000000;
+            } else {
+                time += 1 + (n * 7919) % 5000;
+            }
+            times.push_back(time);
+        }
+        uint64_t time = times[i];
+        return {static_cast<uint8_t>(i % Signals::COUNT), static_cast<uint8_t>((i / Signals::COUNT) & 1),
+                static_cast<uint16_t>(time % 1000), static_cast<uint32_t>(time / 1000)};
+    }
+    
+    bool sameEvent(const EventEntry& a, const EventEntry& b) {
+        return a.signalType == b.signalType && a.edgeType == b.edgeType && a.micros == b.micros
+            && a.timestamp == b.timestamp;
+    }
+}
+
+void setUp() {
+    buffer.reset();
+    buffer.setWatermarkHandler(0, nullptr);
+}
+
+void tearDown() {}
+
+void test_sync_entries_round_trip() {
+    // Packed, past the packed delta, backwards, across the millis() wrap
+    const EventEntry events[] = {
+        {0, EDGE_RISING, 250, 1000},
+        {1, EDGE_FALLING, 999, 1000 + MAX_PACKED_DELTA_US / 1000},
+        {2, EDGE_RISING, 0, 1000 + MAX_PACKED_DELTA_US / 1000 + 1000},
+        {3, EDGE_FALLING, 500, 900},
+        {0, EDGE_RISING, 999, 0xFFFFFFFF},
+        {1, EDGE_FALLING, 1, 0},
+    };
+    constexpr size_t NUM_EVENTS = sizeof(events) / sizeof(events[0]);
+    for (const EventEntry& event : events) {
+        TEST_ASSERT_TRUE(buffer.write(static_cast<SignalType>(event.signalType),
+                                      static_cast<EdgeType>(event.edgeType), event.timestamp, event.micros));
+    }
+    
+    // One slot per event, two for each jump
+    TEST_ASSERT_EQUAL(NUM_EVENTS + 4, buffer.getCount());
+    
+    EventEntry read[NUM_EVENTS + 1];
+    TEST_ASSERT_EQUAL(NUM_EVENTS, buffer.read(read, NUM_EVENTS + 1));
+    for (size_t i = 0; i < NUM_EVENTS; i++) {
+        TEST_ASSERT_TRUE(sameEvent(events[i], read[i]));
+    }
+    TEST_ASSERT_TRUE(buffer.isEmpty());
+}
+
+void test_wrap_around_with_partial_commits() {
+    // Keep the buffer about half full, committing fewer events than read,
+    // for several passes over the slots
+    size_t written = 0;
+    size_t checked = 0;
+    while (checked < 5 * BufferConfig::BUFFER_SIZE) {
+        while (buffer.getCount() < BufferConfig::BUFFER_SIZE / 2) {
+            EventEntry event = patternEvent(written);
+            TEST_ASSERT_EQUAL(1, buffer.write(&event, 1));
+            written++;
+        }
+        
+        const EventEntry* events;
+        size_t available = buffer.readSpan(events);
+        TEST_ASSERT_GREATER_THAN(0, available);
+        size_t numEvents = std::min(available, 1 + checked % 97);
+        for (size_t i = 0; i < numEvents; i++) {
+            TEST_ASSERT_TRUE(sameEvent(patternEvent(checked + i), events[i]));
+        }
+        buffer.commit(numEvents);
+        checked += numEvents;
+    }
+    TEST_ASSERT_EQUAL(0, buffer.getDroppedCount());
+}
+
+void test_full_buffer_drops_and_recovers() {
+    size_t written = 0;
+    while (buffer.write(static_cast<SignalType>(0), EDGE_RISING, static_cast<uint32_t>(written), 0)) {
+        written++;
+    }
+    
+    // One slot each, the timestamps being close to the start
+    TEST_ASSERT_EQUAL(BufferConfig::BUFFER_SIZE, written);
+    TEST_ASSERT_EQUAL(1, buffer.getDroppedCount());
+    TEST_ASSERT_EQUAL(BufferConfig::BUFFER_SIZE, buffer.getPeakCount());
+    
+    // A batch not fitting is written up to the room left
+    EventEntry batch[4] = {};
+    TEST_ASSERT_EQUAL(0, buffer.write(batch, 4));
+    TEST_ASSERT_EQUAL(5, buffer.getDroppedCount());
+    
+    EventEntry read[16];
+    TEST_ASSERT_EQUAL(16, buffer.read(read, 16));
+    TEST_ASSERT_EQUAL(0, read[0].timestamp);
+    TEST_ASSERT_EQUAL(15, read[15].timestamp);
+    for (size_t i = 0; i < 4; i++) {
+        batch[i] = {1, EDGE_FALLING, 0, static_cast<uint32_t>(written + i)};
+    }
+    TEST_ASSERT_EQUAL(4, buffer.write(batch, 4));
+}
+
+void test_concurrent_producer_consumer() {
+    std::vector<uint8_t> accepted(STRESS_EVENTS);
+    std::vector<EventEntry> received;
+    received.reserve(STRESS_EVENTS);
+    for (size_t i = 0; i < STRESS_EVENTS; i++) {
+        patternEvent(i);
+    }
+    std::atomic<bool> producing(true);
+    
+    auto start = std::chrono::steady_clock::now();
+    std::thread producer([&]() {
+        // Single events as the GPIO interrupts, batches of 4 as the RMT task,
+        // in bursts
+        size_t i = 0;
+        while (i < STRESS_EVENTS) {
+            if (i % 1024 == 0) {
+                std::this_thread::yield();
+            }
+            if (i % 64 < 60) {
+                EventEntry event = patternEvent(i);
+                accepted[i] = buffer.write(static_cast<SignalType>(event.signalType),
+                                           static_cast<EdgeType>(event.edgeType), event.timestamp, event.micros);
+                i++;
+            } else {
+                EventEntry batch[4];
+                size_t numEvents = std::min<size_t>(4, STRESS_EVENTS - i);
+                for (size_t j = 0; j < numEvents; j++) {
+                    batch[j] = patternEvent(i + j);
+                }
+                size_t written = buffer.write(batch, numEvents);
+                for (size_t j = 0; j < numEvents; j++) {
+                    accepted[i + j] = j < written;
+                }
+                i += numEvents;
+            }
+        }
+        producing = false;
+    });
+    std::thread consumer([&]() {
+        // Alternate the in-place reads and the copies, pausing now and then so
+        // that the buffer fills up and drops
+        EventEntry copies[BufferConfig::READ_WINDOW_SIZE];
+        size_t reads = 0;
+        while (producing || !buffer.isEmpty()) {
+            if (reads % 2 == 0) {
+                const EventEntry* events;
+                size_t numEvents = buffer.readSpan(events);
+                numEvents = std::min(numEvents, 1 + reads % BufferConfig::READ_WINDOW_SIZE);
+                received.insert(received.end(), events, events + numEvents);
+                buffer.commit(numEvents);
+            } else {
+                size_t numEvents = buffer.read(copies, BufferConfig::READ_WINDOW_SIZE);
+                received.insert(received.end(), copies, copies + numEvents);
+            }
+            if (++reads % 512 == 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+        }
+    });
+    producer.join();
+    consumer.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    // Accepted events in order, against what came out
+    size_t numAccepted = 0;
+    size_t reordered = 0;
+    for (size_t i = 0; i < STRESS_EVENTS; i++) {
+        if (!accepted[i]) {
+            continue;
+        }
+        if (numAccepted < received.size() && !sameEvent(patternEvent(i), received[numAccepted])) {
+            reordered++;
+        }
+        numAccepted++;
+    }
+    size_t lost = numAccepted > received.size() ? numAccepted - received.size() : 0;
+    
+    char message[160];
+    snprintf(message, sizeof(message), "%zu events through in %.3f s (%.1f M events/s), %zu dropped, %zu lost, "
+             "%zu reordered", received.size(), seconds, received.size() / seconds / 1e6, STRESS_EVENTS - numAccepted,
+             lost, reordered);
+    TEST_MESSAGE(message);
+    
+    TEST_ASSERT_EQUAL(0, lost);
+    TEST_ASSERT_EQUAL(0, reordered);
+    TEST_ASSERT_EQUAL(numAccepted, received.size());
+    TEST_ASSERT_EQUAL(STRESS_EVENTS - numAccepted, buffer.getDroppedCount());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_sync_entries_round_trip);
+    RUN_TEST(test_wrap_around_with_partial_commits);
+    RUN_TEST(test_full_buffer_drops_and_recovers);
+    RUN_TEST(test_concurrent_producer_consumer);
+    return UNITY_END();
+}
@@ -0,0 +1,187 @@
+/**
+ * Benchmark of the SD card write path, on the host file system (NativeHal).
+ *
+ * The same events are saved twice: by the per-row path of the first versions
+ * (open the file, println() each event, close it at the end of the flush),
+ * and by SDCardManager, formatting into the staging buffer and writing whole
+ * sectors. Both files must hold the same event rows; the write calls, the
+ * bytes per call and the throughput of both paths are reported.
+ */
+
+#include <unity.h>
+#include "SDCardManager.h"
+#include <NativeHal.h>
+#include <Preferences.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+    constexpr size_t NUM_EVENTS = 100000;
+    
+    // Events per flush, a busy commit interval
+    constexpr size_t FLUSH_EVENTS = 2000;
+    
+    // Assumed time the card takes per write call (command, busy wait), on top
+    // of the host time, for the throughput at the card
+    constexpr double CARD_CALL_US = 200.0;
+    
+    const char* const LEGACY_PATH = "/legacy.csv";
+    
+    std::filesystem::path rootDirectory() {
+        return std::filesystem::temp_directory_path() / "sniffer_test_sd_write";
+    }
+    
+    // Write activity of a path
+    struct PathStats {
+        uint32_t writes;
+        uint64_t bytes;
+        double seconds;
+    };
+    
+    /**
+     * Event number i: PON edges, which no decoder holds back, a few
+     * milliseconds apart
+     */
+    EventEntry makeEvent(size_t i) {
+        uint64_t time = 5000000 + i * 2347ULL;
+        return {PON_SIGNAL, static_cast<uint8_t>(i % 2 == 0 ? EDGE_RISING : EDGE_FALLING),
+                static_cast<uint16_t>(time % 1000), static_cast<uint32_t>(time / 1000)};
+    }
+    
+    /**
+     * Run a write path, measuring the SD card activity and the host time
+     */
+    template <typename Function>
+    PathStats measure(Function writePath) {
+        NativeHal::CardStats before = NativeHal::getCardStats();
+        auto start = std::chrono::steady_clock::now();
+        writePath();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        NativeHal::CardStats after = NativeHal::getCardStats();
+        return {after.writes - before.writes, after.bytesWritten - before.bytesWritten, seconds};
+    }
+    
+    /**
+     * Per-row path: a println() per event, the file opened for each flush
+     * @return true if all events were written
+     */
+    bool legacyFlush(const EventEntry* events, size_t numEvents) {
+        if (!SD.exists(LEGACY_PATH)) {
+            File header = SD.open(LEGACY_PATH, FILE_WRITE);
+            if (!header || header.println(BufferConfig::CSV_HEADER) == 0) {
+                return false;
+            }
+            header.close();
+        }
+        
+        File dataFile = SD.open(LEGACY_PATH, FILE_APPEND);
+        if (!dataFile) {
+            return false;
+        }
+        char csvLine[64];
+        for (size_t i = 0; i < numEvents; i++) {
+            snprintf(csvLine, sizeof(csvLine), "%s,%s,%lu,%u",
+                     signalTypeToString(static_cast<SignalType>(events[i].signalType)),
+                     edgeTypeToString(static_cast<EdgeType>(events[i].edgeType)),
+                     static_cast<unsigned long>(events[i].timestamp), static_cast<unsigned>(events[i].micros));
+            if (dataFile.println(csvLine) == 0) {
+                return false;
+            }
+        }
+        dataFile.close();
+        return true;
+    }
+    
+    /**
+     * Read the event rows of a data file, the rows with an edge
+     */
+    std::vector<std::string> readEventRows(const char* path) {
+        std::vector<std::string> rows;
+        std::ifstream file(rootDirectory().string() + path);
+        std::string line;
+        while (std::getline(file, line)) {
+            size_t comma = line.find(',');
+            if (comma != std::string::npos && (line.compare(comma, 3, ",R,") == 0 || line.compare(comma, 3, ",F,") == 0)) {
+                rows.push_back(line);
+            }
+        }
+        return rows;
+    }
+    
+    void reportPath(const char* name, const PathStats& stats) {
+        double cardSeconds = stats.seconds + stats.writes * CARD_CALL_US / 1e6;
+        char message[200];
+        snprintf(message, sizeof(message),
+                 "%-8s %7lu writes, %6.1f bytes/write, host %7.1f KB/s, card at %.0fus/write %7.1f KB/s", name,
+                 static_cast<unsigned long>(stats.writes), stats.writes > 0 ? double(stats.bytes) / stats.writes : 0.0,
+                 stats.bytes / stats.seconds / 1024, CARD_CALL_US, stats.bytes / cardSeconds / 1024);
+        TEST_MESSAGE(message);
+    }
+}
+
+void setUp() {
+    std::error_code error;
+    std::filesystem::remove_all(rootDirectory(), error);
+    SD.setRoot((rootDirectory() / "sd").string());
+    Preferences::setRoot((rootDirectory() / "nvs").string());
+    NativeHal::setSerialEnabled(false);
+    NativeHal::begin(1.0, 0);
+}
+
+void tearDown() {
+    std::error_code error;
+    std::filesystem::remove_all(rootDirectory(), error);
+}
+
+void test_staged_path_against_per_row_path() {
+    std::vector<EventEntry> events(NUM_EVENTS);
+    for (size_t i = 0; i < NUM_EVENTS; i++) {
+        events[i] = makeEvent(i);
+    }
+    
+    RingBuffer ring;
+    EventPipeline pipeline;
+    PipelineMetrics metrics(ring);
+    SDCardManager manager(ring, pipeline, metrics);
+    TEST_ASSERT_TRUE(manager.begin());
+    
+    PathStats legacy = measure([&]() {
+        for (size_t i = 0; i < NUM_EVENTS; i += FLUSH_EVENTS) {
+            TEST_ASSERT_TRUE(legacyFlush(&events[i], std::min(FLUSH_EVENTS, NUM_EVENTS - i)));
+        }
+    });
+    
+    // The ring buffer holds a flush worth of events, the last flush syncs
+    PathStats staged = measure([&]() {
+        for (size_t i = 0; i < NUM_EVENTS; i += FLUSH_EVENTS) {
+            size_t numEvents = std::min(FLUSH_EVENTS, NUM_EVENTS - i);
+            TEST_ASSERT_EQUAL(numEvents, ring.write(&events[i], numEvents));
+            TEST_ASSERT_TRUE(manager.saveEvents(i + numEvents == NUM_EVENTS));
+        }
+    });
+    TEST_ASSERT_FALSE(manager.hasStagedData());
+    
+    reportPath("per-row", legacy);
+    reportPath("staged", staged);
+    
+    // Same rows, whatever the path
+    std::vector<std::string> legacyRows = readEventRows("/sd/legacy.csv");
+    std::vector<std::string> stagedRows = readEventRows("/sd/log/00001.csv");
+    TEST_ASSERT_EQUAL(NUM_EVENTS, legacyRows.size());
+    TEST_ASSERT_TRUE(legacyRows == stagedRows);
+    
+    // Two calls per row and for the header, against whole sectors but for the
+    // synced tail
+    TEST_ASSERT_EQUAL(2 * NUM_EVENTS + 2, legacy.writes);
+    TEST_ASSERT_GREATER_OR_EQUAL(BufferConfig::SD_SECTOR_SIZE, staged.bytes / staged.writes);
+    TEST_ASSERT_LESS_THAN(legacy.writes / 100, staged.writes);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_staged_path_against_per_row_path);
+    return UNITY_END();
+}